@@ -28,7 +28,8 @@ set compiler_args=^
 -IE:/Tools/glfw/include/GLFW ^
 -IE:/Tools/VulkanSDK/Include ^
 -IE:/Tools/VulkanSDK/Third-Party/Include/glm ^
--DSLOW
+-DSLOW ^
+-DENABLE_TRACING
 
 set linker_args=^
 E:/Tools/glfw/build/src/Debug/glfw3.lib ^
@@ -39,6 +40,7 @@ pushd build
 
 glslc ../src/shaders/simple.vert -o ../engine/shaders/simple.vert.spv
 glslc ../src/shaders/simple.frag -o ../engine/shaders/simple.frag.spv
+glslc ../src/shaders/cull.comp -o ../engine/shaders/cull.comp.spv
 
 cl %compiler_args% ../src/*.cpp /link /NODEFAULTLIB:library %linker_args% && echo [32mBuild successfull[0m || echo [31mBuild failed[0m
 
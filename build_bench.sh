@@ -0,0 +1,22 @@
+#!/bin/sh
+# Builds the headless benchmark on Linux, run it from the engine directory like the engine itself.
+# Optimized and without validation layers, so the numbers mean something. Needs glslc, the Vulkan loader and glfw
+
+set -e
+
+mkdir -p build engine/shaders
+
+glslc src/shaders/bench.vert -o engine/shaders/bench.vert.spv
+glslc src/shaders/bench.frag -o engine/shaders/bench.frag.spv
+
+# everything the engine builds except its own main
+sources=$(ls src/*.cpp | grep -v '^src/main.cpp$')
+
+c++ -std=c++14 -O2 -g -DNDEBUG \
+    -Wall -Wno-write-strings -Wno-unused-parameter -Wno-missing-field-initializers \
+    -Isrc -I/usr/include/GLFW \
+    $sources src/bench/*.cpp \
+    -o build/vulkan_engine_bench \
+    -lvulkan -lglfw -lpthread
+
+echo "Build successful: build/vulkan_engine_bench"
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "utils/utils.h"
+
+// Alignment need not be a power of two, the upload ring also rounds up to its staging size
+inline u64 AlignUp( u64 value, u64 alignment )
+{
+    return ( value + alignment - 1 ) / alignment * alignment;
+}
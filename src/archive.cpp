@@ -0,0 +1,432 @@
+#include "archive.h"
+#include "platform.h"
+#include "hash.h"
+#include "align.h"
+#include "trace.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include <vector> //@TODO: Remove std garbage
+#include <algorithm>
+#include <mutex>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+bool MapFile( Mapped_File *file, char *path )
+{
+    *file = {};
+#ifdef _WIN32
+    HANDLE fileHandle = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+    if ( fileHandle == INVALID_HANDLE_VALUE )
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if ( !GetFileSizeEx( fileHandle, &size ) || size.QuadPart == 0 )
+    {
+        CloseHandle( fileHandle );
+        return false;
+    }
+
+    HANDLE mappingHandle = CreateFileMappingA( fileHandle, 0, PAGE_READONLY, 0, 0, 0 );
+    if ( !mappingHandle )
+    {
+        CloseHandle( fileHandle );
+        return false;
+    }
+
+    void *data = MapViewOfFile( mappingHandle, FILE_MAP_READ, 0, 0, 0 );
+    if ( !data )
+    {
+        CloseHandle( mappingHandle );
+        CloseHandle( fileHandle );
+        return false;
+    }
+
+    file->data = data;
+    file->size = ( u64 ) size.QuadPart;
+    file->fileHandle = fileHandle;
+    file->mappingHandle = mappingHandle;
+#else
+    int fd = open( path, O_RDONLY );
+    if ( fd < 0 )
+    {
+        return false;
+    }
+
+    struct stat fileStat;
+    if ( fstat( fd, &fileStat ) != 0 || fileStat.st_size == 0 )
+    {
+        close( fd );
+        return false;
+    }
+
+    void *data = mmap( 0, ( size_t ) fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    if ( data == MAP_FAILED )
+    {
+        close( fd );
+        return false;
+    }
+
+    file->data = data;
+    file->size = ( u64 ) fileStat.st_size;
+    file->fd = fd;
+#endif
+    return true;
+}
+
+void UnmapFile( Mapped_File *file )
+{
+    if ( !file->data )
+    {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile( file->data );
+    CloseHandle( file->mappingHandle );
+    CloseHandle( file->fileHandle );
+#else
+    munmap( file->data, ( size_t ) file->size );
+    close( file->fd );
+#endif
+    *file = {};
+}
+
+bool EvictFileFromPageCache( char *path )
+{
+#ifdef __linux__
+    int fd = open( path, O_RDONLY );
+    if ( fd < 0 )
+    {
+        return false;
+    }
+    bool evicted = posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED ) == 0;
+    close( fd );
+    return evicted;
+#else
+    return false;
+#endif
+}
+
+// Hints have to start on a page boundary
+static void AdviseWillNeed( void *data, u64 size )
+{
+#ifdef _WIN32
+    WIN32_MEMORY_RANGE_ENTRY range = { data, ( SIZE_T ) size };
+    PrefetchVirtualMemory( GetCurrentProcess(), 1, &range, 0 );
+#else
+    u64 pageSize = ( u64 ) sysconf( _SC_PAGESIZE );
+    u64 start = ( u64 ) data & ~( pageSize - 1 );
+    madvise( ( void * ) start, ( size_t ) ( ( u64 ) data + size - start ), MADV_WILLNEED );
+#endif
+}
+
+bool OpenArchive( Asset_Archive *archive, char *path )
+{
+    TRACE_FUNCTION();
+    *archive = {};
+    if ( !MapFile( &archive->file, path ) )
+    {
+        printf( "Could not map archive: %s\n", path );
+        return false;
+    }
+
+    u8 *base = ( u8 * ) archive->file.data;
+    u64 fileSize = archive->file.size;
+    Archive_Header *header = ( Archive_Header * ) base;
+    if ( fileSize < sizeof( Archive_Header ) || header->magic != ARCHIVE_MAGIC || header->version != ARCHIVE_VERSION ||
+         header->fileSize != fileSize )
+    {
+        printf( "Invalid archive header: %s\n", path );
+        CloseArchive( archive );
+        return false;
+    }
+
+    u64 entriesSize = ( u64 ) header->entryCount * sizeof( Archive_Entry );
+    if ( header->entriesOffset > fileSize || entriesSize > fileSize - header->entriesOffset ||
+         header->entriesOffset % alignof( Archive_Entry ) != 0 )
+    {
+        printf( "Archive entry table is out of bounds: %s\n", path );
+        CloseArchive( archive );
+        return false;
+    }
+
+    Archive_Entry *entries = ( Archive_Entry * ) ( base + header->entriesOffset );
+    if ( HashBytes64( entries, entriesSize ) != header->entriesHash )
+    {
+        printf( "Archive entry table is corrupt: %s\n", path );
+        CloseArchive( archive );
+        return false;
+    }
+
+    for ( u32 i = 0; i < header->entryCount; ++i )
+    {
+        Archive_Entry *entry = &entries[ i ];
+        if ( entry->offset > fileSize || entry->size > fileSize - entry->offset ||
+             entry->name[ ARCHIVE_NAME_SIZE - 1 ] != 0 || ( i > 0 && entries[ i - 1 ].nameHash > entry->nameHash ) )
+        {
+            printf( "Archive entry %u is invalid: %s\n", i, path );
+            CloseArchive( archive );
+            return false;
+        }
+    }
+
+    archive->header = header;
+    archive->entries = entries;
+    return true;
+}
+
+void CloseArchive( Asset_Archive *archive )
+{
+    UnmapFile( &archive->file );
+    archive->header = 0;
+    archive->entries = 0;
+}
+
+Archive_Entry *FindArchiveEntry( Asset_Archive *archive, char *name )
+{
+    u64 nameHash = HashString64( name );
+    u32 low = 0;
+    u32 high = archive->header->entryCount;
+    while ( low < high )
+    {
+        u32 middle = low + ( high - low ) / 2;
+        if ( archive->entries[ middle ].nameHash < nameHash ) low = middle + 1;
+        else high = middle;
+    }
+
+    // the writer rejects hash collisions, the compare guards against names that were never packed
+    if ( low < archive->header->entryCount && archive->entries[ low ].nameHash == nameHash &&
+         strcmp( archive->entries[ low ].name, name ) == 0 )
+    {
+        return &archive->entries[ low ];
+    }
+    return 0;
+}
+
+void *GetArchiveEntryData( Asset_Archive *archive, Archive_Entry *entry )
+{
+    return ( u8 * ) archive->file.data + entry->offset;
+}
+
+bool VerifyArchiveEntry( Asset_Archive *archive, Archive_Entry *entry )
+{
+    TRACE_FUNCTION();
+    return HashBytes64( GetArchiveEntryData( archive, entry ), entry->size ) == entry->contentHash;
+}
+
+void PrefetchArchiveEntry( Asset_Archive *archive, Archive_Entry *entry )
+{
+    if ( entry->size > 0 )
+    {
+        AdviseWillNeed( GetArchiveEntryData( archive, entry ), entry->size );
+    }
+}
+
+void PrefetchArchive( Asset_Archive *archive )
+{
+    AdviseWillNeed( archive->file.data, archive->file.size );
+}
+
+static bool WritePadding( FILE *file, u64 *offset, u64 alignment )
+{
+    static u8 zeros[ ARCHIVE_BLOB_ALIGNMENT ] = {};
+    u64 padding = AlignUp( *offset, alignment ) - *offset;
+    *offset += padding;
+    return padding == 0 || fwrite( zeros, ( size_t ) padding, 1, file ) == 1;
+}
+
+bool WriteArchive( char *path, char **filePaths, char **names, u32 fileCount )
+{
+    TRACE_FUNCTION();
+    std::vector< Archive_Entry > entries( fileCount );
+    std::vector< Asset_Data > blobs( fileCount );
+    defer
+    {
+        for ( auto &blob : blobs ) FreeAsset( &blob );
+    };
+
+    for ( u32 i = 0; i < fileCount; ++i )
+    {
+        if ( strlen( names[ i ] ) >= ARCHIVE_NAME_SIZE )
+        {
+            printf( "Archive entry name is too long: %s\n", names[ i ] );
+            return false;
+        }
+        if ( !LoadLooseAsset( filePaths[ i ], &blobs[ i ] ) )
+        {
+            return false;
+        }
+
+        Archive_Entry *entry = &entries[ i ];
+        *entry = {};
+        entry->nameHash = HashString64( names[ i ] );
+        entry->size = blobs[ i ].size;
+        entry->contentHash = HashBytes64( blobs[ i ].data, blobs[ i ].size );
+        strcpy( entry->name, names[ i ] );
+    }
+
+    FILE *file = OpenFile( path, "wb" );
+    if ( !file )
+    {
+        printf( "Could not create archive: %s\n", path );
+        return false;
+    }
+
+    Archive_Header header = {};
+    header.magic = ARCHIVE_MAGIC;
+    header.version = ARCHIVE_VERSION;
+    header.entryCount = fileCount;
+    header.blobAlignment = ARCHIVE_BLOB_ALIGNMENT;
+
+    // the header is written again once the offsets are known
+    bool written = fwrite( &header, sizeof( header ), 1, file ) == 1;
+    u64 offset = sizeof( header );
+    for ( u32 i = 0; i < fileCount && written; ++i )
+    {
+        written = WritePadding( file, &offset, ARCHIVE_BLOB_ALIGNMENT );
+        entries[ i ].offset = offset;
+        written = written && ( blobs[ i ].size == 0 || fwrite( blobs[ i ].data, ( size_t ) blobs[ i ].size, 1, file ) == 1 );
+        offset += blobs[ i ].size;
+    }
+
+    std::sort( entries.begin(), entries.end(),
+               []( Archive_Entry &a, Archive_Entry &b ) { return a.nameHash < b.nameHash; } );
+    for ( u32 i = 1; i < fileCount; ++i )
+    {
+        if ( entries[ i - 1 ].nameHash == entries[ i ].nameHash )
+        {
+            printf( "Archive entries %s and %s have the same name hash\n", entries[ i - 1 ].name, entries[ i ].name );
+            written = false;
+        }
+    }
+
+    u64 entriesSize = ( u64 ) fileCount * sizeof( Archive_Entry );
+    written = written && WritePadding( file, &offset, ARCHIVE_BLOB_ALIGNMENT );
+    header.entriesOffset = offset;
+    header.entriesHash = HashBytes64( entries.data(), entriesSize );
+    header.fileSize = offset + entriesSize;
+    written = written && ( fileCount == 0 || fwrite( entries.data(), ( size_t ) entriesSize, 1, file ) == 1 );
+    written = written && fseek( file, 0, SEEK_SET ) == 0 && fwrite( &header, sizeof( header ), 1, file ) == 1;
+    fclose( file );
+
+    if ( !written )
+    {
+        printf( "Failed to write archive: %s\n", path );
+        remove( path );
+        return false;
+    }
+    printf( "Packed %u files into %s (%.2f KB)\n", fileCount, path, ( float64 ) header.fileSize / 1024.0 );
+    return true;
+}
+
+struct Asset_Mount
+{
+    Asset_Archive *archive;
+    std::vector< u64 > shadowedNames;
+    // the shader reload thread loads while the main thread does
+    std::mutex mutex;
+};
+
+static Asset_Mount assetMount;
+
+void MountArchive( Asset_Archive *archive )
+{
+    std::lock_guard< std::mutex > lock( assetMount.mutex );
+    assetMount.archive = archive;
+}
+
+void UnmountArchive()
+{
+    std::lock_guard< std::mutex > lock( assetMount.mutex );
+    assetMount.archive = 0;
+    assetMount.shadowedNames.clear();
+}
+
+void ShadowArchiveEntry( char *name )
+{
+    std::lock_guard< std::mutex > lock( assetMount.mutex );
+    u64 nameHash = HashString64( name );
+    if ( std::find( assetMount.shadowedNames.begin(), assetMount.shadowedNames.end(), nameHash ) ==
+         assetMount.shadowedNames.end() )
+    {
+        assetMount.shadowedNames.push_back( nameHash );
+    }
+}
+
+bool LoadAsset( char *path, Asset_Data *asset )
+{
+    {
+        std::lock_guard< std::mutex > lock( assetMount.mutex );
+        Asset_Archive *archive = assetMount.archive;
+        u64 nameHash = HashString64( path );
+        bool shadowed = std::find( assetMount.shadowedNames.begin(), assetMount.shadowedNames.end(), nameHash ) !=
+                        assetMount.shadowedNames.end();
+        Archive_Entry *entry = archive && !shadowed ? FindArchiveEntry( archive, path ) : 0;
+        if ( entry )
+        {
+            asset->data = GetArchiveEntryData( archive, entry );
+            asset->size = entry->size;
+            asset->owned = false;
+            return true;
+        }
+    }
+    return LoadLooseAsset( path, asset );
+}
+
+bool LoadLooseAsset( char *path, Asset_Data *asset )
+{
+    TRACE_FUNCTION();
+    *asset = {};
+    FILE *file = OpenFile( path, "rb" );
+    if ( !file )
+    {
+        printf( "Could not read file: %s\n", path );
+        return false;
+    }
+
+#ifdef _WIN32
+    _fseeki64( file, 0, SEEK_END );
+    s64 size = _ftelli64( file );
+    _fseeki64( file, 0, SEEK_SET );
+#else
+    fseeko( file, 0, SEEK_END );
+    s64 size = ( s64 ) ftello( file );
+    fseeko( file, 0, SEEK_SET );
+#endif
+
+    // SPIR-V is read as u32 words, keep the same alignment the archive gives
+    void *data = size > 0 ? AllocateAligned( ( size_t ) size, ARCHIVE_BLOB_ALIGNMENT ) : 0;
+    bool read = size >= 0 && ( size == 0 || ( data && fread( data, ( size_t ) size, 1, file ) == 1 ) );
+    fclose( file );
+
+    if ( !read )
+    {
+        printf( "Could not read file: %s\n", path );
+        FreeAligned( data );
+        return false;
+    }
+
+    asset->data = data;
+    asset->size = ( u64 ) size;
+    asset->owned = true;
+    return true;
+}
+
+void FreeAsset( Asset_Data *asset )
+{
+    if ( asset->owned )
+    {
+        FreeAligned( asset->data );
+    }
+    *asset = {};
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "utils/utils.h"
+
+#define ARCHIVE_MAGIC 0x4b504b56 // "VKPK"
+#define ARCHIVE_VERSION 1
+// Blobs start on cache lines, which also keeps SPIR-V and vertex data aligned for zero copy use
+#define ARCHIVE_BLOB_ALIGNMENT 64
+#define ARCHIVE_NAME_SIZE 96
+
+struct Archive_Header
+{
+    u32 magic;
+    u32 version;
+    u32 entryCount;
+    u32 blobAlignment;
+    u64 fileSize;
+    u64 entriesOffset;
+    u64 entriesHash;
+};
+
+// Sorted by nameHash so lookups are a binary search, names are relative paths like "shaders/simple.vert.spv"
+struct Archive_Entry
+{
+    u64 nameHash;
+    u64 offset;
+    u64 size;
+    u64 contentHash;
+    char name[ ARCHIVE_NAME_SIZE ];
+};
+
+struct Mapped_File
+{
+    void *data;
+    u64 size;
+#ifdef _WIN32
+    void *fileHandle;
+    void *mappingHandle;
+#else
+    int fd;
+#endif
+};
+
+// Read only and mapped, blobs are used straight from the page cache
+struct Asset_Archive
+{
+    Mapped_File file;
+    Archive_Header *header;
+    Archive_Entry *entries;
+};
+
+struct Asset_Data
+{
+    void *data;
+    u64 size;
+    // loose files are read into memory, archive blobs point into the mapping
+    bool owned;
+};
+
+bool MapFile( Mapped_File *file, char *path );
+void UnmapFile( Mapped_File *file );
+
+// Drops the file's clean pages so the next read comes from disk, only implemented on Linux
+bool EvictFileFromPageCache( char *path );
+
+// Validates the header, the entry table and every entry's bounds, not the blob contents
+bool OpenArchive( Asset_Archive *archive, char *path );
+void CloseArchive( Asset_Archive *archive );
+
+Archive_Entry *FindArchiveEntry( Asset_Archive *archive, char *name );
+void *GetArchiveEntryData( Asset_Archive *archive, Archive_Entry *entry );
+
+// Hashes the blob, touches every page of it
+bool VerifyArchiveEntry( Asset_Archive *archive, Archive_Entry *entry );
+
+// madvise hints, the kernel reads ahead in the background and the first touch doesn't stall on the disk
+void PrefetchArchiveEntry( Asset_Archive *archive, Archive_Entry *entry );
+void PrefetchArchive( Asset_Archive *archive );
+
+// Packs the files under the names given, pass the paths themselves as names to look them up by path
+bool WriteArchive( char *path, char **filePaths, char **names, u32 fileCount );
+
+// Assets are looked up in the mounted archive first and fall back to loose files
+void MountArchive( Asset_Archive *archive );
+void UnmountArchive();
+
+// From now on the loose file wins over the archive, for files rewritten at runtime like hot reloaded shaders
+void ShadowArchiveEntry( char *name );
+
+bool LoadAsset( char *path, Asset_Data *asset );
+bool LoadLooseAsset( char *path, Asset_Data *asset );
+void FreeAsset( Asset_Data *asset );
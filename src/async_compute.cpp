@@ -0,0 +1,310 @@
+#include "async_compute.h"
+#include "trace.h"
+#include "stdio.h"
+#include <vector> //@TODO: Remove std garbage
+
+bool InitAsyncCompute( Async_Compute *compute, Device *device, u32 framesInFlight )
+{
+    *compute = {};
+    compute->device = device;
+    compute->queue = device->computeQueue;
+    compute->queueFamily = device->queueFamilies.computeFamily;
+    compute->dedicated = device->queueFamilies.computeFamily != device->queueFamilies.graphicsFamily;
+    compute->nextTimelineValue = 1;
+    compute->framesInFlight = framesInFlight;
+
+    if ( framesInFlight > ASYNC_COMPUTE_MAX_FRAMES )
+    {
+        printf( "Async compute supports at most %u frames in flight!\n", ASYNC_COMPUTE_MAX_FRAMES );
+        return false;
+    }
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = compute->queueFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    if ( vkCreateCommandPool( device->device, &poolInfo, 0, &compute->commandPool ) != VK_SUCCESS )
+    {
+        printf( "Failed to create async compute command pool!\n" );
+        return false;
+    }
+
+    VkCommandBuffer commandBuffers[ ASYNC_COMPUTE_MAX_FRAMES ];
+    VkCommandBufferAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocateInfo.commandPool = compute->commandPool;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount = framesInFlight;
+    if ( vkAllocateCommandBuffers( device->device, &allocateInfo, commandBuffers ) != VK_SUCCESS )
+    {
+        printf( "Failed to allocate async compute command buffers!\n" );
+        DestroyAsyncCompute( compute );
+        return false;
+    }
+    for ( u32 i = 0; i < framesInFlight; ++i )
+    {
+        compute->frames[ i ].commandBuffer = commandBuffers[ i ];
+    }
+
+    VkSemaphoreTypeCreateInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &timelineInfo;
+    if ( vkCreateSemaphore( device->device, &semaphoreInfo, 0, &compute->timeline ) != VK_SUCCESS )
+    {
+        printf( "Failed to create async compute timeline semaphore!\n" );
+        DestroyAsyncCompute( compute );
+        return false;
+    }
+
+    // both queues have to write timestamps for the intervals to be compared
+    u32 queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties( device->physicalDevice, &queueFamilyCount, 0 );
+    std::vector< VkQueueFamilyProperties > queueFamilies( queueFamilyCount );
+    vkGetPhysicalDeviceQueueFamilyProperties( device->physicalDevice, &queueFamilyCount, queueFamilies.data() );
+
+    u32 validBits = queueFamilies[ compute->queueFamily ].timestampValidBits;
+    u32 graphicsValidBits = queueFamilies[ device->queueFamilies.graphicsFamily ].timestampValidBits;
+    if ( graphicsValidBits < validBits ) validBits = graphicsValidBits;
+    compute->timestampsSupported = validBits > 0 && device->properties.limits.timestampPeriod > 0.0f;
+    compute->timestampMask = validBits >= 64 ? ~0ull : ( 1ull << validBits ) - 1;
+    compute->timestampPeriod = device->properties.limits.timestampPeriod;
+
+    if ( compute->timestampsSupported )
+    {
+        VkQueryPoolCreateInfo queryPoolInfo = {};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = framesInFlight * ASYNC_COMPUTE_QUERIES_PER_FRAME;
+        if ( vkCreateQueryPool( device->device, &queryPoolInfo, 0, &compute->queryPool ) != VK_SUCCESS )
+        {
+            printf( "Failed to create async compute query pool, overlap won't be measured\n" );
+            compute->queryPool = VK_NULL_HANDLE;
+            compute->timestampsSupported = false;
+        }
+    }
+
+    return true;
+}
+
+void DestroyAsyncCompute( Async_Compute *compute )
+{
+    VkDevice device = compute->device->device;
+    if ( compute->queryPool != VK_NULL_HANDLE )
+    {
+        vkDestroyQueryPool( device, compute->queryPool, 0 );
+        compute->queryPool = VK_NULL_HANDLE;
+    }
+    if ( compute->timeline != VK_NULL_HANDLE )
+    {
+        vkDestroySemaphore( device, compute->timeline, 0 );
+        compute->timeline = VK_NULL_HANDLE;
+    }
+    if ( compute->commandPool != VK_NULL_HANDLE )
+    {
+        // frees the command buffers with it
+        vkDestroyCommandPool( device, compute->commandPool, 0 );
+        compute->commandPool = VK_NULL_HANDLE;
+    }
+}
+
+static u64 GetIntervalOverlap( u64 beginA, u64 endA, u64 beginB, u64 endB )
+{
+    u64 begin = beginA > beginB ? beginA : beginB;
+    u64 end = endA < endB ? endA : endB;
+    return end > begin ? end - begin : 0;
+}
+
+static void ReadAsyncComputeTimestamps( Async_Compute *compute, u32 frameIndex )
+{
+    Async_Compute_Frame *frame = &compute->frames[ frameIndex ];
+    bool measured = frame->computeTimestamps && frame->graphicsTimestamps;
+    frame->computeTimestamps = false;
+    frame->graphicsTimestamps = false;
+    if ( !measured )
+    {
+        compute->previousGraphicsValid = false;
+        return;
+    }
+
+    u64 timestamps[ ASYNC_COMPUTE_QUERIES_PER_FRAME ];
+    VkResult result = vkGetQueryPoolResults( compute->device->device, compute->queryPool, frameIndex * ASYNC_COMPUTE_QUERIES_PER_FRAME,
+                                             ASYNC_COMPUTE_QUERIES_PER_FRAME, sizeof( timestamps ), timestamps, sizeof( u64 ),
+                                             VK_QUERY_RESULT_64_BIT );
+    for ( u32 i = 0; i < ASYNC_COMPUTE_QUERIES_PER_FRAME; ++i )
+    {
+        timestamps[ i ] &= compute->timestampMask;
+    }
+
+    u64 computeBegin = timestamps[ 0 ];
+    u64 computeEnd = timestamps[ 1 ];
+    u64 graphicsBegin = timestamps[ 2 ];
+    u64 graphicsEnd = timestamps[ 3 ];
+    // a counter that wrapped inside the frame can't be compared, the frame is skipped
+    if ( result != VK_SUCCESS || computeEnd < computeBegin || graphicsEnd < graphicsBegin )
+    {
+        compute->previousGraphicsValid = false;
+        return;
+    }
+
+    u64 overlapTicks = GetIntervalOverlap( computeBegin, computeEnd, graphicsBegin, graphicsEnd );
+    if ( compute->previousGraphicsValid )
+    {
+        overlapTicks += GetIntervalOverlap( computeBegin, computeEnd, compute->previousGraphicsBegin, compute->previousGraphicsEnd );
+    }
+    // the next frame's begin timestamp can land before the previous frame's end, don't count that twice
+    if ( overlapTicks > computeEnd - computeBegin ) overlapTicks = computeEnd - computeBegin;
+    compute->previousGraphicsBegin = graphicsBegin;
+    compute->previousGraphicsEnd = graphicsEnd;
+    compute->previousGraphicsValid = true;
+
+    Async_Compute_Stats *stats = &compute->stats;
+    stats->lastComputeMilliseconds = ( float64 ) ( computeEnd - computeBegin ) * compute->timestampPeriod / 1000000.0;
+    stats->lastOverlapMilliseconds = ( float64 ) overlapTicks * compute->timestampPeriod / 1000000.0;
+    if ( stats->lastOverlapMilliseconds > stats->maxOverlapMilliseconds ) stats->maxOverlapMilliseconds = stats->lastOverlapMilliseconds;
+    stats->totalComputeMilliseconds += stats->lastComputeMilliseconds;
+    stats->totalOverlapMilliseconds += stats->lastOverlapMilliseconds;
+    stats->measuredFrames++;
+}
+
+VkCommandBuffer BeginAsyncCompute( Async_Compute *compute, u32 frameIndex )
+{
+    TRACE_FUNCTION();
+    Assert( frameIndex < compute->framesInFlight && !compute->recording );
+    Async_Compute_Frame *frame = &compute->frames[ frameIndex ];
+
+    // the graphics frame that waited on this slot's last submit has finished, so this returns right away
+    if ( frame->timelineValue > 0 )
+    {
+        VkSemaphoreWaitInfo waitInfo = {};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &compute->timeline;
+        waitInfo.pValues = &frame->timelineValue;
+        vkWaitSemaphores( compute->device->device, &waitInfo, UINT64_MAX );
+    }
+
+    if ( compute->timestampsSupported )
+    {
+        ReadAsyncComputeTimestamps( compute, frameIndex );
+    }
+
+    VkCommandBuffer commandBuffer = frame->commandBuffer;
+    vkResetCommandBuffer( commandBuffer, 0 );
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if ( vkBeginCommandBuffer( commandBuffer, &beginInfo ) != VK_SUCCESS )
+    {
+        printf( "Failed to begin recording async compute command buffer!\n" );
+        return VK_NULL_HANDLE;
+    }
+
+    if ( compute->timestampsSupported )
+    {
+        u32 firstQuery = frameIndex * ASYNC_COMPUTE_QUERIES_PER_FRAME;
+        vkCmdResetQueryPool( commandBuffer, compute->queryPool, firstQuery, 2 );
+        vkCmdWriteTimestamp( commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, compute->queryPool, firstQuery );
+    }
+
+    compute->currentFrame = frameIndex;
+    compute->recording = true;
+    return commandBuffer;
+}
+
+u64 SubmitAsyncCompute( Async_Compute *compute )
+{
+    TRACE_FUNCTION();
+    Assert( compute->recording );
+    compute->recording = false;
+    Async_Compute_Frame *frame = &compute->frames[ compute->currentFrame ];
+
+    if ( compute->timestampsSupported )
+    {
+        vkCmdWriteTimestamp( frame->commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, compute->queryPool,
+                             compute->currentFrame * ASYNC_COMPUTE_QUERIES_PER_FRAME + 1 );
+    }
+
+    if ( vkEndCommandBuffer( frame->commandBuffer ) != VK_SUCCESS )
+    {
+        printf( "Failed to record async compute command buffer!\n" );
+        return 0;
+    }
+
+    u64 signalValue = compute->nextTimelineValue;
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frame->commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &compute->timeline;
+
+    if ( vkQueueSubmit( compute->queue, 1, &submitInfo, VK_NULL_HANDLE ) != VK_SUCCESS )
+    {
+        printf( "Failed to submit async compute command buffer!\n" );
+        return 0;
+    }
+
+    compute->nextTimelineValue++;
+    compute->stats.submitCount++;
+    frame->timelineValue = signalValue;
+    frame->computeTimestamps = compute->timestampsSupported;
+    return signalValue;
+}
+
+void BeginAsyncComputeOverlap( Async_Compute *compute, VkCommandBuffer commandBuffer, u32 frameIndex )
+{
+    if ( !compute->timestampsSupported )
+    {
+        return;
+    }
+    u32 firstQuery = frameIndex * ASYNC_COMPUTE_QUERIES_PER_FRAME + 2;
+    vkCmdResetQueryPool( commandBuffer, compute->queryPool, firstQuery, 2 );
+    vkCmdWriteTimestamp( commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, compute->queryPool, firstQuery );
+}
+
+void EndAsyncComputeOverlap( Async_Compute *compute, VkCommandBuffer commandBuffer, u32 frameIndex )
+{
+    if ( !compute->timestampsSupported )
+    {
+        return;
+    }
+    vkCmdWriteTimestamp( commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, compute->queryPool,
+                         frameIndex * ASYNC_COMPUTE_QUERIES_PER_FRAME + 3 );
+    compute->frames[ frameIndex ].graphicsTimestamps = true;
+}
+
+void PrintAsyncComputeStats( Async_Compute *compute )
+{
+    Async_Compute_Stats *stats = &compute->stats;
+    if ( compute->dedicated )
+    {
+        printf( "Async compute: queue family %u, %llu submits\n", compute->queueFamily, ( unsigned long long ) stats->submitCount );
+    }
+    else
+    {
+        printf( "Async compute: no compute family without graphics, %llu submits\n", ( unsigned long long ) stats->submitCount );
+    }
+
+    if ( stats->measuredFrames == 0 )
+    {
+        return;
+    }
+    float64 averageCompute = stats->totalComputeMilliseconds / ( float64 ) stats->measuredFrames;
+    float64 averageOverlap = stats->totalOverlapMilliseconds / ( float64 ) stats->measuredFrames;
+    printf( "  %llu frames measured: %.3f ms of compute per frame, %.3f ms of it overlapping graphics (%.0f%%), best %.3f ms\n",
+            ( unsigned long long ) stats->measuredFrames, averageCompute, averageOverlap,
+            averageCompute > 0.0 ? 100.0 * averageOverlap / averageCompute : 0.0, stats->maxOverlapMilliseconds );
+    printf( "  last frame: %.3f ms of compute, %.3f ms overlapping\n", stats->lastComputeMilliseconds, stats->lastOverlapMilliseconds );
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "device.h"
+#include "utils/utils.h"
+
+#define ASYNC_COMPUTE_MAX_FRAMES 4
+
+// Compute begin and end, then the graphics frame's begin and end
+#define ASYNC_COMPUTE_QUERIES_PER_FRAME 4
+
+struct Async_Compute_Frame
+{
+    VkCommandBuffer commandBuffer;
+    // reached on the timeline once this slot's last submit has finished, 0 before the first one
+    u64 timelineValue;
+    bool computeTimestamps;
+    bool graphicsTimestamps;
+};
+
+struct Async_Compute_Stats
+{
+    u64 submitCount;
+    // frames whose timestamps were read back
+    u64 measuredFrames;
+    float64 totalComputeMilliseconds;
+    float64 totalOverlapMilliseconds;
+    float64 lastComputeMilliseconds;
+    float64 lastOverlapMilliseconds;
+    float64 maxOverlapMilliseconds;
+};
+
+// Work recorded here runs on the compute family without graphics and is handed to the graphics queue through a
+// timeline semaphore. Overlap is measured with timestamps on both queues, the compute work of a frame can run next to
+// the graphics work of the same frame and of the one before it
+struct Async_Compute
+{
+    Device *device;
+    VkQueue queue;
+    u32 queueFamily;
+    // false when the device has no compute family without graphics, nothing can overlap then
+    bool dedicated;
+    VkCommandPool commandPool;
+    VkSemaphore timeline;
+    u64 nextTimelineValue;
+
+    VkQueryPool queryPool;
+    bool timestampsSupported;
+    u64 timestampMask;
+    float64 timestampPeriod;
+
+    u32 framesInFlight;
+    Async_Compute_Frame frames[ ASYNC_COMPUTE_MAX_FRAMES ];
+    u32 currentFrame;
+    bool recording;
+
+    // the graphics frame before the one being read back
+    u64 previousGraphicsBegin;
+    u64 previousGraphicsEnd;
+    bool previousGraphicsValid;
+
+    Async_Compute_Stats stats;
+};
+
+bool InitAsyncCompute( Async_Compute *compute, Device *device, u32 framesInFlight );
+
+// Call with the device idle
+void DestroyAsyncCompute( Async_Compute *compute );
+
+// Call once the graphics fence of the frame slot has been waited on. Reads back what the slot measured framesInFlight
+// frames ago and returns a command buffer for this frame's compute work, already begun
+VkCommandBuffer BeginAsyncCompute( Async_Compute *compute, u32 frameIndex );
+
+// Returns the timeline value the graphics submit has to wait on before it reads what the compute work wrote
+u64 SubmitAsyncCompute( Async_Compute *compute );
+
+// Around the frame's graphics work on the primary command buffer, outside any render pass. Only frames that also
+// submitted compute work are measured
+void BeginAsyncComputeOverlap( Async_Compute *compute, VkCommandBuffer commandBuffer, u32 frameIndex );
+void EndAsyncComputeOverlap( Async_Compute *compute, VkCommandBuffer commandBuffer, u32 frameIndex );
+
+void PrintAsyncComputeStats( Async_Compute *compute );
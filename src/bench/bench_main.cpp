@@ -0,0 +1,663 @@
+#include "benchmark.h"
+#include "device.h"
+#include "swap_chain.h"
+#include "pipeline.h"
+#include "frame_commands.h"
+#include "render_graph.h"
+#include "job_system.h"
+#include "cpu_culling.h"
+#include "gpu_scene.h"
+#include "archive.h"
+#include "trace.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "math.h"
+
+#define BENCH_DEFAULT_DRAWS 10000
+#define BENCH_DEFAULT_OBJECTS 65536
+#define BENCH_UPLOAD_SIZE ( 16 << 20 )
+#define BENCH_IMAGE_SIZE 1024
+#define BENCH_PARALLEL_FOR_ITEMS ( 1 << 20 )
+#define BENCH_PARALLEL_FOR_BATCH 1024
+
+// Offscreen frames through the swap chain and a one pass render graph, the same path the engine's frames take
+struct Bench_Frames
+{
+    Device *device;
+    Swap_Chain *swapChain;
+    Frame_Command_Pools *pools;
+    Render_Graph *graph;
+    u32 backbuffer;
+    u32 drawPass;
+    VkPipeline pipeline;
+    u32 drawCount;
+    // one instanced draw instead of a draw per triangle, both put the same triangles on screen
+    bool instanced;
+    // draw samples include the GPU, frame loop samples only what the CPU spends per frame
+    bool waitForGpu;
+};
+
+struct Bench_Uploads
+{
+    Device *device;
+    VkBuffer stagingBuffer;
+    Gpu_Allocation stagingAllocation;
+    VkBuffer deviceBuffer;
+    Gpu_Allocation deviceAllocation;
+    VkImage image;
+    Gpu_Allocation imageAllocation;
+};
+
+struct Bench_Pipelines
+{
+    Device *device;
+    Pipeline_Config_Info configInfo;
+    VkShaderModule vertexShaderModule;
+    VkShaderModule fragmentShaderModule;
+};
+
+struct Bench_Culling
+{
+    Cpu_Culler *culler;
+    Job_System *jobs;
+    float32 frustumPlanes[ 6 ][ 4 ];
+};
+
+struct Bench_Parallel_For
+{
+    Job_System *jobs;
+    std::vector< u32 > values;
+};
+
+enum Bench_Archive_Mode
+{
+    BENCH_ARCHIVE_LOOSE,
+    BENCH_ARCHIVE_MAPPED,
+    BENCH_ARCHIVE_MAPPED_PREFETCH,
+    BENCH_ARCHIVE_MODE_COUNT,
+};
+
+// Loads everything in a pack through the loose files it was packed from or through the mapping,
+// the entry names have to be valid paths from the working directory
+struct Bench_Archive
+{
+    char *path;
+    std::vector< Archive_Entry > entries;
+    Bench_Archive_Mode mode;
+    u64 sink;
+};
+
+void RecordBenchDraws( Render_Graph_Context *context, void *data )
+{
+    Bench_Frames *frames = ( Bench_Frames * ) data;
+    if ( frames->drawCount == 0 )
+    {
+        return;
+    }
+    vkCmdBindPipeline( context->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, frames->pipeline );
+    SetViewportAndScissor( context->commandBuffer, context->extent );
+    if ( frames->instanced )
+    {
+        vkCmdDraw( context->commandBuffer, 3, frames->drawCount, 0, 0 );
+        return;
+    }
+    for ( u32 i = 0; i < frames->drawCount; ++i )
+    {
+        vkCmdDraw( context->commandBuffer, 3, 1, 0, i );
+    }
+}
+
+bool BuildBenchRenderGraph( Bench_Frames *frames )
+{
+    Render_Graph *graph = frames->graph;
+    Swap_Chain *swapChain = frames->swapChain;
+    frames->backbuffer = ImportRenderGraphImage( graph, "backbuffer", swapChain->swapChainImageFormat,
+                                                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL );
+    frames->drawPass = AddRenderGraphPass( graph, "draws", true, RecordBenchDraws, frames );
+    UseRenderGraphResource( graph, frames->drawPass, frames->backbuffer, RENDER_GRAPH_COLOR_ATTACHMENT );
+
+    VkClearValue clearColor = {};
+    clearColor.color = { 0.0f, 0.0f, 0.0f, 1.0f };
+    ClearRenderGraphAttachment( graph, frames->drawPass, frames->backbuffer, clearColor );
+    return CompileRenderGraph( graph, swapChain->swapChainExtent );
+}
+
+bool RunBenchFrame( void *data )
+{
+    Bench_Frames *frames = ( Bench_Frames * ) data;
+    Swap_Chain *swapChain = frames->swapChain;
+    Render_Graph *graph = frames->graph;
+    if ( !UpdateRenderGraphTargets( graph, swapChain->swapChainExtent, swapChain->recreateCount, swapChain->frameNumber ) )
+    {
+        return false;
+    }
+
+    u32 imageIndex;
+    if ( AcquireNextImage( swapChain, &imageIndex ) != VK_SUCCESS )
+    {
+        return false;
+    }
+
+    VkCommandBuffer commandBuffer = BeginFrameCommands( frames->pools, ( u32 ) swapChain->currentFrame )->primaryBuffer;
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if ( vkBeginCommandBuffer( commandBuffer, &beginInfo ) != VK_SUCCESS )
+    {
+        return false;
+    }
+
+    SetRenderGraphImage( graph, frames->backbuffer, swapChain->swapChainImages[ imageIndex ], swapChain->swapChainImageViews[ imageIndex ] );
+    BeginRenderGraphFrame( graph, ( u32 ) swapChain->currentFrame, swapChain->frameNumber );
+    ExecuteRenderGraph( graph, commandBuffer );
+
+    if ( vkEndCommandBuffer( commandBuffer ) != VK_SUCCESS )
+    {
+        return false;
+    }
+    if ( SubmitCommandBuffers( swapChain, &commandBuffer, &imageIndex ) != VK_SUCCESS )
+    {
+        return false;
+    }
+
+    if ( frames->waitForGpu )
+    {
+        vkQueueWaitIdle( frames->device->graphicsQueue );
+    }
+    return true;
+}
+
+bool RunBenchCopyBuffer( void *data )
+{
+    Bench_Uploads *uploads = ( Bench_Uploads * ) data;
+    CopyBuffer( uploads->device, uploads->stagingBuffer, uploads->deviceBuffer, BENCH_UPLOAD_SIZE );
+    return true;
+}
+
+bool RunBenchCopyBufferToImage( void *data )
+{
+    Bench_Uploads *uploads = ( Bench_Uploads * ) data;
+    CopyBufferToImage( uploads->device, uploads->stagingBuffer, uploads->image, BENCH_IMAGE_SIZE, BENCH_IMAGE_SIZE, 1 );
+    return true;
+}
+
+bool InitBenchUploads( Bench_Uploads *uploads, Device *device )
+{
+    *uploads = {};
+    uploads->device = device;
+    CreateBuffer( device, BENCH_UPLOAD_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uploads->stagingBuffer,
+                  uploads->stagingAllocation );
+    CreateBuffer( device, BENCH_UPLOAD_SIZE, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                  uploads->deviceBuffer, uploads->deviceAllocation );
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.extent = { BENCH_IMAGE_SIZE, BENCH_IMAGE_SIZE, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    CreateImageWithInfo( device, imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, uploads->image, uploads->imageAllocation );
+
+    if ( uploads->stagingAllocation.memory == VK_NULL_HANDLE || uploads->deviceAllocation.memory == VK_NULL_HANDLE ||
+         uploads->imageAllocation.memory == VK_NULL_HANDLE )
+    {
+        return false;
+    }
+
+    // every copy leaves the image where CopyBufferToImage expects it
+    VkCommandBuffer commandBuffer = BeginSingleTimeCommands( device );
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = uploads->image;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1,
+                          &barrier );
+    EndSingleTimeCommands( device, commandBuffer );
+    return true;
+}
+
+void DestroyBenchUploads( Bench_Uploads *uploads )
+{
+    Device *device = uploads->device;
+    if ( uploads->stagingBuffer != VK_NULL_HANDLE ) DestroyBuffer( device, uploads->stagingBuffer, uploads->stagingAllocation );
+    if ( uploads->deviceBuffer != VK_NULL_HANDLE ) DestroyBuffer( device, uploads->deviceBuffer, uploads->deviceAllocation );
+    if ( uploads->image != VK_NULL_HANDLE ) DestroyImage( device, uploads->image, uploads->imageAllocation );
+}
+
+// Goes through the device pipeline cache, which is warm after the first sample
+bool RunBenchCachedPipeline( void *data )
+{
+    Bench_Pipelines *pipelines = ( Bench_Pipelines * ) data;
+    VkPipeline pipeline = CreateGraphicsPipelineWithModules( pipelines->device, &pipelines->configInfo, pipelines->vertexShaderModule,
+                                                             pipelines->fragmentShaderModule );
+    if ( pipeline == VK_NULL_HANDLE )
+    {
+        return false;
+    }
+    vkDestroyPipeline( pipelines->device->device, pipeline, 0 );
+    return true;
+}
+
+// Without a pipeline cache. Drivers with a shader cache of their own still hit it, Mesa's is off with
+// MESA_SHADER_CACHE_DISABLE=true
+bool RunBenchUncachedPipeline( void *data )
+{
+    Bench_Pipelines *pipelines = ( Bench_Pipelines * ) data;
+    Graphics_Pipeline_Create_State state;
+    FillGraphicsPipelineCreateState( &state, &pipelines->configInfo, pipelines->vertexShaderModule, pipelines->fragmentShaderModule );
+
+    VkPipeline pipeline;
+    if ( vkCreateGraphicsPipelines( pipelines->device->device, VK_NULL_HANDLE, 1, &state.pipelineInfo, 0, &pipeline ) != VK_SUCCESS )
+    {
+        return false;
+    }
+    vkDestroyPipeline( pipelines->device->device, pipeline, 0 );
+    return true;
+}
+
+VkShaderModule LoadBenchShaderModule( Device *device, char *path )
+{
+    Asset_Data shader;
+    if ( !LoadAsset( path, &shader ) )
+    {
+        printf( "Failed to load %s!\n", path );
+        return VK_NULL_HANDLE;
+    }
+    VkShaderModule module = VK_NULL_HANDLE;
+    CreateShaderModule( device->device, shader, &module );
+    FreeAsset( &shader );
+    return module;
+}
+
+bool RunBenchCulling( void *data )
+{
+    Bench_Culling *culling = ( Bench_Culling * ) data;
+    CullObjects( culling->culler, culling->jobs, culling->frustumPlanes );
+    return true;
+}
+
+void HashBenchValues( void *data, u32 begin, u32 end, u32 workerIndex )
+{
+    Bench_Parallel_For *parallelFor = ( Bench_Parallel_For * ) data;
+    for ( u32 i = begin; i < end; ++i )
+    {
+        u32 value = parallelFor->values[ i ] ^ i;
+        value *= 0x9e3779b1;
+        parallelFor->values[ i ] = value ^ ( value >> 15 );
+    }
+}
+
+bool RunBenchParallelFor( void *data )
+{
+    Bench_Parallel_For *parallelFor = ( Bench_Parallel_For * ) data;
+    ParallelFor( parallelFor->jobs, ( u32 ) parallelFor->values.size(), BENCH_PARALLEL_FOR_BATCH, HashBenchValues, parallelFor );
+    return true;
+}
+
+// One read per page is enough to fault the whole blob in
+static u64 TouchPages( void *data, u64 size )
+{
+    u8 *bytes = ( u8 * ) data;
+    u64 sum = 0;
+    for ( u64 i = 0; i < size; i += 4096 )
+    {
+        sum += bytes[ i ];
+    }
+    return sum;
+}
+
+bool EvictBenchArchive( void *data )
+{
+    Bench_Archive *archive = ( Bench_Archive * ) data;
+    if ( archive->mode == BENCH_ARCHIVE_LOOSE )
+    {
+        for ( auto &entry : archive->entries ) EvictFileFromPageCache( entry.name );
+    }
+    else
+    {
+        EvictFileFromPageCache( archive->path );
+    }
+    return true;
+}
+
+bool RunBenchArchiveLoad( void *data )
+{
+    Bench_Archive *bench = ( Bench_Archive * ) data;
+    u64 sum = 0;
+    if ( bench->mode == BENCH_ARCHIVE_LOOSE )
+    {
+        for ( auto &entry : bench->entries )
+        {
+            Asset_Data asset;
+            if ( !LoadLooseAsset( entry.name, &asset ) )
+            {
+                return false;
+            }
+            sum += TouchPages( asset.data, asset.size );
+            FreeAsset( &asset );
+        }
+    }
+    else
+    {
+        Asset_Archive archive;
+        if ( !OpenArchive( &archive, bench->path ) )
+        {
+            return false;
+        }
+        if ( bench->mode == BENCH_ARCHIVE_MAPPED_PREFETCH ) PrefetchArchive( &archive );
+        for ( auto &entry : bench->entries )
+        {
+            Archive_Entry *found = FindArchiveEntry( &archive, entry.name );
+            if ( found ) sum += TouchPages( GetArchiveEntryData( &archive, found ), found->size );
+        }
+        CloseArchive( &archive );
+    }
+    // keeps the reads from being optimized away
+    bench->sink += sum;
+    return true;
+}
+
+// Cold and warm loads of every mode, cold samples drop the page cache first
+void RunArchiveBenchmarks( Benchmark *benchmark, char *archivePath )
+{
+    Bench_Archive bench;
+    bench.path = archivePath;
+    bench.sink = 0;
+
+    Asset_Archive archive;
+    if ( !OpenArchive( &archive, archivePath ) )
+    {
+        benchmark->failCount++;
+        return;
+    }
+    bench.entries.assign( archive.entries, archive.entries + archive.header->entryCount );
+    u64 totalBytes = 0;
+    u32 corruptCount = 0;
+    for ( u32 i = 0; i < archive.header->entryCount; ++i )
+    {
+        totalBytes += archive.entries[ i ].size;
+        if ( !VerifyArchiveEntry( &archive, &archive.entries[ i ] ) ) corruptCount++;
+    }
+    CloseArchive( &archive );
+
+    printf( "%s: %u entries, %.2f KB, %u failed verification\n", archivePath, ( u32 ) bench.entries.size(),
+            ( float64 ) totalBytes / 1024.0, corruptCount );
+    if ( !EvictFileFromPageCache( archivePath ) )
+    {
+        printf( "The page cache can't be dropped here, cold loads are warm\n" );
+    }
+
+    char *modeNames[ BENCH_ARCHIVE_MODE_COUNT ] = { "loose", "mapped", "mapped_prefetch" };
+    for ( u32 mode = 0; mode < BENCH_ARCHIVE_MODE_COUNT; ++mode )
+    {
+        bench.mode = ( Bench_Archive_Mode ) mode;
+        char name[ BENCHMARK_NAME_LENGTH ];
+        snprintf( name, sizeof( name ), "archive_%s_cold", modeNames[ mode ] );
+        RunBenchmarkScenarioWithSetup( benchmark, name, "bytes", totalBytes, EvictBenchArchive, RunBenchArchiveLoad, &bench );
+        snprintf( name, sizeof( name ), "archive_%s_warm", modeNames[ mode ] );
+        RunBenchmarkScenario( benchmark, name, "bytes", totalBytes, RunBenchArchiveLoad, &bench );
+    }
+}
+
+// Renders nothing to a window, so it runs on software drivers too: VK_ICD_FILENAMES picks lavapipe's ICD when the
+// machine has more than one. Run from the engine directory, the shaders are loaded from shaders/
+//
+// --warmup and --samples set the iterations per scenario, --filter only runs scenarios whose name contains it,
+// --json writes the results (benchmark.json by default), --compare checks the medians against a stored result and
+// exits with 1 when any is more than --threshold percent slower, --draws and --objects size the scenarios.
+// The instancing scenarios step the instance count up by 16x until it reaches --draws, --archive <pack> adds cold and
+// warm loads of a pack's contents against the loose files it was packed from
+int main( int argc, char **argv )
+{
+    InitTracing();
+    defer { ShutdownTracing(); };
+
+    u32 warmupCount = BENCHMARK_DEFAULT_WARMUP;
+    u32 sampleCount = BENCHMARK_DEFAULT_SAMPLES;
+    char *filter = 0;
+    char *jsonPath = "benchmark.json";
+    char *baselinePath = 0;
+    char *archivePath = 0;
+    float64 threshold = BENCHMARK_DEFAULT_THRESHOLD;
+    u32 drawCount = BENCH_DEFAULT_DRAWS;
+    u32 objectCount = BENCH_DEFAULT_OBJECTS;
+    for ( int i = 1; i < argc; ++i )
+    {
+        if ( strcmp( argv[ i ], "--warmup" ) == 0 && i + 1 < argc )
+        {
+            warmupCount = ( u32 ) atoi( argv[ ++i ] );
+        }
+        else if ( strcmp( argv[ i ], "--samples" ) == 0 && i + 1 < argc )
+        {
+            sampleCount = ( u32 ) atoi( argv[ ++i ] );
+        }
+        else if ( strcmp( argv[ i ], "--filter" ) == 0 && i + 1 < argc )
+        {
+            filter = argv[ ++i ];
+        }
+        else if ( strcmp( argv[ i ], "--json" ) == 0 && i + 1 < argc )
+        {
+            jsonPath = argv[ ++i ];
+        }
+        else if ( strcmp( argv[ i ], "--compare" ) == 0 && i + 1 < argc )
+        {
+            baselinePath = argv[ ++i ];
+        }
+        else if ( strcmp( argv[ i ], "--threshold" ) == 0 && i + 1 < argc )
+        {
+            threshold = atof( argv[ ++i ] ) / 100.0;
+        }
+        else if ( strcmp( argv[ i ], "--draws" ) == 0 && i + 1 < argc )
+        {
+            drawCount = ( u32 ) atoi( argv[ ++i ] );
+        }
+        else if ( strcmp( argv[ i ], "--archive" ) == 0 && i + 1 < argc )
+        {
+            archivePath = argv[ ++i ];
+        }
+        else if ( strcmp( argv[ i ], "--objects" ) == 0 && i + 1 < argc )
+        {
+            objectCount = ( u32 ) atoi( argv[ ++i ] );
+            if ( objectCount == 0 ) objectCount = 1;
+        }
+        else
+        {
+            printf( "Unknown argument: %s\n", argv[ i ] );
+            return 1;
+        }
+    }
+
+    Benchmark benchmark;
+    InitBenchmark( &benchmark, warmupCount, sampleCount, filter );
+
+    Job_System jobs;
+    InitJobSystem( &jobs, 0 );
+    defer { DestroyJobSystem( &jobs ); };
+
+    Device device;
+    InitDevice( &device, 0 );
+    defer { DestroyDevice( &device ); };
+    printf( "%s, %s %s, %u workers, %u warmup and %u samples per scenario\n", device.properties.deviceName,
+            device.vulkan12Properties.driverName, device.vulkan12Properties.driverInfo, GetJobWorkerCount( &jobs ),
+            benchmark.warmupCount, benchmark.sampleCount );
+
+    Swap_Chain swapChain;
+    InitSwapChain( &swapChain, &device, { 1280, 720 } );
+    defer { DestroySwapChain( &swapChain ); };
+
+    Frame_Command_Pools framePools;
+    InitFrameCommandPools( &framePools, &device, swapChain.framesInFlight, 1 );
+    defer { DestroyFrameCommandPools( &framePools ); };
+
+    Render_Graph graph;
+    InitRenderGraph( &graph, &device, 0, swapChain.framesInFlight );
+    defer { DestroyRenderGraph( &graph ); };
+
+    Bench_Frames frames = {};
+    frames.device = &device;
+    frames.swapChain = &swapChain;
+    frames.pools = &framePools;
+    frames.graph = &graph;
+    if ( !BuildBenchRenderGraph( &frames ) )
+    {
+        printf( "Failed to compile the render graph!\n" );
+        return 1;
+    }
+
+    VkPipelineLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    VkPipelineLayout pipelineLayout;
+    if ( vkCreatePipelineLayout( device.device, &layoutInfo, 0, &pipelineLayout ) != VK_SUCCESS )
+    {
+        printf( "Failed to create pipeline layout!\n" );
+        return 1;
+    }
+    defer { vkDestroyPipelineLayout( device.device, pipelineLayout, 0 ); };
+
+    Bench_Pipelines pipelines = {};
+    pipelines.device = &device;
+    pipelines.configInfo = DefaultPipelineConfigInfo();
+    pipelines.configInfo.depthStencilInfo.depthTestEnable = VK_FALSE;
+    pipelines.configInfo.depthStencilInfo.depthWriteEnable = VK_FALSE;
+    pipelines.configInfo.pipelineLayout = pipelineLayout;
+    pipelines.configInfo.renderPass = GetRenderGraphRenderPass( &graph, frames.drawPass );
+    pipelines.vertexShaderModule = LoadBenchShaderModule( &device, "shaders/bench.vert.spv" );
+    pipelines.fragmentShaderModule = LoadBenchShaderModule( &device, "shaders/bench.frag.spv" );
+    defer
+    {
+        vkDestroyShaderModule( device.device, pipelines.vertexShaderModule, 0 );
+        vkDestroyShaderModule( device.device, pipelines.fragmentShaderModule, 0 );
+    };
+    if ( pipelines.vertexShaderModule == VK_NULL_HANDLE || pipelines.fragmentShaderModule == VK_NULL_HANDLE )
+    {
+        return 1;
+    }
+
+    frames.pipeline = CreateGraphicsPipelineWithModules( &device, &pipelines.configInfo, pipelines.vertexShaderModule,
+                                                         pipelines.fragmentShaderModule );
+    if ( frames.pipeline == VK_NULL_HANDLE )
+    {
+        return 1;
+    }
+    defer { vkDestroyPipeline( device.device, frames.pipeline, 0 ); };
+
+    // draw call throughput, every sample is a whole frame up to the GPU finishing it
+    frames.drawCount = drawCount;
+    frames.waitForGpu = true;
+    RunBenchmarkScenario( &benchmark, "draw_calls", "draws", drawCount, RunBenchFrame, &frames );
+
+    // how throughput scales with the instance count, a draw per instance against a single instanced draw
+    for ( u32 instanceCount = 1;; instanceCount *= 16 )
+    {
+        if ( instanceCount > drawCount ) instanceCount = drawCount;
+        char name[ BENCHMARK_NAME_LENGTH ];
+        frames.drawCount = instanceCount;
+        for ( u32 mode = 0; mode < 2; ++mode )
+        {
+            frames.instanced = mode == 1;
+            snprintf( name, sizeof( name ), "instancing_%s_%u", frames.instanced ? "batched" : "per_object", instanceCount );
+            RunBenchmarkScenario( &benchmark, name, "instances", instanceCount, RunBenchFrame, &frames );
+        }
+        if ( instanceCount == drawCount ) break;
+    }
+    frames.instanced = false;
+
+    // an empty frame kept in flight, what acquiring, recording the graph and submitting costs the CPU
+    frames.drawCount = 0;
+    frames.waitForGpu = false;
+    RunBenchmarkScenario( &benchmark, "frame_loop", "frames", 1, RunBenchFrame, &frames );
+    vkDeviceWaitIdle( device.device );
+
+    if ( IsBenchmarkScenarioEnabled( &benchmark, "copy_buffer" ) || IsBenchmarkScenarioEnabled( &benchmark, "copy_buffer_to_image" ) )
+    {
+        Bench_Uploads uploads;
+        if ( InitBenchUploads( &uploads, &device ) )
+        {
+            RunBenchmarkScenario( &benchmark, "copy_buffer", "bytes", BENCH_UPLOAD_SIZE, RunBenchCopyBuffer, &uploads );
+            RunBenchmarkScenario( &benchmark, "copy_buffer_to_image", "bytes", ( u64 ) BENCH_IMAGE_SIZE * BENCH_IMAGE_SIZE * 4,
+                                  RunBenchCopyBufferToImage, &uploads );
+        }
+        else
+        {
+            printf( "Failed to create the upload benchmark resources!\n" );
+            benchmark.failCount++;
+        }
+        DestroyBenchUploads( &uploads );
+    }
+
+    RunBenchmarkScenario( &benchmark, "pipeline_create_cached", "pipelines", 1, RunBenchCachedPipeline, &pipelines );
+    RunBenchmarkScenario( &benchmark, "pipeline_create_uncached", "pipelines", 1, RunBenchUncachedPipeline, &pipelines );
+
+    if ( IsBenchmarkScenarioEnabled( &benchmark, "cpu_cull" ) )
+    {
+        // the engine's grid, overhanging the screen so the edges get culled
+        Cpu_Culler culler;
+        InitCpuCuller( &culler, objectCount );
+        u32 gridSize = ( u32 ) ceil( sqrt( ( float64 ) objectCount ) );
+        float32 cellSize = 2.5f / ( float32 ) gridSize;
+        float32 boundingSphere[ 4 ] = { 0.0f, 0.0f, 0.0f, 0.5f };
+        float32 boundsMin[ 3 ] = { -0.5f, -0.5f, 0.0f };
+        float32 boundsMax[ 3 ] = { 0.5f, 0.5f, 0.0f };
+        for ( u32 i = 0; i < objectCount; ++i )
+        {
+            float32 transform[ 16 ] = {};
+            transform[ 0 ] = cellSize;
+            transform[ 5 ] = cellSize;
+            transform[ 10 ] = cellSize;
+            transform[ 12 ] = -1.25f + ( ( float32 ) ( i % gridSize ) + 0.5f ) * cellSize;
+            transform[ 13 ] = -1.25f + ( ( float32 ) ( i / gridSize ) + 0.5f ) * cellSize;
+            transform[ 14 ] = 0.5f;
+            transform[ 15 ] = 1.0f;
+            SetCullObject( &culler, i, transform, boundingSphere, boundsMin, boundsMax );
+        }
+
+        Bench_Culling culling = {};
+        culling.culler = &culler;
+        culling.jobs = &jobs;
+        float32 viewProjection[ 16 ] = {};
+        viewProjection[ 0 ] = 1.0f;
+        viewProjection[ 5 ] = 1.0f;
+        viewProjection[ 10 ] = 1.0f;
+        viewProjection[ 15 ] = 1.0f;
+        ExtractFrustumPlanes( viewProjection, culling.frustumPlanes );
+        RunBenchmarkScenario( &benchmark, "cpu_cull", "objects", objectCount, RunBenchCulling, &culling );
+        DestroyCpuCuller( &culler );
+    }
+
+    Bench_Parallel_For parallelFor;
+    parallelFor.jobs = &jobs;
+    parallelFor.values.resize( BENCH_PARALLEL_FOR_ITEMS );
+    RunBenchmarkScenario( &benchmark, "parallel_for", "items", BENCH_PARALLEL_FOR_ITEMS, RunBenchParallelFor, &parallelFor );
+
+    if ( archivePath && IsBenchmarkScenarioEnabled( &benchmark, "archive" ) )
+    {
+        RunArchiveBenchmarks( &benchmark, archivePath );
+    }
+
+    vkDeviceWaitIdle( device.device );
+    PrintBenchmarkResults( &benchmark );
+
+    char driverName[ 512 ];
+    snprintf( driverName, sizeof( driverName ), "%s %s", device.vulkan12Properties.driverName, device.vulkan12Properties.driverInfo );
+    WriteBenchmarkJson( &benchmark, jsonPath, device.properties.deviceName, driverName );
+
+    u32 regressionCount = 0;
+    if ( baselinePath && !CompareBenchmarkBaseline( &benchmark, baselinePath, threshold, &regressionCount ) )
+    {
+        return 1;
+    }
+    return regressionCount > 0 || benchmark.failCount > 0 ? 1 : 0;
+}
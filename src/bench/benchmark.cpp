@@ -0,0 +1,256 @@
+#include "benchmark.h"
+#include "platform.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "math.h"
+#include <algorithm> //@TODO: Remove std garbage
+#include <chrono>
+
+void InitBenchmark( Benchmark *benchmark, u32 warmupCount, u32 sampleCount, char *filter )
+{
+    benchmark->warmupCount = warmupCount;
+    benchmark->sampleCount = sampleCount > 0 ? sampleCount : 1;
+    benchmark->filter = filter;
+    benchmark->results.clear();
+    benchmark->samples.clear();
+    benchmark->failCount = 0;
+}
+
+bool IsBenchmarkScenarioEnabled( Benchmark *benchmark, char *name )
+{
+    return !benchmark->filter || strstr( name, benchmark->filter ) != 0;
+}
+
+// nearest rank on sorted samples
+static float64 GetPercentile( std::vector< float64 > &sorted, float64 percentile )
+{
+    u32 count = ( u32 ) sorted.size();
+    u32 rank = ( u32 ) ceil( percentile * ( float64 ) count );
+    if ( rank < 1 ) rank = 1;
+    if ( rank > count ) rank = count;
+    return sorted[ rank - 1 ];
+}
+
+bool RunBenchmarkScenario( Benchmark *benchmark, char *name, char *itemName, u64 itemsPerSample, Benchmark_Function function,
+                           void *data )
+{
+    return RunBenchmarkScenarioWithSetup( benchmark, name, itemName, itemsPerSample, 0, function, data );
+}
+
+bool RunBenchmarkScenarioWithSetup( Benchmark *benchmark, char *name, char *itemName, u64 itemsPerSample, Benchmark_Function setup,
+                                    Benchmark_Function function, void *data )
+{
+    if ( !IsBenchmarkScenarioEnabled( benchmark, name ) )
+    {
+        return false;
+    }
+
+    printf( "Running %s...\n", name );
+    for ( u32 i = 0; i < benchmark->warmupCount; ++i )
+    {
+        if ( ( setup && !setup( data ) ) || !function( data ) )
+        {
+            printf( "Benchmark %s failed during warmup\n", name );
+            benchmark->failCount++;
+            return false;
+        }
+    }
+
+    std::vector< float64 > &samples = benchmark->samples;
+    samples.resize( benchmark->sampleCount );
+    for ( u32 i = 0; i < benchmark->sampleCount; ++i )
+    {
+        if ( setup && !setup( data ) )
+        {
+            printf( "Benchmark %s failed to set up sample %u\n", name, i );
+            benchmark->failCount++;
+            return false;
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        bool succeeded = function( data );
+        samples[ i ] = std::chrono::duration< float64, std::milli >( std::chrono::high_resolution_clock::now() - start ).count();
+        if ( !succeeded )
+        {
+            printf( "Benchmark %s failed on sample %u\n", name, i );
+            benchmark->failCount++;
+            return false;
+        }
+    }
+    std::sort( samples.begin(), samples.end() );
+
+    Benchmark_Result result = {};
+    snprintf( result.name, sizeof( result.name ), "%s", name );
+    snprintf( result.itemName, sizeof( result.itemName ), "%s", itemName );
+    result.itemsPerSample = itemsPerSample;
+    result.sampleCount = benchmark->sampleCount;
+
+    float64 total = 0.0;
+    for ( float64 sample : samples )
+    {
+        total += sample;
+    }
+    result.meanMilliseconds = total / ( float64 ) samples.size();
+    float64 variance = 0.0;
+    for ( float64 sample : samples )
+    {
+        variance += ( sample - result.meanMilliseconds ) * ( sample - result.meanMilliseconds );
+    }
+    result.stddevMilliseconds = sqrt( variance / ( float64 ) samples.size() );
+
+    result.minMilliseconds = samples.front();
+    result.maxMilliseconds = samples.back();
+    result.p50Milliseconds = GetPercentile( samples, 0.50 );
+    result.p90Milliseconds = GetPercentile( samples, 0.90 );
+    result.p99Milliseconds = GetPercentile( samples, 0.99 );
+    result.itemsPerSecond = result.p50Milliseconds > 0.0 ? ( float64 ) itemsPerSample * 1000.0 / result.p50Milliseconds : 0.0;
+
+    benchmark->results.push_back( result );
+    return true;
+}
+
+void PrintBenchmarkResults( Benchmark *benchmark )
+{
+    printf( "\n%-28s %10s %10s %10s %10s %10s %16s\n", "scenario", "min ms", "p50 ms", "p90 ms", "p99 ms", "stddev", "throughput" );
+    for ( Benchmark_Result &result : benchmark->results )
+    {
+        printf( "%-28s %10.3f %10.3f %10.3f %10.3f %10.3f %12.4g %s/s\n", result.name, result.minMilliseconds, result.p50Milliseconds,
+                result.p90Milliseconds, result.p99Milliseconds, result.stddevMilliseconds, result.itemsPerSecond, result.itemName );
+    }
+    if ( benchmark->failCount > 0 )
+    {
+        printf( "%u scenarios failed\n", benchmark->failCount );
+    }
+}
+
+bool WriteBenchmarkJson( Benchmark *benchmark, char *path, char *deviceName, char *driverName )
+{
+    FILE *file = OpenFile( path, "w" );
+    if ( !file )
+    {
+        printf( "Failed to write benchmark results: %s\n", path );
+        return false;
+    }
+
+    fprintf( file, "{\n" );
+    fprintf( file, "  \"version\": %u,\n", BENCHMARK_JSON_VERSION );
+    fprintf( file, "  \"device\": \"%s\",\n", deviceName );
+    fprintf( file, "  \"driver\": \"%s\",\n", driverName );
+    fprintf( file, "  \"warmup\": %u,\n", benchmark->warmupCount );
+    fprintf( file, "  \"samples\": %u,\n", benchmark->sampleCount );
+    fprintf( file, "  \"failed\": %u,\n", benchmark->failCount );
+
+    fprintf( file, "  \"scenarios\": [" );
+    for ( u32 i = 0; i < benchmark->results.size(); ++i )
+    {
+        Benchmark_Result *result = &benchmark->results[ i ];
+        fprintf( file,
+                 "%s\n    { \"name\": \"%s\", \"item\": \"%s\", \"itemsPerSample\": %llu, \"samples\": %u, \"minMs\": %.6f, "
+                 "\"meanMs\": %.6f, \"stddevMs\": %.6f, \"p50Ms\": %.6f, \"p90Ms\": %.6f, \"p99Ms\": %.6f, \"maxMs\": %.6f, "
+                 "\"itemsPerSecond\": %.3f }",
+                 i ? "," : "", result->name, result->itemName, ( unsigned long long ) result->itemsPerSample, result->sampleCount,
+                 result->minMilliseconds, result->meanMilliseconds, result->stddevMilliseconds, result->p50Milliseconds,
+                 result->p90Milliseconds, result->p99Milliseconds, result->maxMilliseconds, result->itemsPerSecond );
+    }
+    fprintf( file, "\n  ]\n}\n" );
+
+    fclose( file );
+    return true;
+}
+
+static char *ReadJsonString( char *cursor, char *key, char *value, u32 valueSize )
+{
+    char *found = strstr( cursor, key );
+    if ( !found )
+    {
+        return 0;
+    }
+    char *begin = strchr( found + strlen( key ), '"' );
+    char *end = begin ? strchr( begin + 1, '"' ) : 0;
+    if ( !end )
+    {
+        return 0;
+    }
+    snprintf( value, valueSize, "%.*s", ( int ) ( end - begin - 1 ), begin + 1 );
+    return end + 1;
+}
+
+static Benchmark_Result *FindBenchmarkResult( Benchmark *benchmark, char *name )
+{
+    for ( Benchmark_Result &result : benchmark->results )
+    {
+        if ( strcmp( result.name, name ) == 0 )
+        {
+            return &result;
+        }
+    }
+    return 0;
+}
+
+bool CompareBenchmarkBaseline( Benchmark *benchmark, char *path, float64 threshold, u32 *regressionCount )
+{
+    *regressionCount = 0;
+    FILE *file = OpenFile( path, "rb" );
+    if ( !file )
+    {
+        printf( "Failed to open benchmark baseline: %s\n", path );
+        return false;
+    }
+    fseek( file, 0, SEEK_END );
+    long size = ftell( file );
+    fseek( file, 0, SEEK_SET );
+    std::vector< char > text( size > 0 ? ( size_t ) size + 1 : 1, 0 );
+    size_t readSize = size > 0 ? fread( text.data(), 1, ( size_t ) size, file ) : 0;
+    fclose( file );
+    text[ readSize ] = 0;
+
+    char baselineDevice[ 256 ] = {};
+    ReadJsonString( text.data(), "\"device\":", baselineDevice, sizeof( baselineDevice ) );
+    char *cursor = strstr( text.data(), "\"scenarios\":" );
+    if ( !cursor )
+    {
+        printf( "%s isn't a benchmark result file\n", path );
+        return false;
+    }
+
+    printf( "\nCompared with %s (%s), regressions are medians more than %.1f%% slower\n", path, baselineDevice, threshold * 100.0 );
+    printf( "%-28s %12s %12s %10s\n", "scenario", "baseline ms", "current ms", "change" );
+
+    std::vector< bool > compared( benchmark->results.size(), false );
+    char name[ BENCHMARK_NAME_LENGTH ];
+    while ( ( cursor = ReadJsonString( cursor, "\"name\":", name, sizeof( name ) ) ) != 0 )
+    {
+        char *p50 = strstr( cursor, "\"p50Ms\":" );
+        char *nextName = strstr( cursor, "\"name\":" );
+        if ( !p50 || ( nextName && p50 > nextName ) )
+        {
+            printf( "%-28s has no median in the baseline\n", name );
+            continue;
+        }
+        float64 baselineMilliseconds = strtod( p50 + strlen( "\"p50Ms\":" ), 0 );
+
+        Benchmark_Result *result = FindBenchmarkResult( benchmark, name );
+        if ( !result )
+        {
+            printf( "%-28s %12.3f %12s\n", name, baselineMilliseconds, "not run" );
+            continue;
+        }
+        compared[ result - benchmark->results.data() ] = true;
+
+        float64 change = baselineMilliseconds > 0.0 ? result->p50Milliseconds / baselineMilliseconds - 1.0 : 0.0;
+        bool regressed = change > threshold;
+        if ( regressed ) ( *regressionCount )++;
+        printf( "%-28s %12.3f %12.3f %+9.1f%%%s\n", name, baselineMilliseconds, result->p50Milliseconds, change * 100.0,
+                regressed ? "  REGRESSION" : change < -threshold ? "  improved" : "" );
+    }
+
+    for ( u32 i = 0; i < benchmark->results.size(); ++i )
+    {
+        if ( !compared[ i ] )
+        {
+            printf( "%-28s %12s %12.3f\n", benchmark->results[ i ].name, "new", benchmark->results[ i ].p50Milliseconds );
+        }
+    }
+    printf( "%u regressions\n", *regressionCount );
+    return true;
+}
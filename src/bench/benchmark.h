@@ -0,0 +1,65 @@
+#pragma once
+
+#include "utils/utils.h"
+#include <vector> //@TODO: Remove std garbage
+
+#define BENCHMARK_DEFAULT_WARMUP 10
+#define BENCHMARK_DEFAULT_SAMPLES 50
+// a scenario regresses when its median is this much slower than the baseline's
+#define BENCHMARK_DEFAULT_THRESHOLD 0.10
+#define BENCHMARK_NAME_LENGTH 64
+#define BENCHMARK_JSON_VERSION 1
+
+// One sample, false stops the scenario
+typedef bool ( *Benchmark_Function )( void *data );
+
+struct Benchmark_Result
+{
+    char name[ BENCHMARK_NAME_LENGTH ];
+    // what a sample processes, throughput is items per second at the median
+    char itemName[ BENCHMARK_NAME_LENGTH ];
+    u64 itemsPerSample;
+    u32 sampleCount;
+
+    float64 minMilliseconds;
+    float64 meanMilliseconds;
+    float64 stddevMilliseconds;
+    float64 p50Milliseconds;
+    float64 p90Milliseconds;
+    float64 p99Milliseconds;
+    float64 maxMilliseconds;
+    float64 itemsPerSecond;
+};
+
+struct Benchmark
+{
+    u32 warmupCount;
+    u32 sampleCount;
+    // only scenarios whose name contains it run, null runs everything
+    char *filter;
+
+    std::vector< Benchmark_Result > results;
+    std::vector< float64 > samples;
+    u32 failCount;
+};
+
+void InitBenchmark( Benchmark *benchmark, u32 warmupCount, u32 sampleCount, char *filter );
+
+bool IsBenchmarkScenarioEnabled( Benchmark *benchmark, char *name );
+
+// Warms up, then times every sample on its own. False when the filter skips it or a sample failed
+bool RunBenchmarkScenario( Benchmark *benchmark, char *name, char *itemName, u64 itemsPerSample, Benchmark_Function function,
+                           void *data );
+
+// Same, setup runs untimed before every warmup run and sample
+bool RunBenchmarkScenarioWithSetup( Benchmark *benchmark, char *name, char *itemName, u64 itemsPerSample, Benchmark_Function setup,
+                                    Benchmark_Function function, void *data );
+
+void PrintBenchmarkResults( Benchmark *benchmark );
+
+// deviceName and driverName end up in the file so comparisons across machines are easy to spot
+bool WriteBenchmarkJson( Benchmark *benchmark, char *path, char *deviceName, char *driverName );
+
+// Only reads files WriteBenchmarkJson wrote. Medians are compared, threshold is a fraction of the baseline's.
+// Scenarios missing from either side are reported but never count as regressions
+bool CompareBenchmarkBaseline( Benchmark *benchmark, char *path, float64 threshold, u32 *regressionCount );
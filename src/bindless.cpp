@@ -0,0 +1,238 @@
+#include "bindless.h"
+#include "trace.h"
+#include "stdio.h"
+
+static VkDescriptorType bindlessDescriptorTypes[ BINDLESS_BINDING_COUNT ] = {
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    VK_DESCRIPTOR_TYPE_SAMPLER,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+};
+
+static char *bindlessBindingNames[ BINDLESS_BINDING_COUNT ] = { "sampled images", "samplers", "storage buffers" };
+
+static u32 MinU32( u32 a, u32 b )
+{
+    return a < b ? a : b;
+}
+
+bool IsBindlessSupported( Device *device )
+{
+    VkPhysicalDeviceVulkan12Features *features = &device->enabledVulkan12Features;
+    return features->descriptorIndexing && features->runtimeDescriptorArray && features->descriptorBindingPartiallyBound &&
+           features->descriptorBindingSampledImageUpdateAfterBind && features->descriptorBindingStorageBufferUpdateAfterBind &&
+           features->descriptorBindingUpdateUnusedWhilePending;
+}
+
+static void InitBindlessSlots( Bindless_Slots *slots, u32 capacity )
+{
+    slots->capacity = capacity;
+    slots->usedCount = 0;
+    slots->peakUsedCount = 0;
+    slots->retired.clear();
+
+    // popped from the back, so the low indices go first
+    slots->freeList.resize( capacity );
+    for ( u32 i = 0; i < capacity; ++i )
+    {
+        slots->freeList[ i ] = capacity - 1 - i;
+    }
+}
+
+bool InitBindlessSet( Bindless_Set *bindless, Device *device )
+{
+    TRACE_FUNCTION();
+    bindless->device = device;
+    bindless->descriptorSetLayout = VK_NULL_HANDLE;
+    bindless->descriptorPool = VK_NULL_HANDLE;
+    bindless->descriptorSet = VK_NULL_HANDLE;
+
+    if ( !IsBindlessSupported( device ) )
+    {
+        printf( "Descriptor indexing with update after bind isn't supported!\n" );
+        return false;
+    }
+
+    // the per stage limits bound every array since all of them are visible to every stage
+    VkPhysicalDeviceVulkan12Properties *limits = &device->vulkan12Properties;
+    u32 capacities[ BINDLESS_BINDING_COUNT ];
+    capacities[ BINDLESS_BINDING_SAMPLED_IMAGES ] =
+        MinU32( BINDLESS_MAX_SAMPLED_IMAGES, MinU32( limits->maxDescriptorSetUpdateAfterBindSampledImages,
+                                                     limits->maxPerStageDescriptorUpdateAfterBindSampledImages ) );
+    capacities[ BINDLESS_BINDING_SAMPLERS ] =
+        MinU32( BINDLESS_MAX_SAMPLERS, MinU32( limits->maxDescriptorSetUpdateAfterBindSamplers,
+                                               limits->maxPerStageDescriptorUpdateAfterBindSamplers ) );
+    capacities[ BINDLESS_BINDING_STORAGE_BUFFERS ] =
+        MinU32( BINDLESS_MAX_STORAGE_BUFFERS, MinU32( limits->maxDescriptorSetUpdateAfterBindStorageBuffers,
+                                                      limits->maxPerStageDescriptorUpdateAfterBindStorageBuffers ) );
+
+    // frames in flight keep the set in use, unused while pending is what allows writing slots they don't read
+    VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    Descriptor_Set_Layout_Desc *layoutDesc = &bindless->layoutDesc;
+    *layoutDesc = {};
+    layoutDesc->flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    VkDescriptorPoolSize poolSizes[ BINDLESS_BINDING_COUNT ];
+    for ( u32 i = 0; i < BINDLESS_BINDING_COUNT; ++i )
+    {
+        AddDescriptorBinding( layoutDesc, i, bindlessDescriptorTypes[ i ], capacities[ i ],
+                              VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, bindingFlags );
+        poolSizes[ i ] = { bindlessDescriptorTypes[ i ], capacities[ i ] };
+        InitBindlessSlots( &bindless->slots[ i ], capacities[ i ] );
+    }
+
+    bindless->descriptorSetLayout = GetDescriptorSetLayout( &device->layoutCache, device->device, layoutDesc );
+    if ( bindless->descriptorSetLayout == VK_NULL_HANDLE )
+    {
+        printf( "Failed to create bindless descriptor set layout!\n" );
+        return false;
+    }
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = BINDLESS_BINDING_COUNT;
+    poolInfo.pPoolSizes = poolSizes;
+
+    if ( vkCreateDescriptorPool( device->device, &poolInfo, 0, &bindless->descriptorPool ) != VK_SUCCESS )
+    {
+        printf( "Failed to create bindless descriptor pool!\n" );
+        DestroyBindlessSet( bindless );
+        return false;
+    }
+
+    VkDescriptorSetAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = bindless->descriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &bindless->descriptorSetLayout;
+
+    if ( vkAllocateDescriptorSets( device->device, &allocateInfo, &bindless->descriptorSet ) != VK_SUCCESS )
+    {
+        printf( "Failed to allocate bindless descriptor set!\n" );
+        DestroyBindlessSet( bindless );
+        return false;
+    }
+
+    return true;
+}
+
+void DestroyBindlessSet( Bindless_Set *bindless )
+{
+    Device *device = bindless->device;
+
+    // destroying the pool frees the set, the layout belongs to the device's layout cache
+    vkDestroyDescriptorPool( device->device, bindless->descriptorPool, 0 );
+    bindless->descriptorPool = VK_NULL_HANDLE;
+    bindless->descriptorSetLayout = VK_NULL_HANDLE;
+    bindless->descriptorSet = VK_NULL_HANDLE;
+
+    for ( u32 i = 0; i < BINDLESS_BINDING_COUNT; ++i )
+    {
+        bindless->slots[ i ].freeList.clear();
+        bindless->slots[ i ].retired.clear();
+    }
+}
+
+// Takes the slot and writes its descriptor under the lock, vkUpdateDescriptorSets needs the set externally synchronized
+static u32 AddBindlessDescriptor( Bindless_Set *bindless, Bindless_Binding binding, VkDescriptorImageInfo *imageInfo,
+                                  VkDescriptorBufferInfo *bufferInfo )
+{
+    std::lock_guard< std::mutex > lock( bindless->mutex );
+
+    Bindless_Slots *slots = &bindless->slots[ binding ];
+    if ( slots->freeList.empty() )
+    {
+        printf( "Out of bindless %s (%u)!\n", bindlessBindingNames[ binding ], slots->capacity );
+        return BINDLESS_INVALID_INDEX;
+    }
+
+    u32 index = slots->freeList.back();
+    slots->freeList.pop_back();
+    slots->usedCount++;
+    if ( slots->usedCount > slots->peakUsedCount ) slots->peakUsedCount = slots->usedCount;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = bindless->descriptorSet;
+    write.dstBinding = binding;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = bindlessDescriptorTypes[ binding ];
+    write.pImageInfo = imageInfo;
+    write.pBufferInfo = bufferInfo;
+    vkUpdateDescriptorSets( bindless->device->device, 1, &write, 0, 0 );
+
+    return index;
+}
+
+u32 AddBindlessSampledImage( Bindless_Set *bindless, VkImageView imageView, VkImageLayout imageLayout )
+{
+    VkDescriptorImageInfo imageInfo = { VK_NULL_HANDLE, imageView, imageLayout };
+    return AddBindlessDescriptor( bindless, BINDLESS_BINDING_SAMPLED_IMAGES, &imageInfo, 0 );
+}
+
+u32 AddBindlessSampler( Bindless_Set *bindless, VkSampler sampler )
+{
+    VkDescriptorImageInfo imageInfo = { sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED };
+    return AddBindlessDescriptor( bindless, BINDLESS_BINDING_SAMPLERS, &imageInfo, 0 );
+}
+
+u32 AddBindlessStorageBuffer( Bindless_Set *bindless, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range )
+{
+    VkDescriptorBufferInfo bufferInfo = { buffer, offset, range };
+    return AddBindlessDescriptor( bindless, BINDLESS_BINDING_STORAGE_BUFFERS, 0, &bufferInfo );
+}
+
+void RemoveBindlessResource( Bindless_Set *bindless, Bindless_Binding binding, u32 index, u64 frameNumber )
+{
+    if ( index == BINDLESS_INVALID_INDEX )
+    {
+        return;
+    }
+
+    std::lock_guard< std::mutex > lock( bindless->mutex );
+    Bindless_Slots *slots = &bindless->slots[ binding ];
+    slots->retired.push_back( { index, frameNumber } );
+    slots->usedCount--;
+}
+
+void UpdateBindlessSet( Bindless_Set *bindless, u64 frameNumber, u32 framesInFlight )
+{
+    std::lock_guard< std::mutex > lock( bindless->mutex );
+    for ( u32 i = 0; i < BINDLESS_BINDING_COUNT; ++i )
+    {
+        Bindless_Slots *slots = &bindless->slots[ i ];
+        for ( size_t j = 0; j < slots->retired.size(); )
+        {
+            if ( slots->retired[ j ].retireFrame + framesInFlight <= frameNumber )
+            {
+                slots->freeList.push_back( slots->retired[ j ].index );
+                slots->retired[ j ] = slots->retired.back();
+                slots->retired.pop_back();
+            }
+            else
+            {
+                ++j;
+            }
+        }
+    }
+}
+
+void BindBindlessSet( Bindless_Set *bindless, VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint,
+                      VkPipelineLayout pipelineLayout )
+{
+    vkCmdBindDescriptorSets( commandBuffer, bindPoint, pipelineLayout, 0, 1, &bindless->descriptorSet, 0, 0 );
+}
+
+void PrintBindlessStats( Bindless_Set *bindless )
+{
+    std::lock_guard< std::mutex > lock( bindless->mutex );
+    printf( "Bindless descriptors:\n" );
+    for ( u32 i = 0; i < BINDLESS_BINDING_COUNT; ++i )
+    {
+        Bindless_Slots *slots = &bindless->slots[ i ];
+        printf( "\t%s: %u / %u used (peak %u), %u waiting on frames in flight\n", bindlessBindingNames[ i ],
+                slots->usedCount, slots->capacity, slots->peakUsedCount, ( u32 ) slots->retired.size() );
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "device.h"
+#include "utils/utils.h"
+#include <vector> //@TODO: Remove std garbage
+#include <mutex>
+
+// Requested sizes, clamped to the device's update after bind limits
+#define BINDLESS_MAX_SAMPLED_IMAGES 16384
+#define BINDLESS_MAX_SAMPLERS 64
+#define BINDLESS_MAX_STORAGE_BUFFERS 4096
+
+#define BINDLESS_INVALID_INDEX 0xffffffff
+
+// Binding numbers match the arrays declared in the shaders
+enum Bindless_Binding
+{
+    BINDLESS_BINDING_SAMPLED_IMAGES = 0,
+    BINDLESS_BINDING_SAMPLERS = 1,
+    BINDLESS_BINDING_STORAGE_BUFFERS = 2,
+    BINDLESS_BINDING_COUNT,
+};
+
+struct Bindless_Retired_Slot
+{
+    u32 index;
+    u64 retireFrame;
+};
+
+struct Bindless_Slots
+{
+    u32 capacity;
+    u32 usedCount;
+    u32 peakUsedCount;
+    std::vector< u32 > freeList;
+    std::vector< Bindless_Retired_Slot > retired;
+};
+
+// One global descriptor set bound once per command buffer, resources are referenced by their slot index
+// from push constants. The arrays are partially bound and update after bind, so slots can be written
+// while frames that never touch them are in flight
+struct Bindless_Set
+{
+    Device *device;
+    // pipeline layouts built from shader reflection take set 0 from this
+    Descriptor_Set_Layout_Desc layoutDesc;
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSet;
+    Bindless_Slots slots[ BINDLESS_BINDING_COUNT ];
+    // streaming and the main thread both add resources
+    std::mutex mutex;
+};
+
+bool IsBindlessSupported( Device *device );
+
+bool InitBindlessSet( Bindless_Set *bindless, Device *device );
+void DestroyBindlessSet( Bindless_Set *bindless );
+
+// Each returns BINDLESS_INVALID_INDEX when its array is full
+u32 AddBindlessSampledImage( Bindless_Set *bindless, VkImageView imageView, VkImageLayout imageLayout );
+u32 AddBindlessSampler( Bindless_Set *bindless, VkSampler sampler );
+u32 AddBindlessStorageBuffer( Bindless_Set *bindless, VkBuffer buffer, VkDeviceSize offset = 0,
+                              VkDeviceSize range = VK_WHOLE_SIZE );
+
+// Frames already recorded may still read the slot, it's handed out again once they have finished
+void RemoveBindlessResource( Bindless_Set *bindless, Bindless_Binding binding, u32 index, u64 frameNumber );
+
+// Call once a frame before recording, recycles the slots no frame in flight can see anymore
+void UpdateBindlessSet( Bindless_Set *bindless, u64 frameNumber, u32 framesInFlight );
+
+void BindBindlessSet( Bindless_Set *bindless, VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint,
+                      VkPipelineLayout pipelineLayout );
+
+void PrintBindlessStats( Bindless_Set *bindless );
@@ -0,0 +1,467 @@
+#include "cpu_culling.h"
+#include "platform.h"
+#include "trace.h"
+#include "stdio.h"
+#include "math.h"
+#include <chrono> //@TODO: Remove std garbage
+
+#if defined( _M_X64 ) || defined( __x86_64__ )
+#define CULL_SIMD 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CULL_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define CULL_TARGET_AVX2 __attribute__( ( target( "avx2" ) ) )
+#endif
+#else
+#define CULL_SIMD 0
+#endif
+
+#define CULL_ARRAY_COUNT 10
+
+#if CULL_SIMD
+static u32 FindLowestSetBit( u32 mask )
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward( &index, mask );
+    return ( u32 ) index;
+#else
+    return ( u32 ) __builtin_ctz( mask );
+#endif
+}
+#endif
+
+Cull_Kernel GetBestCullKernel()
+{
+#if CULL_SIMD
+    u32 registers[ 4 ] = {};
+#ifdef _MSC_VER
+    __cpuidex( ( int * ) registers, 1, 0 );
+#else
+    __cpuid_count( 1, 0, registers[ 0 ], registers[ 1 ], registers[ 2 ], registers[ 3 ] );
+#endif
+    bool osxsave = ( registers[ 2 ] & ( 1u << 27 ) ) != 0;
+    bool avx = ( registers[ 2 ] & ( 1u << 28 ) ) != 0;
+
+    // the OS has to save the ymm registers on context switches too
+    bool ymmEnabled = false;
+    if ( osxsave && avx )
+    {
+#ifdef _MSC_VER
+        u64 xcr0 = _xgetbv( 0 );
+#else
+        u32 eax, edx;
+        __asm__( "xgetbv" : "=a"( eax ), "=d"( edx ) : "c"( 0 ) );
+        u64 xcr0 = ( ( u64 ) edx << 32 ) | eax;
+#endif
+        ymmEnabled = ( xcr0 & 0x6 ) == 0x6;
+    }
+
+#ifdef _MSC_VER
+    __cpuidex( ( int * ) registers, 7, 0 );
+#else
+    __cpuid_count( 7, 0, registers[ 0 ], registers[ 1 ], registers[ 2 ], registers[ 3 ] );
+#endif
+    bool avx2 = ( registers[ 1 ] & ( 1u << 5 ) ) != 0;
+
+    if ( avx2 && ymmEnabled )
+    {
+        return CULL_KERNEL_AVX2;
+    }
+    // SSE2 is part of x64
+    return CULL_KERNEL_SSE;
+#else
+    return CULL_KERNEL_SCALAR;
+#endif
+}
+
+char *GetCullKernelName( Cull_Kernel kernel )
+{
+    switch ( kernel )
+    {
+    case CULL_KERNEL_SCALAR: return "scalar";
+    case CULL_KERNEL_SSE: return "sse";
+    case CULL_KERNEL_AVX2: return "avx2";
+    }
+    return "unknown";
+}
+
+void InitCpuCuller( Cpu_Culler *culler, u32 objectCount )
+{
+    *culler = {};
+    culler->objectCount = objectCount;
+    culler->capacity = ( objectCount + CULL_LANE_COUNT - 1 ) & ~( CULL_LANE_COUNT - 1 );
+    culler->kernel = GetBestCullKernel();
+
+    size_t arraySize = ( size_t ) culler->capacity * sizeof( float32 );
+    culler->memory = AllocateAligned( arraySize * CULL_ARRAY_COUNT, 64 );
+    culler->visible = ( u32 * ) malloc( ( size_t ) culler->capacity * sizeof( u32 ) );
+    if ( !culler->memory || !culler->visible )
+    {
+        printf( "Failed to allocate culling data!\n" );
+        culler->objectCount = 0;
+        return;
+    }
+
+    // padding lanes get an empty sphere far behind every plane so they are never visible
+    float32 *arrays[ CULL_ARRAY_COUNT ];
+    for ( u32 i = 0; i < CULL_ARRAY_COUNT; ++i )
+    {
+        arrays[ i ] = ( float32 * ) ( ( u8 * ) culler->memory + arraySize * i );
+        for ( u32 object = 0; object < culler->capacity; ++object )
+        {
+            arrays[ i ][ object ] = 0.0f;
+        }
+    }
+    culler->bounds.sphereX = arrays[ 0 ];
+    culler->bounds.sphereY = arrays[ 1 ];
+    culler->bounds.sphereZ = arrays[ 2 ];
+    culler->bounds.sphereRadius = arrays[ 3 ];
+    culler->bounds.boxX = arrays[ 4 ];
+    culler->bounds.boxY = arrays[ 5 ];
+    culler->bounds.boxZ = arrays[ 6 ];
+    culler->bounds.extentX = arrays[ 7 ];
+    culler->bounds.extentY = arrays[ 8 ];
+    culler->bounds.extentZ = arrays[ 9 ];
+    for ( u32 object = objectCount; object < culler->capacity; ++object )
+    {
+        culler->bounds.sphereRadius[ object ] = -INFINITY;
+    }
+
+    u32 chunkCount = ( objectCount + CULL_CHUNK_SIZE - 1 ) / CULL_CHUNK_SIZE;
+    culler->jobs.resize( chunkCount );
+    for ( u32 i = 0; i < chunkCount; ++i )
+    {
+        Cull_Job *job = &culler->jobs[ i ];
+        job->culler = culler;
+        job->firstObject = i * CULL_CHUNK_SIZE;
+        job->objectCount = CULL_CHUNK_SIZE;
+        if ( job->firstObject + job->objectCount > objectCount )
+        {
+            job->objectCount = objectCount - job->firstObject;
+        }
+        job->visibleCount = 0;
+    }
+}
+
+void DestroyCpuCuller( Cpu_Culler *culler )
+{
+    FreeAligned( culler->memory );
+    free( culler->visible );
+    culler->memory = 0;
+    culler->visible = 0;
+    culler->jobs.clear();
+}
+
+void SetCullObject( Cpu_Culler *culler, u32 objectIndex, float32 *transform, float32 *boundingSphere,
+                    float32 *boundsMin, float32 *boundsMax )
+{
+    Assert( objectIndex < culler->objectCount );
+    Cull_Bounds *bounds = &culler->bounds;
+
+    float32 scale = 0.0f;
+    for ( u32 column = 0; column < 3; ++column )
+    {
+        float32 *axis = &transform[ column * 4 ];
+        float32 length = sqrtf( axis[ 0 ] * axis[ 0 ] + axis[ 1 ] * axis[ 1 ] + axis[ 2 ] * axis[ 2 ] );
+        if ( length > scale ) scale = length;
+    }
+
+    float32 sphere[ 3 ];
+    float32 boxCenter[ 3 ];
+    float32 boxExtent[ 3 ];
+    for ( u32 row = 0; row < 3; ++row )
+    {
+        sphere[ row ] = transform[ 12 + row ];
+        boxCenter[ row ] = transform[ 12 + row ];
+        boxExtent[ row ] = 0.0f;
+        for ( u32 column = 0; column < 3; ++column )
+        {
+            float32 element = transform[ column * 4 + row ];
+            float32 center = ( boundsMin[ column ] + boundsMax[ column ] ) * 0.5f;
+            float32 extent = ( boundsMax[ column ] - boundsMin[ column ] ) * 0.5f;
+            sphere[ row ] += element * boundingSphere[ column ];
+            boxCenter[ row ] += element * center;
+            boxExtent[ row ] += fabsf( element ) * extent;
+        }
+    }
+
+    bounds->sphereX[ objectIndex ] = sphere[ 0 ];
+    bounds->sphereY[ objectIndex ] = sphere[ 1 ];
+    bounds->sphereZ[ objectIndex ] = sphere[ 2 ];
+    bounds->sphereRadius[ objectIndex ] = boundingSphere[ 3 ] * scale;
+    bounds->boxX[ objectIndex ] = boxCenter[ 0 ];
+    bounds->boxY[ objectIndex ] = boxCenter[ 1 ];
+    bounds->boxZ[ objectIndex ] = boxCenter[ 2 ];
+    bounds->extentX[ objectIndex ] = boxExtent[ 0 ];
+    bounds->extentY[ objectIndex ] = boxExtent[ 1 ];
+    bounds->extentZ[ objectIndex ] = boxExtent[ 2 ];
+}
+
+// An object is visible when its sphere and its box both reach the inner side of every plane.
+// All kernels use the same operation order without FMA so they agree bit for bit with this one
+static u32 CullScalar( Cull_Bounds *bounds, float32 planes[ 6 ][ 4 ], u32 first, u32 count, u32 *visible )
+{
+    u32 visibleCount = 0;
+    for ( u32 i = first; i < first + count; ++i )
+    {
+        bool inside = true;
+        for ( u32 plane = 0; plane < 6; ++plane )
+        {
+            float32 *p = planes[ plane ];
+            float32 sphereDistance = p[ 0 ] * bounds->sphereX[ i ] + p[ 1 ] * bounds->sphereY[ i ] +
+                                     p[ 2 ] * bounds->sphereZ[ i ] + p[ 3 ];
+            float32 boxDistance = p[ 0 ] * bounds->boxX[ i ] + p[ 1 ] * bounds->boxY[ i ] + p[ 2 ] * bounds->boxZ[ i ] + p[ 3 ];
+            float32 boxRadius = fabsf( p[ 0 ] ) * bounds->extentX[ i ] + fabsf( p[ 1 ] ) * bounds->extentY[ i ] +
+                                fabsf( p[ 2 ] ) * bounds->extentZ[ i ];
+            inside = inside && sphereDistance > -bounds->sphereRadius[ i ] && boxDistance > -boxRadius;
+        }
+        visible[ visibleCount ] = i;
+        visibleCount += inside ? 1 : 0;
+    }
+    return visibleCount;
+}
+
+#if CULL_SIMD
+static u32 CullSse( Cull_Bounds *bounds, float32 planes[ 6 ][ 4 ], u32 first, u32 count, u32 *visible )
+{
+    __m128 absMask = _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) );
+    __m128 signMask = _mm_castsi128_ps( _mm_set1_epi32( ( int ) 0x80000000 ) );
+
+    __m128 planeX[ 6 ], planeY[ 6 ], planeZ[ 6 ], planeW[ 6 ];
+    __m128 absX[ 6 ], absY[ 6 ], absZ[ 6 ];
+    for ( u32 plane = 0; plane < 6; ++plane )
+    {
+        planeX[ plane ] = _mm_set1_ps( planes[ plane ][ 0 ] );
+        planeY[ plane ] = _mm_set1_ps( planes[ plane ][ 1 ] );
+        planeZ[ plane ] = _mm_set1_ps( planes[ plane ][ 2 ] );
+        planeW[ plane ] = _mm_set1_ps( planes[ plane ][ 3 ] );
+        absX[ plane ] = _mm_and_ps( planeX[ plane ], absMask );
+        absY[ plane ] = _mm_and_ps( planeY[ plane ], absMask );
+        absZ[ plane ] = _mm_and_ps( planeZ[ plane ], absMask );
+    }
+
+    // chunks start on a lane boundary and the padding is never visible, so the last group can overrun count
+    u32 visibleCount = 0;
+    u32 end = first + count;
+    for ( u32 i = first; i < end; i += 4 )
+    {
+        __m128 sphereX = _mm_load_ps( bounds->sphereX + i );
+        __m128 sphereY = _mm_load_ps( bounds->sphereY + i );
+        __m128 sphereZ = _mm_load_ps( bounds->sphereZ + i );
+        __m128 negativeRadius = _mm_xor_ps( _mm_load_ps( bounds->sphereRadius + i ), signMask );
+
+        __m128 inside = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
+        for ( u32 plane = 0; plane < 6; ++plane )
+        {
+            __m128 sphereDistance = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( planeX[ plane ], sphereX ),
+                                                                        _mm_mul_ps( planeY[ plane ], sphereY ) ),
+                                                            _mm_mul_ps( planeZ[ plane ], sphereZ ) ),
+                                                planeW[ plane ] );
+            inside = _mm_and_ps( inside, _mm_cmpgt_ps( sphereDistance, negativeRadius ) );
+        }
+
+        // most culled objects fail the sphere test, skip loading their boxes
+        if ( _mm_movemask_ps( inside ) == 0 )
+        {
+            continue;
+        }
+
+        __m128 boxX = _mm_load_ps( bounds->boxX + i );
+        __m128 boxY = _mm_load_ps( bounds->boxY + i );
+        __m128 boxZ = _mm_load_ps( bounds->boxZ + i );
+        __m128 extentX = _mm_load_ps( bounds->extentX + i );
+        __m128 extentY = _mm_load_ps( bounds->extentY + i );
+        __m128 extentZ = _mm_load_ps( bounds->extentZ + i );
+        for ( u32 plane = 0; plane < 6; ++plane )
+        {
+            __m128 boxDistance = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( planeX[ plane ], boxX ),
+                                                                     _mm_mul_ps( planeY[ plane ], boxY ) ),
+                                                         _mm_mul_ps( planeZ[ plane ], boxZ ) ),
+                                             planeW[ plane ] );
+            __m128 boxRadius = _mm_add_ps( _mm_add_ps( _mm_mul_ps( absX[ plane ], extentX ), _mm_mul_ps( absY[ plane ], extentY ) ),
+                                           _mm_mul_ps( absZ[ plane ], extentZ ) );
+            inside = _mm_and_ps( inside, _mm_cmpgt_ps( boxDistance, _mm_xor_ps( boxRadius, signMask ) ) );
+        }
+
+        u32 mask = ( u32 ) _mm_movemask_ps( inside );
+        while ( mask )
+        {
+            visible[ visibleCount++ ] = i + FindLowestSetBit( mask );
+            mask &= mask - 1;
+        }
+    }
+    return visibleCount;
+}
+
+CULL_TARGET_AVX2
+static u32 CullAvx2( Cull_Bounds *bounds, float32 planes[ 6 ][ 4 ], u32 first, u32 count, u32 *visible )
+{
+    __m256 absMask = _mm256_castsi256_ps( _mm256_set1_epi32( 0x7fffffff ) );
+    __m256 signMask = _mm256_castsi256_ps( _mm256_set1_epi32( ( int ) 0x80000000 ) );
+
+    __m256 planeX[ 6 ], planeY[ 6 ], planeZ[ 6 ], planeW[ 6 ];
+    __m256 absX[ 6 ], absY[ 6 ], absZ[ 6 ];
+    for ( u32 plane = 0; plane < 6; ++plane )
+    {
+        planeX[ plane ] = _mm256_set1_ps( planes[ plane ][ 0 ] );
+        planeY[ plane ] = _mm256_set1_ps( planes[ plane ][ 1 ] );
+        planeZ[ plane ] = _mm256_set1_ps( planes[ plane ][ 2 ] );
+        planeW[ plane ] = _mm256_set1_ps( planes[ plane ][ 3 ] );
+        absX[ plane ] = _mm256_and_ps( planeX[ plane ], absMask );
+        absY[ plane ] = _mm256_and_ps( planeY[ plane ], absMask );
+        absZ[ plane ] = _mm256_and_ps( planeZ[ plane ], absMask );
+    }
+
+    __m256i laneIndices = _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 );
+
+    u32 visibleCount = 0;
+    u32 end = first + count;
+    for ( u32 i = first; i < end; i += 8 )
+    {
+        __m256 sphereX = _mm256_load_ps( bounds->sphereX + i );
+        __m256 sphereY = _mm256_load_ps( bounds->sphereY + i );
+        __m256 sphereZ = _mm256_load_ps( bounds->sphereZ + i );
+        __m256 negativeRadius = _mm256_xor_ps( _mm256_load_ps( bounds->sphereRadius + i ), signMask );
+
+        __m256 inside = _mm256_castsi256_ps( _mm256_set1_epi32( -1 ) );
+        for ( u32 plane = 0; plane < 6; ++plane )
+        {
+            __m256 sphereDistance = _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( planeX[ plane ], sphereX ),
+                                                                                 _mm256_mul_ps( planeY[ plane ], sphereY ) ),
+                                                                  _mm256_mul_ps( planeZ[ plane ], sphereZ ) ),
+                                                   planeW[ plane ] );
+            inside = _mm256_and_ps( inside, _mm256_cmp_ps( sphereDistance, negativeRadius, _CMP_GT_OQ ) );
+        }
+
+        if ( _mm256_movemask_ps( inside ) == 0 )
+        {
+            continue;
+        }
+
+        __m256 boxX = _mm256_load_ps( bounds->boxX + i );
+        __m256 boxY = _mm256_load_ps( bounds->boxY + i );
+        __m256 boxZ = _mm256_load_ps( bounds->boxZ + i );
+        __m256 extentX = _mm256_load_ps( bounds->extentX + i );
+        __m256 extentY = _mm256_load_ps( bounds->extentY + i );
+        __m256 extentZ = _mm256_load_ps( bounds->extentZ + i );
+        for ( u32 plane = 0; plane < 6; ++plane )
+        {
+            __m256 boxDistance = _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( planeX[ plane ], boxX ),
+                                                                              _mm256_mul_ps( planeY[ plane ], boxY ) ),
+                                                               _mm256_mul_ps( planeZ[ plane ], boxZ ) ),
+                                                planeW[ plane ] );
+            __m256 boxRadius = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( absX[ plane ], extentX ),
+                                                             _mm256_mul_ps( absY[ plane ], extentY ) ),
+                                              _mm256_mul_ps( absZ[ plane ], extentZ ) );
+            inside = _mm256_and_ps( inside, _mm256_cmp_ps( boxDistance, _mm256_xor_ps( boxRadius, signMask ), _CMP_GT_OQ ) );
+        }
+
+        u32 mask = ( u32 ) _mm256_movemask_ps( inside );
+        if ( mask == 0xff )
+        {
+            // fully visible groups are common, store all eight indices at once
+            _mm256_storeu_si256( ( __m256i * ) ( visible + visibleCount ),
+                                 _mm256_add_epi32( laneIndices, _mm256_set1_epi32( ( int ) i ) ) );
+            visibleCount += 8;
+            continue;
+        }
+        while ( mask )
+        {
+            visible[ visibleCount++ ] = i + FindLowestSetBit( mask );
+            mask &= mask - 1;
+        }
+    }
+    return visibleCount;
+}
+
+#endif
+
+static void CullChunk( void *data, u32 workerIndex )
+{
+    TRACE_FUNCTION();
+    Cull_Job *job = ( Cull_Job * ) data;
+    Cpu_Culler *culler = job->culler;
+    u32 *visible = culler->visible + job->firstObject;
+
+    switch ( culler->kernel )
+    {
+    case CULL_KERNEL_SCALAR:
+        job->visibleCount = CullScalar( &culler->bounds, culler->frustumPlanes, job->firstObject, job->objectCount, visible );
+        break;
+#if CULL_SIMD
+    case CULL_KERNEL_SSE:
+        job->visibleCount = CullSse( &culler->bounds, culler->frustumPlanes, job->firstObject, job->objectCount, visible );
+        break;
+    case CULL_KERNEL_AVX2:
+        job->visibleCount = CullAvx2( &culler->bounds, culler->frustumPlanes, job->firstObject, job->objectCount, visible );
+        break;
+#else
+    default:
+        job->visibleCount = CullScalar( &culler->bounds, culler->frustumPlanes, job->firstObject, job->objectCount, visible );
+        break;
+#endif
+    }
+}
+
+static void CullChunks( void *data, u32 begin, u32 end, u32 workerIndex )
+{
+    Cpu_Culler *culler = ( Cpu_Culler * ) data;
+    for ( u32 i = begin; i < end; ++i )
+    {
+        CullChunk( &culler->jobs[ i ], workerIndex );
+    }
+}
+
+u32 CullObjects( Cpu_Culler *culler, Job_System *jobs, float32 frustumPlanes[ 6 ][ 4 ] )
+{
+    TRACE_FUNCTION();
+    auto start = std::chrono::high_resolution_clock::now();
+
+    memcpy( culler->frustumPlanes, frustumPlanes, sizeof( culler->frustumPlanes ) );
+
+    u32 jobCount = ( u32 ) culler->jobs.size();
+    if ( jobs && jobCount > 1 )
+    {
+        ParallelFor( jobs, jobCount, 1, CullChunks, culler );
+    }
+    else
+    {
+        CullChunks( culler, 0, jobCount, 0 );
+    }
+
+    // every chunk wrote at its own start, close the gaps between them
+    u32 visibleCount = 0;
+    for ( u32 i = 0; i < jobCount; ++i )
+    {
+        Cull_Job *job = &culler->jobs[ i ];
+        if ( job->firstObject != visibleCount )
+        {
+            memmove( culler->visible + visibleCount, culler->visible + job->firstObject, job->visibleCount * sizeof( u32 ) );
+        }
+        visibleCount += job->visibleCount;
+    }
+    culler->visibleCount = visibleCount;
+
+    auto end = std::chrono::high_resolution_clock::now();
+    culler->lastMilliseconds = std::chrono::duration< float64, std::milli >( end - start ).count();
+    culler->totalMilliseconds += culler->lastMilliseconds;
+    culler->cullCount++;
+
+    return visibleCount;
+}
+
+void PrintCpuCullerStats( Cpu_Culler *culler )
+{
+    if ( culler->cullCount == 0 )
+    {
+        return;
+    }
+
+    printf( "CPU culling (%s): %u objects, %u visible, %.3f ms average, %.3f ms last\n", GetCullKernelName( culler->kernel ),
+            culler->objectCount, culler->visibleCount, culler->totalMilliseconds / ( float64 ) culler->cullCount,
+            culler->lastMilliseconds );
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "job_system.h"
+#include "utils/utils.h"
+#include <vector> //@TODO: Remove std garbage
+
+// Kernels process 8 objects at a time, capacity is padded so they never need a scalar tail
+#define CULL_LANE_COUNT 8
+#define CULL_CHUNK_SIZE 16384
+
+enum Cull_Kernel
+{
+    CULL_KERNEL_SCALAR,
+    CULL_KERNEL_SSE,
+    CULL_KERNEL_AVX2,
+};
+
+// World space bounds in structure-of-arrays form, boxes are stored as center + half extent
+struct Cull_Bounds
+{
+    float32 *sphereX;
+    float32 *sphereY;
+    float32 *sphereZ;
+    float32 *sphereRadius;
+    float32 *boxX;
+    float32 *boxY;
+    float32 *boxZ;
+    float32 *extentX;
+    float32 *extentY;
+    float32 *extentZ;
+};
+
+struct Cull_Job
+{
+    struct Cpu_Culler *culler;
+    u32 firstObject;
+    u32 objectCount;
+    u32 visibleCount;
+};
+
+struct Cpu_Culler
+{
+    Cull_Bounds bounds;
+    void *memory;
+    u32 objectCount;
+    u32 capacity;
+
+    Cull_Kernel kernel;
+    float32 frustumPlanes[ 6 ][ 4 ];
+
+    // jobs write into their own range of visible, CullObjects packs the ranges together afterwards
+    std::vector< Cull_Job > jobs;
+    u32 *visible;
+    u32 visibleCount;
+
+    u64 cullCount;
+    float64 totalMilliseconds;
+    float64 lastMilliseconds;
+};
+
+void InitCpuCuller( Cpu_Culler *culler, u32 objectCount );
+void DestroyCpuCuller( Cpu_Culler *culler );
+
+// Best kernel the CPU and OS support
+Cull_Kernel GetBestCullKernel();
+char *GetCullKernelName( Cull_Kernel kernel );
+
+// Transforms object space bounds by a column major object to world matrix
+void SetCullObject( Cpu_Culler *culler, u32 objectIndex, float32 *transform, float32 *boundingSphere,
+                    float32 *boundsMin, float32 *boundsMax );
+
+// Fills culler->visible with the indices of the objects inside the frustum, in ascending order.
+// jobs is null to cull on the calling thread only
+u32 CullObjects( Cpu_Culler *culler, Job_System *jobs, float32 frustumPlanes[ 6 ][ 4 ] );
+
+void PrintCpuCullerStats( Cpu_Culler *culler );
@@ -1,4 +1,6 @@
 #include "device.h"
+#include "trace.h"
+#include "string.h"
 #include <set> //@TODO: Remove std garbage
 #include <unordered_set>
 #include <string>
@@ -43,17 +45,30 @@ void DestroyDebugUtilsMessengerEXT( VkInstance instance,
 void InitDevice( Device *device, Window *window )
 {
     device->window = window;
+    device->headless = window == 0;
+    if ( device->headless )
+    {
+        // presenting is the only reason we need the swapchain extension
+        device->deviceExtensions.clear();
+    }
+
     CreateInstance( device );
     SetupDebugMessenger( device );
     CreateSurface( device );
     PickPhysicalDevice( device );
     CreateLogicalDevice( device );
+    InitGpuAllocator( &device->allocator, device->physicalDevice, device->device );
+    LoadPipelineCache( &device->pipelineCache, device->device, &device->properties, PIPELINE_CACHE_PATH );
     CreateCommandPool( device );
 }
 
 void DestroyDevice( Device *device )
 {
     vkDestroyCommandPool( device->device, device->commandPool, 0 );
+    SavePipelineCache( &device->pipelineCache, device->device, &device->properties, PIPELINE_CACHE_PATH );
+    DestroyPipelineCache( &device->pipelineCache, device->device );
+    DestroyLayoutCache( &device->layoutCache, device->device );
+    DestroyGpuAllocator( &device->allocator );
     vkDestroyDevice( device->device, 0 );
 
     if ( device->enableValidationLayers )
@@ -61,7 +76,10 @@ void DestroyDevice( Device *device )
         DestroyDebugUtilsMessengerEXT( device->instance, device->debugMessenger, 0 );
     }
 
-    vkDestroySurfaceKHR( device->instance, device->surface, 0 );
+    if ( !device->headless )
+    {
+        vkDestroySurfaceKHR( device->instance, device->surface, 0 );
+    }
     vkDestroyInstance( device->instance, 0 );
 }
 
@@ -79,7 +97,7 @@ void CreateInstance( Device *device )
     appInfo.applicationVersion = VK_MAKE_VERSION( 1, 0, 0 );
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION( 1, 0, 0 );
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_2;
 
     VkInstanceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -141,6 +159,15 @@ void PickPhysicalDevice( Device *device )
     }
 
     vkGetPhysicalDeviceProperties( device->physicalDevice, &device->properties );
+
+    device->vulkan12Properties = {};
+    device->vulkan12Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2 = {};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &device->vulkan12Properties;
+    vkGetPhysicalDeviceProperties2( device->physicalDevice, &properties2 );
+    device->vulkan12Properties.pNext = 0;
+
     printf( "Physical device: %s\n", device->properties.deviceName );
 }
 
@@ -148,8 +175,11 @@ void CreateLogicalDevice( Device *device )
 {
     Queue_Family_Indices indices = FindQueueFamilies( device, device->physicalDevice );
 
+    device->queueFamilies = indices;
+
     std::vector< VkDeviceQueueCreateInfo > queueCreateInfos;
-    std::set< u32 > uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+    std::set< u32 > uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily, indices.transferFamily,
+                                            indices.computeFamily };
 
     float queuePriority = 1.0f;
     for ( u32 queueFamily : uniqueQueueFamilies )
@@ -162,11 +192,64 @@ void CreateLogicalDevice( Device *device )
         queueCreateInfos.push_back( queueCreateInfo );
     }
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures( device->physicalDevice, &supportedFeatures );
+
     VkPhysicalDeviceFeatures deviceFeatures = {};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
+    deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+    deviceFeatures.inheritedQueries = supportedFeatures.inheritedQueries;
+    deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+    deviceFeatures.fragmentStoresAndAtomics = supportedFeatures.fragmentStoresAndAtomics;
+    device->enabledFeatures = deviceFeatures;
+
+    VkPhysicalDeviceVulkan12Features supportedVulkan12Features = {};
+    supportedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    // the feature struct can only be chained when the extension is there
+    bool dynamicStateExtension = IsDeviceExtensionSupported( device->physicalDevice, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME );
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT supportedDynamicState = {};
+    supportedDynamicState.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    supportedVulkan12Features.pNext = dynamicStateExtension ? &supportedDynamicState : 0;
+
+    VkPhysicalDeviceFeatures2 supportedFeatures2 = {};
+    supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures2.pNext = &supportedVulkan12Features;
+    vkGetPhysicalDeviceFeatures2( device->physicalDevice, &supportedFeatures2 );
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.timelineSemaphore = VK_TRUE;
+    vulkan12Features.drawIndirectCount = supportedVulkan12Features.drawIndirectCount;
+    vulkan12Features.descriptorIndexing = supportedVulkan12Features.descriptorIndexing;
+    vulkan12Features.runtimeDescriptorArray = supportedVulkan12Features.runtimeDescriptorArray;
+    vulkan12Features.descriptorBindingPartiallyBound = supportedVulkan12Features.descriptorBindingPartiallyBound;
+    vulkan12Features.descriptorBindingSampledImageUpdateAfterBind =
+        supportedVulkan12Features.descriptorBindingSampledImageUpdateAfterBind;
+    vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind =
+        supportedVulkan12Features.descriptorBindingStorageBufferUpdateAfterBind;
+    vulkan12Features.descriptorBindingUpdateUnusedWhilePending =
+        supportedVulkan12Features.descriptorBindingUpdateUnusedWhilePending;
+    vulkan12Features.shaderSampledImageArrayNonUniformIndexing =
+        supportedVulkan12Features.shaderSampledImageArrayNonUniformIndexing;
+    vulkan12Features.shaderStorageBufferArrayNonUniformIndexing =
+        supportedVulkan12Features.shaderStorageBufferArrayNonUniformIndexing;
+    device->enabledVulkan12Features = vulkan12Features;
+
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures = {};
+    dynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    dynamicStateFeatures.extendedDynamicState = VK_TRUE;
+    device->extendedDynamicState = dynamicStateExtension && supportedDynamicState.extendedDynamicState == VK_TRUE;
+    if ( device->extendedDynamicState )
+    {
+        device->deviceExtensions.push_back( VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME );
+        vulkan12Features.pNext = &dynamicStateFeatures;
+    }
 
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &vulkan12Features;
 
     createInfo.queueCreateInfoCount = ( u32 ) queueCreateInfos.size();
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -195,6 +278,8 @@ void CreateLogicalDevice( Device *device )
 
     vkGetDeviceQueue( device->device, indices.graphicsFamily, 0, &device->graphicsQueue );
     vkGetDeviceQueue( device->device, indices.presentFamily, 0, &device->presentQueue );
+    vkGetDeviceQueue( device->device, indices.transferFamily, 0, &device->transferQueue );
+    vkGetDeviceQueue( device->device, indices.computeFamily, 0, &device->computeQueue );
 }
 
 void CreateCommandPool( Device *device )
@@ -214,6 +299,12 @@ void CreateCommandPool( Device *device )
 
 void CreateSurface( Device *device )
 {
+    if ( device->headless )
+    {
+        device->surface = VK_NULL_HANDLE;
+        return;
+    }
+
     CreateWindowSurface( device->window, device->instance, &device->surface );
 }
 
@@ -233,17 +324,30 @@ bool IsDeviceSuitable( Device *device, VkPhysicalDevice physicalDevice )
 
     bool extensionsSupported = CheckDeviceExtensionSupport( device, physicalDevice );
 
-    bool swapChainAdequate = false;
-    if ( extensionsSupported )
+    bool swapChainAdequate = device->headless;
+    if ( extensionsSupported && !device->headless )
     {
         Swap_Chain_Support_Details swapChainSupport = QuerySwapChainSupport( device, physicalDevice );
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
 
-    VkPhysicalDeviceFeatures supportedFeatures;
-    vkGetPhysicalDeviceFeatures( physicalDevice, &supportedFeatures );
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties( physicalDevice, &properties );
+    if ( properties.apiVersion < VK_API_VERSION_1_2 )
+    {
+        return false;
+    }
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
 
-    return QueueFamilyIndiciesIsComplete( &indices ) && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+    VkPhysicalDeviceFeatures2 supportedFeatures = {};
+    supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures.pNext = &vulkan12Features;
+    vkGetPhysicalDeviceFeatures2( physicalDevice, &supportedFeatures );
+
+    return QueueFamilyIndiciesIsComplete( &indices ) && extensionsSupported && swapChainAdequate &&
+           supportedFeatures.features.samplerAnisotropy && vulkan12Features.timelineSemaphore;
 }
 
 void PopulateDebugMessengerCreateInfo( Device *device, VkDebugUtilsMessengerCreateInfoEXT &createInfo )
@@ -302,11 +406,15 @@ bool CheckValidationLayerSupport( Device *device )
 
 std::vector< const char * > GetRequiredExtensions( Device *device )
 {
-    u32 glfwExtensionCount = 0;
-    const char **glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions( &glfwExtensionCount );
+    std::vector< const char * > extensions;
 
-    std::vector< const char * > extensions( glfwExtensions, glfwExtensions + glfwExtensionCount );
+    if ( !device->headless )
+    {
+        u32 glfwExtensionCount = 0;
+        const char **glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions( &glfwExtensionCount );
+        extensions.assign( glfwExtensions, glfwExtensions + glfwExtensionCount );
+    }
 
     if ( device->enableValidationLayers )
     {
@@ -344,6 +452,24 @@ void HasGflwRequiredInstanceExtensions( Device *device )
     }
 }
 
+bool IsDeviceExtensionSupported( VkPhysicalDevice physicalDevice, char *extensionName )
+{
+    u32 extensionCount;
+    vkEnumerateDeviceExtensionProperties( physicalDevice, 0, &extensionCount, 0 );
+
+    std::vector< VkExtensionProperties > availableExtensions( extensionCount );
+    vkEnumerateDeviceExtensionProperties( physicalDevice, 0, &extensionCount, availableExtensions.data() );
+
+    for ( auto &extension : availableExtensions )
+    {
+        if ( strcmp( extension.extensionName, extensionName ) == 0 )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool CheckDeviceExtensionSupport( Device *device, VkPhysicalDevice physicalDevice )
 {
     u32 extensionCount;
@@ -375,26 +501,62 @@ Queue_Family_Indices FindQueueFamilies( Device *device, VkPhysicalDevice physica
     int i = 0;
     for ( auto &queueFamily : queueFamilies )
     {
-        if ( queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT )
+        if ( queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT &&
+             !indices.graphicsFamilyHasValue )
         {
             indices.graphicsFamily = i;
             indices.graphicsFamilyHasValue = true;
         }
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR( physicalDevice, i, device->surface, &presentSupport );
-        if ( queueFamily.queueCount > 0 && presentSupport )
+        if ( !device->headless )
+        {
+            vkGetPhysicalDeviceSurfaceSupportKHR( physicalDevice, i, device->surface, &presentSupport );
+        }
+        if ( queueFamily.queueCount > 0 && presentSupport && !indices.presentFamilyHasValue )
         {
             indices.presentFamily = i;
             indices.presentFamilyHasValue = true;
         }
-        if ( QueueFamilyIndiciesIsComplete( &indices ) )
+
+        // a transfer-only family usually maps to the copy engines, prefer it over anything else
+        bool transferOnly = ( queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT ) &&
+                            !( queueFamily.queueFlags & ( VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT ) );
+        if ( queueFamily.queueCount > 0 && transferOnly && !indices.transferFamilyHasValue )
         {
-            break;
+            indices.transferFamily = i;
+            indices.transferFamilyHasValue = true;
+        }
+
+        // compute without graphics runs next to the graphics queue instead of being scheduled in between its work
+        bool asyncCompute = ( queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT ) && !( queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT );
+        if ( queueFamily.queueCount > 0 && asyncCompute && !indices.computeFamilyHasValue )
+        {
+            indices.computeFamily = i;
+            indices.computeFamilyHasValue = true;
         }
 
         i++;
     }
 
+    // nothing is presented headless, the graphics queue stands in so the rest of the code doesn't care
+    if ( device->headless && indices.graphicsFamilyHasValue )
+    {
+        indices.presentFamily = indices.graphicsFamily;
+        indices.presentFamilyHasValue = true;
+    }
+
+    if ( !indices.transferFamilyHasValue && indices.graphicsFamilyHasValue )
+    {
+        indices.transferFamily = indices.graphicsFamily;
+        indices.transferFamilyHasValue = true;
+    }
+
+    if ( !indices.computeFamilyHasValue && indices.graphicsFamilyHasValue )
+    {
+        indices.computeFamily = indices.graphicsFamily;
+        indices.computeFamilyHasValue = true;
+    }
+
     return indices;
 }
 
@@ -462,14 +624,43 @@ u32 FindMemoryType( Device *device, u32 typeFilter, VkMemoryPropertyFlags proper
     return 0xFFFFFFFF;
 }
 
+// Resources filled by the upload manager on a dedicated transfer queue, and buffers the async compute queue reads
+// or writes, are shared concurrently so they never need queue family ownership transfers
+static u32 GetSharingFamilies( Device *device, bool transfer, bool compute, u32 *families )
+{
+    Queue_Family_Indices &indices = device->queueFamilies;
+    u32 count = 0;
+    families[ count++ ] = indices.graphicsFamily;
+    if ( transfer && indices.transferFamily != indices.graphicsFamily )
+    {
+        families[ count++ ] = indices.transferFamily;
+    }
+    if ( compute && indices.computeFamily != indices.graphicsFamily && indices.computeFamily != indices.transferFamily )
+    {
+        families[ count++ ] = indices.computeFamily;
+    }
+    return count > 1 ? count : 0;
+}
+
 void CreateBuffer( Device *device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                   VkBuffer &buffer, VkDeviceMemory &bufferMemory )
+                   VkBuffer &buffer, Gpu_Allocation &bufferAllocation, bool transient )
 {
+    TRACE_FUNCTION();
+    u32 sharingFamilies[ 3 ];
+    u32 sharingFamilyCount = GetSharingFamilies( device, ( usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT ) != 0,
+                                                 ( usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT ) != 0, sharingFamilies );
+
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
     bufferInfo.usage = usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if ( sharingFamilyCount > 0 )
+    {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = sharingFamilyCount;
+        bufferInfo.pQueueFamilyIndices = sharingFamilies;
+    }
 
     if ( vkCreateBuffer( device->device, &bufferInfo, 0, &buffer ) != VK_SUCCESS )
     {
@@ -480,18 +671,28 @@ void CreateBuffer( Device *device, VkDeviceSize size, VkBufferUsageFlags usage,
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements( device->device, buffer, &memRequirements );
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = FindMemoryType( device, memRequirements.memoryTypeBits, properties );
+    if ( transient )
+    {
+        bufferAllocation = AllocateTransientGpuMemory( &device->allocator, memRequirements, properties, true );
+    }
+    else
+    {
+        bufferAllocation = AllocateGpuMemory( &device->allocator, memRequirements, properties, true );
+    }
 
-    if ( vkAllocateMemory( device->device, &allocInfo, 0, &bufferMemory ) != VK_SUCCESS )
+    if ( bufferAllocation.memory == VK_NULL_HANDLE )
     {
         printf( "Failed to allocate vertex buffer memory!\n" );
         return;
     }
 
-    vkBindBufferMemory( device->device, buffer, bufferMemory, 0 );
+    vkBindBufferMemory( device->device, buffer, bufferAllocation.memory, bufferAllocation.offset );
+}
+
+void DestroyBuffer( Device *device, VkBuffer buffer, Gpu_Allocation &bufferAllocation )
+{
+    vkDestroyBuffer( device->device, buffer, 0 );
+    FreeGpuMemory( &device->allocator, &bufferAllocation );
 }
 
 VkCommandBuffer BeginSingleTimeCommands( Device *device )
@@ -515,6 +716,7 @@ VkCommandBuffer BeginSingleTimeCommands( Device *device )
 
 void EndSingleTimeCommands( Device *device, VkCommandBuffer commandBuffer )
 {
+    TRACE_FUNCTION();
     vkEndCommandBuffer( commandBuffer );
 
     VkSubmitInfo submitInfo{};
@@ -522,14 +724,22 @@ void EndSingleTimeCommands( Device *device, VkCommandBuffer commandBuffer )
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    vkQueueSubmit( device->graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE );
-    vkQueueWaitIdle( device->graphicsQueue );
+    // wait for this submission only instead of draining the whole graphics queue
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkFence fence;
+    vkCreateFence( device->device, &fenceInfo, 0, &fence );
+
+    vkQueueSubmit( device->graphicsQueue, 1, &submitInfo, fence );
+    vkWaitForFences( device->device, 1, &fence, VK_TRUE, UINT64_MAX );
+    vkDestroyFence( device->device, fence, 0 );
 
     vkFreeCommandBuffers( device->device, device->commandPool, 1, &commandBuffer );
 }
 
 void CopyBuffer( Device *device, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size )
 {
+    TRACE_FUNCTION();
     VkCommandBuffer commandBuffer = BeginSingleTimeCommands( device );
 
     VkBufferCopy copyRegion{};
@@ -543,6 +753,7 @@ void CopyBuffer( Device *device, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDevic
 
 void CopyBufferToImage( Device *device, VkBuffer buffer, VkImage image, u32 width, u32 height, u32 layerCount )
 {
+    TRACE_FUNCTION();
     VkCommandBuffer commandBuffer = BeginSingleTimeCommands( device );
 
     VkBufferImageCopy region{};
@@ -563,9 +774,23 @@ void CopyBufferToImage( Device *device, VkBuffer buffer, VkImage image, u32 widt
 }
 
 void CreateImageWithInfo( Device *device, VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties,
-                          VkImage &image, VkDeviceMemory &imageMemory )
+                          VkImage &image, Gpu_Allocation &imageAllocation, bool transient )
 {
-    if ( vkCreateImage( device->device, &imageInfo, 0, &image ) != VK_SUCCESS )
+    // the sharing families only live in this function, so the caller's info is left as it was
+    VkImageCreateInfo createInfo = imageInfo;
+    u32 sharingFamilies[ 3 ];
+    if ( ( createInfo.usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT ) && createInfo.sharingMode == VK_SHARING_MODE_EXCLUSIVE )
+    {
+        u32 sharingFamilyCount = GetSharingFamilies( device, true, false, sharingFamilies );
+        if ( sharingFamilyCount > 0 )
+        {
+            createInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            createInfo.queueFamilyIndexCount = sharingFamilyCount;
+            createInfo.pQueueFamilyIndices = sharingFamilies;
+        }
+    }
+
+    if ( vkCreateImage( device->device, &createInfo, 0, &image ) != VK_SUCCESS )
     {
         printf( "Failed to create image!\n" );
         return;
@@ -574,20 +799,32 @@ void CreateImageWithInfo( Device *device, VkImageCreateInfo &imageInfo, VkMemory
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements( device->device, image, &memRequirements );
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = FindMemoryType( device, memRequirements.memoryTypeBits, properties );
+    if ( transient )
+    {
+        imageAllocation = AllocateTransientGpuMemory( &device->allocator, memRequirements, properties,
+                                                      imageInfo.tiling == VK_IMAGE_TILING_LINEAR );
+    }
+    else
+    {
+        imageAllocation = AllocateGpuMemory( &device->allocator, memRequirements, properties,
+                                             imageInfo.tiling == VK_IMAGE_TILING_LINEAR );
+    }
 
-    if ( vkAllocateMemory( device->device, &allocInfo, 0, &imageMemory ) != VK_SUCCESS )
+    if ( imageAllocation.memory == VK_NULL_HANDLE )
     {
         printf( "Failed to allocate image memory!\n" );
         return;
     }
 
-    if ( vkBindImageMemory( device->device, image, imageMemory, 0 ) != VK_SUCCESS )
+    if ( vkBindImageMemory( device->device, image, imageAllocation.memory, imageAllocation.offset ) != VK_SUCCESS )
     {
         printf( "Failed to bind image memory!\n" );
         return;
     }
 }
+
+void DestroyImage( Device *device, VkImage image, Gpu_Allocation &imageAllocation )
+{
+    vkDestroyImage( device->device, image, 0 );
+    FreeGpuMemory( &device->allocator, &imageAllocation );
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "window.h"
+#include "gpu_memory.h"
+#include "pipeline_cache.h"
+#include "layout_cache.h"
 #include "utils/utils.h"
 #include <vector> //@TODO: Remove std garbage
 
@@ -15,8 +18,13 @@ struct Queue_Family_Indices
 {
     u32 graphicsFamily;
     u32 presentFamily;
+    u32 transferFamily;
+    // the graphics family when there is no compute family without graphics
+    u32 computeFamily;
     bool graphicsFamilyHasValue = false;
     bool presentFamilyHasValue = false;
+    bool transferFamilyHasValue = false;
+    bool computeFamilyHasValue = false;
 };
 
 inline bool QueueFamilyIndiciesIsComplete( Queue_Family_Indices *queue )
@@ -33,21 +41,39 @@ struct Device
 #endif
 
     VkPhysicalDeviceProperties properties;
+    // Descriptor indexing limits live here, pNext is cleared after the query
+    VkPhysicalDeviceVulkan12Properties vulkan12Properties;
+    // Optional features are only switched on when the physical device supports them
+    VkPhysicalDeviceFeatures enabledFeatures;
+    VkPhysicalDeviceVulkan12Features enabledVulkan12Features;
+    // VK_EXT_extended_dynamic_state, cull mode, front face and depth state are set on the command buffer
+    bool extendedDynamicState;
     VkInstance instance;
     VkDebugUtilsMessengerEXT debugMessenger;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     Window *window;
+    // No window or surface, the swap chain renders into images it owns and nothing is presented
+    bool headless;
     VkCommandPool commandPool;
 
     VkDevice device;
     VkSurfaceKHR surface;
     VkQueue graphicsQueue;
     VkQueue presentQueue;
+    VkQueue transferQueue;
+    // the graphics queue itself when the device has no separate compute family
+    VkQueue computeQueue;
+    Queue_Family_Indices queueFamilies;
+
+    Gpu_Allocator allocator;
+    Pipeline_Cache pipelineCache;
+    Layout_Cache layoutCache;
 
     std::vector< char * > validationLayers = { "VK_LAYER_KHRONOS_validation" };
     std::vector< char * > deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 };
 
+// Pass a null window to create a headless device for offscreen rendering
 void InitDevice( Device *device, Window *window );
 void DestroyDevice( Device *device );
 
@@ -60,8 +86,10 @@ Queue_Family_Indices FindPhysicalQueueFamilies( Device *device );
 VkFormat FindSupportedFormat( Device *device, std::vector< VkFormat > &candidates, VkImageTiling tiling, VkFormatFeatureFlags features );
 
 // Buffer Helper Functions
-void CreateBuffer( VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                   VkBuffer &buffer, VkDeviceMemory &bufferMemory );
+void CreateBuffer( Device *device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                   VkBuffer &buffer, Gpu_Allocation &bufferAllocation, bool transient = false );
+
+void DestroyBuffer( Device *device, VkBuffer buffer, Gpu_Allocation &bufferAllocation );
 
 VkCommandBuffer BeginSingleTimeCommands( Device *device );
 
@@ -71,7 +99,10 @@ void CopyBuffer( Device *device, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDevic
 
 void CopyBufferToImage( Device *device, VkBuffer buffer, VkImage image, u32 width, u32 height, u32 layerCount );
 
-void CreateImageWithInfo( Device *device, VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &imageMemory );
+void CreateImageWithInfo( Device *device, VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties,
+                          VkImage &image, Gpu_Allocation &imageAllocation, bool transient = false );
+
+void DestroyImage( Device *device, VkImage image, Gpu_Allocation &imageAllocation );
 
 void CreateInstance( Device *device );
 
@@ -99,4 +130,6 @@ void HasGflwRequiredInstanceExtensions( Device *device );
 
 bool CheckDeviceExtensionSupport( Device *device, VkPhysicalDevice physicalDevice );
 
+bool IsDeviceExtensionSupported( VkPhysicalDevice physicalDevice, char *extensionName );
+
 Swap_Chain_Support_Details QuerySwapChainSupport( Device *device, VkPhysicalDevice physicalDevice );
@@ -0,0 +1,95 @@
+#include "frame_commands.h"
+#include "stdio.h"
+
+void InitFrameCommandPools( Frame_Command_Pools *pools, Device *device, u32 framesInFlight, u32 threadCount )
+{
+    pools->device = device;
+    pools->frames.resize( framesInFlight );
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = device->queueFamilies.graphicsFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    for ( auto &frame : pools->frames )
+    {
+        if ( vkCreateCommandPool( device->device, &poolInfo, 0, &frame.primaryPool ) != VK_SUCCESS )
+        {
+            printf( "Failed to create frame command pool!\n" );
+            return;
+        }
+
+        frame.threadPools.resize( threadCount );
+        for ( auto &threadPool : frame.threadPools )
+        {
+            threadPool.usedSecondaryCount = 0;
+            if ( vkCreateCommandPool( device->device, &poolInfo, 0, &threadPool.commandPool ) != VK_SUCCESS )
+            {
+                printf( "Failed to create frame command pool!\n" );
+                return;
+            }
+        }
+
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = frame.primaryPool;
+        allocInfo.commandBufferCount = 1;
+
+        if ( vkAllocateCommandBuffers( device->device, &allocInfo, &frame.primaryBuffer ) != VK_SUCCESS )
+        {
+            printf( "Failed to allocate primary command buffer!\n" );
+            return;
+        }
+    }
+}
+
+void DestroyFrameCommandPools( Frame_Command_Pools *pools )
+{
+    for ( auto &frame : pools->frames )
+    {
+        // destroying a pool frees every buffer allocated from it
+        vkDestroyCommandPool( pools->device->device, frame.primaryPool, 0 );
+        for ( auto &threadPool : frame.threadPools )
+        {
+            vkDestroyCommandPool( pools->device->device, threadPool.commandPool, 0 );
+        }
+    }
+    pools->frames.clear();
+}
+
+Frame_Commands *BeginFrameCommands( Frame_Command_Pools *pools, u32 frameIndex )
+{
+    Frame_Commands *frame = &pools->frames[ frameIndex ];
+    vkResetCommandPool( pools->device->device, frame->primaryPool, 0 );
+    for ( auto &threadPool : frame->threadPools )
+    {
+        vkResetCommandPool( pools->device->device, threadPool.commandPool, 0 );
+        threadPool.usedSecondaryCount = 0;
+    }
+    return frame;
+}
+
+VkCommandBuffer AcquireSecondaryCommandBuffer( Frame_Command_Pools *pools, Frame_Commands *frame, u32 threadIndex )
+{
+    Thread_Command_Pool *threadPool = &frame->threadPools[ threadIndex ];
+
+    if ( threadPool->usedSecondaryCount == threadPool->secondaryBuffers.size() )
+    {
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandPool = threadPool->commandPool;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if ( vkAllocateCommandBuffers( pools->device->device, &allocInfo, &commandBuffer ) != VK_SUCCESS )
+        {
+            printf( "Failed to allocate secondary command buffer!\n" );
+            return VK_NULL_HANDLE;
+        }
+        threadPool->secondaryBuffers.push_back( commandBuffer );
+    }
+
+    return threadPool->secondaryBuffers[ threadPool->usedSecondaryCount++ ];
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "device.h"
+#include "utils/utils.h"
+#include <vector> //@TODO: Remove std garbage
+
+// One pool per recording thread, so threads never share a pool and buffers are recycled by resetting the pool
+struct Thread_Command_Pool
+{
+    VkCommandPool commandPool;
+    std::vector< VkCommandBuffer > secondaryBuffers;
+    u32 usedSecondaryCount;
+};
+
+struct Frame_Commands
+{
+    // the primary has a pool of its own, the main thread records it while workers record into their pools
+    VkCommandPool primaryPool;
+    VkCommandBuffer primaryBuffer;
+    std::vector< Thread_Command_Pool > threadPools;
+};
+
+struct Frame_Command_Pools
+{
+    Device *device;
+    std::vector< Frame_Commands > frames;
+};
+
+void InitFrameCommandPools( Frame_Command_Pools *pools, Device *device, u32 framesInFlight, u32 threadCount );
+void DestroyFrameCommandPools( Frame_Command_Pools *pools );
+
+// Only call once the fence of the frame's previous submission has been waited on
+Frame_Commands *BeginFrameCommands( Frame_Command_Pools *pools, u32 frameIndex );
+
+// Safe to call from several threads at once as long as each one passes its own threadIndex
+VkCommandBuffer AcquireSecondaryCommandBuffer( Frame_Command_Pools *pools, Frame_Commands *frame, u32 threadIndex );
@@ -0,0 +1,78 @@
+#include "frame_pacer.h"
+#include "trace.h"
+#include "stdio.h"
+#include <chrono> //@TODO: Remove std garbage
+#include <thread>
+
+static u64 GetPacerTimestamp()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return ( u64 ) std::chrono::duration_cast< std::chrono::nanoseconds >( now ).count();
+}
+
+void InitFramePacer( Frame_Pacer *pacer, bool enabled )
+{
+    *pacer = {};
+    pacer->enabled = enabled;
+}
+
+void WaitForInputSample( Frame_Pacer *pacer )
+{
+    if ( !pacer->enabled || pacer->frameCount == 0 )
+    {
+        return;
+    }
+
+    // the previous frame started on the GPU roughly when it was submitted
+    float64 sleepMilliseconds = pacer->gpuMilliseconds - pacer->cpuMilliseconds - FRAME_PACER_MARGIN_MILLISECONDS;
+    float64 elapsedMilliseconds = ( float64 ) ( GetPacerTimestamp() - pacer->submitNanoseconds ) / 1000000.0;
+    sleepMilliseconds -= elapsedMilliseconds;
+
+    if ( sleepMilliseconds > 0.0 )
+    {
+        TRACE_ZONE( "FramePacerSleep" );
+        std::this_thread::sleep_for( std::chrono::microseconds( ( s64 ) ( sleepMilliseconds * 1000.0 ) ) );
+        pacer->totalSleepMilliseconds += sleepMilliseconds;
+    }
+}
+
+void MarkInputSampled( Frame_Pacer *pacer )
+{
+    pacer->inputSampleNanoseconds = GetPacerTimestamp();
+}
+
+void MarkFrameSubmitted( Frame_Pacer *pacer, float64 gpuMilliseconds )
+{
+    pacer->submitNanoseconds = GetPacerTimestamp();
+
+    float64 cpuMilliseconds = ( float64 ) ( pacer->submitNanoseconds - pacer->inputSampleNanoseconds ) / 1000000.0;
+    if ( pacer->frameCount == 0 )
+    {
+        pacer->cpuMilliseconds = cpuMilliseconds;
+        pacer->gpuMilliseconds = gpuMilliseconds;
+    }
+    else
+    {
+        pacer->cpuMilliseconds += ( cpuMilliseconds - pacer->cpuMilliseconds ) * FRAME_PACER_SMOOTHING;
+        if ( gpuMilliseconds > 0.0 )
+        {
+            pacer->gpuMilliseconds += ( gpuMilliseconds - pacer->gpuMilliseconds ) * FRAME_PACER_SMOOTHING;
+        }
+    }
+
+    // input age once the GPU starts on the frame, the display adds its own latency on top
+    pacer->totalInputLatencyMilliseconds += cpuMilliseconds;
+    pacer->frameCount++;
+}
+
+void PrintFramePacerStats( Frame_Pacer *pacer )
+{
+    if ( pacer->frameCount == 0 )
+    {
+        return;
+    }
+
+    printf( "Frame pacer (%s): cpu %.3f ms, gpu %.3f ms, avg input to submit %.3f ms, avg sleep %.3f ms\n",
+            pacer->enabled ? "low latency" : "off", pacer->cpuMilliseconds, pacer->gpuMilliseconds,
+            pacer->totalInputLatencyMilliseconds / pacer->frameCount, pacer->totalSleepMilliseconds / pacer->frameCount );
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "utils/utils.h"
+
+// EMA weight of the newest sample
+#define FRAME_PACER_SMOOTHING 0.1
+// headroom kept between the predicted GPU finish and the input sample
+#define FRAME_PACER_MARGIN_MILLISECONDS 1.0
+
+// Low latency pacing: instead of sampling input as soon as the previous frame is submitted and letting the new
+// frame queue up behind it, sleep until the GPU is predicted to finish the previous frame minus the time the CPU
+// needs to record, so the new frame is submitted just as the GPU frees up.
+struct Frame_Pacer
+{
+    bool enabled;
+
+    float64 cpuMilliseconds;
+    float64 gpuMilliseconds;
+
+    u64 inputSampleNanoseconds;
+    u64 submitNanoseconds;
+
+    u64 frameCount;
+    float64 totalSleepMilliseconds;
+    float64 totalInputLatencyMilliseconds;
+};
+
+void InitFramePacer( Frame_Pacer *pacer, bool enabled );
+
+// Call right before polling input, sleeps in low latency mode
+void WaitForInputSample( Frame_Pacer *pacer );
+
+// Call right after polling input
+void MarkInputSampled( Frame_Pacer *pacer );
+
+// Call right after the frame was submitted. gpuMilliseconds is the most recent GPU frame time, 0 if unknown.
+void MarkFrameSubmitted( Frame_Pacer *pacer, float64 gpuMilliseconds );
+
+void PrintFramePacerStats( Frame_Pacer *pacer );
@@ -0,0 +1,180 @@
+#include "frame_ring.h"
+#include "align.h"
+#include "trace.h"
+#include "stdio.h"
+#include "string.h"
+
+bool InitFrameRing( Frame_Ring *ring, Device *device, u32 framesInFlight, VkDeviceSize segmentSize )
+{
+    TRACE_FUNCTION();
+    ring->device = device;
+    ring->buffer = VK_NULL_HANDLE;
+    ring->mapped = 0;
+    ring->descriptorSetLayout = VK_NULL_HANDLE;
+    ring->descriptorPool = VK_NULL_HANDLE;
+    ring->descriptorSet = VK_NULL_HANDLE;
+
+    // the same allocations can be read as storage buffers, so both alignments apply
+    VkPhysicalDeviceLimits *limits = &device->properties.limits;
+    ring->alignment = limits->minUniformBufferOffsetAlignment;
+    if ( limits->minStorageBufferOffsetAlignment > ring->alignment ) ring->alignment = limits->minStorageBufferOffsetAlignment;
+    ring->segmentSize = AlignUp( segmentSize, ring->alignment );
+    ring->segmentCount = framesInFlight;
+    ring->currentSegment = 0;
+    ring->head = 0;
+    ring->allocationCount = 0;
+    ring->failedAllocations = 0;
+    ring->peakSegmentBytes = 0;
+    ring->lastSegmentBytes = 0;
+    ring->overflowedFrames = 0;
+
+    // the binding range past the last segment keeps every descriptor read inside the buffer
+    VkDeviceSize bufferSize = ring->segmentSize * framesInFlight + FRAME_RING_BINDING_RANGE;
+    CreateBuffer( device, bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ring->buffer,
+                  ring->allocation );
+    ring->mapped = ( u8 * ) ring->allocation.mapped;
+    if ( !ring->mapped )
+    {
+        printf( "Failed to create frame ring buffer!\n" );
+        DestroyFrameRing( ring );
+        return false;
+    }
+
+    ring->layoutDesc = {};
+    AddDescriptorBinding( &ring->layoutDesc, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1,
+                          VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT );
+    ring->descriptorSetLayout = GetDescriptorSetLayout( &device->layoutCache, device->device, &ring->layoutDesc );
+    if ( ring->descriptorSetLayout == VK_NULL_HANDLE )
+    {
+        printf( "Failed to create frame ring descriptor set layout!\n" );
+        DestroyFrameRing( ring );
+        return false;
+    }
+
+    VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 };
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+
+    if ( vkCreateDescriptorPool( device->device, &poolInfo, 0, &ring->descriptorPool ) != VK_SUCCESS )
+    {
+        printf( "Failed to create frame ring descriptor pool!\n" );
+        DestroyFrameRing( ring );
+        return false;
+    }
+
+    VkDescriptorSetAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = ring->descriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &ring->descriptorSetLayout;
+
+    if ( vkAllocateDescriptorSets( device->device, &allocateInfo, &ring->descriptorSet ) != VK_SUCCESS )
+    {
+        printf( "Failed to allocate frame ring descriptor set!\n" );
+        DestroyFrameRing( ring );
+        return false;
+    }
+
+    VkDescriptorBufferInfo bufferInfo = { ring->buffer, 0, FRAME_RING_BINDING_RANGE };
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = ring->descriptorSet;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    write.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets( device->device, 1, &write, 0, 0 );
+
+    return true;
+}
+
+void DestroyFrameRing( Frame_Ring *ring )
+{
+    Device *device = ring->device;
+    if ( ring->buffer != VK_NULL_HANDLE )
+    {
+        DestroyBuffer( device, ring->buffer, ring->allocation );
+        ring->buffer = VK_NULL_HANDLE;
+    }
+    ring->mapped = 0;
+
+    // destroying the pool frees its set, the layout belongs to the device's layout cache
+    vkDestroyDescriptorPool( device->device, ring->descriptorPool, 0 );
+    ring->descriptorPool = VK_NULL_HANDLE;
+    ring->descriptorSetLayout = VK_NULL_HANDLE;
+    ring->descriptorSet = VK_NULL_HANDLE;
+}
+
+void BeginFrameRing( Frame_Ring *ring, u32 frameIndex )
+{
+    // head keeps counting past the end of a full segment, so it is what the frame wanted
+    u64 used = ring->head.exchange( 0 );
+    ring->lastSegmentBytes = used;
+    if ( used > ring->peakSegmentBytes ) ring->peakSegmentBytes = used;
+    if ( used > ring->segmentSize ) ring->overflowedFrames++;
+    ring->currentSegment = frameIndex;
+}
+
+Frame_Ring_Allocation AllocateFrameRing( Frame_Ring *ring, VkDeviceSize size )
+{
+    Frame_Ring_Allocation result = {};
+    VkDeviceSize alignedSize = AlignUp( size, ring->alignment );
+    u64 offset = ring->head.fetch_add( alignedSize );
+    if ( offset + alignedSize > ring->segmentSize )
+    {
+        ring->failedAllocations++;
+        return result;
+    }
+
+    ring->allocationCount++;
+    u64 bufferOffset = ( u64 ) ring->currentSegment * ring->segmentSize + offset;
+    result.data = ring->mapped + bufferOffset;
+    result.offset = ( u32 ) bufferOffset;
+    return result;
+}
+
+u32 PushFrameRing( Frame_Ring *ring, void *data, VkDeviceSize size )
+{
+    Frame_Ring_Allocation allocation = AllocateFrameRing( ring, size );
+    if ( !allocation.data )
+    {
+        return FRAME_RING_INVALID_OFFSET;
+    }
+    memcpy( allocation.data, data, size );
+    return allocation.offset;
+}
+
+void BindFrameRing( Frame_Ring *ring, VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint,
+                    VkPipelineLayout pipelineLayout, u32 set, u32 offset )
+{
+    vkCmdBindDescriptorSets( commandBuffer, bindPoint, pipelineLayout, set, 1, &ring->descriptorSet, 1, &offset );
+}
+
+Frame_Ring_Stats GetFrameRingStats( Frame_Ring *ring )
+{
+    Frame_Ring_Stats stats = {};
+    stats.peakSegmentBytes = ring->peakSegmentBytes;
+    stats.lastSegmentBytes = ring->lastSegmentBytes;
+    stats.allocationCount = ring->allocationCount;
+    stats.failedAllocations = ring->failedAllocations;
+    // the frame being recorded hasn't been through BeginFrameRing yet
+    stats.overflowedFrames = ring->overflowedFrames + ( ring->head > ring->segmentSize ? 1 : 0 );
+    return stats;
+}
+
+void PrintFrameRingStats( Frame_Ring *ring )
+{
+    Frame_Ring_Stats stats = GetFrameRingStats( ring );
+    printf( "Frame ring: %u segments of %.2f KB, %llu byte alignment\n", ring->segmentCount,
+            ( float64 ) ring->segmentSize / 1024.0, ( unsigned long long ) ring->alignment );
+    printf( "\thigh water: %.2f KB per frame (last frame %.2f KB)\n", ( float64 ) stats.peakSegmentBytes / 1024.0,
+            ( float64 ) stats.lastSegmentBytes / 1024.0 );
+    printf( "\tallocations: %llu, failed: %llu in %llu frames\n", ( unsigned long long ) stats.allocationCount,
+            ( unsigned long long ) stats.failedAllocations, ( unsigned long long ) stats.overflowedFrames );
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "device.h"
+#include "utils/utils.h"
+#include <atomic> //@TODO: Remove std garbage
+
+#define FRAME_RING_SEGMENT_SIZE ( 1024 * 1024 )
+// How much of the ring one dynamic uniform buffer descriptor can see past its offset
+#define FRAME_RING_BINDING_RANGE 256
+// 0 is a valid offset, failed pushes return this instead
+#define FRAME_RING_INVALID_OFFSET 0xFFFFFFFF
+
+struct Frame_Ring_Stats
+{
+    u64 peakSegmentBytes; // most bytes any one frame asked for, including what didn't fit
+    u64 lastSegmentBytes;
+    u64 allocationCount;
+    u64 failedAllocations;
+    // frames that asked for more than a segment, what didn't fit was never drawn
+    u64 overflowedFrames;
+};
+
+// One persistently mapped buffer split into a segment per frame in flight. Each frame allocates linearly
+// from its segment and the whole segment is reset once that frame's fence has signalled, so per frame
+// constants never need a buffer of their own
+struct Frame_Ring
+{
+    Device *device;
+    VkBuffer buffer;
+    Gpu_Allocation allocation;
+    u8 *mapped;
+    VkDeviceSize alignment;
+    VkDeviceSize segmentSize;
+    u32 segmentCount;
+
+    u32 currentSegment;
+    // worker threads allocate per draw constants while recording
+    std::atomic< u64 > head;
+    std::atomic< u64 > allocationCount;
+    std::atomic< u64 > failedAllocations;
+    u64 peakSegmentBytes;
+    u64 lastSegmentBytes;
+    u64 overflowedFrames;
+
+    // A single VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, pass the allocation offset as its dynamic offset
+    Descriptor_Set_Layout_Desc layoutDesc;
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSet;
+};
+
+struct Frame_Ring_Allocation
+{
+    void *data;
+    u32 offset; // from the start of the buffer, usable as a dynamic offset
+};
+
+bool InitFrameRing( Frame_Ring *ring, Device *device, u32 framesInFlight, VkDeviceSize segmentSize );
+void DestroyFrameRing( Frame_Ring *ring );
+
+// Only after the frame's fence has been waited on, everything allocated from the segment last time is gone
+void BeginFrameRing( Frame_Ring *ring, u32 frameIndex );
+
+// Thread safe, data is null when the segment is full
+Frame_Ring_Allocation AllocateFrameRing( Frame_Ring *ring, VkDeviceSize size );
+
+// Copies the data in and returns the dynamic offset, or FRAME_RING_INVALID_OFFSET with the failure counted
+// when the segment is full
+u32 PushFrameRing( Frame_Ring *ring, void *data, VkDeviceSize size );
+
+void BindFrameRing( Frame_Ring *ring, VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint,
+                    VkPipelineLayout pipelineLayout, u32 set, u32 offset );
+
+Frame_Ring_Stats GetFrameRingStats( Frame_Ring *ring );
+void PrintFrameRingStats( Frame_Ring *ring );
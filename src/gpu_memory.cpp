@@ -0,0 +1,535 @@
+#include "gpu_memory.h"
+#include "align.h"
+#include "stdio.h"
+
+#define GPU_MEMORY_ORDER_COUNT ( GPU_MEMORY_BLOCK_ORDER - GPU_MEMORY_MIN_ORDER + 1 )
+#define GPU_MEMORY_NODE_COUNT ( ( 1u << GPU_MEMORY_ORDER_COUNT ) - 1 )
+
+static u32 OrderForSize( VkDeviceSize size )
+{
+    u32 order = GPU_MEMORY_MIN_ORDER;
+    while ( ( ( VkDeviceSize ) 1 << order ) < size )
+    {
+        order++;
+    }
+    return order;
+}
+
+static u8 FreeNodeValue( u32 order )
+{
+    return ( u8 ) ( order - GPU_MEMORY_MIN_ORDER + 1 );
+}
+
+static u32 FindAllocatorMemoryType( Gpu_Allocator *allocator, u32 typeFilter, VkMemoryPropertyFlags properties )
+{
+    // nothing flushes or invalidates mapped ranges, so every mapping has to be coherent
+    if ( properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT )
+    {
+        properties |= VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    }
+
+    for ( u32 i = 0; i < allocator->memoryProperties.memoryTypeCount; i++ )
+    {
+        if ( ( typeFilter & ( 1 << i ) ) &&
+             ( allocator->memoryProperties.memoryTypes[ i ].propertyFlags & properties ) == properties )
+        {
+            return i;
+        }
+    }
+
+    printf( "Failed to find suitable memory type!\n" );
+    return 0xFFFFFFFF;
+}
+
+static bool AllocateDeviceMemory( Gpu_Allocator *allocator, VkDeviceSize size, u32 memoryTypeIndex,
+                                  VkDeviceMemory *memory, void **mapped )
+{
+    if ( allocator->deviceMemoryCount >= allocator->maxMemoryAllocationCount )
+    {
+        printf( "Reached maxMemoryAllocationCount (%u)!\n", allocator->maxMemoryAllocationCount );
+        return false;
+    }
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+    if ( vkAllocateMemory( allocator->device, &allocInfo, 0, memory ) != VK_SUCCESS )
+    {
+        return false;
+    }
+
+    *mapped = 0;
+    VkMemoryPropertyFlags hostCoherent = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    if ( ( allocator->memoryProperties.memoryTypes[ memoryTypeIndex ].propertyFlags & hostCoherent ) == hostCoherent )
+    {
+        // host visible memory stays mapped for its whole lifetime, device local types that happen to be
+        // host visible but not coherent are never mapped
+        if ( vkMapMemory( allocator->device, *memory, 0, VK_WHOLE_SIZE, 0, mapped ) != VK_SUCCESS )
+        {
+            printf( "Failed to map device memory!\n" );
+        }
+    }
+
+    allocator->deviceMemoryCount++;
+    u32 heapIndex = allocator->memoryProperties.memoryTypes[ memoryTypeIndex ].heapIndex;
+    allocator->heapUsedBytes[ heapIndex ] += size;
+    return true;
+}
+
+static void FreeDeviceMemory( Gpu_Allocator *allocator, VkDeviceMemory memory, VkDeviceSize size, u32 memoryTypeIndex )
+{
+    vkFreeMemory( allocator->device, memory, 0 );
+    allocator->deviceMemoryCount--;
+    u32 heapIndex = allocator->memoryProperties.memoryTypes[ memoryTypeIndex ].heapIndex;
+    allocator->heapUsedBytes[ heapIndex ] -= size;
+}
+
+static void UpdateBuddyNode( Memory_Block *block, u32 node, u32 nodeOrder )
+{
+    u8 left = block->longest[ 2 * node + 1 ];
+    u8 right = block->longest[ 2 * node + 2 ];
+    u8 childFree = FreeNodeValue( nodeOrder - 1 );
+
+    if ( left == childFree && right == childFree )
+    {
+        block->longest[ node ] = FreeNodeValue( nodeOrder );
+    }
+    else
+    {
+        block->longest[ node ] = left > right ? left : right;
+    }
+}
+
+static bool BuddyAllocate( Memory_Block *block, u32 order, VkDeviceSize *offset )
+{
+    u8 wanted = FreeNodeValue( order );
+    if ( block->longest[ 0 ] < wanted )
+    {
+        return false;
+    }
+
+    u32 node = 0;
+    u32 nodeOrder = GPU_MEMORY_BLOCK_ORDER;
+    while ( nodeOrder != order )
+    {
+        u32 left = 2 * node + 1;
+        u32 right = left + 1;
+
+        // descend into the tighter fitting child so large ranges stay intact
+        u8 leftLongest = block->longest[ left ];
+        u8 rightLongest = block->longest[ right ];
+        if ( leftLongest >= wanted && ( rightLongest < wanted || leftLongest <= rightLongest ) )
+        {
+            node = left;
+        }
+        else
+        {
+            node = right;
+        }
+        nodeOrder--;
+    }
+
+    block->longest[ node ] = 0;
+
+    u32 depth = GPU_MEMORY_BLOCK_ORDER - order;
+    u32 indexInLevel = node - ( ( 1u << depth ) - 1 );
+    *offset = ( VkDeviceSize ) indexInLevel << order;
+
+    while ( node != 0 )
+    {
+        node = ( node - 1 ) / 2;
+        nodeOrder++;
+        UpdateBuddyNode( block, node, nodeOrder );
+    }
+
+    return true;
+}
+
+static void BuddyFree( Memory_Block *block, VkDeviceSize offset, u32 order )
+{
+    u32 depth = GPU_MEMORY_BLOCK_ORDER - order;
+    u32 node = ( ( 1u << depth ) - 1 ) + ( u32 ) ( offset >> order );
+    block->longest[ node ] = FreeNodeValue( order );
+
+    u32 nodeOrder = order;
+    while ( node != 0 )
+    {
+        node = ( node - 1 ) / 2;
+        nodeOrder++;
+        UpdateBuddyNode( block, node, nodeOrder );
+    }
+}
+
+static u32 CreateMemoryBlock( Gpu_Allocator *allocator, u32 memoryTypeIndex, bool linearResources )
+{
+    VkDeviceMemory memory;
+    void *mapped;
+    if ( !AllocateDeviceMemory( allocator, GPU_MEMORY_BLOCK_SIZE, memoryTypeIndex, &memory, &mapped ) )
+    {
+        return 0xFFFFFFFF;
+    }
+
+    u32 blockIndex = ( u32 ) allocator->blocks.size();
+    for ( u32 i = 0; i < allocator->blocks.size(); i++ )
+    {
+        if ( allocator->blocks[ i ].memory == VK_NULL_HANDLE )
+        {
+            blockIndex = i;
+            break;
+        }
+    }
+    if ( blockIndex == allocator->blocks.size() )
+    {
+        allocator->blocks.push_back( {} );
+    }
+
+    Memory_Block *block = &allocator->blocks[ blockIndex ];
+    block->memory = memory;
+    block->mapped = mapped;
+    block->memoryTypeIndex = memoryTypeIndex;
+    block->linearResources = linearResources;
+    block->allocationCount = 0;
+    block->longest.resize( GPU_MEMORY_NODE_COUNT );
+
+    u32 node = 0;
+    for ( u32 order = GPU_MEMORY_BLOCK_ORDER; order >= GPU_MEMORY_MIN_ORDER; order-- )
+    {
+        u32 levelCount = 1u << ( GPU_MEMORY_BLOCK_ORDER - order );
+        for ( u32 i = 0; i < levelCount; i++ )
+        {
+            block->longest[ node++ ] = FreeNodeValue( order );
+        }
+    }
+
+    return blockIndex;
+}
+
+static void DestroyMemoryBlock( Gpu_Allocator *allocator, Memory_Block *block )
+{
+    FreeDeviceMemory( allocator, block->memory, GPU_MEMORY_BLOCK_SIZE, block->memoryTypeIndex );
+    block->memory = VK_NULL_HANDLE;
+    block->mapped = 0;
+    block->longest.clear();
+    block->longest.shrink_to_fit();
+}
+
+void InitGpuAllocator( Gpu_Allocator *allocator, VkPhysicalDevice physicalDevice, VkDevice device )
+{
+    allocator->device = device;
+    vkGetPhysicalDeviceMemoryProperties( physicalDevice, &allocator->memoryProperties );
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties( physicalDevice, &properties );
+    allocator->bufferImageGranularity = properties.limits.bufferImageGranularity;
+    allocator->maxMemoryAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+    allocator->deviceMemoryCount = 0;
+    allocator->dedicatedCount = 0;
+    allocator->allocationCount = 0;
+    allocator->usedBytes = 0;
+    allocator->dedicatedBytes = 0;
+    for ( u32 i = 0; i < VK_MAX_MEMORY_HEAPS; i++ )
+    {
+        allocator->heapUsedBytes[ i ] = 0;
+    }
+}
+
+void DestroyGpuAllocator( Gpu_Allocator *allocator )
+{
+    ResetTransientGpuMemory( allocator );
+
+    if ( allocator->allocationCount != 0 )
+    {
+        printf( "Destroying GPU allocator with %u live allocations!\n", allocator->allocationCount );
+    }
+
+    for ( Memory_Block &block : allocator->blocks )
+    {
+        if ( block.memory != VK_NULL_HANDLE )
+        {
+            DestroyMemoryBlock( allocator, &block );
+        }
+    }
+    allocator->blocks.clear();
+
+    for ( u32 i = 0; i < VK_MAX_MEMORY_TYPES; i++ )
+    {
+        Linear_Pool *pool = &allocator->linearPools[ i ];
+        if ( pool->memory != VK_NULL_HANDLE )
+        {
+            FreeDeviceMemory( allocator, pool->memory, pool->size, i );
+            *pool = {};
+        }
+    }
+}
+
+static Gpu_Allocation AllocateDedicated( Gpu_Allocator *allocator, VkDeviceSize size, u32 memoryTypeIndex )
+{
+    Gpu_Allocation allocation = {};
+    if ( !AllocateDeviceMemory( allocator, size, memoryTypeIndex, &allocation.memory, &allocation.mapped ) )
+    {
+        printf( "Failed to allocate dedicated device memory!\n" );
+        return {};
+    }
+
+    allocation.kind = GPU_ALLOCATION_DEDICATED;
+    allocation.offset = 0;
+    allocation.size = size;
+    allocation.memoryTypeIndex = memoryTypeIndex;
+
+    allocator->dedicatedCount++;
+    allocator->dedicatedBytes += size;
+    allocator->allocationCount++;
+    return allocation;
+}
+
+Gpu_Allocation AllocateGpuMemory( Gpu_Allocator *allocator, VkMemoryRequirements requirements,
+                                  VkMemoryPropertyFlags properties, bool linearResource )
+{
+    u32 memoryTypeIndex = FindAllocatorMemoryType( allocator, requirements.memoryTypeBits, properties );
+    if ( memoryTypeIndex == 0xFFFFFFFF )
+    {
+        return {};
+    }
+
+    std::lock_guard< std::mutex > lock( allocator->mutex );
+
+    // buddy ranges are aligned to their own size, so rounding up to the alignment covers both
+    VkDeviceSize size = requirements.size > requirements.alignment ? requirements.size : requirements.alignment;
+    if ( size > GPU_MEMORY_BLOCK_SIZE / 2 )
+    {
+        return AllocateDedicated( allocator, requirements.size, memoryTypeIndex );
+    }
+
+    u32 order = OrderForSize( size );
+    VkDeviceSize offset = 0;
+    u32 blockIndex = 0xFFFFFFFF;
+    for ( u32 i = 0; i < allocator->blocks.size(); i++ )
+    {
+        Memory_Block *block = &allocator->blocks[ i ];
+        if ( block->memory != VK_NULL_HANDLE && block->memoryTypeIndex == memoryTypeIndex &&
+             block->linearResources == linearResource && BuddyAllocate( block, order, &offset ) )
+        {
+            blockIndex = i;
+            break;
+        }
+    }
+
+    if ( blockIndex == 0xFFFFFFFF )
+    {
+        blockIndex = CreateMemoryBlock( allocator, memoryTypeIndex, linearResource );
+        if ( blockIndex == 0xFFFFFFFF )
+        {
+            return AllocateDedicated( allocator, requirements.size, memoryTypeIndex );
+        }
+        BuddyAllocate( &allocator->blocks[ blockIndex ], order, &offset );
+    }
+
+    Memory_Block *block = &allocator->blocks[ blockIndex ];
+    block->allocationCount++;
+
+    Gpu_Allocation allocation = {};
+    allocation.memory = block->memory;
+    allocation.offset = offset;
+    allocation.size = ( VkDeviceSize ) 1 << order;
+    allocation.mapped = block->mapped ? ( u8 * ) block->mapped + offset : 0;
+    allocation.kind = GPU_ALLOCATION_BUDDY;
+    allocation.memoryTypeIndex = memoryTypeIndex;
+    allocation.blockIndex = blockIndex;
+    allocation.order = order;
+
+    allocator->allocationCount++;
+    allocator->usedBytes += allocation.size;
+    return allocation;
+}
+
+Gpu_Allocation AllocateTransientGpuMemory( Gpu_Allocator *allocator, VkMemoryRequirements requirements,
+                                           VkMemoryPropertyFlags properties, bool linearResource )
+{
+    u32 memoryTypeIndex = FindAllocatorMemoryType( allocator, requirements.memoryTypeBits, properties );
+    if ( memoryTypeIndex == 0xFFFFFFFF )
+    {
+        return {};
+    }
+
+    {
+        std::lock_guard< std::mutex > lock( allocator->mutex );
+
+        Linear_Pool *pool = &allocator->linearPools[ memoryTypeIndex ];
+        if ( pool->memory == VK_NULL_HANDLE )
+        {
+            VkDeviceSize poolSize = GPU_MEMORY_LINEAR_POOL_SIZE;
+            while ( poolSize < requirements.size )
+            {
+                poolSize *= 2;
+            }
+            if ( AllocateDeviceMemory( allocator, poolSize, memoryTypeIndex, &pool->memory, &pool->mapped ) )
+            {
+                pool->size = poolSize;
+                pool->head = 0;
+            }
+        }
+
+        // the pool mixes buffers and images, so every allocation starts on a granularity boundary
+        VkDeviceSize alignment = requirements.alignment > allocator->bufferImageGranularity ?
+                                 requirements.alignment :
+                                 allocator->bufferImageGranularity;
+        VkDeviceSize offset = AlignUp( pool->head, alignment );
+        if ( pool->memory != VK_NULL_HANDLE && offset + requirements.size <= pool->size )
+        {
+            pool->head = offset + requirements.size;
+            if ( pool->head > pool->highWater )
+            {
+                pool->highWater = pool->head;
+            }
+
+            Gpu_Allocation allocation = {};
+            allocation.memory = pool->memory;
+            allocation.offset = offset;
+            allocation.size = requirements.size;
+            allocation.mapped = pool->mapped ? ( u8 * ) pool->mapped + offset : 0;
+            allocation.kind = GPU_ALLOCATION_LINEAR;
+            allocation.memoryTypeIndex = memoryTypeIndex;
+            return allocation;
+        }
+    }
+
+    printf( "Transient GPU memory pool exhausted, falling back to a regular allocation\n" );
+    Gpu_Allocation fallback = AllocateGpuMemory( allocator, requirements, properties, linearResource );
+    if ( fallback.memory == VK_NULL_HANDLE )
+    {
+        return {};
+    }
+
+    // callers never free transient memory, the allocator keeps the real allocation and frees it on reset
+    std::lock_guard< std::mutex > lock( allocator->mutex );
+    allocator->transientFallbacks.push_back( fallback );
+    Gpu_Allocation allocation = fallback;
+    allocation.kind = GPU_ALLOCATION_LINEAR;
+    return allocation;
+}
+
+static void ReleaseGpuAllocation( Gpu_Allocator *allocator, Gpu_Allocation *allocation )
+{
+    switch ( allocation->kind )
+    {
+        case GPU_ALLOCATION_BUDDY:
+        {
+            Memory_Block *block = &allocator->blocks[ allocation->blockIndex ];
+            BuddyFree( block, allocation->offset, allocation->order );
+            block->allocationCount--;
+            allocator->allocationCount--;
+            allocator->usedBytes -= allocation->size;
+
+            // keep one empty block per memory type around so alloc / free patterns don't thrash vkAllocateMemory
+            if ( block->allocationCount == 0 )
+            {
+                for ( Memory_Block &other : allocator->blocks )
+                {
+                    if ( &other != block && other.memory != VK_NULL_HANDLE &&
+                         other.memoryTypeIndex == block->memoryTypeIndex &&
+                         other.linearResources == block->linearResources )
+                    {
+                        DestroyMemoryBlock( allocator, block );
+                        break;
+                    }
+                }
+            }
+        }
+        break;
+
+        case GPU_ALLOCATION_DEDICATED:
+        {
+            FreeDeviceMemory( allocator, allocation->memory, allocation->size, allocation->memoryTypeIndex );
+            allocator->dedicatedCount--;
+            allocator->dedicatedBytes -= allocation->size;
+            allocator->allocationCount--;
+        }
+        break;
+
+        case GPU_ALLOCATION_LINEAR:
+        case GPU_ALLOCATION_NONE: break;
+    }
+
+    *allocation = {};
+}
+
+void FreeGpuMemory( Gpu_Allocator *allocator, Gpu_Allocation *allocation )
+{
+    std::lock_guard< std::mutex > lock( allocator->mutex );
+    ReleaseGpuAllocation( allocator, allocation );
+}
+
+void ResetTransientGpuMemory( Gpu_Allocator *allocator )
+{
+    std::lock_guard< std::mutex > lock( allocator->mutex );
+    for ( u32 i = 0; i < VK_MAX_MEMORY_TYPES; i++ )
+    {
+        allocator->linearPools[ i ].head = 0;
+    }
+
+    for ( Gpu_Allocation &fallback : allocator->transientFallbacks )
+    {
+        ReleaseGpuAllocation( allocator, &fallback );
+    }
+    allocator->transientFallbacks.clear();
+}
+
+Gpu_Allocator_Stats GetGpuAllocatorStats( Gpu_Allocator *allocator )
+{
+    std::lock_guard< std::mutex > lock( allocator->mutex );
+
+    Gpu_Allocator_Stats stats = {};
+    stats.deviceMemoryCount = allocator->deviceMemoryCount;
+    stats.dedicatedCount = allocator->dedicatedCount;
+    stats.allocationCount = allocator->allocationCount;
+    stats.usedBytes = allocator->usedBytes;
+    stats.dedicatedBytes = allocator->dedicatedBytes;
+
+    for ( Memory_Block &block : allocator->blocks )
+    {
+        if ( block.memory != VK_NULL_HANDLE )
+        {
+            stats.blockCount++;
+            stats.reservedBytes += GPU_MEMORY_BLOCK_SIZE;
+        }
+    }
+
+    for ( u32 i = 0; i < VK_MAX_MEMORY_TYPES; i++ )
+    {
+        Linear_Pool *pool = &allocator->linearPools[ i ];
+        stats.transientReservedBytes += pool->size;
+        stats.transientUsedBytes += pool->head;
+        stats.transientHighWaterBytes += pool->highWater;
+    }
+
+    for ( u32 i = 0; i < VK_MAX_MEMORY_HEAPS; i++ )
+    {
+        stats.heapUsedBytes[ i ] = allocator->heapUsedBytes[ i ];
+    }
+
+    return stats;
+}
+
+void PrintGpuAllocatorStats( Gpu_Allocator *allocator )
+{
+    Gpu_Allocator_Stats stats = GetGpuAllocatorStats( allocator );
+
+    printf( "GPU memory: %u vkAllocateMemory calls live (limit %u)\n", stats.deviceMemoryCount, allocator->maxMemoryAllocationCount );
+    printf( "\tblocks: %u, %.2f / %.2f MB used in %u allocations\n", stats.blockCount,
+            ( float64 ) stats.usedBytes / ( 1024.0 * 1024.0 ), ( float64 ) stats.reservedBytes / ( 1024.0 * 1024.0 ),
+            stats.allocationCount - stats.dedicatedCount );
+    printf( "\tdedicated: %u, %.2f MB\n", stats.dedicatedCount, ( float64 ) stats.dedicatedBytes / ( 1024.0 * 1024.0 ) );
+    printf( "\ttransient: %.2f / %.2f MB (high water %.2f MB)\n",
+            ( float64 ) stats.transientUsedBytes / ( 1024.0 * 1024.0 ),
+            ( float64 ) stats.transientReservedBytes / ( 1024.0 * 1024.0 ),
+            ( float64 ) stats.transientHighWaterBytes / ( 1024.0 * 1024.0 ) );
+
+    for ( u32 i = 0; i < allocator->memoryProperties.memoryHeapCount; i++ )
+    {
+        printf( "\theap %u: %.2f / %.2f MB\n", i, ( float64 ) stats.heapUsedBytes[ i ] / ( 1024.0 * 1024.0 ),
+                ( float64 ) allocator->memoryProperties.memoryHeaps[ i ].size / ( 1024.0 * 1024.0 ) );
+    }
+}
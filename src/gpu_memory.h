@@ -0,0 +1,112 @@
+#pragma once
+
+#include "window.h"
+#include "utils/utils.h"
+#include <mutex>  //@TODO: Remove std garbage
+#include <vector>
+
+// Buddy blocks are split down to GPU_MEMORY_MIN_ORDER (256 bytes) leaves
+#define GPU_MEMORY_MIN_ORDER 8
+#define GPU_MEMORY_BLOCK_ORDER 26
+#define GPU_MEMORY_BLOCK_SIZE ( ( VkDeviceSize ) 1 << GPU_MEMORY_BLOCK_ORDER )
+#define GPU_MEMORY_LINEAR_POOL_SIZE ( ( VkDeviceSize ) 32 << 20 )
+
+enum Gpu_Allocation_Kind
+{
+    GPU_ALLOCATION_NONE,
+    GPU_ALLOCATION_BUDDY,
+    GPU_ALLOCATION_LINEAR,
+    GPU_ALLOCATION_DEDICATED,
+};
+
+// Resources bind to memory + offset, the rest is bookkeeping for FreeGpuMemory
+struct Gpu_Allocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void *mapped = 0;
+
+    Gpu_Allocation_Kind kind = GPU_ALLOCATION_NONE;
+    u32 memoryTypeIndex = 0;
+    u32 blockIndex = 0;
+    u32 order = 0;
+};
+
+struct Memory_Block
+{
+    VkDeviceMemory memory;
+    void *mapped;
+    u32 memoryTypeIndex;
+    bool linearResources;
+    u32 allocationCount;
+
+    // Implicit binary tree over the block, each node stores 1 + the largest free order in its subtree (0 = full)
+    std::vector< u8 > longest;
+};
+
+struct Linear_Pool
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    void *mapped = 0;
+    VkDeviceSize size = 0;
+    VkDeviceSize head = 0;
+    VkDeviceSize highWater = 0;
+};
+
+struct Gpu_Allocator_Stats
+{
+    u32 deviceMemoryCount;
+    u32 blockCount;
+    u32 dedicatedCount;
+    u32 allocationCount;
+    VkDeviceSize reservedBytes;
+    VkDeviceSize usedBytes;
+    VkDeviceSize dedicatedBytes;
+    VkDeviceSize transientReservedBytes;
+    VkDeviceSize transientUsedBytes;
+    VkDeviceSize transientHighWaterBytes;
+    VkDeviceSize heapUsedBytes[ VK_MAX_MEMORY_HEAPS ];
+};
+
+struct Gpu_Allocator
+{
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    VkDeviceSize bufferImageGranularity;
+    u32 maxMemoryAllocationCount;
+
+    std::mutex mutex;
+    std::vector< Memory_Block > blocks;
+    Linear_Pool linearPools[ VK_MAX_MEMORY_TYPES ];
+    // regular allocations handed out when a linear pool ran out, freed by ResetTransientGpuMemory
+    std::vector< Gpu_Allocation > transientFallbacks;
+
+    u32 deviceMemoryCount;
+    u32 dedicatedCount;
+    u32 allocationCount;
+    VkDeviceSize usedBytes;
+    VkDeviceSize dedicatedBytes;
+    VkDeviceSize heapUsedBytes[ VK_MAX_MEMORY_HEAPS ];
+};
+
+void InitGpuAllocator( Gpu_Allocator *allocator, VkPhysicalDevice physicalDevice, VkDevice device );
+void DestroyGpuAllocator( Gpu_Allocator *allocator );
+
+// linearResource separates buffers / linear images from optimal images so bufferImageGranularity never matters.
+// Asking for host visible memory always gets a coherent type, only those are mapped
+Gpu_Allocation AllocateGpuMemory( Gpu_Allocator *allocator, VkMemoryRequirements requirements,
+                                  VkMemoryPropertyFlags properties, bool linearResource );
+
+// Transient allocations live until the next ResetTransientGpuMemory, FreeGpuMemory ignores them.
+// When the pool is full they come from the regular allocator, the reset frees those too
+Gpu_Allocation AllocateTransientGpuMemory( Gpu_Allocator *allocator, VkMemoryRequirements requirements,
+                                           VkMemoryPropertyFlags properties, bool linearResource );
+
+void FreeGpuMemory( Gpu_Allocator *allocator, Gpu_Allocation *allocation );
+
+void ResetTransientGpuMemory( Gpu_Allocator *allocator );
+
+Gpu_Allocator_Stats GetGpuAllocatorStats( Gpu_Allocator *allocator );
+
+void PrintGpuAllocatorStats( Gpu_Allocator *allocator );
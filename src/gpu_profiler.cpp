@@ -0,0 +1,398 @@
+#include "gpu_profiler.h"
+#include "platform.h"
+#include "stdio.h"
+#include "string.h"
+
+#define GPU_PROFILER_INVALID_ZONE GPU_PROFILER_MAX_ZONES
+
+static char *statisticNames[ GPU_STATISTIC_COUNT ] = {
+    "ia_vertices",
+    "ia_primitives",
+    "vs_invocations",
+    "clipping_primitives",
+    "fs_invocations",
+    "cs_invocations",
+};
+
+void InitGpuProfiler( Gpu_Profiler *profiler, Device *device, u32 framesInFlight )
+{
+    profiler->device = device;
+    profiler->currentFrame = 0;
+    profiler->frameNumber = 0;
+    profiler->zoneDepth = 0;
+    profiler->statisticsActive = false;
+    profiler->lastResultFrame = 0;
+    profiler->droppedFrames = 0;
+
+    u32 queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties( device->physicalDevice, &queueFamilyCount, 0 );
+    std::vector< VkQueueFamilyProperties > queueFamilies( queueFamilyCount );
+    vkGetPhysicalDeviceQueueFamilyProperties( device->physicalDevice, &queueFamilyCount, queueFamilies.data() );
+
+    u32 validBits = queueFamilies[ device->queueFamilies.graphicsFamily ].timestampValidBits;
+    profiler->timestampsSupported = validBits > 0;
+    profiler->timestampMask = validBits >= 64 ? ~0ull : ( 1ull << validBits ) - 1;
+    profiler->timestampPeriod = device->properties.limits.timestampPeriod;
+
+    // secondaries record the draws, so statistics are useless unless they can inherit the query
+    profiler->statisticsSupported = device->enabledFeatures.pipelineStatisticsQuery && device->enabledFeatures.inheritedQueries;
+    profiler->statisticsFlags = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+                                VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+                                VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                                VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                                VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+                                VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+    if ( !profiler->timestampsSupported )
+    {
+        printf( "GPU profiler: the graphics queue doesn't support timestamps\n" );
+    }
+
+    profiler->frames.resize( framesInFlight );
+    for ( auto &frame : profiler->frames )
+    {
+        frame.timestampPool = VK_NULL_HANDLE;
+        frame.statisticsPool = VK_NULL_HANDLE;
+        frame.zoneCount = 0;
+        frame.statisticsCount = 0;
+        frame.frameNumber = 0;
+        frame.recorded = false;
+
+        VkQueryPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+
+        if ( profiler->timestampsSupported )
+        {
+            poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            poolInfo.queryCount = GPU_PROFILER_MAX_ZONES * 2;
+            if ( vkCreateQueryPool( device->device, &poolInfo, 0, &frame.timestampPool ) != VK_SUCCESS )
+            {
+                printf( "Failed to create timestamp query pool!\n" );
+                profiler->timestampsSupported = false;
+            }
+        }
+
+        if ( profiler->statisticsSupported )
+        {
+            poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            poolInfo.queryCount = GPU_PROFILER_MAX_ZONES;
+            poolInfo.pipelineStatistics = profiler->statisticsFlags;
+            if ( vkCreateQueryPool( device->device, &poolInfo, 0, &frame.statisticsPool ) != VK_SUCCESS )
+            {
+                printf( "Failed to create pipeline statistics query pool!\n" );
+                profiler->statisticsSupported = false;
+            }
+        }
+    }
+}
+
+void DestroyGpuProfiler( Gpu_Profiler *profiler )
+{
+    for ( auto &frame : profiler->frames )
+    {
+        if ( frame.timestampPool != VK_NULL_HANDLE )
+        {
+            vkDestroyQueryPool( profiler->device->device, frame.timestampPool, 0 );
+        }
+        if ( frame.statisticsPool != VK_NULL_HANDLE )
+        {
+            vkDestroyQueryPool( profiler->device->device, frame.statisticsPool, 0 );
+        }
+    }
+    profiler->frames.clear();
+}
+
+static void AccumulateZoneStats( Gpu_Profiler *profiler, Gpu_Zone_Result *result )
+{
+    Gpu_Zone_Stats *stats = GetGpuZoneStats( profiler, result->name );
+    if ( !stats )
+    {
+        Gpu_Zone_Stats newStats = {};
+        newStats.name = result->name;
+        newStats.minMilliseconds = result->milliseconds;
+        newStats.maxMilliseconds = result->milliseconds;
+        profiler->zoneStats.push_back( newStats );
+        stats = &profiler->zoneStats.back();
+    }
+
+    stats->sampleCount++;
+    stats->totalMilliseconds += result->milliseconds;
+    stats->lastMilliseconds = result->milliseconds;
+    if ( result->milliseconds < stats->minMilliseconds ) stats->minMilliseconds = result->milliseconds;
+    if ( result->milliseconds > stats->maxMilliseconds ) stats->maxMilliseconds = result->milliseconds;
+    if ( result->hasStatistics )
+    {
+        memcpy( stats->lastStatistics, result->statistics, sizeof( stats->lastStatistics ) );
+    }
+}
+
+static void ReadGpuProfilerFrame( Gpu_Profiler *profiler, Gpu_Profiler_Frame *frame )
+{
+    if ( frame->zoneCount == 0 )
+    {
+        return;
+    }
+
+    VkDevice device = profiler->device->device;
+    VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+
+    // every query is followed by its availability word
+    u64 timestamps[ GPU_PROFILER_MAX_ZONES * 2 ][ 2 ] = {};
+    if ( profiler->timestampsSupported )
+    {
+        VkResult result = vkGetQueryPoolResults( device, frame->timestampPool, 0, frame->zoneCount * 2, sizeof( timestamps ),
+                                                 timestamps, sizeof( timestamps[ 0 ] ), flags );
+        if ( result != VK_SUCCESS && result != VK_NOT_READY )
+        {
+            profiler->droppedFrames++;
+            return;
+        }
+    }
+
+    u64 statistics[ GPU_PROFILER_MAX_ZONES ][ GPU_STATISTIC_COUNT + 1 ] = {};
+    if ( frame->statisticsCount > 0 )
+    {
+        VkResult result = vkGetQueryPoolResults( device, frame->statisticsPool, 0, frame->statisticsCount, sizeof( statistics ),
+                                                 statistics, sizeof( statistics[ 0 ] ), flags );
+        if ( result != VK_SUCCESS && result != VK_NOT_READY )
+        {
+            profiler->droppedFrames++;
+            return;
+        }
+    }
+
+    // a frame is only reported whole, if anything is still in flight the entire frame is dropped
+    for ( u32 i = 0; i < frame->zoneCount; ++i )
+    {
+        Gpu_Zone *zone = &frame->zones[ i ];
+        bool available = !profiler->timestampsSupported || ( timestamps[ i * 2 ][ 1 ] && timestamps[ i * 2 + 1 ][ 1 ] );
+        if ( zone->statisticsQuery >= 0 && !statistics[ zone->statisticsQuery ][ GPU_STATISTIC_COUNT ] )
+        {
+            available = false;
+        }
+
+        if ( !available )
+        {
+            profiler->droppedFrames++;
+            return;
+        }
+    }
+
+    profiler->lastResults.resize( frame->zoneCount );
+    profiler->lastResultFrame = frame->frameNumber;
+
+    for ( u32 i = 0; i < frame->zoneCount; ++i )
+    {
+        Gpu_Zone *zone = &frame->zones[ i ];
+        Gpu_Zone_Result *result = &profiler->lastResults[ i ];
+        result->name = zone->name;
+        result->depth = zone->depth;
+        result->milliseconds = 0.0;
+
+        if ( profiler->timestampsSupported )
+        {
+            u64 begin = timestamps[ i * 2 ][ 0 ] & profiler->timestampMask;
+            u64 end = timestamps[ i * 2 + 1 ][ 0 ] & profiler->timestampMask;
+            u64 ticks = ( end - begin ) & profiler->timestampMask;
+            result->milliseconds = ( float64 ) ticks * profiler->timestampPeriod / 1000000.0;
+        }
+
+        result->hasStatistics = zone->statisticsQuery >= 0;
+        if ( result->hasStatistics )
+        {
+            memcpy( result->statistics, statistics[ zone->statisticsQuery ], sizeof( result->statistics ) );
+        }
+        else
+        {
+            memset( result->statistics, 0, sizeof( result->statistics ) );
+        }
+
+        AccumulateZoneStats( profiler, result );
+    }
+}
+
+void BeginGpuProfilerFrame( Gpu_Profiler *profiler, VkCommandBuffer commandBuffer, u32 frameIndex )
+{
+    Gpu_Profiler_Frame *frame = &profiler->frames[ frameIndex ];
+    if ( frame->recorded )
+    {
+        ReadGpuProfilerFrame( profiler, frame );
+    }
+
+    frame->zoneCount = 0;
+    frame->statisticsCount = 0;
+    frame->frameNumber = profiler->frameNumber++;
+    frame->recorded = true;
+
+    if ( profiler->timestampsSupported )
+    {
+        vkCmdResetQueryPool( commandBuffer, frame->timestampPool, 0, GPU_PROFILER_MAX_ZONES * 2 );
+    }
+    if ( profiler->statisticsSupported )
+    {
+        vkCmdResetQueryPool( commandBuffer, frame->statisticsPool, 0, GPU_PROFILER_MAX_ZONES );
+    }
+
+    profiler->currentFrame = frame;
+    profiler->zoneDepth = 0;
+    profiler->statisticsActive = false;
+}
+
+u32 BeginGpuZone( Gpu_Profiler *profiler, VkCommandBuffer commandBuffer, char *name, bool pipelineStatistics )
+{
+    Gpu_Profiler_Frame *frame = profiler->currentFrame;
+    if ( !frame || frame->zoneCount == GPU_PROFILER_MAX_ZONES )
+    {
+        return GPU_PROFILER_INVALID_ZONE;
+    }
+
+    u32 zoneIndex = frame->zoneCount++;
+    Gpu_Zone *zone = &frame->zones[ zoneIndex ];
+    zone->name = name;
+    zone->depth = profiler->zoneDepth++;
+    zone->statisticsQuery = -1;
+
+    if ( profiler->timestampsSupported )
+    {
+        vkCmdWriteTimestamp( commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame->timestampPool, zoneIndex * 2 );
+    }
+
+    if ( pipelineStatistics && profiler->statisticsSupported && !profiler->statisticsActive )
+    {
+        zone->statisticsQuery = ( s32 ) frame->statisticsCount++;
+        vkCmdBeginQuery( commandBuffer, frame->statisticsPool, ( u32 ) zone->statisticsQuery, 0 );
+        profiler->statisticsActive = true;
+    }
+
+    return zoneIndex;
+}
+
+void EndGpuZone( Gpu_Profiler *profiler, VkCommandBuffer commandBuffer, u32 zoneIndex )
+{
+    Gpu_Profiler_Frame *frame = profiler->currentFrame;
+    if ( !frame || zoneIndex == GPU_PROFILER_INVALID_ZONE )
+    {
+        return;
+    }
+
+    Gpu_Zone *zone = &frame->zones[ zoneIndex ];
+    if ( zone->statisticsQuery >= 0 )
+    {
+        vkCmdEndQuery( commandBuffer, frame->statisticsPool, ( u32 ) zone->statisticsQuery );
+        profiler->statisticsActive = false;
+    }
+
+    if ( profiler->timestampsSupported )
+    {
+        vkCmdWriteTimestamp( commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame->timestampPool, zoneIndex * 2 + 1 );
+    }
+
+    profiler->zoneDepth--;
+}
+
+VkQueryPipelineStatisticFlags GetGpuProfilerInheritedStatistics( Gpu_Profiler *profiler )
+{
+    return profiler->statisticsActive ? profiler->statisticsFlags : 0;
+}
+
+Gpu_Zone_Stats *GetGpuZoneStats( Gpu_Profiler *profiler, char *name )
+{
+    for ( auto &stats : profiler->zoneStats )
+    {
+        if ( stats.name == name || strcmp( stats.name, name ) == 0 )
+        {
+            return &stats;
+        }
+    }
+    return 0;
+}
+
+void PrintGpuProfilerStats( Gpu_Profiler *profiler )
+{
+    printf( "GPU profiler: %llu frames, %llu dropped\n", ( unsigned long long ) profiler->frameNumber,
+            ( unsigned long long ) profiler->droppedFrames );
+    for ( auto &stats : profiler->zoneStats )
+    {
+        float64 average = stats.sampleCount ? stats.totalMilliseconds / stats.sampleCount : 0.0;
+        printf( "\t%-24s avg %.3f ms, min %.3f ms, max %.3f ms\n", stats.name, average, stats.minMilliseconds, stats.maxMilliseconds );
+    }
+}
+
+bool DumpGpuProfilerCsv( Gpu_Profiler *profiler, char *path )
+{
+    FILE *file = OpenFile( path, "w" );
+    if ( !file )
+    {
+        printf( "Failed to write GPU profile: %s\n", path );
+        return false;
+    }
+
+    fprintf( file, "zone,samples,avg_ms,min_ms,max_ms,last_ms" );
+    for ( u32 i = 0; i < GPU_STATISTIC_COUNT; ++i )
+    {
+        fprintf( file, ",%s", statisticNames[ i ] );
+    }
+    fprintf( file, "\n" );
+
+    for ( auto &stats : profiler->zoneStats )
+    {
+        float64 average = stats.sampleCount ? stats.totalMilliseconds / stats.sampleCount : 0.0;
+        fprintf( file, "%s,%llu,%.6f,%.6f,%.6f,%.6f", stats.name, ( unsigned long long ) stats.sampleCount, average,
+                 stats.minMilliseconds, stats.maxMilliseconds, stats.lastMilliseconds );
+        for ( u32 i = 0; i < GPU_STATISTIC_COUNT; ++i )
+        {
+            fprintf( file, ",%llu", ( unsigned long long ) stats.lastStatistics[ i ] );
+        }
+        fprintf( file, "\n" );
+    }
+
+    fclose( file );
+    return true;
+}
+
+bool DumpGpuProfilerJson( Gpu_Profiler *profiler, char *path )
+{
+    FILE *file = OpenFile( path, "w" );
+    if ( !file )
+    {
+        printf( "Failed to write GPU profile: %s\n", path );
+        return false;
+    }
+
+    fprintf( file, "{\n" );
+    fprintf( file, "  \"device\": \"%s\",\n", profiler->device->properties.deviceName );
+    fprintf( file, "  \"frames\": %llu,\n", ( unsigned long long ) profiler->frameNumber );
+    fprintf( file, "  \"droppedFrames\": %llu,\n", ( unsigned long long ) profiler->droppedFrames );
+    fprintf( file, "  \"timestampPeriod\": %f,\n", profiler->timestampPeriod );
+
+    fprintf( file, "  \"zones\": [" );
+    for ( u32 i = 0; i < profiler->zoneStats.size(); ++i )
+    {
+        Gpu_Zone_Stats *stats = &profiler->zoneStats[ i ];
+        float64 average = stats->sampleCount ? stats->totalMilliseconds / stats->sampleCount : 0.0;
+        fprintf( file, "%s\n    { \"name\": \"%s\", \"samples\": %llu, \"avgMs\": %.6f, \"minMs\": %.6f, \"maxMs\": %.6f, \"lastMs\": %.6f }",
+                 i ? "," : "", stats->name, ( unsigned long long ) stats->sampleCount, average, stats->minMilliseconds,
+                 stats->maxMilliseconds, stats->lastMilliseconds );
+    }
+    fprintf( file, "\n  ],\n" );
+
+    fprintf( file, "  \"lastFrame\": { \"frame\": %llu, \"zones\": [", ( unsigned long long ) profiler->lastResultFrame );
+    for ( u32 i = 0; i < profiler->lastResults.size(); ++i )
+    {
+        Gpu_Zone_Result *result = &profiler->lastResults[ i ];
+        fprintf( file, "%s\n    { \"name\": \"%s\", \"depth\": %u, \"ms\": %.6f", i ? "," : "", result->name, result->depth,
+                 result->milliseconds );
+        if ( result->hasStatistics )
+        {
+            for ( u32 s = 0; s < GPU_STATISTIC_COUNT; ++s )
+            {
+                fprintf( file, ", \"%s\": %llu", statisticNames[ s ], ( unsigned long long ) result->statistics[ s ] );
+            }
+        }
+        fprintf( file, " }" );
+    }
+    fprintf( file, "\n  ] }\n}\n" );
+
+    fclose( file );
+    return true;
+}
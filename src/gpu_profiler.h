@@ -0,0 +1,103 @@
+#pragma once
+
+#include "device.h"
+#include "utils/utils.h"
+#include <vector> //@TODO: Remove std garbage
+
+#define GPU_PROFILER_MAX_ZONES 64
+
+enum Gpu_Statistic
+{
+    GPU_STATISTIC_INPUT_ASSEMBLY_VERTICES,
+    GPU_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES,
+    GPU_STATISTIC_VERTEX_SHADER_INVOCATIONS,
+    GPU_STATISTIC_CLIPPING_PRIMITIVES,
+    GPU_STATISTIC_FRAGMENT_SHADER_INVOCATIONS,
+    GPU_STATISTIC_COMPUTE_SHADER_INVOCATIONS,
+    GPU_STATISTIC_COUNT
+};
+
+struct Gpu_Zone
+{
+    char *name;
+    u32 depth;
+    // -1 when the zone only records timestamps
+    s32 statisticsQuery;
+};
+
+// One set of query pools per frame in flight, read back when the frame slot comes around again
+struct Gpu_Profiler_Frame
+{
+    VkQueryPool timestampPool;
+    VkQueryPool statisticsPool;
+    Gpu_Zone zones[ GPU_PROFILER_MAX_ZONES ];
+    u32 zoneCount;
+    u32 statisticsCount;
+    u64 frameNumber;
+    bool recorded;
+};
+
+struct Gpu_Zone_Result
+{
+    char *name;
+    u32 depth;
+    float64 milliseconds;
+    bool hasStatistics;
+    u64 statistics[ GPU_STATISTIC_COUNT ];
+};
+
+struct Gpu_Zone_Stats
+{
+    char *name;
+    u64 sampleCount;
+    float64 totalMilliseconds;
+    float64 minMilliseconds;
+    float64 maxMilliseconds;
+    float64 lastMilliseconds;
+    u64 lastStatistics[ GPU_STATISTIC_COUNT ];
+};
+
+struct Gpu_Profiler
+{
+    Device *device;
+    std::vector< Gpu_Profiler_Frame > frames;
+    Gpu_Profiler_Frame *currentFrame;
+    u64 frameNumber;
+
+    bool timestampsSupported;
+    bool statisticsSupported;
+    u64 timestampMask;
+    float64 timestampPeriod;
+    VkQueryPipelineStatisticFlags statisticsFlags;
+
+    u32 zoneDepth;
+    bool statisticsActive;
+
+    // results of the most recent frame that was read back
+    std::vector< Gpu_Zone_Result > lastResults;
+    u64 lastResultFrame;
+    u64 droppedFrames;
+
+    std::vector< Gpu_Zone_Stats > zoneStats;
+};
+
+void InitGpuProfiler( Gpu_Profiler *profiler, Device *device, u32 framesInFlight );
+void DestroyGpuProfiler( Gpu_Profiler *profiler );
+
+// Call at the start of the frame's primary command buffer, outside a render pass, once its fence has signalled.
+// Reads back the results this frame slot recorded framesInFlight frames ago without waiting.
+void BeginGpuProfilerFrame( Gpu_Profiler *profiler, VkCommandBuffer commandBuffer, u32 frameIndex );
+
+// Zones are recorded on the primary command buffer and may nest. Only one zone at a time can collect
+// pipeline statistics, nested requests fall back to timestamps only.
+u32 BeginGpuZone( Gpu_Profiler *profiler, VkCommandBuffer commandBuffer, char *name, bool pipelineStatistics = false );
+void EndGpuZone( Gpu_Profiler *profiler, VkCommandBuffer commandBuffer, u32 zone );
+
+// Secondary command buffers executed inside a statistics zone have to inherit the query
+VkQueryPipelineStatisticFlags GetGpuProfilerInheritedStatistics( Gpu_Profiler *profiler );
+
+Gpu_Zone_Stats *GetGpuZoneStats( Gpu_Profiler *profiler, char *name );
+
+void PrintGpuProfilerStats( Gpu_Profiler *profiler );
+bool DumpGpuProfilerCsv( Gpu_Profiler *profiler, char *path );
+bool DumpGpuProfilerJson( Gpu_Profiler *profiler, char *path );
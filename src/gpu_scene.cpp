@@ -0,0 +1,373 @@
+#include "gpu_scene.h"
+#include "shader_reflection.h"
+#include "trace.h"
+#include "stdio.h"
+#include "math.h"
+
+#define GPU_SCENE_BINDING_COUNT 4
+
+static bool CreateSceneDescriptors( Gpu_Scene *scene, Shader_Reflection *cullReflection )
+{
+    VkDevice device = scene->device->device;
+
+    // objects, draws, draw count and instances, the layout itself comes from cull.comp
+    Descriptor_Set_Layout_Desc *setDesc = &cullReflection->sets[ 0 ];
+    for ( u32 i = 0; i < GPU_SCENE_BINDING_COUNT; ++i )
+    {
+        Descriptor_Binding_Desc *binding = FindDescriptorBinding( setDesc, i );
+        if ( !binding || binding->type != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER || binding->count != 1 )
+        {
+            printf( "Cull shader binding %u isn't a single storage buffer!\n", i );
+            return false;
+        }
+    }
+
+    scene->descriptorSetLayout = GetDescriptorSetLayout( &scene->device->layoutCache, device, setDesc );
+    if ( scene->descriptorSetLayout == VK_NULL_HANDLE )
+    {
+        printf( "Failed to create scene descriptor set layout!\n" );
+        return false;
+    }
+
+    VkDescriptorPoolSize poolSize = {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = GPU_SCENE_BINDING_COUNT * scene->frameCount;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = scene->frameCount;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+
+    if ( vkCreateDescriptorPool( device, &poolInfo, 0, &scene->descriptorPool ) != VK_SUCCESS )
+    {
+        printf( "Failed to create scene descriptor pool!\n" );
+        return false;
+    }
+
+    for ( u32 f = 0; f < scene->frameCount; ++f )
+    {
+        Gpu_Scene_Frame *frame = &scene->frames[ f ];
+
+        VkDescriptorSetAllocateInfo allocateInfo = {};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocateInfo.descriptorPool = scene->descriptorPool;
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &scene->descriptorSetLayout;
+
+        if ( vkAllocateDescriptorSets( device, &allocateInfo, &frame->descriptorSet ) != VK_SUCCESS )
+        {
+            printf( "Failed to allocate scene descriptor set!\n" );
+            return false;
+        }
+
+        VkDescriptorBufferInfo bufferInfos[ GPU_SCENE_BINDING_COUNT ] = {};
+        bufferInfos[ 0 ] = { scene->objectBuffer, 0, VK_WHOLE_SIZE };
+        bufferInfos[ 1 ] = { frame->drawBuffer, 0, VK_WHOLE_SIZE };
+        bufferInfos[ 2 ] = { frame->countBuffer, 0, VK_WHOLE_SIZE };
+        bufferInfos[ 3 ] = { frame->instanceBuffer, 0, VK_WHOLE_SIZE };
+
+        VkWriteDescriptorSet writes[ GPU_SCENE_BINDING_COUNT ] = {};
+        for ( u32 i = 0; i < GPU_SCENE_BINDING_COUNT; ++i )
+        {
+            writes[ i ].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[ i ].dstSet = frame->descriptorSet;
+            writes[ i ].dstBinding = i;
+            writes[ i ].descriptorCount = 1;
+            writes[ i ].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[ i ].pBufferInfo = &bufferInfos[ i ];
+        }
+        vkUpdateDescriptorSets( device, GPU_SCENE_BINDING_COUNT, writes, 0, 0 );
+    }
+
+    return true;
+}
+
+bool IsGpuDrivenRenderingSupported( Device *device )
+{
+    return device->enabledFeatures.multiDrawIndirect && device->enabledFeatures.drawIndirectFirstInstance;
+}
+
+static bool CreateCullVariants( Gpu_Scene *scene, Job_System *jobs, Shader_Reflection *cullReflection, char *cullShaderPath )
+{
+    Device *device = scene->device;
+    VkPhysicalDeviceLimits *limits = &device->properties.limits;
+
+    u32 workgroupSizes[] = { 64, 128, 256 };
+    u32 workgroupSizeCount = 0;
+    for ( u32 i = 0; i < sizeof( workgroupSizes ) / sizeof( workgroupSizes[ 0 ] ); ++i )
+    {
+        if ( workgroupSizes[ i ] <= limits->maxComputeWorkGroupSize[ 0 ] && workgroupSizes[ i ] <= limits->maxComputeWorkGroupInvocations )
+        {
+            workgroupSizes[ workgroupSizeCount++ ] = workgroupSizes[ i ];
+        }
+    }
+    u32 compactModes[] = { 0, 1 };
+
+    Shader_Variants *variants = &scene->cullVariants;
+    InitShaderVariants( variants, device );
+    if ( !AddShaderVariantSwitch( variants, "workgroup size", GPU_CULL_CONSTANT_WORKGROUP_SIZE, workgroupSizes, workgroupSizeCount ) ||
+         !AddShaderVariantSwitch( variants, "compact", GPU_CULL_CONSTANT_COMPACT, compactModes, 2 ) ||
+         !CheckShaderVariantSwitches( variants, cullReflection ) )
+    {
+        return false;
+    }
+
+    Asset_Data shader;
+    if ( !LoadAsset( cullShaderPath, &shader ) )
+    {
+        return false;
+    }
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    bool moduleCreated = CreateShaderModule( device->device, shader, &shaderModule );
+    FreeAsset( &shader );
+    if ( !moduleCreated )
+    {
+        return false;
+    }
+
+    bool built = BuildComputeVariants( variants, jobs, scene->cullPipelineLayout, shaderModule, 0 );
+    vkDestroyShaderModule( device->device, shaderModule, 0 );
+
+    u32 values[] = { scene->cullWorkgroupSize, scene->indirectCount ? 1u : 0u };
+    scene->cullPipeline = GetShaderVariant( variants, values );
+    if ( scene->cullPipeline == VK_NULL_HANDLE )
+    {
+        printf( "Cull shader variant for workgroup size %u isn't available, using %u\n", scene->cullWorkgroupSize,
+                GPU_CULL_WORKGROUP_SIZE );
+        scene->cullWorkgroupSize = GPU_CULL_WORKGROUP_SIZE;
+        values[ 0 ] = scene->cullWorkgroupSize;
+        scene->cullPipeline = GetShaderVariant( variants, values );
+    }
+
+    if ( !built )
+    {
+        printf( "Failed to build %u of %u cull shader variants!\n", variants->stats.failCount,
+                ( u32 ) variants->pipelines.size() );
+    }
+    return scene->cullPipeline != VK_NULL_HANDLE;
+}
+
+static bool CreateSceneFrame( Gpu_Scene *scene, Gpu_Scene_Frame *frame )
+{
+    Device *device = scene->device;
+    frame->instanceBindlessIndex = BINDLESS_INVALID_INDEX;
+
+    CreateBuffer( device, ( VkDeviceSize ) scene->objectCount * sizeof( VkDrawIndexedIndirectCommand ),
+                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                  frame->drawBuffer, frame->drawAllocation );
+    CreateBuffer( device, sizeof( u32 ),
+                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame->countBuffer, frame->countAllocation );
+    CreateBuffer( device, ( VkDeviceSize ) scene->objectCount * sizeof( Gpu_Instance ), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame->instanceBuffer, frame->instanceAllocation );
+    if ( frame->drawAllocation.memory == VK_NULL_HANDLE || frame->countAllocation.memory == VK_NULL_HANDLE ||
+         frame->instanceAllocation.memory == VK_NULL_HANDLE )
+    {
+        return false;
+    }
+
+    frame->instanceBindlessIndex = AddBindlessStorageBuffer( scene->bindless, frame->instanceBuffer );
+    return frame->instanceBindlessIndex != BINDLESS_INVALID_INDEX;
+}
+
+bool InitGpuScene( Gpu_Scene *scene, Device *device, Job_System *jobs, Upload_Manager *uploads, Bindless_Set *bindless,
+                   u32 framesInFlight, Gpu_Object *objects, u32 objectCount, char *cullShaderPath, u32 cullWorkgroupSize )
+{
+    TRACE_FUNCTION();
+    *scene = {};
+    scene->device = device;
+    scene->uploads = uploads;
+    scene->bindless = bindless;
+    scene->objectCount = objectCount;
+    scene->indirectCount = device->enabledVulkan12Features.drawIndirectCount;
+    scene->cullVariants.device = device;
+    scene->cullWorkgroupSize = cullWorkgroupSize;
+
+    if ( objectCount == 0 )
+    {
+        printf( "Can't create an empty GPU scene!\n" );
+        return false;
+    }
+    if ( framesInFlight > GPU_SCENE_MAX_FRAMES )
+    {
+        printf( "GPU scene supports at most %u frames in flight!\n", GPU_SCENE_MAX_FRAMES );
+        return false;
+    }
+
+    scene->uploadToken = UploadDeviceLocalBuffer( uploads, objects, ( VkDeviceSize ) objectCount * sizeof( Gpu_Object ),
+                                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, scene->objectBuffer, scene->objectAllocation );
+    if ( scene->uploadToken == 0 )
+    {
+        DestroyGpuScene( scene );
+        return false;
+    }
+
+    for ( scene->frameCount = 0; scene->frameCount < framesInFlight; )
+    {
+        // counted first so a half created frame is cleaned up too
+        if ( !CreateSceneFrame( scene, &scene->frames[ scene->frameCount++ ] ) )
+        {
+            printf( "Failed to create GPU scene buffers!\n" );
+            DestroyGpuScene( scene );
+            return false;
+        }
+    }
+
+    Shader_Reflection cullReflection;
+    if ( !ReflectShaderFile( cullShaderPath, &cullReflection ) )
+    {
+        DestroyGpuScene( scene );
+        return false;
+    }
+    if ( cullReflection.pushConstants.size > sizeof( Gpu_Cull_Push_Constants ) )
+    {
+        printf( "Cull shader push constants are bigger than Gpu_Cull_Push_Constants!\n" );
+        DestroyGpuScene( scene );
+        return false;
+    }
+    scene->cullPushConstantSize = cullReflection.pushConstants.size;
+
+    if ( !CreateSceneDescriptors( scene, &cullReflection ) )
+    {
+        DestroyGpuScene( scene );
+        return false;
+    }
+
+    scene->cullPipelineLayout = CreateReflectedPipelineLayout( device, &cullReflection, 0, 0 );
+    if ( scene->cullPipelineLayout == VK_NULL_HANDLE )
+    {
+        printf( "Failed to create cull pipeline layout!\n" );
+        DestroyGpuScene( scene );
+        return false;
+    }
+
+    if ( !CreateCullVariants( scene, jobs, &cullReflection, cullShaderPath ) )
+    {
+        DestroyGpuScene( scene );
+        return false;
+    }
+
+    return true;
+}
+
+void DestroyGpuScene( Gpu_Scene *scene )
+{
+    Device *device = scene->device;
+
+    // both layouts belong to the device's layout cache
+    DestroyShaderVariants( &scene->cullVariants );
+    scene->cullPipeline = VK_NULL_HANDLE;
+    vkDestroyDescriptorPool( device->device, scene->descriptorPool, 0 );
+    scene->cullPipelineLayout = VK_NULL_HANDLE;
+    scene->descriptorPool = VK_NULL_HANDLE;
+    scene->descriptorSetLayout = VK_NULL_HANDLE;
+
+    if ( scene->objectBuffer != VK_NULL_HANDLE )
+    {
+        if ( scene->uploadToken != 0 )
+        {
+            WaitForUpload( scene->uploads, scene->uploadToken );
+            scene->uploadToken = 0;
+        }
+        DestroyBuffer( device, scene->objectBuffer, scene->objectAllocation );
+        scene->objectBuffer = VK_NULL_HANDLE;
+    }
+    for ( u32 i = 0; i < scene->frameCount; ++i )
+    {
+        Gpu_Scene_Frame *frame = &scene->frames[ i ];
+        if ( frame->instanceBindlessIndex != BINDLESS_INVALID_INDEX )
+        {
+            RemoveBindlessResource( scene->bindless, BINDLESS_BINDING_STORAGE_BUFFERS, frame->instanceBindlessIndex, 0 );
+        }
+        if ( frame->drawBuffer != VK_NULL_HANDLE )
+        {
+            DestroyBuffer( device, frame->drawBuffer, frame->drawAllocation );
+        }
+        if ( frame->countBuffer != VK_NULL_HANDLE )
+        {
+            DestroyBuffer( device, frame->countBuffer, frame->countAllocation );
+        }
+        if ( frame->instanceBuffer != VK_NULL_HANDLE )
+        {
+            DestroyBuffer( device, frame->instanceBuffer, frame->instanceAllocation );
+        }
+        *frame = {};
+    }
+    scene->frameCount = 0;
+}
+
+void ExtractFrustumPlanes( float32 *viewProjection, float32 planes[ 6 ][ 4 ] )
+{
+    // rows of the column major matrix
+    float32 rows[ 4 ][ 4 ];
+    for ( u32 row = 0; row < 4; ++row )
+    {
+        for ( u32 column = 0; column < 4; ++column )
+        {
+            rows[ row ][ column ] = viewProjection[ column * 4 + row ];
+        }
+    }
+
+    for ( u32 i = 0; i < 4; ++i )
+    {
+        planes[ 0 ][ i ] = rows[ 3 ][ i ] + rows[ 0 ][ i ]; // left
+        planes[ 1 ][ i ] = rows[ 3 ][ i ] - rows[ 0 ][ i ]; // right
+        planes[ 2 ][ i ] = rows[ 3 ][ i ] + rows[ 1 ][ i ]; // top
+        planes[ 3 ][ i ] = rows[ 3 ][ i ] - rows[ 1 ][ i ]; // bottom
+        planes[ 4 ][ i ] = rows[ 2 ][ i ];                  // near
+        planes[ 5 ][ i ] = rows[ 3 ][ i ] - rows[ 2 ][ i ]; // far
+    }
+
+    for ( u32 plane = 0; plane < 6; ++plane )
+    {
+        float32 length = sqrtf( planes[ plane ][ 0 ] * planes[ plane ][ 0 ] + planes[ plane ][ 1 ] * planes[ plane ][ 1 ] +
+                                planes[ plane ][ 2 ] * planes[ plane ][ 2 ] );
+        if ( length > 0.0f )
+        {
+            for ( u32 i = 0; i < 4; ++i )
+            {
+                planes[ plane ][ i ] /= length;
+            }
+        }
+    }
+}
+
+void RecordGpuCulling( Gpu_Scene *scene, VkCommandBuffer commandBuffer, u32 frameIndex, float32 *viewProjection )
+{
+    Gpu_Scene_Frame *frame = &scene->frames[ frameIndex ];
+    vkCmdFillBuffer( commandBuffer, frame->countBuffer, 0, sizeof( u32 ), 0 );
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                          &barrier, 0, 0, 0, 0 );
+
+    Gpu_Cull_Push_Constants pushConstants = {};
+    ExtractFrustumPlanes( viewProjection, pushConstants.frustumPlanes );
+    pushConstants.objectCount = scene->objectCount;
+
+    vkCmdBindPipeline( commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, scene->cullPipeline );
+    vkCmdBindDescriptorSets( commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, scene->cullPipelineLayout, 0, 1,
+                             &frame->descriptorSet, 0, 0 );
+    vkCmdPushConstants( commandBuffer, scene->cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, scene->cullPushConstantSize,
+                        &pushConstants );
+    vkCmdDispatch( commandBuffer, ( scene->objectCount + scene->cullWorkgroupSize - 1 ) / scene->cullWorkgroupSize, 1, 1 );
+}
+
+void RecordGpuSceneDraws( Gpu_Scene *scene, VkCommandBuffer commandBuffer, u32 frameIndex )
+{
+    Gpu_Scene_Frame *frame = &scene->frames[ frameIndex ];
+    if ( scene->indirectCount )
+    {
+        vkCmdDrawIndexedIndirectCount( commandBuffer, frame->drawBuffer, 0, frame->countBuffer, 0, scene->objectCount,
+                                       sizeof( VkDrawIndexedIndirectCommand ) );
+    }
+    else
+    {
+        vkCmdDrawIndexedIndirect( commandBuffer, frame->drawBuffer, 0, scene->objectCount,
+                                  sizeof( VkDrawIndexedIndirectCommand ) );
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "device.h"
+#include "pipeline.h"
+#include "instancing.h"
+#include "bindless.h"
+#include "job_system.h"
+#include "shader_variants.h"
+#include "upload.h"
+#include "utils/utils.h"
+
+#define GPU_CULL_WORKGROUP_SIZE 64
+#define GPU_SCENE_MAX_FRAMES 4
+
+// specialization constants of cull.comp
+#define GPU_CULL_CONSTANT_WORKGROUP_SIZE 0
+#define GPU_CULL_CONSTANT_COMPACT 1
+
+// std430 layout shared with cull.comp
+struct Gpu_Object
+{
+    float32 transform[ 16 ];      // column major, object to world
+    float32 boundingSphere[ 4 ]; // object space center + radius
+    u32 indexCount;
+    u32 firstIndex;
+    s32 vertexOffset;
+    u32 materialIndex;
+};
+
+struct Gpu_Cull_Push_Constants
+{
+    float32 frustumPlanes[ 6 ][ 4 ];
+    u32 objectCount;
+    u32 padding[ 3 ];
+};
+
+// What the cull pass writes and the draws read. One per frame in flight, so culling a frame on the async compute queue
+// never races the draws of the frame before it
+struct Gpu_Scene_Frame
+{
+    VkBuffer drawBuffer;
+    Gpu_Allocation drawAllocation;
+    VkBuffer countBuffer;
+    Gpu_Allocation countAllocation;
+    // visible objects as Gpu_Instances, each draw's firstInstance points at its slot
+    VkBuffer instanceBuffer;
+    Gpu_Allocation instanceAllocation;
+    u32 instanceBindlessIndex;
+    VkDescriptorSet descriptorSet;
+};
+
+// Object data lives on the GPU, a compute pass culls it and writes the indirect draws and instances for the frame
+struct Gpu_Scene
+{
+    Device *device;
+    Bindless_Set *bindless;
+    u32 objectCount;
+    // without drawIndirectCount every object keeps its slot and culled ones get an instance count of 0
+    bool indirectCount;
+
+    VkBuffer objectBuffer;
+    Gpu_Allocation objectAllocation;
+    // the objects are filled on the upload queue, nothing may cull them before this completes
+    Upload_Manager *uploads;
+    Upload_Token uploadToken;
+    u32 frameCount;
+    Gpu_Scene_Frame frames[ GPU_SCENE_MAX_FRAMES ];
+
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorPool descriptorPool;
+
+    VkPipelineLayout cullPipelineLayout;
+    // from cull.comp, Gpu_Cull_Push_Constants may be padded past it
+    u32 cullPushConstantSize;
+    // every workgroup size and compaction mode of cull.comp, cullPipeline is the one the device and options pick
+    Shader_Variants cullVariants;
+    VkPipeline cullPipeline;
+    u32 cullWorkgroupSize;
+};
+
+// cullWorkgroupSize is one of 64, 128 or 256 and falls back to GPU_CULL_WORKGROUP_SIZE past the device's limits.
+// Every frame's instance buffer is registered as a bindless storage buffer
+bool InitGpuScene( Gpu_Scene *scene, Device *device, Job_System *jobs, Upload_Manager *uploads, Bindless_Set *bindless,
+                   u32 framesInFlight, Gpu_Object *objects, u32 objectCount, char *cullShaderPath, u32 cullWorkgroupSize );
+void DestroyGpuScene( Gpu_Scene *scene );
+
+// Multi draw indirect with firstInstance is what lets a single command draw every object
+bool IsGpuDrivenRenderingSupported( Device *device );
+
+// Planes point inwards and are normalized, Vulkan clip space depth is [0, 1]
+void ExtractFrustumPlanes( float32 *viewProjection, float32 planes[ 6 ][ 4 ] );
+
+// Outside a render pass, culls every object into the frame's draw, count and instance buffers. Only the clear of the
+// count is ordered here, the caller orders the writes against the draws, with its render graph on the graphics queue
+// or a semaphore when this is recorded for the async compute queue
+void RecordGpuCulling( Gpu_Scene *scene, VkCommandBuffer commandBuffer, u32 frameIndex, float32 *viewProjection );
+
+// Inside the render pass with the graphics pipeline, mesh and descriptors bound
+void RecordGpuSceneDraws( Gpu_Scene *scene, VkCommandBuffer commandBuffer, u32 frameIndex );
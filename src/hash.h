@@ -0,0 +1,29 @@
+#pragma once
+
+#include "utils/utils.h"
+
+// FNV-1a, good enough for cache keys and corruption checks, not for anything adversarial
+#define HASH_SEED_64 0xcbf29ce484222325ull
+
+inline u64 HashBytes64( void *data, u64 size, u64 seed = HASH_SEED_64 )
+{
+    u8 *bytes = ( u8 * ) data;
+    u64 hash = seed;
+    for ( u64 i = 0; i < size; i++ )
+    {
+        hash ^= bytes[ i ];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+inline u64 HashString64( char *string, u64 seed = HASH_SEED_64 )
+{
+    u64 hash = seed;
+    for ( char *c = string; *c; c++ )
+    {
+        hash ^= ( u8 ) *c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
@@ -0,0 +1,69 @@
+#include "instancing.h"
+#include "trace.h"
+#include "stdio.h"
+
+bool InitInstanceBuffers( Instance_Buffers *instanceBuffers, Device *device, Bindless_Set *bindless, u32 framesInFlight,
+                          u32 capacity )
+{
+    TRACE_FUNCTION();
+    instanceBuffers->device = device;
+    instanceBuffers->bindless = bindless;
+    instanceBuffers->capacity = capacity;
+
+    instanceBuffers->frames.resize( framesInFlight );
+    for ( auto &frame : instanceBuffers->frames )
+    {
+        frame = {};
+        frame.bindlessIndex = BINDLESS_INVALID_INDEX;
+    }
+
+    for ( auto &frame : instanceBuffers->frames )
+    {
+        CreateBuffer( device, ( VkDeviceSize ) capacity * sizeof( Gpu_Instance ), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.buffer,
+                      frame.allocation );
+        frame.instances = ( Gpu_Instance * ) frame.allocation.mapped;
+        if ( frame.instances )
+        {
+            frame.bindlessIndex = AddBindlessStorageBuffer( bindless, frame.buffer );
+        }
+        if ( frame.bindlessIndex == BINDLESS_INVALID_INDEX )
+        {
+            printf( "Failed to create instance buffer!\n" );
+            DestroyInstanceBuffers( instanceBuffers );
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Call with the device idle, nothing is left in flight to read the buffers
+void DestroyInstanceBuffers( Instance_Buffers *instanceBuffers )
+{
+    Device *device = instanceBuffers->device;
+    for ( auto &frame : instanceBuffers->frames )
+    {
+        RemoveBindlessResource( instanceBuffers->bindless, BINDLESS_BINDING_STORAGE_BUFFERS, frame.bindlessIndex, 0 );
+        if ( frame.buffer != VK_NULL_HANDLE )
+        {
+            DestroyBuffer( device, frame.buffer, frame.allocation );
+        }
+    }
+    instanceBuffers->frames.clear();
+}
+
+void SetInstance( Gpu_Instance *instance, float32 *transform, u32 materialIndex )
+{
+    for ( u32 row = 0; row < 3; ++row )
+    {
+        for ( u32 column = 0; column < 4; ++column )
+        {
+            instance->rows[ row ][ column ] = transform[ column * 4 + row ];
+        }
+    }
+    instance->materialIndex = materialIndex;
+    instance->padding[ 0 ] = 0;
+    instance->padding[ 1 ] = 0;
+    instance->padding[ 2 ] = 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "device.h"
+#include "bindless.h"
+#include "utils/utils.h"
+#include <vector> //@TODO: Remove std garbage
+
+// std430 layout shared with simple.vert and cull.comp, 64 bytes
+struct Gpu_Instance
+{
+    float32 rows[ 3 ][ 4 ]; // affine object to world transform, row major
+    u32 materialIndex;
+    u32 padding[ 3 ];
+};
+
+struct Instance_Frame
+{
+    VkBuffer buffer;
+    Gpu_Allocation allocation;
+    Gpu_Instance *instances;
+    u32 bindlessIndex;
+};
+
+// Persistently mapped instance data, one buffer per frame in flight so the CPU never writes what the GPU reads
+struct Instance_Buffers
+{
+    Device *device;
+    Bindless_Set *bindless;
+    u32 capacity;
+    std::vector< Instance_Frame > frames;
+};
+
+// The buffers are registered as bindless storage buffers, shaders find them through Instance_Frame::bindlessIndex
+bool InitInstanceBuffers( Instance_Buffers *instanceBuffers, Device *device, Bindless_Set *bindless, u32 framesInFlight,
+                          u32 capacity );
+void DestroyInstanceBuffers( Instance_Buffers *instanceBuffers );
+
+// Takes a column major 4x4 transform
+void SetInstance( Gpu_Instance *instance, float32 *transform, u32 materialIndex );
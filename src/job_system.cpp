@@ -0,0 +1,583 @@
+#include "job_system.h"
+#include "platform.h"
+#include "trace.h"
+#include "stdio.h"
+#include <new>
+#include <chrono>
+
+static thread_local Job_Worker *currentWorker;
+
+static u64 GetNanoseconds()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return ( u64 ) std::chrono::duration_cast< std::chrono::nanoseconds >( now ).count();
+}
+
+// Only the owner writes its stats, so plain loads and stores are enough
+static void AddStat( std::atomic< u64 > *stat, u64 value )
+{
+    stat->store( stat->load( std::memory_order_relaxed ) + value, std::memory_order_relaxed );
+}
+
+static Job_Worker *GetCurrentWorker( Job_System *system )
+{
+    Job_Worker *worker = currentWorker;
+    Assert( worker && worker->system == system );
+    return worker;
+}
+
+static void ReadSlot( Job_Worker *worker, s64 index, Job *job )
+{
+    Job_Slot *slot = &worker->slots[ index & ( JOB_DEQUE_CAPACITY - 1 ) ];
+    job->function = slot->function.load( std::memory_order_relaxed );
+    job->data = slot->data.load( std::memory_order_relaxed );
+    job->counter = slot->counter.load( std::memory_order_relaxed );
+}
+
+static bool PushJob( Job_Worker *worker, Job job )
+{
+    s64 bottom = worker->bottom.load( std::memory_order_relaxed );
+    s64 top = worker->top.load( std::memory_order_acquire );
+    if ( bottom - top >= JOB_DEQUE_CAPACITY )
+    {
+        return false;
+    }
+
+    Job_Slot *slot = &worker->slots[ bottom & ( JOB_DEQUE_CAPACITY - 1 ) ];
+    slot->function.store( job.function, std::memory_order_relaxed );
+    slot->data.store( job.data, std::memory_order_relaxed );
+    slot->counter.store( job.counter, std::memory_order_relaxed );
+    worker->bottom.store( bottom + 1, std::memory_order_release );
+    return true;
+}
+
+static bool PopJob( Job_Worker *worker, Job *job )
+{
+    s64 bottom = worker->bottom.load( std::memory_order_relaxed ) - 1;
+    worker->bottom.store( bottom, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    s64 top = worker->top.load( std::memory_order_relaxed );
+
+    if ( top > bottom )
+    {
+        worker->bottom.store( bottom + 1, std::memory_order_relaxed );
+        return false;
+    }
+
+    ReadSlot( worker, bottom, job );
+    if ( top == bottom )
+    {
+        // the last job, a thief may be taking it at the same time
+        bool taken = worker->top.compare_exchange_strong( top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed );
+        worker->bottom.store( bottom + 1, std::memory_order_relaxed );
+        return taken;
+    }
+    return true;
+}
+
+static bool StealJob( Job_Worker *victim, Job *job )
+{
+    s64 top = victim->top.load( std::memory_order_acquire );
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    s64 bottom = victim->bottom.load( std::memory_order_acquire );
+    if ( top >= bottom )
+    {
+        return false;
+    }
+
+    ReadSlot( victim, top, job );
+    return victim->top.compare_exchange_strong( top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed );
+}
+
+static bool FindJob( Job_System *system, Job_Worker *worker, Job *job )
+{
+    if ( PopJob( worker, job ) )
+    {
+        return true;
+    }
+
+    // xorshift, starting at a random victim keeps thieves from piling onto the same deque
+    worker->randomState ^= worker->randomState << 13;
+    worker->randomState ^= worker->randomState >> 17;
+    worker->randomState ^= worker->randomState << 5;
+    u32 first = worker->randomState % system->workerCount;
+    for ( u32 i = 0; i < system->workerCount; ++i )
+    {
+        Job_Worker *victim = &system->workers[ ( first + i ) % system->workerCount ];
+        if ( victim == worker )
+        {
+            continue;
+        }
+
+        AddStat( &worker->stats.stealAttemptCount, 1 );
+        if ( StealJob( victim, job ) )
+        {
+            AddStat( &worker->stats.stealCount, 1 );
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool IsAnyJobQueued( Job_System *system )
+{
+    for ( u32 i = 0; i < system->workerCount; ++i )
+    {
+        Job_Worker *worker = &system->workers[ i ];
+        if ( worker->bottom.load() > worker->top.load() )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void WakeWorker( Job_System *system )
+{
+    // pairs with the sleeping worker bumping sleepingCount before it looks at the deques
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    if ( system->sleepingCount.load() > 0 )
+    {
+        std::lock_guard< std::mutex > lock( system->sleepMutex );
+        system->workAvailable.notify_one();
+    }
+}
+
+static void ExecuteJob( Job_System *system, Job_Worker *worker, Job job );
+
+static void EnqueueJob( Job_System *system, Job_Worker *worker, Job job )
+{
+    if ( PushJob( worker, job ) )
+    {
+        WakeWorker( system );
+    }
+    else
+    {
+        ExecuteJob( system, worker, job );
+    }
+}
+
+static void ReleaseParkedJobs( Job_System *system, Job_Worker *worker )
+{
+    Job released[ 64 ];
+    u32 releasedCount = 0;
+    {
+        std::lock_guard< std::mutex > lock( system->parkedMutex );
+        for ( size_t i = 0; i < system->parked.size() && releasedCount < 64; )
+        {
+            if ( system->parked[ i ].dependency->value.load() == 0 )
+            {
+                released[ releasedCount++ ] = system->parked[ i ].job;
+                system->parked[ i ] = system->parked.back();
+                system->parked.pop_back();
+            }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+
+    for ( u32 i = 0; i < releasedCount; ++i )
+    {
+        EnqueueJob( system, worker, released[ i ] );
+    }
+    if ( releasedCount == 64 )
+    {
+        ReleaseParkedJobs( system, worker );
+    }
+}
+
+static void ExecuteJob( Job_System *system, Job_Worker *worker, Job job )
+{
+    u64 start = worker->jobDepth == 0 ? GetNanoseconds() : 0;
+    worker->jobDepth++;
+    job.function( job.data, worker->index );
+    worker->jobDepth--;
+    if ( worker->jobDepth == 0 )
+    {
+        AddStat( &worker->stats.busyNanoseconds, GetNanoseconds() - start );
+    }
+    AddStat( &worker->stats.jobCount, 1 );
+
+    // taking parkedMutex on every counter that reaches zero means a job parked just before can't be missed
+    if ( job.counter && job.counter->value.fetch_sub( 1 ) == 1 )
+    {
+        ReleaseParkedJobs( system, worker );
+    }
+}
+
+static void WorkerThread( Job_System *system, u32 workerIndex )
+{
+    SetTraceThreadName( "worker" );
+    Job_Worker *worker = &system->workers[ workerIndex ];
+    currentWorker = worker;
+
+    u32 idleCount = 0;
+    for ( ;; )
+    {
+        Job job;
+        if ( FindJob( system, worker, &job ) )
+        {
+            ExecuteJob( system, worker, job );
+            idleCount = 0;
+            continue;
+        }
+
+        // the queues are drained before quitting
+        if ( system->quit.load() )
+        {
+            return;
+        }
+
+        if ( ++idleCount < JOB_SYSTEM_SPIN_COUNT )
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        idleCount = 0;
+
+        std::unique_lock< std::mutex > lock( system->sleepMutex );
+        system->sleepingCount.fetch_add( 1 );
+        system->workAvailable.wait( lock, [ system ] { return system->quit.load() || IsAnyJobQueued( system ); } );
+        system->sleepingCount.fetch_sub( 1 );
+        AddStat( &worker->stats.sleepCount, 1 );
+    }
+}
+
+void InitJobSystem( Job_System *system, u32 workerCount )
+{
+    if ( workerCount == 0 )
+    {
+        workerCount = std::thread::hardware_concurrency();
+    }
+    if ( workerCount == 0 ) workerCount = 1;
+    if ( workerCount > JOB_SYSTEM_MAX_WORKERS ) workerCount = JOB_SYSTEM_MAX_WORKERS;
+
+    system->workerCount = workerCount;
+    system->workers = ( Job_Worker * ) AllocateAligned( workerCount * sizeof( Job_Worker ), 64 );
+    for ( u32 i = 0; i < workerCount; ++i )
+    {
+        Job_Worker *worker = new ( &system->workers[ i ] ) Job_Worker();
+        worker->system = system;
+        worker->index = i;
+        worker->randomState = 0x9e3779b9u * ( i + 1 );
+        worker->jobDepth = 0;
+        worker->top.store( 0 );
+        worker->bottom.store( 0 );
+    }
+
+    system->sleepingCount.store( 0 );
+    system->quit.store( false );
+    ResetJobSystemStats( system );
+
+    currentWorker = &system->workers[ workerCount - 1 ];
+    system->threads.reserve( workerCount - 1 );
+    for ( u32 i = 0; i + 1 < workerCount; ++i )
+    {
+        system->threads.emplace_back( WorkerThread, system, i );
+    }
+}
+
+void DestroyJobSystem( Job_System *system )
+{
+    {
+        std::lock_guard< std::mutex > lock( system->sleepMutex );
+        system->quit.store( true );
+    }
+    system->workAvailable.notify_all();
+
+    for ( auto &thread : system->threads )
+    {
+        thread.join();
+    }
+    system->threads.clear();
+
+    // jobs still on the calling thread's deque were never waited on
+    Job_Worker *worker = &system->workers[ system->workerCount - 1 ];
+    Job job;
+    while ( PopJob( worker, &job ) )
+    {
+        ExecuteJob( system, worker, job );
+    }
+
+    if ( !system->parked.empty() )
+    {
+        printf( "Job system destroyed with %u jobs still waiting on dependencies\n", ( u32 ) system->parked.size() );
+        system->parked.clear();
+    }
+
+    if ( currentWorker == worker )
+    {
+        currentWorker = 0;
+    }
+    for ( u32 i = 0; i < system->workerCount; ++i )
+    {
+        system->workers[ i ].~Job_Worker();
+    }
+    FreeAligned( system->workers );
+    system->workers = 0;
+    system->workerCount = 0;
+}
+
+u32 GetJobWorkerCount( Job_System *system )
+{
+    return system->workerCount;
+}
+
+void SubmitJob( Job_System *system, Job_Function function, void *data, Job_Counter *counter )
+{
+    Job_Worker *worker = GetCurrentWorker( system );
+    if ( counter )
+    {
+        counter->value.fetch_add( 1 );
+    }
+    EnqueueJob( system, worker, { function, data, counter } );
+}
+
+void SubmitJobAfter( Job_System *system, Job_Function function, void *data, Job_Counter *counter, Job_Counter *dependency )
+{
+    Job_Worker *worker = GetCurrentWorker( system );
+    if ( counter )
+    {
+        counter->value.fetch_add( 1 );
+    }
+
+    Job job = { function, data, counter };
+    {
+        std::lock_guard< std::mutex > lock( system->parkedMutex );
+        if ( dependency->value.load() > 0 )
+        {
+            system->parked.push_back( { job, dependency } );
+            return;
+        }
+    }
+    EnqueueJob( system, worker, job );
+}
+
+void WaitForCounter( Job_System *system, Job_Counter *counter )
+{
+    TRACE_FUNCTION();
+    Job_Worker *worker = GetCurrentWorker( system );
+    while ( counter->value.load() > 0 )
+    {
+        Job job;
+        if ( FindJob( system, worker, &job ) )
+        {
+            ExecuteJob( system, worker, job );
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+struct Parallel_For_State
+{
+    Parallel_For_Function function;
+    void *data;
+    u32 count;
+    u32 batchSize;
+    u32 batchCount;
+    std::atomic< u32 > nextBatch;
+};
+
+// Every helper keeps taking batches until none are left, so a slow batch doesn't hold up the others
+static void RunParallelForBatches( void *data, u32 workerIndex )
+{
+    Parallel_For_State *state = ( Parallel_For_State * ) data;
+    for ( ;; )
+    {
+        u32 batch = state->nextBatch.fetch_add( 1, std::memory_order_relaxed );
+        if ( batch >= state->batchCount )
+        {
+            return;
+        }
+
+        u32 begin = batch * state->batchSize;
+        u32 end = state->count - begin < state->batchSize ? state->count : begin + state->batchSize;
+        state->function( state->data, begin, end, workerIndex );
+    }
+}
+
+void ParallelFor( Job_System *system, u32 count, u32 batchSize, Parallel_For_Function function, void *data )
+{
+    if ( count == 0 )
+    {
+        return;
+    }
+    if ( batchSize == 0 ) batchSize = 1;
+
+    Parallel_For_State state;
+    state.function = function;
+    state.data = data;
+    state.count = count;
+    state.batchSize = batchSize;
+    state.batchCount = ( u32 ) ( ( ( u64 ) count + batchSize - 1 ) / batchSize );
+    state.nextBatch.store( 0 );
+
+    u32 helperCount = state.batchCount < system->workerCount ? state.batchCount - 1 : system->workerCount - 1;
+    Job_Counter counter = {};
+    for ( u32 i = 0; i < helperCount; ++i )
+    {
+        SubmitJob( system, RunParallelForBatches, &state, &counter );
+    }
+
+    ExecuteJob( system, GetCurrentWorker( system ), { RunParallelForBatches, &state, 0 } );
+    WaitForCounter( system, &counter );
+}
+
+void ResetJobSystemStats( Job_System *system )
+{
+    for ( u32 i = 0; i < system->workerCount; ++i )
+    {
+        Job_Worker_Stats *stats = &system->workers[ i ].stats;
+        stats->jobCount.store( 0 );
+        stats->stealCount.store( 0 );
+        stats->stealAttemptCount.store( 0 );
+        stats->busyNanoseconds.store( 0 );
+        stats->sleepCount.store( 0 );
+    }
+    system->statsStartNanoseconds = GetNanoseconds();
+}
+
+float64 GetJobWorkerUtilization( Job_System *system, u32 workerIndex )
+{
+    u64 elapsed = GetNanoseconds() - system->statsStartNanoseconds;
+    if ( elapsed == 0 )
+    {
+        return 0.0;
+    }
+    return ( float64 ) system->workers[ workerIndex ].stats.busyNanoseconds.load() / ( float64 ) elapsed;
+}
+
+void PrintJobSystemStats( Job_System *system )
+{
+    u64 jobCount = 0;
+    u64 stealCount = 0;
+    for ( u32 i = 0; i < system->workerCount; ++i )
+    {
+        jobCount += system->workers[ i ].stats.jobCount.load();
+        stealCount += system->workers[ i ].stats.stealCount.load();
+    }
+
+    printf( "Job system: %u workers, %llu jobs, %.1f%% stolen\n", system->workerCount, ( unsigned long long ) jobCount,
+            jobCount ? 100.0 * ( float64 ) stealCount / ( float64 ) jobCount : 0.0 );
+    for ( u32 i = 0; i < system->workerCount; ++i )
+    {
+        Job_Worker_Stats *stats = &system->workers[ i ].stats;
+        u64 attempts = stats->stealAttemptCount.load();
+        printf( "  worker %2u%s: %5.1f%% busy, %8llu jobs, %8llu stolen (%.1f%% of attempts), %6llu sleeps\n", i,
+                i + 1 == system->workerCount ? " (main)" : "       ", 100.0 * GetJobWorkerUtilization( system, i ),
+                ( unsigned long long ) stats->jobCount.load(), ( unsigned long long ) stats->stealCount.load(),
+                attempts ? 100.0 * ( float64 ) stats->stealCount.load() / ( float64 ) attempts : 0.0,
+                ( unsigned long long ) stats->sleepCount.load() );
+    }
+}
+
+static void EmptyJob( void *data, u32 workerIndex )
+{
+}
+
+static std::atomic< u64 > benchmarkSink;
+
+// Integer hashing with nothing shared but the result, scales with the cores if the scheduler does
+static void HashRange( void *data, u32 begin, u32 end, u32 workerIndex )
+{
+    u64 hash = 0;
+    for ( u32 i = begin; i < end; ++i )
+    {
+        u64 x = i;
+        for ( u32 round = 0; round < 64; ++round )
+        {
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+            hash ^= x >> 33;
+        }
+    }
+    benchmarkSink.fetch_add( hash, std::memory_order_relaxed );
+}
+
+static float64 GetStealPercentage( Job_System *system )
+{
+    u64 jobCount = 0;
+    u64 stealCount = 0;
+    for ( u32 i = 0; i < system->workerCount; ++i )
+    {
+        jobCount += system->workers[ i ].stats.jobCount.load();
+        stealCount += system->workers[ i ].stats.stealCount.load();
+    }
+    return jobCount ? 100.0 * ( float64 ) stealCount / ( float64 ) jobCount : 0.0;
+}
+
+static float64 GetAverageUtilization( Job_System *system )
+{
+    float64 total = 0.0;
+    for ( u32 i = 0; i < system->workerCount; ++i )
+    {
+        total += GetJobWorkerUtilization( system, i );
+    }
+    return 100.0 * total / ( float64 ) system->workerCount;
+}
+
+void RunJobSystemBenchmark()
+{
+    u32 coreCount = std::thread::hardware_concurrency();
+    printf( "%u hardware threads\n", coreCount );
+
+    // every job is submitted from the main thread, the others only get work by stealing it
+    u32 rounds = 256;
+    u32 jobsPerRound = JOB_DEQUE_CAPACITY / 2;
+    printf( "\nSpawn overhead, %u empty jobs\n%10s %12s %12s %12s\n", rounds * jobsPerRound, "workers", "ns/job", "stolen %",
+            "busy %" );
+    u32 spawnWorkerCounts[ 2 ] = { 1, 0 };
+    for ( u32 run = 0; run < 2; ++run )
+    {
+        Job_System system;
+        InitJobSystem( &system, spawnWorkerCounts[ run ] );
+
+        u64 start = GetNanoseconds();
+        for ( u32 round = 0; round < rounds; ++round )
+        {
+            Job_Counter counter = {};
+            for ( u32 i = 0; i < jobsPerRound; ++i )
+            {
+                SubmitJob( &system, EmptyJob, 0, &counter );
+            }
+            WaitForCounter( &system, &counter );
+        }
+        float64 nanoseconds = ( float64 ) ( GetNanoseconds() - start );
+
+        printf( "%10u %12.1f %12.1f %12.1f\n", system.workerCount, nanoseconds / ( float64 ) ( rounds * jobsPerRound ),
+                GetStealPercentage( &system ), GetAverageUtilization( &system ) );
+        DestroyJobSystem( &system );
+    }
+
+    u32 itemCount = 1 << 22;
+    u32 batchSize = 1024;
+    printf( "\nParallelFor scaling, %u items in batches of %u\n%10s %12s %12s %12s %12s\n", itemCount, batchSize, "workers", "ms",
+            "speedup", "stolen %", "busy %" );
+    float64 singleMilliseconds = 0.0;
+    for ( u32 workerCount = 1; workerCount <= JOB_SYSTEM_MAX_WORKERS; workerCount *= 2 )
+    {
+        Job_System system;
+        InitJobSystem( &system, workerCount );
+
+        // best of a few runs, the first also wakes every thread up
+        float64 bestMilliseconds = 0.0;
+        for ( u32 run = 0; run < 5; ++run )
+        {
+            ResetJobSystemStats( &system );
+            u64 start = GetNanoseconds();
+            ParallelFor( &system, itemCount, batchSize, HashRange, 0 );
+            float64 milliseconds = ( float64 ) ( GetNanoseconds() - start ) / 1e6;
+            if ( run == 0 || milliseconds < bestMilliseconds ) bestMilliseconds = milliseconds;
+        }
+        if ( workerCount == 1 ) singleMilliseconds = bestMilliseconds;
+
+        printf( "%10u %12.3f %12.2f %12.1f %12.1f%s\n", workerCount, bestMilliseconds, singleMilliseconds / bestMilliseconds,
+                GetStealPercentage( &system ), GetAverageUtilization( &system ),
+                workerCount > coreCount ? " (oversubscribed)" : "" );
+        DestroyJobSystem( &system );
+    }
+}
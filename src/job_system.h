@@ -0,0 +1,122 @@
+#pragma once
+
+#include "utils/utils.h"
+#include <vector> //@TODO: Remove std garbage
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+// Per worker deque size, has to be a power of two. Jobs pushed onto a full deque run right away instead
+#define JOB_DEQUE_CAPACITY 4096
+#define JOB_SYSTEM_MAX_WORKERS 64
+// Failed rounds of stealing before a worker goes to sleep
+#define JOB_SYSTEM_SPIN_COUNT 64
+
+// workerIndex is in [0, workerCount), the thread that initialized the system is workerCount - 1
+typedef void ( *Job_Function )( void *data, u32 workerIndex );
+typedef void ( *Parallel_For_Function )( void *data, u32 begin, u32 end, u32 workerIndex );
+
+// Number of jobs submitted against it that haven't finished, zero initialize before use
+struct Job_Counter
+{
+    std::atomic< u32 > value;
+};
+
+// The fields are atomics because a thief may read a slot while its owner reuses it, the steal then fails
+struct Job_Slot
+{
+    std::atomic< Job_Function > function;
+    std::atomic< void * > data;
+    std::atomic< Job_Counter * > counter;
+};
+
+struct Job
+{
+    Job_Function function;
+    void *data;
+    Job_Counter *counter;
+};
+
+// Written by the owning worker only
+struct Job_Worker_Stats
+{
+    std::atomic< u64 > jobCount;
+    std::atomic< u64 > stealCount;
+    std::atomic< u64 > stealAttemptCount;
+    std::atomic< u64 > busyNanoseconds;
+    std::atomic< u64 > sleepCount;
+};
+
+struct Job_System;
+
+// Chase-Lev deque, the owner pushes and pops at the bottom, everyone else steals from the top.
+// top and bottom live on their own cache lines so thieves don't slow the owner down
+struct Job_Worker
+{
+    Job_System *system;
+    u32 index;
+    u32 randomState;
+    u32 jobDepth; // jobs run while waiting inside another job don't count their time twice
+    Job_Worker_Stats stats;
+
+    u8 topPadding[ 64 ];
+    std::atomic< s64 > top;
+    u8 bottomPadding[ 64 ];
+    std::atomic< s64 > bottom;
+    u8 slotsPadding[ 64 ];
+    Job_Slot slots[ JOB_DEQUE_CAPACITY ];
+};
+
+// A job waiting for its dependency to reach zero
+struct Parked_Job
+{
+    Job job;
+    Job_Counter *dependency;
+};
+
+struct Job_System
+{
+    Job_Worker *workers;
+    u32 workerCount;
+    std::vector< std::thread > threads;
+
+    std::mutex parkedMutex;
+    std::vector< Parked_Job > parked;
+
+    // sleeping workers are woken when work is pushed
+    std::mutex sleepMutex;
+    std::condition_variable workAvailable;
+    std::atomic< u32 > sleepingCount;
+    std::atomic< bool > quit;
+
+    u64 statsStartNanoseconds;
+};
+
+// workerCount 0 gives one worker per core. The calling thread is the last worker and the rest get a thread each,
+// jobs can only be submitted from that thread and from inside jobs
+void InitJobSystem( Job_System *system, u32 workerCount );
+void DestroyJobSystem( Job_System *system );
+
+// Total number of threads that run jobs, including the one that initialized the system
+u32 GetJobWorkerCount( Job_System *system );
+
+// counter can be null for fire and forget jobs, it is incremented here and decremented once the job finishes
+void SubmitJob( Job_System *system, Job_Function function, void *data, Job_Counter *counter );
+
+// The job is held back until dependency reaches zero, counter counts it as unfinished from now on
+void SubmitJobAfter( Job_System *system, Job_Function function, void *data, Job_Counter *counter, Job_Counter *dependency );
+
+// Runs other jobs on the calling thread until the counter reaches zero
+void WaitForCounter( Job_System *system, Job_Counter *counter );
+
+// Splits [0, count) into ranges of batchSize and waits for all of them
+void ParallelFor( Job_System *system, u32 count, u32 batchSize, Parallel_For_Function function, void *data );
+
+// Utilization is busy time over the time since the last reset
+void ResetJobSystemStats( Job_System *system );
+float64 GetJobWorkerUtilization( Job_System *system, u32 workerIndex );
+void PrintJobSystemStats( Job_System *system );
+
+// Spawn overhead, steal rate and how a compute bound ParallelFor scales up to JOB_SYSTEM_MAX_WORKERS threads
+void RunJobSystemBenchmark();
@@ -0,0 +1,183 @@
+#include "layout_cache.h"
+#include "hash.h"
+#include "stdio.h"
+#include "string.h"
+
+void DestroyLayoutCache( Layout_Cache *cache, VkDevice device )
+{
+    for ( Cached_Pipeline_Layout &pipelineLayout : cache->pipelineLayouts )
+    {
+        vkDestroyPipelineLayout( device, pipelineLayout.layout, 0 );
+    }
+    for ( Cached_Set_Layout &setLayout : cache->setLayouts )
+    {
+        vkDestroyDescriptorSetLayout( device, setLayout.layout, 0 );
+    }
+    cache->pipelineLayouts.clear();
+    cache->setLayouts.clear();
+}
+
+bool AddDescriptorBinding( Descriptor_Set_Layout_Desc *desc, u32 binding, VkDescriptorType type, u32 count,
+                           VkShaderStageFlags stages, VkDescriptorBindingFlags flags )
+{
+    u32 index = 0;
+    while ( index < desc->bindingCount && desc->bindings[ index ].binding < binding )
+    {
+        index++;
+    }
+
+    if ( index == desc->bindingCount || desc->bindings[ index ].binding != binding )
+    {
+        if ( desc->bindingCount == LAYOUT_MAX_BINDINGS )
+        {
+            printf( "Descriptor set layout has more than %u bindings!\n", LAYOUT_MAX_BINDINGS );
+            return false;
+        }
+        memmove( &desc->bindings[ index + 1 ], &desc->bindings[ index ],
+                 ( desc->bindingCount - index ) * sizeof( Descriptor_Binding_Desc ) );
+        desc->bindingCount++;
+    }
+
+    Descriptor_Binding_Desc *entry = &desc->bindings[ index ];
+    memset( entry, 0, sizeof( *entry ) );
+    entry->binding = binding;
+    entry->type = type;
+    entry->count = count;
+    entry->stages = stages;
+    entry->flags = flags;
+    return true;
+}
+
+Descriptor_Binding_Desc *FindDescriptorBinding( Descriptor_Set_Layout_Desc *desc, u32 binding )
+{
+    for ( u32 i = 0; i < desc->bindingCount; ++i )
+    {
+        if ( desc->bindings[ i ].binding == binding )
+        {
+            return &desc->bindings[ i ];
+        }
+    }
+    return 0;
+}
+
+static u64 HashSetLayoutDesc( Descriptor_Set_Layout_Desc *desc )
+{
+    u64 hash = HashBytes64( &desc->flags, sizeof( desc->flags ) );
+    hash = HashBytes64( &desc->bindingCount, sizeof( desc->bindingCount ), hash );
+    return HashBytes64( desc->bindings, desc->bindingCount * sizeof( Descriptor_Binding_Desc ), hash );
+}
+
+static bool SetLayoutDescsEqual( Descriptor_Set_Layout_Desc *a, Descriptor_Set_Layout_Desc *b )
+{
+    return a->flags == b->flags && a->bindingCount == b->bindingCount &&
+           memcmp( a->bindings, b->bindings, a->bindingCount * sizeof( Descriptor_Binding_Desc ) ) == 0;
+}
+
+VkDescriptorSetLayout GetDescriptorSetLayout( Layout_Cache *cache, VkDevice device, Descriptor_Set_Layout_Desc *desc )
+{
+    u64 hash = HashSetLayoutDesc( desc );
+
+    std::lock_guard< std::mutex > lock( cache->mutex );
+    cache->stats.setLookups++;
+    for ( Cached_Set_Layout &cached : cache->setLayouts )
+    {
+        if ( cached.hash == hash && SetLayoutDescsEqual( &cached.desc, desc ) )
+        {
+            return cached.layout;
+        }
+    }
+
+    VkDescriptorSetLayoutBinding bindings[ LAYOUT_MAX_BINDINGS ] = {};
+    VkDescriptorBindingFlags bindingFlags[ LAYOUT_MAX_BINDINGS ];
+    bool anyBindingFlags = false;
+    for ( u32 i = 0; i < desc->bindingCount; ++i )
+    {
+        bindings[ i ].binding = desc->bindings[ i ].binding;
+        bindings[ i ].descriptorType = desc->bindings[ i ].type;
+        bindings[ i ].descriptorCount = desc->bindings[ i ].count;
+        bindings[ i ].stageFlags = desc->bindings[ i ].stages;
+        bindingFlags[ i ] = desc->bindings[ i ].flags;
+        anyBindingFlags = anyBindingFlags || bindingFlags[ i ] != 0;
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = desc->bindingCount;
+    bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = anyBindingFlags ? &bindingFlagsInfo : 0;
+    layoutInfo.flags = desc->flags;
+    layoutInfo.bindingCount = desc->bindingCount;
+    layoutInfo.pBindings = bindings;
+
+    Cached_Set_Layout cached = {};
+    cached.hash = hash;
+    cached.desc = *desc;
+    if ( vkCreateDescriptorSetLayout( device, &layoutInfo, 0, &cached.layout ) != VK_SUCCESS )
+    {
+        printf( "Failed to create descriptor set layout!\n" );
+        return VK_NULL_HANDLE;
+    }
+    cache->setLayouts.push_back( cached );
+    return cached.layout;
+}
+
+VkPipelineLayout GetPipelineLayout( Layout_Cache *cache, VkDevice device, VkDescriptorSetLayout *setLayouts, u32 setCount,
+                                    VkPushConstantRange *pushConstants )
+{
+    if ( setCount > LAYOUT_MAX_SETS )
+    {
+        printf( "Pipeline layout has more than %u descriptor sets!\n", LAYOUT_MAX_SETS );
+        return VK_NULL_HANDLE;
+    }
+
+    // set layouts are deduplicated already, so their handles are enough to tell pipeline layouts apart
+    Cached_Pipeline_Layout key = {};
+    key.setCount = setCount;
+    memcpy( key.setLayouts, setLayouts, setCount * sizeof( VkDescriptorSetLayout ) );
+    if ( pushConstants && pushConstants->size > 0 )
+    {
+        key.pushConstants = *pushConstants;
+    }
+    u64 hash = HashBytes64( key.setLayouts, sizeof( key.setLayouts ) );
+    hash = HashBytes64( &key.pushConstants, sizeof( key.pushConstants ), hash );
+    hash = HashBytes64( &key.setCount, sizeof( key.setCount ), hash );
+    key.hash = hash;
+
+    std::lock_guard< std::mutex > lock( cache->mutex );
+    cache->stats.pipelineLookups++;
+    for ( Cached_Pipeline_Layout &cached : cache->pipelineLayouts )
+    {
+        if ( cached.hash == hash && cached.setCount == key.setCount &&
+             memcmp( cached.setLayouts, key.setLayouts, sizeof( key.setLayouts ) ) == 0 &&
+             memcmp( &cached.pushConstants, &key.pushConstants, sizeof( key.pushConstants ) ) == 0 )
+        {
+            return cached.layout;
+        }
+    }
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = setCount;
+    pipelineLayoutInfo.pSetLayouts = setLayouts;
+    pipelineLayoutInfo.pushConstantRangeCount = key.pushConstants.size > 0 ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = &key.pushConstants;
+
+    if ( vkCreatePipelineLayout( device, &pipelineLayoutInfo, 0, &key.layout ) != VK_SUCCESS )
+    {
+        printf( "Failed to create pipeline layout!\n" );
+        return VK_NULL_HANDLE;
+    }
+    cache->pipelineLayouts.push_back( key );
+    return key.layout;
+}
+
+void PrintLayoutCacheStats( Layout_Cache *cache )
+{
+    std::lock_guard< std::mutex > lock( cache->mutex );
+    printf( "Layout cache: %u descriptor set layouts for %llu lookups, %u pipeline layouts for %llu lookups\n",
+            ( u32 ) cache->setLayouts.size(), ( unsigned long long ) cache->stats.setLookups, ( u32 ) cache->pipelineLayouts.size(),
+            ( unsigned long long ) cache->stats.pipelineLookups );
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "window.h"
+#include "utils/utils.h"
+#include <vector> //@TODO: Remove std garbage
+#include <mutex>
+
+#define LAYOUT_MAX_SETS 4
+#define LAYOUT_MAX_BINDINGS 16
+
+struct Descriptor_Binding_Desc
+{
+    u32 binding;
+    VkDescriptorType type;
+    // 0 is a runtime array, the set that provides it decides the size
+    u32 count;
+    VkShaderStageFlags stages;
+    VkDescriptorBindingFlags flags;
+};
+
+// Bindings are kept sorted by binding number, so equal layouts compare equal byte for byte
+struct Descriptor_Set_Layout_Desc
+{
+    VkDescriptorSetLayoutCreateFlags flags;
+    u32 bindingCount;
+    Descriptor_Binding_Desc bindings[ LAYOUT_MAX_BINDINGS ];
+};
+
+struct Cached_Set_Layout
+{
+    u64 hash;
+    Descriptor_Set_Layout_Desc desc;
+    VkDescriptorSetLayout layout;
+};
+
+struct Cached_Pipeline_Layout
+{
+    u64 hash;
+    u32 setCount;
+    VkDescriptorSetLayout setLayouts[ LAYOUT_MAX_SETS ];
+    VkPushConstantRange pushConstants;
+    VkPipelineLayout layout;
+};
+
+struct Layout_Cache_Stats
+{
+    u64 setLookups;
+    u64 pipelineLookups;
+};
+
+// Owns every descriptor set and pipeline layout, identical descriptions share one handle for the device's lifetime
+struct Layout_Cache
+{
+    std::vector< Cached_Set_Layout > setLayouts;
+    std::vector< Cached_Pipeline_Layout > pipelineLayouts;
+    Layout_Cache_Stats stats = {};
+    std::mutex mutex;
+};
+
+void DestroyLayoutCache( Layout_Cache *cache, VkDevice device );
+
+// Inserts or replaces the binding, keeping the bindings sorted
+bool AddDescriptorBinding( Descriptor_Set_Layout_Desc *desc, u32 binding, VkDescriptorType type, u32 count,
+                           VkShaderStageFlags stages, VkDescriptorBindingFlags flags = 0 );
+
+Descriptor_Binding_Desc *FindDescriptorBinding( Descriptor_Set_Layout_Desc *desc, u32 binding );
+
+// Thread safe, returns VK_NULL_HANDLE when creation failed
+VkDescriptorSetLayout GetDescriptorSetLayout( Layout_Cache *cache, VkDevice device, Descriptor_Set_Layout_Desc *desc );
+
+// pushConstants may be null or have a size of 0 when there are none
+VkPipelineLayout GetPipelineLayout( Layout_Cache *cache, VkDevice device, VkDescriptorSetLayout *setLayouts, u32 setCount,
+                                    VkPushConstantRange *pushConstants );
+
+void PrintLayoutCacheStats( Layout_Cache *cache );
@@ -1,101 +1,629 @@
 #include "window.h"
 #include "pipeline.h"
 #include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
 #include "swap_chain.h"
+#include "upload.h"
+#include "job_system.h"
+#include "frame_commands.h"
+#include "gpu_profiler.h"
+#include "frame_pacer.h"
+#include "trace.h"
+#include "shader_reload.h"
+#include "mesh.h"
+#include "gpu_scene.h"
+#include "cpu_culling.h"
+#include "instancing.h"
+#include "bindless.h"
+#include "frame_ring.h"
+#include "archive.h"
+#include "texture_streaming.h"
+#include "render_graph.h"
+#include "pipeline_manager.h"
+#include "shader_reflection.h"
+#include "shader_variants.h"
+#include "async_compute.h"
+#include "math.h"
+#include <chrono> //@TODO: Remove std garbage
 
-void CreatePipelineLayout( Pipeline *pipeline, VkPipelineLayout *pipelineLayout )
+// Matches the push constant block in simple.vert
+struct Scene_Push_Constants
 {
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0;
-    pipelineLayoutInfo.pSetLayouts = 0;
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
-    pipelineLayoutInfo.pPushConstantRanges = 0;
+    Mesh_Push_Constants mesh;
+    u32 instanceBufferIndex; // bindless storage buffer slot
+    u32 padding[ 3 ];
+};
 
-    if ( vkCreatePipelineLayout( pipeline->device->device, &pipelineLayoutInfo, 0, pipelineLayout ) != VK_SUCCESS )
+#define SCENE_MATERIAL_COUNT 4
+
+struct Gpu_Material
+{
+    u32 textureIndex;    // bindless sampled image, BINDLESS_INVALID_INDEX for the flat color
+    u32 streamedTexture; // slot in the texture feedback buffer
+    u32 width;
+    u32 height;
+};
+
+// Matches the uniform block in simple.vert and simple.frag, written to the frame ring once a frame
+struct Frame_Constants
+{
+    float32 viewProjection[ 16 ];
+    float32 time;
+    u32 frameNumber;
+    u32 textureFeedbackIndex; // bindless storage buffer, BINDLESS_INVALID_INDEX without fragment stores
+    u32 samplerIndex;
+    Gpu_Material materials[ SCENE_MATERIAL_COUNT ];
+};
+
+// The bindless set is always set 0
+#define SCENE_SET_FRAME 1
+
+// specialization constants of simple.frag
+#define SCENE_CONSTANT_TEXTURE_FEEDBACK 0
+
+// The global bindless set and the frame ring's dynamic uniform buffer, everything else is indexed through the push constants
+// The layout comes from the shaders, the bindless set and the frame ring provide the two sets they bind. Every variant
+// is built up front on the jobs and pipeline gets the one matching textureFeedback
+Pipeline_Config_Info CreatePipeline( Pipeline *pipeline, Pipeline_Manager *manager, Job_System *jobs, Shader_Variants *variants,
+                                     VkRenderPass renderPass, Descriptor_Set_Layout_Desc **sceneSets, u32 sceneSetCount,
+                                     VkPipelineLayout *pipelineLayout, u32 *pushConstantSize, Mesh_Vertex_Format vertexFormat,
+                                     bool textureFeedback )
+{
+    pipeline->device = manager->device;
+    Pipeline_Config_Info pipelineConfig = DefaultPipelineConfigInfo();
+
+    char *shaderPaths[] = { "shaders/simple.vert.spv", "shaders/simple.frag.spv" };
+    Shader_Reflection reflection;
+    if ( !ReflectShaderFiles( shaderPaths, 2, &reflection ) )
     {
-        printf( "Failed to create pipeline layout!\n" );
-        return;
+        *pipelineLayout = VK_NULL_HANDLE;
+        return pipelineConfig;
+    }
+    if ( reflection.pushConstants.size > sizeof( Scene_Push_Constants ) )
+    {
+        printf( "Scene shaders read more push constants than Scene_Push_Constants has!\n" );
     }
+    *pushConstantSize = reflection.pushConstants.size;
+    *pipelineLayout = CreateReflectedPipelineLayout( manager->device, &reflection, sceneSets, sceneSetCount );
+
+    pipelineConfig.renderPass = renderPass;
+    pipelineConfig.pipelineLayout = *pipelineLayout;
+    SetMeshVertexInput( &pipelineConfig, vertexFormat );
+    CheckReflectedVertexInput( &reflection, &pipelineConfig );
+
+    u32 textureFeedbackModes[] = { 0, 1 };
+    InitShaderVariants( variants, manager->device );
+    if ( AddShaderVariantSwitch( variants, "texture feedback", SCENE_CONSTANT_TEXTURE_FEEDBACK, textureFeedbackModes, 2 ) &&
+         CheckShaderVariantSwitches( variants, &reflection ) )
+    {
+        BuildGraphicsVariants( variants, manager, jobs, &pipelineConfig, GetManagedShaderModule( manager, shaderPaths[ 0 ] ),
+                               GetManagedShaderModule( manager, shaderPaths[ 1 ] ) );
+    }
+
+    // the variant built above, shader reloads keep the constant since it's part of the config
+    SetSpecializationConstant( &pipelineConfig.specialization, SCENE_CONSTANT_TEXTURE_FEEDBACK, textureFeedback ? 1 : 0 );
+    CreateManagedGraphicsPipeline( manager, pipeline, &pipelineConfig, shaderPaths[ 0 ], shaderPaths[ 1 ] );
+    return pipelineConfig;
 }
 
-void CreatePipeline( Pipeline *pipeline, Device *device, Swap_Chain *swapChain, VkPipelineLayout *pipelineLayout )
+#define MIN_DRAWS_PER_RECORD_JOB 256
+#define MAX_RECORD_JOBS 64
+#define INSTANCES_PER_FILL_JOB 16384
+
+struct Instance_Fill_Job
 {
-    pipeline->device = device;
-    CreatePipelineLayout( pipeline, pipelineLayout );
-    Pipeline_Config_Info pipelineConfig = DefaultPipelineConfigInfo( swapChain->swapChainExtent.width,
-                                                                     swapChain->swapChainExtent.height );
-    pipelineConfig.renderPass = swapChain->renderPass;
-    pipelineConfig.pipelineLayout = *pipelineLayout;
-    CreateGraphicsPipline( pipeline, &pipelineConfig, "shaders/simple.vert.spv", "shaders/simple.frag.spv" );
+    struct Draw_Scene *scene;
+    Gpu_Instance *instances;
+    u32 firstVisible;
+    u32 visibleCount;
+};
+
+struct Record_Job
+{
+    Frame_Command_Pools *pools;
+    Frame_Commands *frame;
+    struct Draw_Scene *scene;
+    VkRenderPass renderPass;
+    VkFramebuffer framebuffer;
+    VkExtent2D extent;
+    VkQueryPipelineStatisticFlags inheritedStatistics;
+    u32 instanceBufferIndex;
+    VkDrawIndexedIndirectCommand *draws;
+    u32 drawCount;
+    VkCommandBuffer commandBuffer;
+};
+
+// Everything the frame draws, all draws index into the one mesh for now
+struct Draw_Scene
+{
+    Pipeline *pipeline;
+    VkPipelineLayout pipelineLayout;
+    // what the shaders declare, Scene_Push_Constants may be padded past it
+    u32 pushConstantSize;
+    // the state the pipeline leaves dynamic is set from here after every bind
+    Pipeline_Manager *pipelines;
+    Pipeline_Config_Info *pipelineConfig;
+    Mesh *mesh;
+    Gpu_Scene *gpuScene;
+    // culls on the async compute queue when set, the graphics submit waits for computeWaitValue on its timeline.
+    // Otherwise culling is a pass of the render graph
+    Async_Compute *asyncCompute;
+    // 0 when the frame culled on the graphics queue instead
+    u64 computeWaitValue;
+    Bindless_Set *bindless;
+    float32 viewProjection[ 16 ];
+    float32 time;
+
+    // this frame's Frame_Constants, FRAME_RING_INVALID_OFFSET when the ring was full and nothing is drawn
+    Frame_Ring *frameRing;
+    u32 frameConstantsOffset;
+
+    Texture_Streamer *textureStreamer;
+    u32 materialTextures[ SCENE_MATERIAL_COUNT ];
+    bool textureFeedback;
+
+    // GPU driven frames cull in a compute pass and draw everything with one indirect call,
+    // otherwise the culler picks the visible objects and their draws are recorded on the worker threads
+    bool gpuDriven;
+    Cpu_Culler *culler;
+    Gpu_Object *objects;
+    Instance_Buffers *instanceBuffers;
+
+    // instanced frames merge visible objects that share a draw, otherwise every object is its own draw
+    bool instanced;
+    std::vector< VkDrawIndexedIndirectCommand > batches;
+    std::vector< Instance_Fill_Job > fillJobs;
+    u32 batchCount;
+    u32 drawnObjectCount;
+
+    Render_Graph *graph;
+    u32 backbuffer;
+    u32 mainPass;
+    // the cull outputs, swapped for the frame's own buffers every frame
+    u32 drawsResource;
+    u32 drawCountResource;
+    u32 instancesResource;
+    // the main pass executes whatever the record jobs of this frame produced
+    Job_System *jobs;
+    Record_Job recordJobs[ MAX_RECORD_JOBS ];
+    u32 recordJobCount;
+    Job_Counter recordCounter;
+};
+
+void BindSceneState( Draw_Scene *scene, VkCommandBuffer commandBuffer, VkExtent2D extent, u32 instanceBufferIndex )
+{
+    BindPipeline( scene->pipeline, commandBuffer );
+    SetPipelineDynamicState( scene->pipelines, commandBuffer, scene->pipelineConfig );
+    SetViewportAndScissor( commandBuffer, extent );
+    BindMesh( scene->mesh, commandBuffer );
+    BindBindlessSet( scene->bindless, commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->pipelineLayout );
+    BindFrameRing( scene->frameRing, commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->pipelineLayout, SCENE_SET_FRAME,
+                   scene->frameConstantsOffset );
+
+    Scene_Push_Constants pushConstants = {};
+    pushConstants.mesh = GetMeshPushConstants( scene->mesh );
+    pushConstants.instanceBufferIndex = instanceBufferIndex;
+    vkCmdPushConstants( commandBuffer, scene->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, scene->pushConstantSize,
+                        &pushConstants );
+}
+
+void FillInstances( void *data, u32 workerIndex )
+{
+    TRACE_FUNCTION();
+    Instance_Fill_Job *job = ( Instance_Fill_Job * ) data;
+    u32 *visible = job->scene->culler->visible;
+    for ( u32 i = job->firstVisible; i < job->firstVisible + job->visibleCount; ++i )
+    {
+        Gpu_Object *object = &job->scene->objects[ visible[ i ] ];
+        SetInstance( &job->instances[ i ], object->transform, object->materialIndex );
+    }
+}
+
+// Instance i belongs to the i-th visible object, so a batch is a run of visible objects with the same draw
+u32 BuildInstanceBatches( Draw_Scene *scene, u32 visibleCount )
+{
+    TRACE_FUNCTION();
+    u32 *visible = scene->culler->visible;
+    u32 batchCount = 0;
+    for ( u32 i = 0; i < visibleCount; ++i )
+    {
+        Gpu_Object *object = &scene->objects[ visible[ i ] ];
+        if ( scene->instanced && batchCount > 0 )
+        {
+            VkDrawIndexedIndirectCommand *batch = &scene->batches[ batchCount - 1 ];
+            if ( batch->indexCount == object->indexCount && batch->firstIndex == object->firstIndex &&
+                 batch->vertexOffset == object->vertexOffset )
+            {
+                batch->instanceCount++;
+                continue;
+            }
+        }
+        scene->batches[ batchCount++ ] = { object->indexCount, 1, object->firstIndex, object->vertexOffset, i };
+    }
+    return batchCount;
 }
 
-void CreateCommandBuffers( std::vector< VkCommandBuffer > &commandBuffers, Device *device, Swap_Chain *swapChain, Pipeline *pipeline )
+void RecordSecondaryCommands( void *data, u32 workerIndex )
 {
-    commandBuffers.resize( swapChain->swapChainImages.size() );
+    TRACE_FUNCTION();
+    Record_Job *job = ( Record_Job * ) data;
+    VkCommandBuffer commandBuffer = AcquireSecondaryCommandBuffer( job->pools, job->frame, workerIndex );
+    job->commandBuffer = commandBuffer;
+    if ( commandBuffer == VK_NULL_HANDLE )
+    {
+        return;
+    }
 
-    VkCommandBufferAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = device->commandPool;
-    allocInfo.commandBufferCount = ( u32 ) commandBuffers.size();
+    VkCommandBufferInheritanceInfo inheritanceInfo = {};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = job->renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = job->framebuffer;
+    inheritanceInfo.pipelineStatistics = job->inheritedStatistics;
 
-    if ( vkAllocateCommandBuffers( device->device, &allocInfo, commandBuffers.data() ) != VK_SUCCESS )
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    if ( vkBeginCommandBuffer( commandBuffer, &beginInfo ) != VK_SUCCESS )
     {
-        printf( "Failed to allocate command buffers!\n" );
+        printf( "Failed to begin recording secondary command buffer!\n" );
+        job->commandBuffer = VK_NULL_HANDLE;
         return;
     }
 
-    for ( u32 i = 0; i < commandBuffers.size(); ++i )
+    BindSceneState( job->scene, commandBuffer, job->extent, job->instanceBufferIndex );
+
+    for ( u32 i = 0; i < job->drawCount; ++i )
     {
-        VkCommandBufferBeginInfo beginInfo = {};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        VkDrawIndexedIndirectCommand *draw = &job->draws[ i ];
+        vkCmdDrawIndexed( commandBuffer, draw->indexCount, draw->instanceCount, draw->firstIndex, draw->vertexOffset,
+                          draw->firstInstance );
+    }
+
+    if ( vkEndCommandBuffer( commandBuffer ) != VK_SUCCESS )
+    {
+        printf( "Failed to record secondary command buffer!\n" );
+        job->commandBuffer = VK_NULL_HANDLE;
+    }
+}
 
-        if ( vkBeginCommandBuffer( commandBuffers[ i ], &beginInfo ) != VK_SUCCESS )
+void RecordCullPass( Render_Graph_Context *context, void *data )
+{
+    Draw_Scene *scene = ( Draw_Scene * ) data;
+    RecordGpuCulling( scene->gpuScene, context->commandBuffer, context->frameIndex, scene->viewProjection );
+}
+
+void RecordMainPass( Render_Graph_Context *context, void *data )
+{
+    Draw_Scene *scene = ( Draw_Scene * ) data;
+    if ( scene->gpuDriven )
+    {
+        if ( scene->frameConstantsOffset == FRAME_RING_INVALID_OFFSET )
         {
-            printf( "Failed to begin recording command buffer!\n" );
             return;
         }
+        Gpu_Scene *gpuScene = scene->gpuScene;
+        BindSceneState( scene, context->commandBuffer, context->extent, gpuScene->frames[ context->frameIndex ].instanceBindlessIndex );
+        RecordGpuSceneDraws( gpuScene, context->commandBuffer, context->frameIndex );
+        return;
+    }
+
+    WaitForCounter( scene->jobs, &scene->recordCounter );
+
+    VkCommandBuffer secondaryBuffers[ MAX_RECORD_JOBS ];
+    u32 secondaryCount = 0;
+    for ( u32 i = 0; i < scene->recordJobCount; ++i )
+    {
+        if ( scene->recordJobs[ i ].commandBuffer != VK_NULL_HANDLE )
+        {
+            secondaryBuffers[ secondaryCount++ ] = scene->recordJobs[ i ].commandBuffer;
+        }
+    }
+
+    if ( secondaryCount > 0 )
+    {
+        vkCmdExecuteCommands( context->commandBuffer, secondaryCount, secondaryBuffers );
+    }
+}
+
+// The cull pass only survives when the main pass reads what it writes, CPU driven frames drop it. With async compute
+// there is no cull pass, the semaphore the graphics submit waits on orders the draws after it
+bool BuildSceneRenderGraph( Render_Graph *graph, Swap_Chain *swapChain, Draw_Scene *scene )
+{
+    // PRESENT_SRC needs the swapchain extension, which headless devices don't enable
+    VkImageLayout finalLayout = swapChain->offscreen ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    scene->backbuffer = ImportRenderGraphImage( graph, "backbuffer", swapChain->swapChainImageFormat, finalLayout );
+    u32 depth = AddRenderGraphImage( graph, "depth", FindDepthFormat( swapChain ), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT );
+
+    Gpu_Scene *gpuScene = scene->gpuScene;
+    bool graphCulling = scene->gpuDriven && !scene->asyncCompute;
+    u32 draws = ImportRenderGraphBuffer( graph, "draws", gpuScene->frames[ 0 ].drawBuffer );
+    u32 drawCount = ImportRenderGraphBuffer( graph, "draw_count", gpuScene->frames[ 0 ].countBuffer );
+    u32 instances = ImportRenderGraphBuffer( graph, "instances", gpuScene->frames[ 0 ].instanceBuffer );
+    scene->drawsResource = draws;
+    scene->drawCountResource = drawCount;
+    scene->instancesResource = instances;
+
+    if ( graphCulling )
+    {
+        u32 cullPass = AddRenderGraphPass( graph, "cull", false, RecordCullPass, scene );
+        UseRenderGraphResource( graph, cullPass, drawCount, RENDER_GRAPH_TRANSFER_WRITE );
+        UseRenderGraphResource( graph, cullPass, drawCount, RENDER_GRAPH_STORAGE_WRITE );
+        UseRenderGraphResource( graph, cullPass, draws, RENDER_GRAPH_STORAGE_WRITE );
+        UseRenderGraphResource( graph, cullPass, instances, RENDER_GRAPH_STORAGE_WRITE );
+    }
+
+    scene->mainPass = AddRenderGraphPass( graph, "main_pass", true, RecordMainPass, scene );
+    Render_Graph_Pass *mainPass = &graph->passes[ scene->mainPass ];
+    mainPass->pipelineStatistics = true;
+    mainPass->contents = scene->gpuDriven ? VK_SUBPASS_CONTENTS_INLINE : VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS;
+    UseRenderGraphResource( graph, scene->mainPass, scene->backbuffer, RENDER_GRAPH_COLOR_ATTACHMENT );
+    UseRenderGraphResource( graph, scene->mainPass, depth, RENDER_GRAPH_DEPTH_ATTACHMENT );
+
+    VkClearValue clearColor = {};
+    clearColor.color = { 0.3f, 0.0f, 0.3f, 1.0f };
+    VkClearValue clearDepth = {};
+    clearDepth.depthStencil = { 1.0f, 0 };
+    ClearRenderGraphAttachment( graph, scene->mainPass, scene->backbuffer, clearColor );
+    ClearRenderGraphAttachment( graph, scene->mainPass, depth, clearDepth );
+
+    if ( graphCulling )
+    {
+        UseRenderGraphResource( graph, scene->mainPass, draws, RENDER_GRAPH_INDIRECT_READ );
+        if ( gpuScene->indirectCount )
+        {
+            UseRenderGraphResource( graph, scene->mainPass, drawCount, RENDER_GRAPH_INDIRECT_READ );
+        }
+        UseRenderGraphResource( graph, scene->mainPass, instances, RENDER_GRAPH_STORAGE_READ );
+    }
+
+    return CompileRenderGraph( graph, swapChain->swapChainExtent );
+}
+
+VkCommandBuffer RecordFrame( Frame_Command_Pools *pools, Job_System *jobs, Gpu_Profiler *profiler, Swap_Chain *swapChain,
+                             Draw_Scene *scene, u32 imageIndex )
+{
+    TRACE_FUNCTION();
+    Frame_Commands *frame = BeginFrameCommands( pools, ( u32 ) swapChain->currentFrame );
+    VkCommandBuffer commandBuffer = frame->primaryBuffer;
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-        VkRenderPassBeginInfo renderPassInfo = {};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = swapChain->renderPass;
-        renderPassInfo.framebuffer = swapChain->swapChainFramebuffers[ i ];
-        renderPassInfo.renderArea.offset = { 0, 0 };
-        renderPassInfo.renderArea.extent = swapChain->swapChainExtent;
+    if ( vkBeginCommandBuffer( commandBuffer, &beginInfo ) != VK_SUCCESS )
+    {
+        printf( "Failed to begin recording command buffer!\n" );
+        return VK_NULL_HANDLE;
+    }
+
+    BeginGpuProfilerFrame( profiler, commandBuffer, ( u32 ) swapChain->currentFrame );
 
-        VkClearValue clearValues[ 2 ] = {};
-        clearValues[ 0 ].color = { 0.3f, 0.0f, 0.3f, 1.0f };
-        clearValues[ 1 ].depthStencil = { 1.0f, 0 };
-        renderPassInfo.clearValueCount = 2;
-        renderPassInfo.pClearValues = clearValues;
+    // the frame's fence was waited on, so the draws that read this slot's cull outputs last time are done
+    Async_Compute *asyncCompute = scene->asyncCompute;
+    scene->computeWaitValue = 0;
+    if ( asyncCompute )
+    {
+        VkCommandBuffer computeBuffer = BeginAsyncCompute( asyncCompute, ( u32 ) swapChain->currentFrame );
+        if ( computeBuffer != VK_NULL_HANDLE )
+        {
+            RecordGpuCulling( scene->gpuScene, computeBuffer, ( u32 ) swapChain->currentFrame, scene->viewProjection );
+            scene->computeWaitValue = SubmitAsyncCompute( asyncCompute );
+        }
+
+        if ( scene->computeWaitValue != 0 )
+        {
+            BeginAsyncComputeOverlap( asyncCompute, commandBuffer, ( u32 ) swapChain->currentFrame );
+        }
+        else
+        {
+            // the image is acquired and the primary has begun, so the frame has to be submitted anyway.
+            // Culling on the graphics queue keeps it complete, the graph has no cull pass to order it
+            printf( "Async compute failed, culling on the graphics queue this frame\n" );
+            RecordGpuCulling( scene->gpuScene, commandBuffer, ( u32 ) swapChain->currentFrame, scene->viewProjection );
 
-        vkCmdBeginRenderPass( commandBuffers[ i ], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE );
+            VkMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                  VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &barrier, 0, 0,
+                                  0, 0 );
+        }
+    }
 
-        BindPipeline( pipeline, commandBuffers[ i ] );
-        vkCmdDraw( commandBuffers[ i ], 3, 1, 0, 0 );
+    // the frame's fence was waited on when its image was acquired
+    BeginFrameRing( scene->frameRing, ( u32 ) swapChain->currentFrame );
+    Frame_Constants frameConstants = {};
+    memcpy( frameConstants.viewProjection, scene->viewProjection, sizeof( frameConstants.viewProjection ) );
+    frameConstants.time = scene->time;
+    frameConstants.frameNumber = ( u32 ) swapChain->frameNumber;
 
-        vkCmdEndRenderPass( commandBuffers[ i ] );
-        if ( vkEndCommandBuffer( commandBuffers[ i ] ) != VK_SUCCESS )
+    // streaming reads the feedback this frame slot wrote last time around, so it also waits for the fence
+    Texture_Streamer *streamer = scene->textureStreamer;
+    UpdateTextureStreamer( streamer, ( u32 ) swapChain->currentFrame, swapChain->frameNumber, swapChain->framesInFlight );
+    frameConstants.textureFeedbackIndex = scene->textureFeedback ? GetTextureFeedbackIndex( streamer, ( u32 ) swapChain->currentFrame )
+                                                                 : BINDLESS_INVALID_INDEX;
+    frameConstants.samplerIndex = streamer->samplerIndex;
+    for ( u32 i = 0; i < SCENE_MATERIAL_COUNT; ++i )
+    {
+        Gpu_Material *material = &frameConstants.materials[ i ];
+        u32 texture = scene->materialTextures[ i ];
+        material->textureIndex = GetTextureBindlessIndex( streamer, texture );
+        material->streamedTexture = texture;
+        if ( material->textureIndex != BINDLESS_INVALID_INDEX )
         {
-            printf( "Failed to record command buffer!\n" );
-            return;
+            material->width = streamer->textures[ texture ].ktx.width;
+            material->height = streamer->textures[ texture ].ktx.height;
+        }
+    }
+    scene->frameConstantsOffset = PushFrameRing( scene->frameRing, &frameConstants, sizeof( frameConstants ) );
+    // binding offset 0 would read whatever another frame left there, so the pass stays empty instead.
+    // The ring's stats count these frames
+    bool drawScene = scene->frameConstantsOffset != FRAME_RING_INVALID_OFFSET;
+
+    Render_Graph *graph = scene->graph;
+    SetRenderGraphImage( graph, scene->backbuffer, swapChain->swapChainImages[ imageIndex ],
+                         swapChain->swapChainImageViews[ imageIndex ] );
+    Gpu_Scene_Frame *gpuFrame = &scene->gpuScene->frames[ swapChain->currentFrame ];
+    SetRenderGraphBuffer( graph, scene->drawsResource, gpuFrame->drawBuffer );
+    SetRenderGraphBuffer( graph, scene->drawCountResource, gpuFrame->countBuffer );
+    SetRenderGraphBuffer( graph, scene->instancesResource, gpuFrame->instanceBuffer );
+    BeginRenderGraphFrame( graph, ( u32 ) swapChain->currentFrame, swapChain->frameNumber );
+
+    u32 drawCount = 0;
+    u32 instanceBufferIndex = gpuFrame->instanceBindlessIndex;
+    if ( !scene->gpuDriven && drawScene )
+    {
+        float32 frustumPlanes[ 6 ][ 4 ];
+        ExtractFrustumPlanes( scene->viewProjection, frustumPlanes );
+        u32 visibleCount = CullObjects( scene->culler, jobs, frustumPlanes );
+
+        // the fence of this frame slot has been waited on, so its instance buffer is free to overwrite
+        Instance_Frame *instanceFrame = &scene->instanceBuffers->frames[ swapChain->currentFrame ];
+        instanceBufferIndex = instanceFrame->bindlessIndex;
+
+        Job_Counter fillCounter = {};
+        u32 fillJobCount = ( visibleCount + INSTANCES_PER_FILL_JOB - 1 ) / INSTANCES_PER_FILL_JOB;
+        for ( u32 i = 0; i < fillJobCount; ++i )
+        {
+            Instance_Fill_Job *job = &scene->fillJobs[ i ];
+            job->scene = scene;
+            job->instances = instanceFrame->instances;
+            job->firstVisible = i * INSTANCES_PER_FILL_JOB;
+            job->visibleCount = visibleCount - job->firstVisible;
+            if ( job->visibleCount > INSTANCES_PER_FILL_JOB ) job->visibleCount = INSTANCES_PER_FILL_JOB;
+            SubmitJob( jobs, FillInstances, job, &fillCounter );
         }
+
+        drawCount = BuildInstanceBatches( scene, visibleCount );
+        scene->batchCount = drawCount;
+        scene->drawnObjectCount = visibleCount;
+        WaitForCounter( jobs, &fillCounter );
+    }
+
+    // split the draws into contiguous ranges so the secondaries execute in submission order
+    u32 jobCount = ( drawCount + MIN_DRAWS_PER_RECORD_JOB - 1 ) / MIN_DRAWS_PER_RECORD_JOB;
+    u32 workerCount = GetJobWorkerCount( jobs );
+    if ( jobCount > workerCount ) jobCount = workerCount;
+    if ( jobCount > MAX_RECORD_JOBS ) jobCount = MAX_RECORD_JOBS;
+    if ( jobCount == 0 && !scene->gpuDriven && drawScene ) jobCount = 1;
+
+    scene->recordJobCount = jobCount;
+    u32 drawsPerJob = jobCount ? ( drawCount + jobCount - 1 ) / jobCount : 0;
+    for ( u32 i = 0; i < jobCount; ++i )
+    {
+        u32 firstDraw = i * drawsPerJob;
+        if ( firstDraw > drawCount ) firstDraw = drawCount;
+        u32 lastDraw = firstDraw + drawsPerJob;
+        if ( lastDraw > drawCount ) lastDraw = drawCount;
+
+        Record_Job *job = &scene->recordJobs[ i ];
+        job->pools = pools;
+        job->frame = frame;
+        job->scene = scene;
+        job->renderPass = GetRenderGraphRenderPass( graph, scene->mainPass );
+        job->framebuffer = GetRenderGraphFramebuffer( graph, scene->mainPass );
+        job->extent = swapChain->swapChainExtent;
+        job->inheritedStatistics = GetGpuProfilerInheritedStatistics( profiler );
+        job->instanceBufferIndex = instanceBufferIndex;
+        job->draws = scene->batches.data() + firstDraw;
+        job->drawCount = lastDraw - firstDraw;
+        job->commandBuffer = VK_NULL_HANDLE;
+        SubmitJob( jobs, RecordSecondaryCommands, job, &scene->recordCounter );
+    }
+
+    u32 frameZone = BeginGpuZone( profiler, commandBuffer, "frame" );
+    ExecuteRenderGraph( graph, commandBuffer );
+    EndGpuZone( profiler, commandBuffer, frameZone );
+
+    if ( scene->textureFeedback )
+    {
+        RecordTextureFeedbackBarrier( streamer, commandBuffer, ( u32 ) swapChain->currentFrame );
+    }
+
+    if ( asyncCompute && scene->computeWaitValue != 0 )
+    {
+        EndAsyncComputeOverlap( asyncCompute, commandBuffer, ( u32 ) swapChain->currentFrame );
+    }
+
+    if ( vkEndCommandBuffer( commandBuffer ) != VK_SUCCESS )
+    {
+        printf( "Failed to record command buffer!\n" );
+        return VK_NULL_HANDLE;
+    }
+
+    return commandBuffer;
+}
+
+// headless runs have no window, their images keep the extent they were created with
+static void RecreateFrameSwapChain( Window *window, Swap_Chain *swapChain )
+{
+    VkExtent2D extent = window ? GetWindowExtent( window ) : swapChain->swapChainExtent;
+    if ( !RecreateSwapChain( swapChain, extent ) )
+    {
+        printf( "Failed to recreate swap chain!\n" );
+    }
+    if ( window )
+    {
+        window->framebufferResized = false;
     }
 }
 
-void DrawFrame( Swap_Chain *swapChain, std::vector< VkCommandBuffer > &commandBuffers )
+// window is null when rendering headless
+void DrawFrame( Window *window, Swap_Chain *swapChain, Frame_Command_Pools *pools, Job_System *jobs,
+                Gpu_Profiler *profiler, Draw_Scene *scene )
 {
+    TRACE_FUNCTION();
+
+    // before the acquire, a frame that can't be recorded is skipped without an image to give back
+    if ( !UpdateRenderGraphTargets( scene->graph, swapChain->swapChainExtent, swapChain->recreateCount, swapChain->frameNumber ) )
+    {
+        printf( "Failed to recreate the render graph targets!\n" );
+        return;
+    }
+
     u32 imageIndex;
     auto result = AcquireNextImage( swapChain, &imageIndex );
 
+    if ( result == VK_ERROR_OUT_OF_DATE_KHR )
+    {
+        RecreateFrameSwapChain( window, swapChain );
+        return;
+    }
+
     if ( result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR )
     {
         printf( "Failed to acquire swap chain image!\n" );
         return;
     }
 
-    result = SubmitCommandBuffers( swapChain, &commandBuffers[ imageIndex ], &imageIndex );
+    VkCommandBuffer commandBuffer = RecordFrame( pools, jobs, profiler, swapChain, scene, imageIndex );
+    if ( commandBuffer == VK_NULL_HANDLE )
+    {
+        return;
+    }
+
+    if ( scene->computeWaitValue != 0 )
+    {
+        // the cull outputs are read by the indirect draws and the vertex shader, everything before that can overlap
+        result = SubmitCommandBuffers( swapChain, &commandBuffer, &imageIndex, scene->asyncCompute->timeline, scene->computeWaitValue,
+                                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT );
+    }
+    else
+    {
+        result = SubmitCommandBuffers( swapChain, &commandBuffer, &imageIndex );
+    }
+
+    // suboptimal images were still presented, recreating afterwards keeps the frame
+    if ( result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || ( window && window->framebufferResized ) )
+    {
+        RecreateFrameSwapChain( window, swapChain );
+        return;
+    }
 
     if ( result != VK_SUCCESS )
     {
@@ -104,45 +632,483 @@ void DrawFrame( Swap_Chain *swapChain, std::vector< VkCommandBuffer > &commandBu
     }
 }
 
-int main()
+struct Texture_Load_Job
+{
+    char *path; // null generates a test pattern
+    u32 seed;
+    Asset_Data file;
+    bool loaded;
+};
+
+void LoadTextureFiles( void *data, u32 begin, u32 end, u32 workerIndex )
+{
+    TRACE_FUNCTION();
+    Texture_Load_Job *loads = ( Texture_Load_Job * ) data;
+    for ( u32 i = begin; i < end; ++i )
+    {
+        Texture_Load_Job *load = &loads[ i ];
+        if ( load->path )
+        {
+            load->loaded = LoadAsset( load->path, &load->file );
+        }
+        else
+        {
+            load->loaded = CreateTestPatternKtx2( 1024, load->seed, &load->file );
+        }
+    }
+}
+
+int main( int argc, char **argv )
 {
+    InitTracing();
+    defer { ShutdownTracing(); };
+
     int width = 1920;
     int height = 1080;
 
-    Window window;
+    // --headless renders offscreen without a window, --frames limits how many frames it renders
+    // --objects sets the scene size, --cpu-draws culls on the CPU and records one draw per visible object
+    // instead of culling on the GPU, --cull-kernel picks the CPU culling implementation
+    // --no-instancing records a draw per object on the CPU path instead of one per run of the same mesh
+    // --pack <archive> <files...> packs the files under their paths and exits, --archive loads assets from a pack
+    // --bench-jobs measures the job system's spawn overhead, steal rate and scaling, then exits
+    // --texture <ktx2> gives the next material a streamed texture, test patterns are used without any,
+    // --texture-budget sets how many MB of texture memory the streamer keeps resident,
+    // --cull-workgroup picks the GPU culling workgroup size out of 64, 128 and 256,
+    // --no-async-compute culls on the graphics queue even when the device has a compute family without graphics,
+    // --profile-out <path> writes the GPU profile to <path>.csv and <path>.json at exit,
+    // --trace-out <path> writes the CPU trace as a Chrome trace at exit
+    bool headless = false;
+    u64 frameCount = 1000;
+    Swap_Chain_Config swapChainConfig = {};
+    u32 objectCount = 4096;
+    u32 cullWorkgroupSize = GPU_CULL_WORKGROUP_SIZE;
+    bool gpuDriven = true;
+    bool asyncComputeEnabled = true;
+    Cull_Kernel cullKernel = GetBestCullKernel();
+    bool instanced = true;
+    char *profilePath = 0;
+    char *tracePath = 0;
+    char *archivePath = 0;
+    char *texturePaths[ SCENE_MATERIAL_COUNT ] = {};
+    u32 texturePathCount = 0;
+    VkDeviceSize textureBudget = ( VkDeviceSize ) 64 << 20;
+    for ( int i = 1; i < argc; ++i )
+    {
+        if ( strcmp( argv[ i ], "--headless" ) == 0 )
+        {
+            headless = true;
+        }
+        else if ( strcmp( argv[ i ], "--pack" ) == 0 && i + 1 < argc )
+        {
+            char **files = argv + i + 2;
+            return WriteArchive( argv[ i + 1 ], files, files, ( u32 ) ( argc - i - 2 ) ) ? 0 : 1;
+        }
+        else if ( strcmp( argv[ i ], "--bench-jobs" ) == 0 )
+        {
+            RunJobSystemBenchmark();
+            return 0;
+        }
+        else if ( strcmp( argv[ i ], "--archive" ) == 0 && i + 1 < argc )
+        {
+            archivePath = argv[ ++i ];
+        }
+        else if ( strcmp( argv[ i ], "--texture" ) == 0 && i + 1 < argc )
+        {
+            char *path = argv[ ++i ];
+            if ( texturePathCount < SCENE_MATERIAL_COUNT ) texturePaths[ texturePathCount++ ] = path;
+            else printf( "Only %u textures are used, ignoring %s\n", SCENE_MATERIAL_COUNT, path );
+        }
+        else if ( strcmp( argv[ i ], "--texture-budget" ) == 0 && i + 1 < argc )
+        {
+            textureBudget = ( VkDeviceSize ) strtoull( argv[ ++i ], 0, 10 ) << 20;
+        }
+        else if ( strcmp( argv[ i ], "--frames" ) == 0 && i + 1 < argc )
+        {
+            frameCount = strtoull( argv[ ++i ], 0, 10 );
+        }
+        else if ( strcmp( argv[ i ], "--frames-in-flight" ) == 0 && i + 1 < argc )
+        {
+            swapChainConfig.framesInFlight = ( u32 ) atoi( argv[ ++i ] );
+        }
+        else if ( strcmp( argv[ i ], "--images" ) == 0 && i + 1 < argc )
+        {
+            swapChainConfig.imageCount = ( u32 ) atoi( argv[ ++i ] );
+        }
+        else if ( strcmp( argv[ i ], "--present-mode" ) == 0 && i + 1 < argc )
+        {
+            char *mode = argv[ ++i ];
+            if ( strcmp( mode, "immediate" ) == 0 ) swapChainConfig.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            else if ( strcmp( mode, "mailbox" ) == 0 ) swapChainConfig.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+            else if ( strcmp( mode, "fifo" ) == 0 ) swapChainConfig.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+            else if ( strcmp( mode, "fifo_relaxed" ) == 0 ) swapChainConfig.presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+            else printf( "Unknown present mode: %s\n", mode );
+        }
+        else if ( strcmp( argv[ i ], "--low-latency" ) == 0 )
+        {
+            swapChainConfig.lowLatency = true;
+        }
+        else if ( strcmp( argv[ i ], "--objects" ) == 0 && i + 1 < argc )
+        {
+            objectCount = ( u32 ) atoi( argv[ ++i ] );
+            if ( objectCount == 0 ) objectCount = 1;
+        }
+        else if ( strcmp( argv[ i ], "--cull-workgroup" ) == 0 && i + 1 < argc )
+        {
+            cullWorkgroupSize = ( u32 ) atoi( argv[ ++i ] );
+        }
+        else if ( strcmp( argv[ i ], "--no-async-compute" ) == 0 )
+        {
+            asyncComputeEnabled = false;
+        }
+        else if ( strcmp( argv[ i ], "--cpu-draws" ) == 0 )
+        {
+            gpuDriven = false;
+        }
+        else if ( strcmp( argv[ i ], "--cull-kernel" ) == 0 && i + 1 < argc )
+        {
+            char *kernel = argv[ ++i ];
+            if ( strcmp( kernel, "scalar" ) == 0 ) cullKernel = CULL_KERNEL_SCALAR;
+            else if ( strcmp( kernel, "sse" ) == 0 ) cullKernel = CULL_KERNEL_SSE;
+            else if ( strcmp( kernel, "avx2" ) == 0 ) cullKernel = CULL_KERNEL_AVX2;
+            else printf( "Unknown cull kernel: %s\n", kernel );
+        }
+        else if ( strcmp( argv[ i ], "--no-instancing" ) == 0 )
+        {
+            instanced = false;
+        }
+        else if ( strcmp( argv[ i ], "--profile-out" ) == 0 && i + 1 < argc )
+        {
+            profilePath = argv[ ++i ];
+        }
+        else if ( strcmp( argv[ i ], "--trace-out" ) == 0 && i + 1 < argc )
+        {
+            tracePath = argv[ ++i ];
+        }
+    }
+
+    Asset_Archive archive = {};
+    if ( archivePath )
+    {
+        if ( OpenArchive( &archive, archivePath ) )
+        {
+            PrefetchArchive( &archive );
+            MountArchive( &archive );
+        }
+        else
+        {
+            printf( "Loading loose files instead of %s\n", archivePath );
+        }
+    }
+    defer
+    {
+        UnmountArchive();
+        CloseArchive( &archive );
+    };
+
+    Job_System jobs;
+    InitJobSystem( &jobs, 0 );
+    defer { DestroyJobSystem( &jobs ); };
+
+    Window window = {};
     window.width = width;
     window.height = height;
     window.windowName = "Vulkan Engine";
-    InitWindow( &window );
+    if ( !headless )
+    {
+        InitWindow( &window );
+    }
 
     Device device;
-    InitDevice( &device, &window );
+    InitDevice( &device, headless ? 0 : &window );
     defer { DestroyDevice( &device ); };
 
+    Pipeline_Manager pipelineManager;
+    InitPipelineManager( &pipelineManager, &device );
+    defer { DestroyPipelineManager( &pipelineManager ); };
+
+    Upload_Manager uploads;
+    InitUploadManager( &uploads, &device, UPLOAD_STAGING_SIZE );
+    defer { DestroyUploadManager( &uploads ); };
+
     Swap_Chain swapChain;
-    InitSwapChain( &swapChain, &device, GetWindowExtent( &window ) );
+    InitSwapChain( &swapChain, &device, GetWindowExtent( &window ), swapChainConfig );
     defer { DestroySwapChain( &swapChain ); };
 
+    Mesh_Vertex_Format vertexFormat = MESH_VERTEX_SNORM16;
+    float32 trianglePositions[] = { 0.0f, -0.5f, 0.0f, 0.5f, 0.5f, 0.0f, -0.5f, 0.5f, 0.0f };
+    float32 triangleNormals[] = { 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f };
+    u32 triangleIndices[] = { 0, 1, 2 };
+
+    Mesh_Data triangleData = {};
+    triangleData.positions = trianglePositions;
+    triangleData.normals = triangleNormals;
+    triangleData.indices = triangleIndices;
+    triangleData.vertexCount = 3;
+    triangleData.indexCount = 3;
+
+    Mesh mesh;
+    CreateMesh( &mesh, &device, &uploads, &triangleData, vertexFormat );
+    defer { DestroyMesh( &mesh ); };
+    PrintMeshStats( &mesh );
+
+    // a grid of objects that overhangs the screen so the edges get culled
+    std::vector< Gpu_Object > objects( objectCount );
+    u32 gridSize = ( u32 ) ceil( sqrt( ( float64 ) objectCount ) );
+    float32 cellSize = 2.5f / ( float32 ) gridSize;
+    for ( u32 i = 0; i < objectCount; ++i )
+    {
+        Gpu_Object *object = &objects[ i ];
+        *object = {};
+        object->transform[ 0 ] = cellSize;
+        object->transform[ 5 ] = cellSize;
+        object->transform[ 10 ] = cellSize;
+        object->transform[ 12 ] = -1.25f + ( ( float32 ) ( i % gridSize ) + 0.5f ) * cellSize;
+        object->transform[ 13 ] = -1.25f + ( ( float32 ) ( i / gridSize ) + 0.5f ) * cellSize;
+        object->transform[ 14 ] = 0.5f;
+        object->transform[ 15 ] = 1.0f;
+        memcpy( object->boundingSphere, mesh.boundingSphere, sizeof( object->boundingSphere ) );
+        object->indexCount = mesh.indexCount;
+        object->materialIndex = i % 4;
+    }
+
+    Cpu_Culler culler;
+    InitCpuCuller( &culler, objectCount );
+    defer { DestroyCpuCuller( &culler ); };
+    if ( cullKernel > GetBestCullKernel() )
+    {
+        printf( "The %s cull kernel isn't supported here\n", GetCullKernelName( cullKernel ) );
+        cullKernel = GetBestCullKernel();
+    }
+    culler.kernel = cullKernel;
+    for ( u32 i = 0; i < objectCount; ++i )
+    {
+        SetCullObject( &culler, i, objects[ i ].transform, mesh.boundingSphere, mesh.boundsMin, mesh.boundsMax );
+    }
+
+    Bindless_Set bindless;
+    if ( !InitBindlessSet( &bindless, &device ) )
+    {
+        printf( "Failed to create the bindless descriptor set!\n" );
+        return 1;
+    }
+    defer { DestroyBindlessSet( &bindless ); };
+
+    Gpu_Scene gpuScene;
+    if ( !InitGpuScene( &gpuScene, &device, &jobs, &uploads, &bindless, swapChain.framesInFlight, objects.data(), objectCount,
+                        "shaders/cull.comp.spv", cullWorkgroupSize ) )
+    {
+        printf( "Failed to create the GPU scene!\n" );
+        return 1;
+    }
+    defer { DestroyGpuScene( &gpuScene ); };
+
+    Async_Compute asyncCompute;
+    if ( !InitAsyncCompute( &asyncCompute, &device, swapChain.framesInFlight ) )
+    {
+        printf( "Failed to create the async compute queue!\n" );
+        return 1;
+    }
+    defer { DestroyAsyncCompute( &asyncCompute ); };
+
+    Instance_Buffers instanceBuffers;
+    if ( !InitInstanceBuffers( &instanceBuffers, &device, &bindless, swapChain.framesInFlight, objectCount ) )
+    {
+        printf( "Failed to create the instance buffers!\n" );
+        return 1;
+    }
+    defer { DestroyInstanceBuffers( &instanceBuffers ); };
+
+    Frame_Ring frameRing;
+    if ( !InitFrameRing( &frameRing, &device, swapChain.framesInFlight, FRAME_RING_SEGMENT_SIZE ) )
+    {
+        printf( "Failed to create the frame ring!\n" );
+        return 1;
+    }
+    defer { DestroyFrameRing( &frameRing ); };
+
+    Texture_Streamer textureStreamer;
+    if ( !InitTextureStreamer( &textureStreamer, &device, &uploads, &bindless, swapChain.framesInFlight, textureBudget ) )
+    {
+        printf( "Failed to create the texture streamer!\n" );
+        return 1;
+    }
+    defer { DestroyTextureStreamer( &textureStreamer ); };
+
+    // the files are read or generated in parallel, the streamer itself is only touched from this thread
+    Texture_Load_Job textureLoads[ SCENE_MATERIAL_COUNT ] = {};
+    for ( u32 i = 0; i < SCENE_MATERIAL_COUNT; ++i )
+    {
+        textureLoads[ i ].path = texturePathCount > 0 ? texturePaths[ i % texturePathCount ] : 0;
+        textureLoads[ i ].seed = i;
+    }
+    ParallelFor( &jobs, SCENE_MATERIAL_COUNT, 1, LoadTextureFiles, textureLoads );
+
+    u32 materialTextures[ SCENE_MATERIAL_COUNT ];
+    for ( u32 i = 0; i < SCENE_MATERIAL_COUNT; ++i )
+    {
+        materialTextures[ i ] = textureLoads[ i ].loaded ? AddStreamedTexture( &textureStreamer, &textureLoads[ i ].file )
+                                                         : TEXTURE_FEEDBACK_NONE;
+    }
+
+    Frame_Command_Pools framePools;
+    InitFrameCommandPools( &framePools, &device, swapChain.framesInFlight, GetJobWorkerCount( &jobs ) );
+    defer { DestroyFrameCommandPools( &framePools ); };
+
+    Gpu_Profiler profiler;
+    InitGpuProfiler( &profiler, &device, swapChain.framesInFlight );
+
+    Frame_Pacer pacer;
+    InitFramePacer( &pacer, swapChainConfig.lowLatency );
+    defer { DestroyGpuProfiler( &profiler ); };
+
+    Draw_Scene scene = {};
+    scene.mesh = &mesh;
+    scene.gpuScene = &gpuScene;
+    scene.bindless = &bindless;
+    scene.frameRing = &frameRing;
+    scene.textureStreamer = &textureStreamer;
+    memcpy( scene.materialTextures, materialTextures, sizeof( materialTextures ) );
+    // the shader only writes mip feedback when it can store from fragments, otherwise textures stay at their tail
+    scene.textureFeedback = device.enabledFeatures.fragmentStoresAndAtomics == VK_TRUE;
+    scene.gpuDriven = gpuDriven && IsGpuDrivenRenderingSupported( &device );
+    // a compute queue of the graphics family would only serialize behind the frame
+    scene.asyncCompute = scene.gpuDriven && asyncComputeEnabled && asyncCompute.dedicated ? &asyncCompute : 0;
+    scene.culler = &culler;
+    scene.objects = objects.data();
+    scene.instanceBuffers = &instanceBuffers;
+    scene.instanced = instanced;
+    scene.jobs = &jobs;
+    // the objects are placed in clip space directly until there is a camera
+    scene.viewProjection[ 0 ] = 1.0f;
+    scene.viewProjection[ 5 ] = 1.0f;
+    scene.viewProjection[ 10 ] = 1.0f;
+    scene.viewProjection[ 15 ] = 1.0f;
+    scene.batches.resize( objectCount );
+    scene.fillJobs.resize( ( objectCount + INSTANCES_PER_FILL_JOB - 1 ) / INSTANCES_PER_FILL_JOB );
+    printf( "Drawing %u objects %s%s%s\n", objectCount, scene.gpuDriven ? "GPU driven" : "from the CPU",
+            scene.gpuDriven || scene.instanced ? ", instanced" : "", scene.asyncCompute ? ", culled on the async compute queue" : "" );
+
+    Render_Graph graph;
+    InitRenderGraph( &graph, &device, &profiler, swapChain.framesInFlight );
+    defer { DestroyRenderGraph( &graph ); };
+    if ( !BuildSceneRenderGraph( &graph, &swapChain, &scene ) )
+    {
+        printf( "Failed to compile the render graph!\n" );
+        return 1;
+    }
+    scene.graph = &graph;
+
+    // pipelines only need a render pass with compatible attachments, the graph keeps its passes for its whole life
     Pipeline pipeline;
     VkPipelineLayout pipelineLayout;
-    CreatePipeline( &pipeline, &device, &swapChain, &pipelineLayout );
+    Shader_Variants sceneVariants;
+    Descriptor_Set_Layout_Desc *sceneSets[] = { &bindless.layoutDesc, &frameRing.layoutDesc };
+    Pipeline_Config_Info pipelineConfig = CreatePipeline( &pipeline, &pipelineManager, &jobs, &sceneVariants,
+                                                          GetRenderGraphRenderPass( &graph, scene.mainPass ), sceneSets, 2,
+                                                          &pipelineLayout, &scene.pushConstantSize, vertexFormat,
+                                                          scene.textureFeedback );
+    if ( pipelineLayout == VK_NULL_HANDLE )
+    {
+        printf( "Failed to create the scene pipeline layout!\n" );
+        return 1;
+    }
+    scene.pipeline = &pipeline;
+    scene.pipelineLayout = pipelineLayout;
+    scene.pipelines = &pipelineManager;
+    scene.pipelineConfig = &pipelineConfig;
 
-    std::vector< VkCommandBuffer > commandBuffers;
-    CreateCommandBuffers( commandBuffers, &device, &swapChain, &pipeline );
+    PrintPipelineCacheStats( &device.pipelineCache );
 
     defer
     {
         DestroyPipeline( &pipeline );
-        vkDestroyPipelineLayout( device.device, pipelineLayout, 0 );
+        DestroyShaderVariants( &sceneVariants );
     };
 
-    while ( !glfwWindowShouldClose( window.window ) )
+    // sources are relative to the engine directory, same as the glslc lines in build.bat
+    Shader_Reload shaderReload;
+    InitShaderReload( &shaderReload, &pipelineManager, &pipelineConfig, "shaders/simple.vert.spv", "shaders/simple.frag.spv",
+                      "../src/shaders/simple.vert", "../src/shaders/simple.frag" );
+    defer { DestroyShaderReload( &shaderReload ); };
+
+    // the mesh and the scene objects went through the upload queue during startup, one wait covers all of them
+    WaitForUpload( &uploads, FlushUploads( &uploads ) );
+
+    auto start = std::chrono::high_resolution_clock::now();
+    u64 frame = 0;
+    while ( headless ? frame < frameCount : !glfwWindowShouldClose( window.window ) )
     {
-        glfwPollEvents();
-        DrawFrame( &swapChain, commandBuffers );
+        WaitForInputSample( &pacer );
+
+        if ( !headless )
+        {
+            TRACE_ZONE( "glfwPollEvents" );
+            glfwPollEvents();
+
+            // nothing to render into while minimized, block until the window comes back
+            while ( IsWindowMinimized( &window ) && !glfwWindowShouldClose( window.window ) )
+            {
+                glfwWaitEvents();
+            }
+            if ( IsWindowMinimized( &window ) )
+            {
+                continue;
+            }
+        }
+        MarkInputSampled( &pacer );
+
+        if ( !headless )
+        {
+            UpdateShaderReload( &shaderReload, &pipeline, swapChain.frameNumber, swapChain.framesInFlight );
+        }
+        UpdateBindlessSet( &bindless, swapChain.frameNumber, swapChain.framesInFlight );
+        scene.time = ( float32 ) std::chrono::duration< float64 >( std::chrono::high_resolution_clock::now() - start ).count();
+
+        FlushUploads( &uploads );
+        DrawFrame( headless ? 0 : &window, &swapChain, &framePools, &jobs, &profiler, &scene );
+
+        Gpu_Zone_Stats *gpuFrame = GetGpuZoneStats( &profiler, "frame" );
+        MarkFrameSubmitted( &pacer, gpuFrame ? gpuFrame->lastMilliseconds : 0.0 );
+        CollectTraceEvents();
+        frame++;
     }
 
     vkDeviceWaitIdle( device.device );
+
+    PrintGpuProfilerStats( &profiler );
+    PrintFramePacerStats( &pacer );
+    PrintCpuCullerStats( &culler );
+    PrintBindlessStats( &bindless );
+    PrintFrameRingStats( &frameRing );
+    PrintTextureStreamingStats( &textureStreamer );
+    PrintJobSystemStats( &jobs );
+    PrintRenderGraphStats( &graph );
+    PrintPipelineManagerStats( &pipelineManager );
+    PrintShaderVariantStats( &sceneVariants, "scene" );
+    PrintShaderVariantStats( &gpuScene.cullVariants, "cull" );
+    PrintAsyncComputeStats( &asyncCompute );
+    PrintLayoutCacheStats( &device.layoutCache );
+    PrintGpuAllocatorStats( &device.allocator );
+    if ( profilePath )
+    {
+        char path[ 512 ];
+        snprintf( path, sizeof( path ), "%s.csv", profilePath );
+        DumpGpuProfilerCsv( &profiler, path );
+        snprintf( path, sizeof( path ), "%s.json", profilePath );
+        DumpGpuProfilerJson( &profiler, path );
+    }
+    if ( tracePath )
+    {
+        ExportChromeTrace( tracePath );
+    }
+
+    if ( headless )
+    {
+        float64 seconds = std::chrono::duration< float64 >( std::chrono::high_resolution_clock::now() - start ).count();
+        printf( "Rendered %llu offscreen frames in %.3f s (%.1f fps)\n", ( unsigned long long ) frame, seconds,
+                seconds > 0.0 ? ( float64 ) frame / seconds : 0.0 );
+    }
     // DestroyPipeline( &pipeline );
     // DestroyDevice( &device );
     return 0;
@@ -0,0 +1,329 @@
+#include "mesh.h"
+#include "trace.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "math.h"
+
+#define MESH_NAIVE_VERTEX_SIZE ( 6 * sizeof( float32 ) )
+
+u16 FloatToHalf( float32 value )
+{
+    u32 bits;
+    memcpy( &bits, &value, sizeof( bits ) );
+
+    u32 sign = ( bits >> 16 ) & 0x8000;
+    s32 exponent = ( s32 ) ( ( bits >> 23 ) & 0xff ) - 127 + 15;
+    u32 mantissa = bits & 0x7fffff;
+
+    if ( ( ( bits >> 23 ) & 0xff ) == 0xff )
+    {
+        return ( u16 ) ( sign | 0x7c00 | ( mantissa ? 0x200 : 0 ) );
+    }
+    if ( exponent >= 31 )
+    {
+        return ( u16 ) ( sign | 0x7c00 );
+    }
+    if ( exponent <= 0 )
+    {
+        if ( exponent < -10 )
+        {
+            return ( u16 ) sign;
+        }
+        // denormal, shift the implicit one in and round to nearest
+        mantissa |= 0x800000;
+        u32 shift = ( u32 ) ( 14 - exponent );
+        u32 half = mantissa >> shift;
+        if ( ( mantissa >> ( shift - 1 ) ) & 1 )
+        {
+            half++;
+        }
+        return ( u16 ) ( sign | half );
+    }
+
+    u32 half = sign | ( ( u32 ) exponent << 10 ) | ( mantissa >> 13 );
+    // round to nearest, a carry into the exponent is still the correct result
+    if ( mantissa & 0x1000 )
+    {
+        half++;
+    }
+    return ( u16 ) half;
+}
+
+static s16 FloatToSnorm16( float32 value )
+{
+    if ( value > 1.0f ) value = 1.0f;
+    if ( value < -1.0f ) value = -1.0f;
+    return ( s16 ) lroundf( value * 32767.0f );
+}
+
+void OctahedralEncode( float32 *normal, s16 *encoded )
+{
+    float32 x = normal[ 0 ];
+    float32 y = normal[ 1 ];
+    float32 z = normal[ 2 ];
+    float32 length = fabsf( x ) + fabsf( y ) + fabsf( z );
+    if ( length == 0.0f )
+    {
+        encoded[ 0 ] = 0;
+        encoded[ 1 ] = 0;
+        return;
+    }
+
+    x /= length;
+    y /= length;
+    if ( z < 0.0f )
+    {
+        // fold the lower hemisphere over the diagonals
+        float32 foldedX = ( 1.0f - fabsf( y ) ) * ( x >= 0.0f ? 1.0f : -1.0f );
+        float32 foldedY = ( 1.0f - fabsf( x ) ) * ( y >= 0.0f ? 1.0f : -1.0f );
+        x = foldedX;
+        y = foldedY;
+    }
+
+    encoded[ 0 ] = FloatToSnorm16( x );
+    encoded[ 1 ] = FloatToSnorm16( y );
+}
+
+u32 GetMeshVertexStride( Mesh_Vertex_Format format )
+{
+    switch ( format )
+    {
+    case MESH_VERTEX_FLOAT32: return 3 * sizeof( float32 ) + 2 * sizeof( s16 );
+    case MESH_VERTEX_FLOAT16: return 4 * sizeof( u16 ) + 2 * sizeof( s16 );
+    case MESH_VERTEX_SNORM16: return 4 * sizeof( s16 ) + 2 * sizeof( s16 );
+    }
+    return 0;
+}
+
+static VkFormat GetMeshPositionFormat( Mesh_Vertex_Format format )
+{
+    switch ( format )
+    {
+    case MESH_VERTEX_FLOAT32: return VK_FORMAT_R32G32B32_SFLOAT;
+    // three component 16-bit formats are rarely supported for vertex fetch, the fourth component is padding
+    case MESH_VERTEX_FLOAT16: return VK_FORMAT_R16G16B16A16_SFLOAT;
+    case MESH_VERTEX_SNORM16: return VK_FORMAT_R16G16B16A16_SNORM;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+void SetMeshVertexInput( Pipeline_Config_Info *configInfo, Mesh_Vertex_Format format )
+{
+    u32 stride = GetMeshVertexStride( format );
+
+    configInfo->vertexBindings[ 0 ].binding = 0;
+    configInfo->vertexBindings[ 0 ].stride = stride;
+    configInfo->vertexBindings[ 0 ].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    configInfo->vertexBindingCount = 1;
+
+    configInfo->vertexAttributes[ 0 ].location = 0;
+    configInfo->vertexAttributes[ 0 ].binding = 0;
+    configInfo->vertexAttributes[ 0 ].format = GetMeshPositionFormat( format );
+    configInfo->vertexAttributes[ 0 ].offset = 0;
+
+    configInfo->vertexAttributes[ 1 ].location = 1;
+    configInfo->vertexAttributes[ 1 ].binding = 0;
+    configInfo->vertexAttributes[ 1 ].format = VK_FORMAT_R16G16_SNORM;
+    configInfo->vertexAttributes[ 1 ].offset = stride - 2 * sizeof( s16 );
+    configInfo->vertexAttributeCount = 2;
+}
+
+static void QuantizeVertices( Mesh *mesh, Mesh_Data *data, u8 *vertices )
+{
+    float32 minimum[ 3 ] = { 0.0f, 0.0f, 0.0f };
+    float32 maximum[ 3 ] = { 0.0f, 0.0f, 0.0f };
+    for ( u32 i = 0; i < data->vertexCount; ++i )
+    {
+        for ( u32 axis = 0; axis < 3; ++axis )
+        {
+            float32 value = data->positions[ i * 3 + axis ];
+            if ( i == 0 || value < minimum[ axis ] ) minimum[ axis ] = value;
+            if ( i == 0 || value > maximum[ axis ] ) maximum[ axis ] = value;
+        }
+    }
+
+    for ( u32 axis = 0; axis < 3; ++axis )
+    {
+        mesh->positionScale[ axis ] = 1.0f;
+        mesh->positionOffset[ axis ] = 0.0f;
+        if ( mesh->format == MESH_VERTEX_SNORM16 )
+        {
+            // snorm covers [-1, 1], so the scale is half the extent of the bounds
+            float32 halfExtent = ( maximum[ axis ] - minimum[ axis ] ) * 0.5f;
+            mesh->positionScale[ axis ] = halfExtent > 0.0f ? halfExtent : 1.0f;
+            mesh->positionOffset[ axis ] = ( maximum[ axis ] + minimum[ axis ] ) * 0.5f;
+        }
+    }
+
+    float32 radiusSquared = 0.0f;
+    for ( u32 i = 0; i < data->vertexCount; ++i )
+    {
+        float32 distanceSquared = 0.0f;
+        for ( u32 axis = 0; axis < 3; ++axis )
+        {
+            float32 delta = data->positions[ i * 3 + axis ] - ( maximum[ axis ] + minimum[ axis ] ) * 0.5f;
+            distanceSquared += delta * delta;
+        }
+        if ( distanceSquared > radiusSquared ) radiusSquared = distanceSquared;
+    }
+    for ( u32 axis = 0; axis < 3; ++axis )
+    {
+        mesh->boundingSphere[ axis ] = ( maximum[ axis ] + minimum[ axis ] ) * 0.5f;
+        mesh->boundsMin[ axis ] = minimum[ axis ];
+        mesh->boundsMax[ axis ] = maximum[ axis ];
+    }
+    mesh->boundingSphere[ 3 ] = sqrtf( radiusSquared );
+
+    u32 stride = mesh->vertexStride;
+    for ( u32 i = 0; i < data->vertexCount; ++i )
+    {
+        u8 *vertex = vertices + ( VkDeviceSize ) i * stride;
+        float32 *position = &data->positions[ i * 3 ];
+
+        if ( mesh->format == MESH_VERTEX_FLOAT32 )
+        {
+            memcpy( vertex, position, 3 * sizeof( float32 ) );
+        }
+        else if ( mesh->format == MESH_VERTEX_FLOAT16 )
+        {
+            u16 half[ 4 ] = { FloatToHalf( position[ 0 ] ), FloatToHalf( position[ 1 ] ), FloatToHalf( position[ 2 ] ), 0 };
+            memcpy( vertex, half, sizeof( half ) );
+        }
+        else
+        {
+            s16 snorm[ 4 ];
+            for ( u32 axis = 0; axis < 3; ++axis )
+            {
+                snorm[ axis ] = FloatToSnorm16( ( position[ axis ] - mesh->positionOffset[ axis ] ) / mesh->positionScale[ axis ] );
+            }
+            snorm[ 3 ] = 0;
+            memcpy( vertex, snorm, sizeof( snorm ) );
+        }
+
+        s16 normal[ 2 ] = { 0, 0 };
+        if ( data->normals )
+        {
+            OctahedralEncode( &data->normals[ i * 3 ], normal );
+        }
+        memcpy( vertex + stride - sizeof( normal ), normal, sizeof( normal ) );
+    }
+}
+
+bool CreateMesh( Mesh *mesh, Device *device, Upload_Manager *uploads, Mesh_Data *data, Mesh_Vertex_Format format )
+{
+    TRACE_FUNCTION();
+    *mesh = {};
+    mesh->device = device;
+    mesh->uploads = uploads;
+    mesh->format = format;
+    mesh->vertexCount = data->vertexCount;
+    mesh->indexCount = data->indexCount;
+    mesh->vertexStride = GetMeshVertexStride( format );
+
+    if ( data->vertexCount == 0 || data->indexCount == 0 )
+    {
+        printf( "Can't create an empty mesh!\n" );
+        return false;
+    }
+
+    VkDeviceSize vertexSize = ( VkDeviceSize ) data->vertexCount * mesh->vertexStride;
+    u8 *vertices = ( u8 * ) malloc( vertexSize );
+    QuantizeVertices( mesh, data, vertices );
+    // the data is copied into the staging ring right away, so it can be freed before the upload lands
+    mesh->uploadToken = UploadDeviceLocalBuffer( uploads, vertices, vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                                 mesh->vertexBuffer, mesh->vertexAllocation );
+    free( vertices );
+
+    if ( mesh->uploadToken == 0 )
+    {
+        DestroyMesh( mesh );
+        return false;
+    }
+
+    // 0xffff stays free so primitive restart can be turned on without touching the data
+    mesh->indexType = data->vertexCount < 0xffff ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    Upload_Token indexToken;
+    if ( mesh->indexType == VK_INDEX_TYPE_UINT16 )
+    {
+        u16 *indices = ( u16 * ) malloc( data->indexCount * sizeof( u16 ) );
+        for ( u32 i = 0; i < data->indexCount; ++i )
+        {
+            indices[ i ] = ( u16 ) data->indices[ i ];
+        }
+        indexToken = UploadDeviceLocalBuffer( uploads, indices, data->indexCount * sizeof( u16 ), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                              mesh->indexBuffer, mesh->indexAllocation );
+        free( indices );
+    }
+    else
+    {
+        indexToken = UploadDeviceLocalBuffer( uploads, data->indices, data->indexCount * sizeof( u32 ), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                              mesh->indexBuffer, mesh->indexAllocation );
+    }
+
+    if ( indexToken == 0 )
+    {
+        DestroyMesh( mesh );
+        return false;
+    }
+
+    mesh->uploadToken = indexToken;
+    return true;
+}
+
+void DestroyMesh( Mesh *mesh )
+{
+    // a mesh that failed half way may still have a copy into its vertex buffer queued
+    if ( mesh->uploadToken != 0 )
+    {
+        WaitForUpload( mesh->uploads, mesh->uploadToken );
+        mesh->uploadToken = 0;
+    }
+    if ( mesh->vertexBuffer != VK_NULL_HANDLE )
+    {
+        DestroyBuffer( mesh->device, mesh->vertexBuffer, mesh->vertexAllocation );
+        mesh->vertexBuffer = VK_NULL_HANDLE;
+    }
+    if ( mesh->indexBuffer != VK_NULL_HANDLE )
+    {
+        DestroyBuffer( mesh->device, mesh->indexBuffer, mesh->indexAllocation );
+        mesh->indexBuffer = VK_NULL_HANDLE;
+    }
+}
+
+Mesh_Push_Constants GetMeshPushConstants( Mesh *mesh )
+{
+    Mesh_Push_Constants constants = {};
+    for ( u32 axis = 0; axis < 3; ++axis )
+    {
+        constants.positionScale[ axis ] = mesh->positionScale[ axis ];
+        constants.positionOffset[ axis ] = mesh->positionOffset[ axis ];
+    }
+    return constants;
+}
+
+void BindMesh( Mesh *mesh, VkCommandBuffer commandBuffer )
+{
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers( commandBuffer, 0, 1, &mesh->vertexBuffer, &offset );
+    vkCmdBindIndexBuffer( commandBuffer, mesh->indexBuffer, 0, mesh->indexType );
+}
+
+VkDeviceSize GetMeshMemorySize( Mesh *mesh )
+{
+    VkDeviceSize indexSize = mesh->indexType == VK_INDEX_TYPE_UINT16 ? sizeof( u16 ) : sizeof( u32 );
+    return ( VkDeviceSize ) mesh->vertexCount * mesh->vertexStride + ( VkDeviceSize ) mesh->indexCount * indexSize;
+}
+
+void PrintMeshStats( Mesh *mesh )
+{
+    static char *formatNames[] = { "float32", "float16", "snorm16" };
+    VkDeviceSize naiveSize = ( VkDeviceSize ) mesh->vertexCount * MESH_NAIVE_VERTEX_SIZE +
+                             ( VkDeviceSize ) mesh->indexCount * sizeof( u32 );
+    VkDeviceSize size = GetMeshMemorySize( mesh );
+
+    printf( "Mesh: %u vertices (%s, %u bytes each), %u indices (%s), %llu bytes vs %llu float32 (%.1f%%)\n",
+            mesh->vertexCount, formatNames[ mesh->format ], mesh->vertexStride, mesh->indexCount,
+            mesh->indexType == VK_INDEX_TYPE_UINT16 ? "u16" : "u32", ( unsigned long long ) size,
+            ( unsigned long long ) naiveSize, naiveSize ? 100.0 * ( float64 ) size / ( float64 ) naiveSize : 0.0 );
+}
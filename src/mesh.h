@@ -0,0 +1,77 @@
+#pragma once
+
+#include "device.h"
+#include "pipeline.h"
+#include "upload.h"
+#include "utils/utils.h"
+
+// Normals are always stored octahedral encoded as two snorm16, only the position encoding changes
+enum Mesh_Vertex_Format
+{
+    MESH_VERTEX_FLOAT32, // float32x3 position, 16 byte vertex
+    MESH_VERTEX_FLOAT16, // float16x4 position, 12 byte vertex
+    MESH_VERTEX_SNORM16, // snorm16x4 position relative to the mesh bounds, 12 byte vertex
+};
+
+// Full precision input, CreateMesh quantizes it into the requested format
+struct Mesh_Data
+{
+    float32 *positions; // xyz per vertex
+    float32 *normals;   // xyz per vertex, may be null
+    u32 *indices;
+    u32 vertexCount;
+    u32 indexCount;
+};
+
+// Matches the push constant block in simple.vert, position = stored * scale + offset
+struct Mesh_Push_Constants
+{
+    float32 positionScale[ 4 ];
+    float32 positionOffset[ 4 ];
+};
+
+struct Mesh
+{
+    Device *device;
+    Mesh_Vertex_Format format;
+    // the buffers are filled on the upload queue, nothing may draw with them before this completes
+    Upload_Manager *uploads;
+    Upload_Token uploadToken;
+
+    VkBuffer vertexBuffer;
+    Gpu_Allocation vertexAllocation;
+    VkBuffer indexBuffer;
+    Gpu_Allocation indexAllocation;
+
+    u32 vertexCount;
+    u32 indexCount;
+    u32 vertexStride;
+    VkIndexType indexType;
+
+    float32 positionScale[ 3 ];
+    float32 positionOffset[ 3 ];
+    // object space bounds, what culling tests against
+    float32 boundingSphere[ 4 ];
+    float32 boundsMin[ 3 ];
+    float32 boundsMax[ 3 ];
+};
+
+bool CreateMesh( Mesh *mesh, Device *device, Upload_Manager *uploads, Mesh_Data *data, Mesh_Vertex_Format format );
+void DestroyMesh( Mesh *mesh );
+
+u32 GetMeshVertexStride( Mesh_Vertex_Format format );
+
+// Fills the vertex input state of the config so the pipeline matches meshes of this format
+void SetMeshVertexInput( Pipeline_Config_Info *configInfo, Mesh_Vertex_Format format );
+
+Mesh_Push_Constants GetMeshPushConstants( Mesh *mesh );
+
+void BindMesh( Mesh *mesh, VkCommandBuffer commandBuffer );
+
+VkDeviceSize GetMeshMemorySize( Mesh *mesh );
+
+// Compares against float32 interleaved position + normal with 32-bit indices
+void PrintMeshStats( Mesh *mesh );
+
+u16 FloatToHalf( float32 value );
+void OctahedralEncode( float32 *normal, s16 *encoded );
@@ -1,135 +1,311 @@
 #include "stdio.h"
 #include "stdlib.h"
 #include "pipeline.h"
+#include "trace.h"
+#include <chrono> //@TODO: Remove std garbage
+#include <vector>
 
-static Read_File_Result ReadFile( char *path )
+bool CreateGraphicsPipline( Pipeline *pipeline, Pipeline_Config_Info *configInfo,
+                            char *vertexShaderPath, char *fragmentShaderPath )
 {
-    FILE *file;
-    errno_t error = fopen_s( &file, path, "rb" );
+    TRACE_FUNCTION();
+    Assert( configInfo->pipelineLayout != VK_NULL_HANDLE );
+    Assert( configInfo->renderPass != VK_NULL_HANDLE );
+
+    Asset_Data vertexShader;
+    Asset_Data fragmentShader;
+    LoadAsset( vertexShaderPath, &vertexShader );
+    LoadAsset( fragmentShaderPath, &fragmentShader );
+
+    pipeline->vertexShaderModule = VK_NULL_HANDLE;
+    pipeline->fragmentShaderModule = VK_NULL_HANDLE;
+    pipeline->graphicsPipeline = VK_NULL_HANDLE;
+    pipeline->managed = false;
+
+    bool modulesCreated = CreateShaderModule( pipeline->device->device, vertexShader, &pipeline->vertexShaderModule ) &&
+                          CreateShaderModule( pipeline->device->device, fragmentShader, &pipeline->fragmentShaderModule );
+    FreeAsset( &vertexShader );
+    FreeAsset( &fragmentShader );
 
-    if ( error )
+    if ( !modulesCreated )
     {
-        printf( "Could not read file: %s\n", path );
-        return {};
+        DestroyPipeline( pipeline );
+        return false;
     }
 
-    fseek( file, 0, SEEK_END );
-    long size = ftell( file );
-    fseek( file, 0, SEEK_SET );
+    pipeline->graphicsPipeline = CreateGraphicsPipelineWithModules( pipeline->device, configInfo, pipeline->vertexShaderModule,
+                                                                    pipeline->fragmentShaderModule );
+    if ( pipeline->graphicsPipeline == VK_NULL_HANDLE )
+    {
+        DestroyPipeline( pipeline );
+        return false;
+    }
+    return true;
+}
 
-    u32 *content = ( u32 * ) malloc( size );
-    fread( content, size, 1, file );
-    fclose( file );
+bool SetSpecializationConstant( Specialization_Constants *constants, u32 id, u32 value )
+{
+    for ( u32 i = 0; i < constants->count; ++i )
+    {
+        if ( constants->ids[ i ] == id )
+        {
+            constants->values[ i ] = value;
+            return true;
+        }
+    }
+    if ( constants->count == PIPELINE_MAX_SPECIALIZATION_CONSTANTS )
+    {
+        printf( "More than %u specialization constants!\n", PIPELINE_MAX_SPECIALIZATION_CONSTANTS );
+        return false;
+    }
+    constants->ids[ constants->count ] = id;
+    constants->values[ constants->count ] = value;
+    constants->count++;
+    return true;
+}
 
-    Read_File_Result result;
-    result.size = size;
-    result.content = content;
+VkSpecializationInfo *FillSpecializationInfo( Specialization_Constants *constants, VkSpecializationMapEntry *entries,
+                                              VkSpecializationInfo *info )
+{
+    if ( constants->count == 0 )
+    {
+        return 0;
+    }
 
-    return result;
+    for ( u32 i = 0; i < constants->count; ++i )
+    {
+        entries[ i ].constantID = constants->ids[ i ];
+        entries[ i ].offset = i * sizeof( u32 );
+        entries[ i ].size = sizeof( u32 );
+    }
+    info->mapEntryCount = constants->count;
+    info->pMapEntries = entries;
+    info->dataSize = constants->count * sizeof( u32 );
+    info->pData = constants->values;
+    return info;
 }
 
-void CreateGraphicsPipline( Pipeline *pipeline, Pipeline_Config_Info *configInfo,
-                            char *vertexShaderPath, char *fragmentShaderPath )
+void FillGraphicsPipelineCreateState( Graphics_Pipeline_Create_State *state, Pipeline_Config_Info *configInfo,
+                                      VkShaderModule vertexShaderModule, VkShaderModule fragmentShaderModule )
 {
     Assert( configInfo->pipelineLayout != VK_NULL_HANDLE );
     Assert( configInfo->renderPass != VK_NULL_HANDLE );
 
-    Read_File_Result vertexShader = ReadFile( vertexShaderPath );
-    Read_File_Result fragmentShader = ReadFile( fragmentShaderPath );
+    VkSpecializationInfo *specializationInfo = FillSpecializationInfo( &configInfo->specialization, state->specializationEntries,
+                                                                       &state->specializationInfo );
 
-    CreateShaderModule( pipeline->device->device, vertexShader, &pipeline->vertexShaderModule );
-    CreateShaderModule( pipeline->device->device, fragmentShader, &pipeline->fragmentShaderModule );
-
-    VkPipelineShaderStageCreateInfo shaderStages[ 2 ];
+    VkPipelineShaderStageCreateInfo *shaderStages = state->shaderStages;
     shaderStages[ 0 ].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStages[ 0 ].stage = VK_SHADER_STAGE_VERTEX_BIT;
-    shaderStages[ 0 ].module = pipeline->vertexShaderModule;
+    shaderStages[ 0 ].module = vertexShaderModule;
     shaderStages[ 0 ].pName = "main";
     shaderStages[ 0 ].flags = 0;
     shaderStages[ 0 ].pNext = 0;
-    shaderStages[ 0 ].pSpecializationInfo = 0;
+    shaderStages[ 0 ].pSpecializationInfo = specializationInfo;
 
     shaderStages[ 1 ].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStages[ 1 ].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    shaderStages[ 1 ].module = pipeline->fragmentShaderModule;
+    shaderStages[ 1 ].module = fragmentShaderModule;
     shaderStages[ 1 ].pName = "main";
     shaderStages[ 1 ].flags = 0;
     shaderStages[ 1 ].pNext = 0;
-    shaderStages[ 1 ].pSpecializationInfo = 0;
-
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexAttributeDescriptionCount = 0;
-    vertexInputInfo.vertexBindingDescriptionCount = 0;
-    vertexInputInfo.pVertexAttributeDescriptions = 0;
-    vertexInputInfo.pVertexBindingDescriptions = 0;
-
-    VkPipelineViewportStateCreateInfo viewportInfo = {};
-    viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportInfo.viewportCount = 1;
-    viewportInfo.pViewports = &configInfo->viewport;
-    viewportInfo.scissorCount = 1;
-    viewportInfo.pScissors = &configInfo->scissor;
-
-    VkPipelineColorBlendStateCreateInfo colorBlendInfo = {};
-    colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlendInfo.logicOpEnable = VK_FALSE;
-    colorBlendInfo.logicOp = VK_LOGIC_OP_COPY; // Optional
-    colorBlendInfo.attachmentCount = 1;
-    colorBlendInfo.pAttachments = &configInfo->colorBlendAttachment;
-    colorBlendInfo.blendConstants[ 0 ] = 0.0f; // Optional
-    colorBlendInfo.blendConstants[ 1 ] = 0.0f; // Optional
-    colorBlendInfo.blendConstants[ 2 ] = 0.0f; // Optional
-    colorBlendInfo.blendConstants[ 3 ] = 0.0f; // Optional
-
-    VkGraphicsPipelineCreateInfo pipelineInfo = {};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = shaderStages;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &configInfo->inputAssemblyInfo;
-    pipelineInfo.pViewportState = &viewportInfo;
-    pipelineInfo.pRasterizationState = &configInfo->rasterizationInfo;
-    pipelineInfo.pMultisampleState = &configInfo->multisampleInfo;
-    pipelineInfo.pColorBlendState = &colorBlendInfo;
-    pipelineInfo.pDepthStencilState = &configInfo->depthStencilInfo;
-    pipelineInfo.pDynamicState = 0;
-
-    pipelineInfo.layout = configInfo->pipelineLayout;
-    pipelineInfo.renderPass = configInfo->renderPass;
-    pipelineInfo.subpass = configInfo->subpass;
+    shaderStages[ 1 ].pSpecializationInfo = specializationInfo;
 
-    pipelineInfo.basePipelineIndex = -1;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    VkPipelineVertexInputStateCreateInfo *vertexInputInfo = &state->vertexInputInfo;
+    *vertexInputInfo = {};
+    vertexInputInfo->sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo->vertexAttributeDescriptionCount = configInfo->vertexAttributeCount;
+    vertexInputInfo->vertexBindingDescriptionCount = configInfo->vertexBindingCount;
+    vertexInputInfo->pVertexAttributeDescriptions = configInfo->vertexAttributes;
+    vertexInputInfo->pVertexBindingDescriptions = configInfo->vertexBindings;
+
+    VkPipelineViewportStateCreateInfo *viewportInfo = &state->viewportInfo;
+    *viewportInfo = {};
+    viewportInfo->sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportInfo->viewportCount = 1;
+    viewportInfo->scissorCount = 1;
+
+    VkPipelineColorBlendStateCreateInfo *colorBlendInfo = &state->colorBlendInfo;
+    *colorBlendInfo = {};
+    colorBlendInfo->sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendInfo->logicOpEnable = VK_FALSE;
+    colorBlendInfo->logicOp = VK_LOGIC_OP_COPY; // Optional
+    colorBlendInfo->attachmentCount = 1;
+    colorBlendInfo->pAttachments = &configInfo->colorBlendAttachment;
+    colorBlendInfo->blendConstants[ 0 ] = 0.0f; // Optional
+    colorBlendInfo->blendConstants[ 1 ] = 0.0f; // Optional
+    colorBlendInfo->blendConstants[ 2 ] = 0.0f; // Optional
+    colorBlendInfo->blendConstants[ 3 ] = 0.0f; // Optional
+
+    VkGraphicsPipelineCreateInfo *pipelineInfo = &state->pipelineInfo;
+    *pipelineInfo = {};
+    pipelineInfo->sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo->stageCount = 2;
+    pipelineInfo->pStages = shaderStages;
+    pipelineInfo->pVertexInputState = vertexInputInfo;
+    pipelineInfo->pInputAssemblyState = &configInfo->inputAssemblyInfo;
+    pipelineInfo->pViewportState = viewportInfo;
+    pipelineInfo->pRasterizationState = &configInfo->rasterizationInfo;
+    pipelineInfo->pMultisampleState = &configInfo->multisampleInfo;
+    pipelineInfo->pColorBlendState = colorBlendInfo;
+    pipelineInfo->pDepthStencilState = &configInfo->depthStencilInfo;
+
+    VkPipelineDynamicStateCreateInfo *dynamicStateInfo = &state->dynamicStateInfo;
+    *dynamicStateInfo = {};
+    dynamicStateInfo->sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicStateInfo->dynamicStateCount = configInfo->dynamicStateCount;
+    dynamicStateInfo->pDynamicStates = configInfo->dynamicStates;
+    pipelineInfo->pDynamicState = configInfo->dynamicStateCount ? dynamicStateInfo : 0;
+
+    pipelineInfo->layout = configInfo->pipelineLayout;
+    pipelineInfo->renderPass = configInfo->renderPass;
+    pipelineInfo->subpass = configInfo->subpass;
+
+    pipelineInfo->basePipelineIndex = -1;
+    pipelineInfo->basePipelineHandle = VK_NULL_HANDLE;
+}
 
-    if ( vkCreateGraphicsPipelines( pipeline->device->device, VK_NULL_HANDLE, 1, &pipelineInfo, 0, &pipeline->graphicsPipeline ) != VK_SUCCESS )
+bool CreateGraphicsPipelines( Device *device, Graphics_Pipeline_Create_State *states, u32 count, VkPipeline *pipelines )
+{
+    TRACE_FUNCTION();
+    std::vector< VkGraphicsPipelineCreateInfo > pipelineInfos( count );
+    for ( u32 i = 0; i < count; ++i )
+    {
+        pipelineInfos[ i ] = states[ i ].pipelineInfo;
+        pipelines[ i ] = VK_NULL_HANDLE;
+    }
+
+    Pipeline_Cache *pipelineCache = &device->pipelineCache;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    VkResult result = vkCreateGraphicsPipelines( device->device, pipelineCache->cache, count, pipelineInfos.data(), 0, pipelines );
+    auto end = std::chrono::high_resolution_clock::now();
+
+    if ( result != VK_SUCCESS )
     {
         printf( "Failed to create graphics pipeline!\n" );
-        return;
     }
+
+    // the driver doesn't say how the batch's time splits, so every pipeline gets an even share
+    float64 milliseconds = std::chrono::duration< float64, std::milli >( end - start ).count() / ( float64 ) count;
+    for ( u32 i = 0; i < count; ++i )
+    {
+        if ( pipelines[ i ] != VK_NULL_HANDLE )
+        {
+            RecordPipelineCreation( pipelineCache, milliseconds );
+        }
+    }
+    return result == VK_SUCCESS;
+}
+
+VkPipeline CreateGraphicsPipelineWithModules( Device *device, Pipeline_Config_Info *configInfo, VkShaderModule vertexShaderModule,
+                                              VkShaderModule fragmentShaderModule )
+{
+    Graphics_Pipeline_Create_State state;
+    FillGraphicsPipelineCreateState( &state, configInfo, vertexShaderModule, fragmentShaderModule );
+
+    VkPipeline graphicsPipeline = VK_NULL_HANDLE;
+    CreateGraphicsPipelines( device, &state, 1, &graphicsPipeline );
+    return graphicsPipeline;
 }
 
 void DestroyPipeline( Pipeline *pipeline )
 {
+    if ( pipeline->managed )
+    {
+        return;
+    }
     vkDestroyShaderModule( pipeline->device->device, pipeline->vertexShaderModule, 0 );
     vkDestroyShaderModule( pipeline->device->device, pipeline->fragmentShaderModule, 0 );
     vkDestroyPipeline( pipeline->device->device, pipeline->graphicsPipeline, 0 );
 }
 
-void CreateShaderModule( VkDevice device, Read_File_Result shader, VkShaderModule *module )
+bool CreateComputePipeline( Compute_Pipeline *pipeline, VkPipelineLayout pipelineLayout, char *shaderPath,
+                            Specialization_Constants *specialization )
+{
+    TRACE_FUNCTION();
+    Assert( pipelineLayout != VK_NULL_HANDLE );
+
+    pipeline->computePipeline = VK_NULL_HANDLE;
+    pipeline->shaderModule = VK_NULL_HANDLE;
+
+    Asset_Data shader;
+    LoadAsset( shaderPath, &shader );
+    bool moduleCreated = CreateShaderModule( pipeline->device->device, shader, &pipeline->shaderModule );
+    FreeAsset( &shader );
+
+    if ( !moduleCreated )
+    {
+        return false;
+    }
+
+    VkSpecializationMapEntry specializationEntries[ PIPELINE_MAX_SPECIALIZATION_CONSTANTS ];
+    VkSpecializationInfo specializationInfo;
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = pipeline->shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.stage.pSpecializationInfo =
+        specialization ? FillSpecializationInfo( specialization, specializationEntries, &specializationInfo ) : 0;
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.basePipelineIndex = -1;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    Pipeline_Cache *pipelineCache = &pipeline->device->pipelineCache;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    VkResult result = vkCreateComputePipelines( pipeline->device->device, pipelineCache->cache, 1, &pipelineInfo, 0,
+                                                &pipeline->computePipeline );
+    auto end = std::chrono::high_resolution_clock::now();
+
+    if ( result != VK_SUCCESS )
+    {
+        printf( "Failed to create compute pipeline!\n" );
+        pipeline->computePipeline = VK_NULL_HANDLE;
+        DestroyComputePipeline( pipeline );
+        return false;
+    }
+
+    RecordPipelineCreation( pipelineCache, std::chrono::duration< float64, std::milli >( end - start ).count() );
+    return true;
+}
+
+void DestroyComputePipeline( Compute_Pipeline *pipeline )
+{
+    vkDestroyShaderModule( pipeline->device->device, pipeline->shaderModule, 0 );
+    vkDestroyPipeline( pipeline->device->device, pipeline->computePipeline, 0 );
+}
+
+void BindComputePipeline( Compute_Pipeline *pipeline, VkCommandBuffer commandBuffer )
+{
+    vkCmdBindPipeline( commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->computePipeline );
+}
+
+bool CreateShaderModule( VkDevice device, Asset_Data shader, VkShaderModule *module )
 {
+    if ( !shader.data || shader.size == 0 || shader.size % sizeof( u32 ) != 0 )
+    {
+        return false;
+    }
+
     VkShaderModuleCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = shader.size;
-    createInfo.pCode = shader.content;
+    createInfo.codeSize = ( size_t ) shader.size;
+    createInfo.pCode = ( u32 * ) shader.data;
 
     if ( vkCreateShaderModule( device, &createInfo, 0, module ) != VK_SUCCESS )
     {
         printf( "Failed to create shader module!\n" );
+        *module = VK_NULL_HANDLE;
+        return false;
     }
+    return true;
 }
 
-Pipeline_Config_Info DefaultPipelineConfigInfo( u32 width, u32 height )
+Pipeline_Config_Info DefaultPipelineConfigInfo()
 {
     Pipeline_Config_Info configInfo = {};
 
@@ -137,15 +313,9 @@ Pipeline_Config_Info DefaultPipelineConfigInfo( u32 width, u32 height )
     configInfo.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     configInfo.inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
 
-    configInfo.viewport.x = 0.0f;
-    configInfo.viewport.y = 0.0f;
-    configInfo.viewport.width = ( float32 ) width;
-    configInfo.viewport.height = ( float32 ) height;
-    configInfo.viewport.minDepth = 0.0f;
-    configInfo.viewport.maxDepth = 1.0f;
-
-    configInfo.scissor.offset = { 0, 0 };
-    configInfo.scissor.extent = { width, height };
+    configInfo.dynamicStates[ 0 ] = VK_DYNAMIC_STATE_VIEWPORT;
+    configInfo.dynamicStates[ 1 ] = VK_DYNAMIC_STATE_SCISSOR;
+    configInfo.dynamicStateCount = 2;
 
     configInfo.rasterizationInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
     configInfo.rasterizationInfo.depthClampEnable = VK_FALSE;
@@ -195,3 +365,21 @@ void BindPipeline( Pipeline *pipeline, VkCommandBuffer commandBuffer )
 {
     vkCmdBindPipeline( commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->graphicsPipeline );
 }
+
+void SetViewportAndScissor( VkCommandBuffer commandBuffer, VkExtent2D extent )
+{
+    VkViewport viewport = {};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = ( float32 ) extent.width;
+    viewport.height = ( float32 ) extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor = {};
+    scissor.offset = { 0, 0 };
+    scissor.extent = extent;
+
+    vkCmdSetViewport( commandBuffer, 0, 1, &viewport );
+    vkCmdSetScissor( commandBuffer, 0, 1, &scissor );
+}
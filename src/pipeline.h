@@ -1,43 +1,107 @@
 #pragma once
 #include "utils/utils.h"
 #include "device.h"
+#include "archive.h"
 
+#define PIPELINE_MAX_DYNAMIC_STATES 8
+#define PIPELINE_MAX_VERTEX_BINDINGS 4
+#define PIPELINE_MAX_VERTEX_ATTRIBUTES 8
+#define PIPELINE_MAX_SPECIALIZATION_CONSTANTS 8
+
+// 4 byte constants only, which covers bool, int, uint and float. A stage ignores the ids it doesn't declare,
+// so one set serves every stage of a pipeline
+struct Specialization_Constants
+{
+    u32 count;
+    u32 ids[ PIPELINE_MAX_SPECIALIZATION_CONSTANTS ];
+    u32 values[ PIPELINE_MAX_SPECIALIZATION_CONSTANTS ];
+};
+
+// Viewport and scissor are always dynamic, so nothing here depends on the extent
 struct Pipeline_Config_Info
 {
-    VkViewport viewport;
-    VkRect2D scissor;
     VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
     VkPipelineRasterizationStateCreateInfo rasterizationInfo;
     VkPipelineMultisampleStateCreateInfo multisampleInfo;
     VkPipelineColorBlendAttachmentState colorBlendAttachment;
     VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
+    VkDynamicState dynamicStates[ PIPELINE_MAX_DYNAMIC_STATES ];
+    u32 dynamicStateCount;
+    VkVertexInputBindingDescription vertexBindings[ PIPELINE_MAX_VERTEX_BINDINGS ];
+    u32 vertexBindingCount;
+    VkVertexInputAttributeDescription vertexAttributes[ PIPELINE_MAX_VERTEX_ATTRIBUTES ];
+    u32 vertexAttributeCount;
+    Specialization_Constants specialization;
     VkPipelineLayout pipelineLayout = 0;
     VkRenderPass renderPass = 0;
     u32 subpass = 0;
 };
 
+// Everything a VkGraphicsPipelineCreateInfo points at besides the config, so a batch of them can go to one
+// vkCreateGraphicsPipelines call. It points into itself and the config, don't copy it once filled
+struct Graphics_Pipeline_Create_State
+{
+    VkPipelineShaderStageCreateInfo shaderStages[ 2 ];
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo;
+    VkPipelineViewportStateCreateInfo viewportInfo;
+    VkPipelineColorBlendStateCreateInfo colorBlendInfo;
+    VkPipelineDynamicStateCreateInfo dynamicStateInfo;
+    VkSpecializationMapEntry specializationEntries[ PIPELINE_MAX_SPECIALIZATION_CONSTANTS ];
+    VkSpecializationInfo specializationInfo;
+    VkGraphicsPipelineCreateInfo pipelineInfo;
+};
+
 struct Pipeline
 {
     Device *device;
     VkPipeline graphicsPipeline;
     VkShaderModule vertexShaderModule;
     VkShaderModule fragmentShaderModule;
+    // the pipeline and modules belong to a Pipeline_Manager, DestroyPipeline leaves them alone
+    bool managed;
 };
 
-struct Read_File_Result
+struct Compute_Pipeline
 {
-    int size;
-    u32 *content;
+    Device *device;
+    VkPipeline computePipeline;
+    VkShaderModule shaderModule;
 };
 
-static Read_File_Result ReadFile( char *path );
+bool CreateGraphicsPipline( Pipeline *pipeline, Pipeline_Config_Info *configInfo, char *vertexShaderPath, char *fragmentShaderPath );
 
-void CreateGraphicsPipline( Pipeline *pipeline, Pipeline_Config_Info *configInfo, char *vertexShaderPath, char *fragmentShaderPath );
+// Goes through the device pipeline cache and records the creation time, returns VK_NULL_HANDLE on failure
+VkPipeline CreateGraphicsPipelineWithModules( Device *device, Pipeline_Config_Info *configInfo, VkShaderModule vertexShaderModule,
+                                              VkShaderModule fragmentShaderModule );
+
+void FillGraphicsPipelineCreateState( Graphics_Pipeline_Create_State *state, Pipeline_Config_Info *configInfo,
+                                      VkShaderModule vertexShaderModule, VkShaderModule fragmentShaderModule );
+
+// One driver call for the whole batch, pipelines that failed come back as VK_NULL_HANDLE
+bool CreateGraphicsPipelines( Device *device, Graphics_Pipeline_Create_State *states, u32 count, VkPipeline *pipelines );
+
+// Replaces the value when the id is already set, false when the set is full
+bool SetSpecializationConstant( Specialization_Constants *constants, u32 id, u32 value );
+
+// Null when there are no constants, otherwise info points at entries and the constants
+VkSpecializationInfo *FillSpecializationInfo( Specialization_Constants *constants, VkSpecializationMapEntry *entries,
+                                              VkSpecializationInfo *info );
 
 void DestroyPipeline( Pipeline *pipeline );
 
-void CreateShaderModule( VkDevice device, Read_File_Result shader, VkShaderModule *module );
+bool CreateComputePipeline( Compute_Pipeline *pipeline, VkPipelineLayout pipelineLayout, char *shaderPath,
+                            Specialization_Constants *specialization = 0 );
 
-Pipeline_Config_Info DefaultPipelineConfigInfo( u32 width, u32 height );
+void DestroyComputePipeline( Compute_Pipeline *pipeline );
+
+void BindComputePipeline( Compute_Pipeline *pipeline, VkCommandBuffer commandBuffer );
+
+// Shaders are loaded through LoadAsset, so they come from the mounted archive when there is one
+bool CreateShaderModule( VkDevice device, Asset_Data shader, VkShaderModule *module );
+
+Pipeline_Config_Info DefaultPipelineConfigInfo();
 
 void BindPipeline( Pipeline *pipeline, VkCommandBuffer commandBuffer );
+
+// Viewport and scissor are dynamic so pipelines survive a swap chain resize
+void SetViewportAndScissor( VkCommandBuffer commandBuffer, VkExtent2D extent );
@@ -0,0 +1,223 @@
+#include "pipeline_cache.h"
+#include "hash.h"
+#include "platform.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+
+static bool IsPipelineCacheValid( u8 *fileData, u64 fileSize, VkPhysicalDeviceProperties *properties )
+{
+    if ( fileSize < sizeof( Pipeline_Cache_File_Header ) )
+    {
+        printf( "Pipeline cache: file too small\n" );
+        return false;
+    }
+
+    Pipeline_Cache_File_Header *header = ( Pipeline_Cache_File_Header * ) fileData;
+    if ( header->magic != PIPELINE_CACHE_MAGIC || header->version != PIPELINE_CACHE_VERSION )
+    {
+        printf( "Pipeline cache: unknown format\n" );
+        return false;
+    }
+
+    if ( header->vendorID != properties->vendorID || header->deviceID != properties->deviceID ||
+         header->driverVersion != properties->driverVersion ||
+         memcmp( header->pipelineCacheUUID, properties->pipelineCacheUUID, VK_UUID_SIZE ) != 0 )
+    {
+        printf( "Pipeline cache: written by a different device or driver\n" );
+        return false;
+    }
+
+    u8 *data = fileData + sizeof( Pipeline_Cache_File_Header );
+    if ( header->dataSize != fileSize - sizeof( Pipeline_Cache_File_Header ) ||
+         header->dataSize < sizeof( VkPipelineCacheHeaderVersionOne ) ||
+         HashBytes64( data, header->dataSize ) != header->dataHash )
+    {
+        printf( "Pipeline cache: corrupt data\n" );
+        return false;
+    }
+
+    // the driver validates its own header too, but not every driver is careful about it
+    VkPipelineCacheHeaderVersionOne driverHeader;
+    memcpy( &driverHeader, data, sizeof( driverHeader ) );
+    if ( driverHeader.headerSize < sizeof( VkPipelineCacheHeaderVersionOne ) ||
+         driverHeader.headerSize > header->dataSize ||
+         driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+         driverHeader.vendorID != properties->vendorID || driverHeader.deviceID != properties->deviceID ||
+         memcmp( driverHeader.pipelineCacheUUID, properties->pipelineCacheUUID, VK_UUID_SIZE ) != 0 )
+    {
+        printf( "Pipeline cache: driver header mismatch\n" );
+        return false;
+    }
+
+    return true;
+}
+
+void LoadPipelineCache( Pipeline_Cache *pipelineCache, VkDevice device, VkPhysicalDeviceProperties *properties, char *path )
+{
+    pipelineCache->stats = {};
+
+    u8 *fileData = 0;
+    u64 fileSize = 0;
+
+    FILE *file = OpenFile( path, "rb" );
+    if ( file )
+    {
+        fseek( file, 0, SEEK_END );
+        long size = ftell( file );
+        fseek( file, 0, SEEK_SET );
+
+        // ftell fails with -1, an unreadable or empty file is a cold start
+        if ( size > 0 )
+        {
+            fileData = ( u8 * ) malloc( ( size_t ) size );
+        }
+        if ( fileData )
+        {
+            fileSize = ( u64 ) size;
+            if ( fread( fileData, 1, fileSize, file ) != fileSize )
+            {
+                free( fileData );
+                fileData = 0;
+                fileSize = 0;
+            }
+        }
+        fclose( file );
+    }
+
+    VkPipelineCacheCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+    if ( fileData && IsPipelineCacheValid( fileData, fileSize, properties ) )
+    {
+        createInfo.initialDataSize = ( size_t ) ( fileSize - sizeof( Pipeline_Cache_File_Header ) );
+        createInfo.pInitialData = fileData + sizeof( Pipeline_Cache_File_Header );
+        pipelineCache->stats.warmStart = true;
+        pipelineCache->stats.loadedBytes = createInfo.initialDataSize;
+    }
+
+    VkResult result = vkCreatePipelineCache( device, &createInfo, 0, &pipelineCache->cache );
+    if ( result != VK_SUCCESS && createInfo.initialDataSize > 0 )
+    {
+        printf( "Pipeline cache: driver rejected the cached data, starting cold\n" );
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = 0;
+        pipelineCache->stats.warmStart = false;
+        pipelineCache->stats.loadedBytes = 0;
+        result = vkCreatePipelineCache( device, &createInfo, 0, &pipelineCache->cache );
+    }
+
+    if ( result != VK_SUCCESS )
+    {
+        printf( "Failed to create pipeline cache!\n" );
+        pipelineCache->cache = VK_NULL_HANDLE;
+    }
+
+    free( fileData );
+
+    printf( "Pipeline cache: %s start (%llu bytes)\n", pipelineCache->stats.warmStart ? "warm" : "cold",
+            ( unsigned long long ) pipelineCache->stats.loadedBytes );
+}
+
+void SavePipelineCache( Pipeline_Cache *pipelineCache, VkDevice device, VkPhysicalDeviceProperties *properties, char *path )
+{
+    if ( pipelineCache->cache == VK_NULL_HANDLE )
+    {
+        return;
+    }
+
+    size_t dataSize = 0;
+    if ( vkGetPipelineCacheData( device, pipelineCache->cache, &dataSize, 0 ) != VK_SUCCESS || dataSize == 0 )
+    {
+        return;
+    }
+
+    u8 *fileData = ( u8 * ) malloc( sizeof( Pipeline_Cache_File_Header ) + dataSize );
+    if ( !fileData )
+    {
+        printf( "Pipeline cache: out of memory, not saving\n" );
+        return;
+    }
+    u8 *data = fileData + sizeof( Pipeline_Cache_File_Header );
+    if ( vkGetPipelineCacheData( device, pipelineCache->cache, &dataSize, data ) != VK_SUCCESS )
+    {
+        free( fileData );
+        return;
+    }
+
+    Pipeline_Cache_File_Header *header = ( Pipeline_Cache_File_Header * ) fileData;
+    *header = {};
+    header->magic = PIPELINE_CACHE_MAGIC;
+    header->version = PIPELINE_CACHE_VERSION;
+    header->vendorID = properties->vendorID;
+    header->deviceID = properties->deviceID;
+    header->driverVersion = properties->driverVersion;
+    header->dataSize = dataSize;
+    header->dataHash = HashBytes64( data, dataSize );
+    memcpy( header->pipelineCacheUUID, properties->pipelineCacheUUID, VK_UUID_SIZE );
+
+    // write next to the old file and swap it in, so a crash mid-write never leaves a truncated cache behind
+    char tempPath[ 512 ];
+    snprintf( tempPath, sizeof( tempPath ), "%s.tmp", path );
+
+    FILE *file = OpenFile( tempPath, "wb" );
+    if ( !file )
+    {
+        printf( "Failed to write pipeline cache: %s\n", tempPath );
+        free( fileData );
+        return;
+    }
+
+    u64 fileSize = sizeof( Pipeline_Cache_File_Header ) + dataSize;
+    bool written = fwrite( fileData, 1, fileSize, file ) == fileSize;
+    written = fclose( file ) == 0 && written;
+    free( fileData );
+
+    if ( written )
+    {
+        remove( path );
+        written = rename( tempPath, path ) == 0;
+    }
+
+    if ( !written )
+    {
+        printf( "Failed to write pipeline cache: %s\n", path );
+        remove( tempPath );
+        return;
+    }
+
+    pipelineCache->stats.savedBytes = dataSize;
+}
+
+void DestroyPipelineCache( Pipeline_Cache *pipelineCache, VkDevice device )
+{
+    if ( pipelineCache->cache != VK_NULL_HANDLE )
+    {
+        vkDestroyPipelineCache( device, pipelineCache->cache, 0 );
+        pipelineCache->cache = VK_NULL_HANDLE;
+    }
+}
+
+void RecordPipelineCreation( Pipeline_Cache *pipelineCache, float64 milliseconds )
+{
+    std::lock_guard< std::mutex > lock( pipelineCache->statsMutex );
+
+    Pipeline_Cache_Stats *stats = &pipelineCache->stats;
+    stats->pipelineCount++;
+    stats->totalCreateMilliseconds += milliseconds;
+    if ( milliseconds > stats->maxCreateMilliseconds )
+    {
+        stats->maxCreateMilliseconds = milliseconds;
+    }
+}
+
+void PrintPipelineCacheStats( Pipeline_Cache *pipelineCache )
+{
+    std::lock_guard< std::mutex > lock( pipelineCache->statsMutex );
+
+    Pipeline_Cache_Stats *stats = &pipelineCache->stats;
+    float64 average = stats->pipelineCount ? stats->totalCreateMilliseconds / stats->pipelineCount : 0.0;
+    printf( "Pipeline cache (%s start): %u pipelines, %.3f ms total, %.3f ms avg, %.3f ms max\n",
+            stats->warmStart ? "warm" : "cold", stats->pipelineCount, stats->totalCreateMilliseconds,
+            average, stats->maxCreateMilliseconds );
+}
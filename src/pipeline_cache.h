@@ -0,0 +1,50 @@
+#pragma once
+
+#include "window.h"
+#include "utils/utils.h"
+#include <mutex> //@TODO: Remove std garbage
+
+#define PIPELINE_CACHE_PATH "pipeline_cache.bin"
+#define PIPELINE_CACHE_MAGIC 0x43504b56 // "VKPC"
+#define PIPELINE_CACHE_VERSION 1
+
+// Written in front of the driver blob so stale or foreign caches are rejected before the driver sees them
+struct Pipeline_Cache_File_Header
+{
+    u32 magic;
+    u32 version;
+    u32 vendorID;
+    u32 deviceID;
+    u32 driverVersion;
+    u32 reserved;
+    u64 dataSize;
+    u64 dataHash;
+    u8 pipelineCacheUUID[ VK_UUID_SIZE ];
+};
+
+struct Pipeline_Cache_Stats
+{
+    bool warmStart;
+    u64 loadedBytes;
+    u64 savedBytes;
+    u32 pipelineCount;
+    float64 totalCreateMilliseconds;
+    float64 maxCreateMilliseconds;
+};
+
+struct Pipeline_Cache
+{
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    Pipeline_Cache_Stats stats = {};
+    std::mutex statsMutex;
+};
+
+void LoadPipelineCache( Pipeline_Cache *pipelineCache, VkDevice device, VkPhysicalDeviceProperties *properties, char *path );
+
+void SavePipelineCache( Pipeline_Cache *pipelineCache, VkDevice device, VkPhysicalDeviceProperties *properties, char *path );
+
+void DestroyPipelineCache( Pipeline_Cache *pipelineCache, VkDevice device );
+
+void RecordPipelineCreation( Pipeline_Cache *pipelineCache, float64 milliseconds );
+
+void PrintPipelineCacheStats( Pipeline_Cache *pipelineCache );
@@ -0,0 +1,405 @@
+#include "pipeline_manager.h"
+#include "hash.h"
+#include "trace.h"
+#include "stdio.h"
+#include "string.h"
+#include <thread> //@TODO: Remove std garbage
+
+void InitPipelineManager( Pipeline_Manager *manager, Device *device )
+{
+    manager->device = device;
+    manager->slots = new Pipeline_Slot[ PIPELINE_MANAGER_SLOT_COUNT ]();
+    manager->pipelines = new Managed_Pipeline[ PIPELINE_MANAGER_CAPACITY ]();
+    manager->pipelineCount = 0;
+    manager->overflow.pipeline = VK_NULL_HANDLE;
+    manager->overflow.state = MANAGED_PIPELINE_FAILED;
+    manager->shaderCount = 0;
+
+    manager->stats.lookupCount = 0;
+    manager->stats.hitCount = 0;
+    manager->stats.createCount = 0;
+    manager->stats.waitCount = 0;
+    manager->stats.failCount = 0;
+    manager->stats.shaderLoadCount = 0;
+
+    manager->setCullMode = 0;
+    manager->setFrontFace = 0;
+    manager->setDepthTestEnable = 0;
+    manager->setDepthWriteEnable = 0;
+    manager->setDepthCompareOp = 0;
+    if ( device->extendedDynamicState )
+    {
+        VkDevice vkDevice = device->device;
+        manager->setCullMode = ( PFN_vkCmdSetCullModeEXT ) vkGetDeviceProcAddr( vkDevice, "vkCmdSetCullModeEXT" );
+        manager->setFrontFace = ( PFN_vkCmdSetFrontFaceEXT ) vkGetDeviceProcAddr( vkDevice, "vkCmdSetFrontFaceEXT" );
+        manager->setDepthTestEnable = ( PFN_vkCmdSetDepthTestEnableEXT ) vkGetDeviceProcAddr( vkDevice, "vkCmdSetDepthTestEnableEXT" );
+        manager->setDepthWriteEnable = ( PFN_vkCmdSetDepthWriteEnableEXT ) vkGetDeviceProcAddr( vkDevice, "vkCmdSetDepthWriteEnableEXT" );
+        manager->setDepthCompareOp = ( PFN_vkCmdSetDepthCompareOpEXT ) vkGetDeviceProcAddr( vkDevice, "vkCmdSetDepthCompareOpEXT" );
+    }
+    manager->extendedDynamicState = manager->setCullMode && manager->setFrontFace && manager->setDepthTestEnable &&
+                                    manager->setDepthWriteEnable && manager->setDepthCompareOp;
+}
+
+void DestroyPipelineManager( Pipeline_Manager *manager )
+{
+    VkDevice device = manager->device->device;
+    u32 pipelineCount = manager->pipelineCount.load();
+    if ( pipelineCount > PIPELINE_MANAGER_CAPACITY ) pipelineCount = PIPELINE_MANAGER_CAPACITY;
+    for ( u32 i = 0; i < pipelineCount; ++i )
+    {
+        if ( manager->pipelines[ i ].pipeline != VK_NULL_HANDLE )
+        {
+            vkDestroyPipeline( device, manager->pipelines[ i ].pipeline, 0 );
+        }
+    }
+
+    for ( u32 i = 0; i < manager->shaderCount; ++i )
+    {
+        vkDestroyShaderModule( device, manager->shaders[ i ].module, 0 );
+    }
+    manager->shaderCount = 0;
+
+    delete[] manager->slots;
+    delete[] manager->pipelines;
+    manager->slots = 0;
+    manager->pipelines = 0;
+}
+
+VkShaderModule GetManagedShaderModule( Pipeline_Manager *manager, char *path )
+{
+    Asset_Data shader;
+    if ( !LoadAsset( path, &shader ) )
+    {
+        return VK_NULL_HANDLE;
+    }
+    u64 hash = HashBytes64( shader.data, shader.size );
+
+    VkShaderModule module = VK_NULL_HANDLE;
+    {
+        std::lock_guard< std::mutex > lock( manager->shaderMutex );
+        for ( u32 i = 0; i < manager->shaderCount; ++i )
+        {
+            if ( manager->shaders[ i ].hash == hash )
+            {
+                module = manager->shaders[ i ].module;
+                break;
+            }
+        }
+
+        if ( module == VK_NULL_HANDLE )
+        {
+            if ( manager->shaderCount == PIPELINE_MANAGER_MAX_SHADERS )
+            {
+                printf( "Pipeline manager: out of shader slots for %s!\n", path );
+            }
+            else if ( CreateShaderModule( manager->device->device, shader, &module ) )
+            {
+                manager->shaders[ manager->shaderCount++ ] = { hash, module };
+                manager->stats.shaderLoadCount.fetch_add( 1, std::memory_order_relaxed );
+            }
+        }
+    }
+
+    FreeAsset( &shader );
+    return module;
+}
+
+// Viewport and scissor always, the extended states when the device has them
+static u32 GetManagedDynamicStates( Pipeline_Manager *manager, Pipeline_Config_Info *configInfo, VkDynamicState *states )
+{
+    VkDynamicState extendedStates[] = { VK_DYNAMIC_STATE_CULL_MODE_EXT, VK_DYNAMIC_STATE_FRONT_FACE_EXT,
+                                        VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT, VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+                                        VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT };
+
+    u32 count = configInfo->dynamicStateCount;
+    memcpy( states, configInfo->dynamicStates, count * sizeof( VkDynamicState ) );
+    if ( !manager->extendedDynamicState )
+    {
+        return count;
+    }
+
+    for ( u32 i = 0; i < sizeof( extendedStates ) / sizeof( extendedStates[ 0 ] ); ++i )
+    {
+        bool present = false;
+        for ( u32 j = 0; j < count; ++j )
+        {
+            present = present || states[ j ] == extendedStates[ i ];
+        }
+        if ( !present && count < PIPELINE_MAX_DYNAMIC_STATES )
+        {
+            states[ count++ ] = extendedStates[ i ];
+        }
+    }
+    return count;
+}
+
+static void BuildPipelineStateKey( Pipeline_Manager *manager, Pipeline_Config_Info *configInfo, VkShaderModule vertexShaderModule,
+                                   VkShaderModule fragmentShaderModule, VkDynamicState *dynamicStates, u32 dynamicStateCount,
+                                   Pipeline_State_Key *key )
+{
+    // zeroed first so padding and unused array entries compare equal
+    memset( key, 0, sizeof( *key ) );
+    key->vertexShader = vertexShaderModule;
+    key->fragmentShader = fragmentShaderModule;
+    key->pipelineLayout = configInfo->pipelineLayout;
+    key->renderPass = configInfo->renderPass;
+    key->subpass = configInfo->subpass;
+
+    key->topology = configInfo->inputAssemblyInfo.topology;
+    key->primitiveRestartEnable = configInfo->inputAssemblyInfo.primitiveRestartEnable;
+
+    VkPipelineRasterizationStateCreateInfo *rasterization = &configInfo->rasterizationInfo;
+    key->depthClampEnable = rasterization->depthClampEnable;
+    key->rasterizerDiscardEnable = rasterization->rasterizerDiscardEnable;
+    key->polygonMode = rasterization->polygonMode;
+    key->depthBiasEnable = rasterization->depthBiasEnable;
+    key->depthBiasConstantFactor = rasterization->depthBiasConstantFactor;
+    key->depthBiasClamp = rasterization->depthBiasClamp;
+    key->depthBiasSlopeFactor = rasterization->depthBiasSlopeFactor;
+    key->lineWidth = rasterization->lineWidth;
+
+    VkPipelineMultisampleStateCreateInfo *multisample = &configInfo->multisampleInfo;
+    key->rasterizationSamples = multisample->rasterizationSamples;
+    key->sampleShadingEnable = multisample->sampleShadingEnable;
+    key->minSampleShading = multisample->minSampleShading;
+    key->alphaToCoverageEnable = multisample->alphaToCoverageEnable;
+    key->alphaToOneEnable = multisample->alphaToOneEnable;
+
+    key->colorBlendAttachment = configInfo->colorBlendAttachment;
+
+    VkPipelineDepthStencilStateCreateInfo *depthStencil = &configInfo->depthStencilInfo;
+    key->depthBoundsTestEnable = depthStencil->depthBoundsTestEnable;
+    key->stencilTestEnable = depthStencil->stencilTestEnable;
+    key->front = depthStencil->front;
+    key->back = depthStencil->back;
+    key->minDepthBounds = depthStencil->minDepthBounds;
+    key->maxDepthBounds = depthStencil->maxDepthBounds;
+
+    // these come from the command buffer, so one pipeline serves every value
+    if ( !manager->extendedDynamicState )
+    {
+        key->cullMode = rasterization->cullMode;
+        key->frontFace = rasterization->frontFace;
+        key->depthTestEnable = depthStencil->depthTestEnable;
+        key->depthWriteEnable = depthStencil->depthWriteEnable;
+        key->depthCompareOp = depthStencil->depthCompareOp;
+    }
+
+    key->dynamicStateCount = dynamicStateCount;
+    for ( u32 i = 0; i < dynamicStateCount; ++i )
+    {
+        key->dynamicStates[ i ] = dynamicStates[ i ];
+    }
+    key->vertexBindingCount = configInfo->vertexBindingCount;
+    memcpy( key->vertexBindings, configInfo->vertexBindings, configInfo->vertexBindingCount * sizeof( key->vertexBindings[ 0 ] ) );
+    key->vertexAttributeCount = configInfo->vertexAttributeCount;
+    memcpy( key->vertexAttributes, configInfo->vertexAttributes,
+            configInfo->vertexAttributeCount * sizeof( key->vertexAttributes[ 0 ] ) );
+    Specialization_Constants *specialization = &configInfo->specialization;
+    key->specializationCount = specialization->count;
+    memcpy( key->specializationIds, specialization->ids, specialization->count * sizeof( u32 ) );
+    memcpy( key->specializationValues, specialization->values, specialization->count * sizeof( u32 ) );
+}
+
+static VkPipeline WaitForManagedPipeline( Pipeline_Manager *manager, Managed_Pipeline *entry )
+{
+    u32 state = entry->state.load( std::memory_order_acquire );
+    if ( state == MANAGED_PIPELINE_CREATING )
+    {
+        TRACE_ZONE( "WaitForManagedPipeline" );
+        manager->stats.waitCount.fetch_add( 1, std::memory_order_relaxed );
+        while ( state == MANAGED_PIPELINE_CREATING )
+        {
+            std::this_thread::yield();
+            state = entry->state.load( std::memory_order_acquire );
+        }
+    }
+    else
+    {
+        manager->stats.hitCount.fetch_add( 1, std::memory_order_relaxed );
+    }
+    return state == MANAGED_PIPELINE_READY ? entry->pipeline : VK_NULL_HANDLE;
+}
+
+// Claims a new entry when the key isn't in the table yet, the caller then has to create it and pass it to
+// FinishClaimedPipeline while every other thread with the same key waits on the entry's state. Null when the manager is full
+static Managed_Pipeline *FindOrClaimPipeline( Pipeline_Manager *manager, Pipeline_State_Key *key, bool *claimed )
+{
+    u64 hash = HashBytes64( key, sizeof( *key ) );
+    if ( hash == 0 ) hash = 1;
+    manager->stats.lookupCount.fetch_add( 1, std::memory_order_relaxed );
+    *claimed = false;
+
+    // slots are never emptied, so a probe sequence only ever grows and a miss ends at the first empty slot
+    for ( u32 probe = 0; probe < PIPELINE_MANAGER_SLOT_COUNT; ++probe )
+    {
+        Pipeline_Slot *slot = &manager->slots[ ( hash + probe ) & ( PIPELINE_MANAGER_SLOT_COUNT - 1 ) ];
+        u64 slotHash = slot->hash.load( std::memory_order_acquire );
+        if ( slotHash == 0 )
+        {
+            if ( slot->hash.compare_exchange_strong( slotHash, hash, std::memory_order_acq_rel ) )
+            {
+                u32 index = manager->pipelineCount.fetch_add( 1, std::memory_order_relaxed );
+                if ( index >= PIPELINE_MANAGER_CAPACITY )
+                {
+                    printf( "Pipeline manager is full, raise PIPELINE_MANAGER_CAPACITY!\n" );
+                    slot->pipeline.store( &manager->overflow, std::memory_order_release );
+                    manager->stats.failCount.fetch_add( 1, std::memory_order_relaxed );
+                    return 0;
+                }
+
+                Managed_Pipeline *entry = &manager->pipelines[ index ];
+                entry->key = *key;
+                entry->pipeline = VK_NULL_HANDLE;
+                entry->state.store( MANAGED_PIPELINE_CREATING, std::memory_order_relaxed );
+                slot->pipeline.store( entry, std::memory_order_release );
+                *claimed = true;
+                return entry;
+            }
+            // lost the race, slotHash now holds the winner's hash
+        }
+        if ( slotHash != hash )
+        {
+            continue;
+        }
+
+        // the claiming thread publishes its entry right after the hash
+        Managed_Pipeline *entry = slot->pipeline.load( std::memory_order_acquire );
+        while ( !entry )
+        {
+            std::this_thread::yield();
+            entry = slot->pipeline.load( std::memory_order_acquire );
+        }
+        if ( memcmp( &entry->key, key, sizeof( *key ) ) == 0 )
+        {
+            return entry;
+        }
+    }
+
+    printf( "Pipeline manager has no free slots, raise PIPELINE_MANAGER_CAPACITY!\n" );
+    manager->stats.failCount.fetch_add( 1, std::memory_order_relaxed );
+    return 0;
+}
+
+static void FinishClaimedPipeline( Pipeline_Manager *manager, Managed_Pipeline *entry, VkPipeline pipeline )
+{
+    entry->pipeline = pipeline;
+    if ( pipeline != VK_NULL_HANDLE )
+    {
+        manager->stats.createCount.fetch_add( 1, std::memory_order_relaxed );
+        entry->state.store( MANAGED_PIPELINE_READY, std::memory_order_release );
+    }
+    else
+    {
+        manager->stats.failCount.fetch_add( 1, std::memory_order_relaxed );
+        entry->state.store( MANAGED_PIPELINE_FAILED, std::memory_order_release );
+    }
+}
+
+VkPipeline GetGraphicsPipeline( Pipeline_Manager *manager, Pipeline_Config_Info *configInfo, VkShaderModule vertexShaderModule,
+                                VkShaderModule fragmentShaderModule )
+{
+    VkPipeline pipeline;
+    GetGraphicsPipelines( manager, configInfo, 1, vertexShaderModule, fragmentShaderModule, &pipeline );
+    return pipeline;
+}
+
+void GetGraphicsPipelines( Pipeline_Manager *manager, Pipeline_Config_Info *configInfos, u32 count, VkShaderModule vertexShaderModule,
+                           VkShaderModule fragmentShaderModule, VkPipeline *pipelines )
+{
+    TRACE_FUNCTION();
+    Assert( count <= PIPELINE_MANAGER_MAX_BATCH );
+
+    Managed_Pipeline *entries[ PIPELINE_MANAGER_MAX_BATCH ];
+    bool claimed[ PIPELINE_MANAGER_MAX_BATCH ];
+    Pipeline_Config_Info createInfos[ PIPELINE_MANAGER_MAX_BATCH ];
+    Graphics_Pipeline_Create_State createStates[ PIPELINE_MANAGER_MAX_BATCH ];
+    Managed_Pipeline *createEntries[ PIPELINE_MANAGER_MAX_BATCH ];
+    u32 createCount = 0;
+
+    for ( u32 i = 0; i < count; ++i )
+    {
+        Pipeline_Config_Info *createInfo = &createInfos[ i ];
+        *createInfo = configInfos[ i ];
+        createInfo->dynamicStateCount = GetManagedDynamicStates( manager, &configInfos[ i ], createInfo->dynamicStates );
+
+        Pipeline_State_Key key;
+        BuildPipelineStateKey( manager, createInfo, vertexShaderModule, fragmentShaderModule, createInfo->dynamicStates,
+                               createInfo->dynamicStateCount, &key );
+        entries[ i ] = FindOrClaimPipeline( manager, &key, &claimed[ i ] );
+        if ( claimed[ i ] )
+        {
+            FillGraphicsPipelineCreateState( &createStates[ createCount ], createInfo, vertexShaderModule, fragmentShaderModule );
+            createEntries[ createCount++ ] = entries[ i ];
+        }
+    }
+
+    // everything this call claimed is created before it waits on anyone, so two threads can't end up waiting on each other
+    if ( createCount > 0 )
+    {
+        VkPipeline created[ PIPELINE_MANAGER_MAX_BATCH ];
+        CreateGraphicsPipelines( manager->device, createStates, createCount, created );
+        for ( u32 i = 0; i < createCount; ++i )
+        {
+            FinishClaimedPipeline( manager, createEntries[ i ], created[ i ] );
+        }
+    }
+
+    for ( u32 i = 0; i < count; ++i )
+    {
+        if ( !entries[ i ] )
+        {
+            pipelines[ i ] = VK_NULL_HANDLE;
+        }
+        else if ( claimed[ i ] )
+        {
+            pipelines[ i ] = entries[ i ]->pipeline;
+        }
+        else
+        {
+            pipelines[ i ] = WaitForManagedPipeline( manager, entries[ i ] );
+        }
+    }
+}
+
+bool CreateManagedGraphicsPipeline( Pipeline_Manager *manager, Pipeline *pipeline, Pipeline_Config_Info *configInfo,
+                                    char *vertexShaderPath, char *fragmentShaderPath )
+{
+    pipeline->device = manager->device;
+    pipeline->managed = true;
+    pipeline->vertexShaderModule = GetManagedShaderModule( manager, vertexShaderPath );
+    pipeline->fragmentShaderModule = GetManagedShaderModule( manager, fragmentShaderPath );
+    pipeline->graphicsPipeline = VK_NULL_HANDLE;
+    if ( pipeline->vertexShaderModule != VK_NULL_HANDLE && pipeline->fragmentShaderModule != VK_NULL_HANDLE )
+    {
+        pipeline->graphicsPipeline = GetGraphicsPipeline( manager, configInfo, pipeline->vertexShaderModule,
+                                                          pipeline->fragmentShaderModule );
+    }
+    return pipeline->graphicsPipeline != VK_NULL_HANDLE;
+}
+
+void SetPipelineDynamicState( Pipeline_Manager *manager, VkCommandBuffer commandBuffer, Pipeline_Config_Info *configInfo )
+{
+    if ( !manager->extendedDynamicState )
+    {
+        return;
+    }
+
+    manager->setCullMode( commandBuffer, configInfo->rasterizationInfo.cullMode );
+    manager->setFrontFace( commandBuffer, configInfo->rasterizationInfo.frontFace );
+    manager->setDepthTestEnable( commandBuffer, configInfo->depthStencilInfo.depthTestEnable );
+    manager->setDepthWriteEnable( commandBuffer, configInfo->depthStencilInfo.depthWriteEnable );
+    manager->setDepthCompareOp( commandBuffer, configInfo->depthStencilInfo.depthCompareOp );
+}
+
+void PrintPipelineManagerStats( Pipeline_Manager *manager )
+{
+    Pipeline_Manager_Stats *stats = &manager->stats;
+    printf( "Pipeline manager: %llu pipelines created for %llu lookups (%llu hits, %llu waited on another thread, %llu failed), "
+            "%u shader modules\n",
+            ( unsigned long long ) stats->createCount.load(), ( unsigned long long ) stats->lookupCount.load(),
+            ( unsigned long long ) stats->hitCount.load(), ( unsigned long long ) stats->waitCount.load(),
+            ( unsigned long long ) stats->failCount.load(), manager->shaderCount );
+    printf( "  dynamic state: viewport, scissor%s\n",
+            manager->extendedDynamicState ? ", cull mode, front face, depth test, depth write, depth compare op" : "" );
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "pipeline.h"
+#include "utils/utils.h"
+#include <atomic> //@TODO: Remove std garbage
+#include <mutex>
+
+// Open addressing with twice as many slots as pipelines, the slot count has to be a power of two
+#define PIPELINE_MANAGER_CAPACITY 1024
+#define PIPELINE_MANAGER_SLOT_COUNT ( PIPELINE_MANAGER_CAPACITY * 2 )
+#define PIPELINE_MANAGER_MAX_SHADERS 256
+// Most pipelines handed to one GetGraphicsPipelines call
+#define PIPELINE_MANAGER_MAX_BATCH 16
+
+// Everything that ends up in the pipeline, states that are dynamic on this device are zeroed so they don't split pipelines
+struct Pipeline_State_Key
+{
+    VkShaderModule vertexShader;
+    VkShaderModule fragmentShader;
+    VkPipelineLayout pipelineLayout;
+    VkRenderPass renderPass;
+    u32 subpass;
+
+    u32 topology;
+    u32 primitiveRestartEnable;
+
+    u32 depthClampEnable;
+    u32 rasterizerDiscardEnable;
+    u32 polygonMode;
+    u32 cullMode;
+    u32 frontFace;
+    u32 depthBiasEnable;
+    float32 depthBiasConstantFactor;
+    float32 depthBiasClamp;
+    float32 depthBiasSlopeFactor;
+    float32 lineWidth;
+
+    u32 rasterizationSamples;
+    u32 sampleShadingEnable;
+    float32 minSampleShading;
+    u32 alphaToCoverageEnable;
+    u32 alphaToOneEnable;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment;
+
+    u32 depthTestEnable;
+    u32 depthWriteEnable;
+    u32 depthCompareOp;
+    u32 depthBoundsTestEnable;
+    u32 stencilTestEnable;
+    VkStencilOpState front;
+    VkStencilOpState back;
+    float32 minDepthBounds;
+    float32 maxDepthBounds;
+
+    u32 dynamicStateCount;
+    u32 dynamicStates[ PIPELINE_MAX_DYNAMIC_STATES ];
+    u32 vertexBindingCount;
+    VkVertexInputBindingDescription vertexBindings[ PIPELINE_MAX_VERTEX_BINDINGS ];
+    u32 vertexAttributeCount;
+    VkVertexInputAttributeDescription vertexAttributes[ PIPELINE_MAX_VERTEX_ATTRIBUTES ];
+    // in the order they were set, the same constants set in another order make a separate pipeline
+    u32 specializationCount;
+    u32 specializationIds[ PIPELINE_MAX_SPECIALIZATION_CONSTANTS ];
+    u32 specializationValues[ PIPELINE_MAX_SPECIALIZATION_CONSTANTS ];
+};
+
+enum Managed_Pipeline_State
+{
+    MANAGED_PIPELINE_CREATING,
+    MANAGED_PIPELINE_READY,
+    MANAGED_PIPELINE_FAILED,
+};
+
+struct Managed_Pipeline
+{
+    Pipeline_State_Key key;
+    VkPipeline pipeline;
+    std::atomic< u32 > state;
+};
+
+// hash is claimed first, pipeline is published once the key is written. 0 is an empty slot
+struct Pipeline_Slot
+{
+    std::atomic< u64 > hash;
+    std::atomic< Managed_Pipeline * > pipeline;
+};
+
+// SPIR-V is deduplicated by content, so the module handle is the shader's identity in the key
+struct Managed_Shader
+{
+    u64 hash;
+    VkShaderModule module;
+};
+
+struct Pipeline_Manager_Stats
+{
+    std::atomic< u64 > lookupCount;
+    std::atomic< u64 > hitCount;
+    std::atomic< u64 > createCount;
+    // lookups that found the pipeline being created by another thread and waited for it
+    std::atomic< u64 > waitCount;
+    std::atomic< u64 > failCount;
+    std::atomic< u64 > shaderLoadCount;
+};
+
+struct Pipeline_Manager
+{
+    Device *device;
+
+    Pipeline_Slot *slots;
+    Managed_Pipeline *pipelines;
+    std::atomic< u32 > pipelineCount;
+    // handed out once the pool is exhausted, always failed
+    Managed_Pipeline overflow;
+
+    std::mutex shaderMutex;
+    Managed_Shader shaders[ PIPELINE_MANAGER_MAX_SHADERS ];
+    u32 shaderCount;
+
+    // dynamic on top of viewport and scissor when the device has VK_EXT_extended_dynamic_state
+    bool extendedDynamicState;
+    PFN_vkCmdSetCullModeEXT setCullMode;
+    PFN_vkCmdSetFrontFaceEXT setFrontFace;
+    PFN_vkCmdSetDepthTestEnableEXT setDepthTestEnable;
+    PFN_vkCmdSetDepthWriteEnableEXT setDepthWriteEnable;
+    PFN_vkCmdSetDepthCompareOpEXT setDepthCompareOp;
+
+    Pipeline_Manager_Stats stats;
+};
+
+void InitPipelineManager( Pipeline_Manager *manager, Device *device );
+
+// The device has to be idle, every pipeline and shader module handed out is destroyed
+void DestroyPipelineManager( Pipeline_Manager *manager );
+
+// Thread safe. Identical SPIR-V gives back the same module, which the manager owns
+VkShaderModule GetManagedShaderModule( Pipeline_Manager *manager, char *path );
+
+// Thread safe and lock free once the pipeline exists. When several threads ask for the same new state at once,
+// one creates it and the others wait for it. Returns VK_NULL_HANDLE when creation failed or the manager is full
+VkPipeline GetGraphicsPipeline( Pipeline_Manager *manager, Pipeline_Config_Info *configInfo, VkShaderModule vertexShaderModule,
+                                VkShaderModule fragmentShaderModule );
+
+// Same as GetGraphicsPipeline for every config, the ones that are new to the manager go to the driver in a single
+// vkCreateGraphicsPipelines call. count is at most PIPELINE_MANAGER_MAX_BATCH
+void GetGraphicsPipelines( Pipeline_Manager *manager, Pipeline_Config_Info *configInfos, u32 count, VkShaderModule vertexShaderModule,
+                           VkShaderModule fragmentShaderModule, VkPipeline *pipelines );
+
+// Loads both shaders and fills in a Pipeline that the manager owns, DestroyPipeline on it does nothing
+bool CreateManagedGraphicsPipeline( Pipeline_Manager *manager, Pipeline *pipeline, Pipeline_Config_Info *configInfo,
+                                    char *vertexShaderPath, char *fragmentShaderPath );
+
+// Sets the states that managed pipelines leave dynamic, call after binding one of them. Viewport and scissor
+// still go through SetViewportAndScissor
+void SetPipelineDynamicState( Pipeline_Manager *manager, VkCommandBuffer commandBuffer, Pipeline_Config_Info *configInfo );
+
+void PrintPipelineManagerStats( Pipeline_Manager *manager );
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "stdio.h"
+#include "stdlib.h"
+#ifdef _WIN32
+#include "malloc.h"
+#endif
+
+// fopen is deprecated under MSVC and fopen_s doesn't exist anywhere else
+inline FILE *OpenFile( char *path, char *mode )
+{
+#ifdef _WIN32
+    FILE *file = 0;
+    if ( fopen_s( &file, path, mode ) != 0 )
+    {
+        return 0;
+    }
+    return file;
+#else
+    return fopen( path, mode );
+#endif
+}
+
+// alignment has to be a power of two, memory from AllocateAligned must go back through FreeAligned
+inline void *AllocateAligned( size_t size, size_t alignment )
+{
+#ifdef _WIN32
+    return _aligned_malloc( size, alignment );
+#else
+    // aligned_alloc wants the size to be a multiple of the alignment
+    return aligned_alloc( alignment, ( size + alignment - 1 ) & ~( alignment - 1 ) );
+#endif
+}
+
+inline void FreeAligned( void *memory )
+{
+#ifdef _WIN32
+    _aligned_free( memory );
+#else
+    free( memory );
+#endif
+}
@@ -0,0 +1,940 @@
+#include "render_graph.h"
+#include "trace.h"
+#include "stdio.h"
+#include "string.h"
+#include <algorithm> //@TODO: Remove std garbage
+
+struct Render_Graph_Usage_Info
+{
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    VkImageLayout layout;
+    bool write;
+};
+
+static Render_Graph_Usage_Info usageInfos[ RENDER_GRAPH_USAGE_COUNT ] = {
+    { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true },
+    { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true },
+    { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false },
+    { VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false },
+    { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true },
+    { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false },
+    { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false },
+    { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true },
+};
+
+static bool IsAttachmentUsage( Render_Graph_Usage usage )
+{
+    return usage == RENDER_GRAPH_COLOR_ATTACHMENT || usage == RENDER_GRAPH_DEPTH_ATTACHMENT;
+}
+
+void InitRenderGraph( Render_Graph *graph, Device *device, Gpu_Profiler *profiler, u32 framesInFlight )
+{
+    graph->device = device;
+    graph->profiler = profiler;
+    graph->framesInFlight = framesInFlight < RENDER_GRAPH_MAX_FRAMES ? framesInFlight : RENDER_GRAPH_MAX_FRAMES;
+    if ( framesInFlight > RENDER_GRAPH_MAX_FRAMES )
+    {
+        printf( "Render graph only supports %u frames in flight!\n", RENDER_GRAPH_MAX_FRAMES );
+    }
+    graph->extent = {};
+    graph->targetGeneration = 0;
+    graph->compiled = false;
+    graph->passCount = 0;
+    graph->resourceCount = 0;
+    graph->frameIndex = 0;
+    graph->stats = {};
+    for ( u32 i = 0; i < RENDER_GRAPH_MAX_FRAMES; ++i )
+    {
+        graph->transientMemory[ i ] = {};
+    }
+}
+
+static u32 AddResource( Render_Graph *graph, char *name, Render_Graph_Resource_Kind kind )
+{
+    if ( graph->compiled || graph->resourceCount == RENDER_GRAPH_MAX_RESOURCES )
+    {
+        printf( "Can't add render graph resource %s!\n", name );
+        return RENDER_GRAPH_INVALID;
+    }
+
+    Render_Graph_Resource *resource = &graph->resources[ graph->resourceCount ];
+    *resource = {};
+    resource->name = name;
+    resource->kind = kind;
+    resource->firstPass = RENDER_GRAPH_INVALID;
+    resource->lastPass = RENDER_GRAPH_INVALID;
+    return graph->resourceCount++;
+}
+
+u32 AddRenderGraphImage( Render_Graph *graph, char *name, VkFormat format, VkImageUsageFlags usage )
+{
+    u32 index = AddResource( graph, name, RENDER_GRAPH_TRANSIENT_IMAGE );
+    if ( index != RENDER_GRAPH_INVALID )
+    {
+        Render_Graph_Resource *resource = &graph->resources[ index ];
+        resource->format = format;
+        resource->usage = usage;
+        resource->aspect = ( usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT ) ? VK_IMAGE_ASPECT_DEPTH_BIT
+                                                                                   : VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+    return index;
+}
+
+u32 ImportRenderGraphImage( Render_Graph *graph, char *name, VkFormat format, VkImageLayout finalLayout )
+{
+    u32 index = AddResource( graph, name, RENDER_GRAPH_IMPORTED_IMAGE );
+    if ( index != RENDER_GRAPH_INVALID )
+    {
+        Render_Graph_Resource *resource = &graph->resources[ index ];
+        resource->format = format;
+        resource->aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        resource->finalLayout = finalLayout;
+    }
+    return index;
+}
+
+u32 ImportRenderGraphBuffer( Render_Graph *graph, char *name, VkBuffer buffer )
+{
+    u32 index = AddResource( graph, name, RENDER_GRAPH_IMPORTED_BUFFER );
+    if ( index != RENDER_GRAPH_INVALID )
+    {
+        graph->resources[ index ].buffer = buffer;
+    }
+    return index;
+}
+
+u32 AddRenderGraphPass( Render_Graph *graph, char *name, bool graphics, Render_Graph_Execute execute, void *data )
+{
+    if ( graph->compiled || graph->passCount == RENDER_GRAPH_MAX_PASSES )
+    {
+        printf( "Can't add render graph pass %s!\n", name );
+        return RENDER_GRAPH_INVALID;
+    }
+
+    Render_Graph_Pass *pass = &graph->passes[ graph->passCount ];
+    *pass = {};
+    pass->name = name;
+    pass->graphics = graphics;
+    pass->contents = VK_SUBPASS_CONTENTS_INLINE;
+    pass->execute = execute;
+    pass->data = data;
+    return graph->passCount++;
+}
+
+static Render_Graph_Access *FindAccess( Render_Graph_Pass *pass, u32 resource )
+{
+    for ( u32 i = 0; i < pass->accessCount; ++i )
+    {
+        if ( pass->accesses[ i ].resource == resource )
+        {
+            return &pass->accesses[ i ];
+        }
+    }
+    return 0;
+}
+
+void UseRenderGraphResource( Render_Graph *graph, u32 pass, u32 resource, Render_Graph_Usage usage )
+{
+    if ( pass >= graph->passCount || resource >= graph->resourceCount )
+    {
+        return;
+    }
+
+    Render_Graph_Pass *graphPass = &graph->passes[ pass ];
+    if ( graphPass->accessCount == RENDER_GRAPH_MAX_PASS_ACCESSES )
+    {
+        printf( "Render graph pass %s uses too many resources!\n", graphPass->name );
+        return;
+    }
+    if ( IsAttachmentUsage( usage ) && !graphPass->graphics )
+    {
+        printf( "Render graph pass %s can't have attachments outside a render pass!\n", graphPass->name );
+        return;
+    }
+
+    Render_Graph_Access *access = &graphPass->accesses[ graphPass->accessCount++ ];
+    *access = {};
+    access->resource = resource;
+    access->usage = usage;
+}
+
+void ClearRenderGraphAttachment( Render_Graph *graph, u32 pass, u32 resource, VkClearValue clearValue )
+{
+    if ( pass >= graph->passCount )
+    {
+        return;
+    }
+
+    Render_Graph_Access *access = FindAccess( &graph->passes[ pass ], resource );
+    if ( !access || !IsAttachmentUsage( access->usage ) )
+    {
+        printf( "Render graph pass %s only clears its attachments!\n", graph->passes[ pass ].name );
+        return;
+    }
+    access->clear = true;
+    access->clearValue = clearValue;
+}
+
+// Walks the passes backwards from the imported images, anything that doesn't feed them is culled
+static void CullPasses( Render_Graph *graph )
+{
+    bool needed[ RENDER_GRAPH_MAX_RESOURCES ] = {};
+    for ( u32 i = 0; i < graph->resourceCount; ++i )
+    {
+        needed[ i ] = graph->resources[ i ].kind == RENDER_GRAPH_IMPORTED_IMAGE;
+    }
+
+    for ( u32 p = graph->passCount; p-- > 0; )
+    {
+        Render_Graph_Pass *pass = &graph->passes[ p ];
+        bool alive = pass->sideEffects;
+        for ( u32 i = 0; i < pass->accessCount; ++i )
+        {
+            if ( usageInfos[ pass->accesses[ i ].usage ].write && needed[ pass->accesses[ i ].resource ] )
+            {
+                alive = true;
+            }
+        }
+
+        pass->culled = !alive;
+        if ( !alive )
+        {
+            continue;
+        }
+
+        // a cleared attachment doesn't depend on whoever wrote it before, everything else does
+        for ( u32 i = 0; i < pass->accessCount; ++i )
+        {
+            Render_Graph_Access *access = &pass->accesses[ i ];
+            needed[ access->resource ] = !access->clear;
+        }
+    }
+}
+
+static void ComputeLifetimes( Render_Graph *graph )
+{
+    for ( u32 i = 0; i < graph->resourceCount; ++i )
+    {
+        graph->resources[ i ].firstPass = RENDER_GRAPH_INVALID;
+        graph->resources[ i ].lastPass = RENDER_GRAPH_INVALID;
+    }
+
+    for ( u32 p = 0; p < graph->passCount; ++p )
+    {
+        Render_Graph_Pass *pass = &graph->passes[ p ];
+        if ( pass->culled )
+        {
+            continue;
+        }
+        for ( u32 i = 0; i < pass->accessCount; ++i )
+        {
+            Render_Graph_Resource *resource = &graph->resources[ pass->accesses[ i ].resource ];
+            if ( resource->firstPass == RENDER_GRAPH_INVALID ) resource->firstPass = p;
+            resource->lastPass = p;
+        }
+    }
+}
+
+// Colors first, then depth, the framebuffer views follow the same order
+static u32 GetPassAttachments( Render_Graph_Pass *pass, Render_Graph_Access **attachments )
+{
+    u32 count = 0;
+    for ( u32 i = 0; i < pass->accessCount; ++i )
+    {
+        if ( pass->accesses[ i ].usage == RENDER_GRAPH_COLOR_ATTACHMENT ) attachments[ count++ ] = &pass->accesses[ i ];
+    }
+    for ( u32 i = 0; i < pass->accessCount; ++i )
+    {
+        if ( pass->accesses[ i ].usage == RENDER_GRAPH_DEPTH_ATTACHMENT ) attachments[ count++ ] = &pass->accesses[ i ];
+    }
+    return count;
+}
+
+// The graph does every layout transition with its own barriers, so attachments stay in one layout for the whole pass
+static bool CreatePassRenderPass( Render_Graph *graph, u32 passIndex )
+{
+    Render_Graph_Pass *pass = &graph->passes[ passIndex ];
+    Render_Graph_Access *attachments[ RENDER_GRAPH_MAX_PASS_ACCESSES ];
+    u32 attachmentCount = GetPassAttachments( pass, attachments );
+
+    VkAttachmentDescription descriptions[ RENDER_GRAPH_MAX_PASS_ACCESSES ] = {};
+    VkAttachmentReference colorReferences[ RENDER_GRAPH_MAX_PASS_ACCESSES ] = {};
+    VkAttachmentReference depthReference = {};
+    u32 colorCount = 0;
+    bool hasDepth = false;
+    for ( u32 i = 0; i < attachmentCount; ++i )
+    {
+        Render_Graph_Access *access = attachments[ i ];
+        Render_Graph_Resource *resource = &graph->resources[ access->resource ];
+        bool transient = resource->kind == RENDER_GRAPH_TRANSIENT_IMAGE;
+        VkImageLayout layout = usageInfos[ access->usage ].layout;
+
+        VkAttachmentDescription *description = &descriptions[ i ];
+        description->format = resource->format;
+        description->samples = VK_SAMPLE_COUNT_1_BIT;
+        // nothing written before the first use survives, imported images are discarded at the start of the frame
+        if ( access->clear ) description->loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        else if ( resource->firstPass == passIndex ) description->loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        else description->loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        description->storeOp = transient && resource->lastPass == passIndex ? VK_ATTACHMENT_STORE_OP_DONT_CARE
+                                                                             : VK_ATTACHMENT_STORE_OP_STORE;
+        description->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        description->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        description->initialLayout = layout;
+        description->finalLayout = layout;
+
+        if ( access->usage == RENDER_GRAPH_DEPTH_ATTACHMENT )
+        {
+            depthReference = { i, layout };
+            hasDepth = true;
+        }
+        else
+        {
+            colorReferences[ colorCount++ ] = { i, layout };
+        }
+    }
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = colorCount;
+    subpass.pColorAttachments = colorReferences;
+    subpass.pDepthStencilAttachment = hasDepth ? &depthReference : 0;
+
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = attachmentCount;
+    renderPassInfo.pAttachments = descriptions;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+
+    if ( vkCreateRenderPass( graph->device->device, &renderPassInfo, 0, &pass->renderPass ) != VK_SUCCESS )
+    {
+        printf( "Failed to create render pass for %s!\n", pass->name );
+        return false;
+    }
+    return true;
+}
+
+static bool LifetimesOverlap( Render_Graph_Resource *a, Render_Graph_Resource *b )
+{
+    return a->firstPass <= b->lastPass && b->firstPass <= a->lastPass;
+}
+
+static bool MemoryOverlaps( Render_Graph_Resource *a, Render_Graph_Resource *b )
+{
+    return a->memoryOffset < b->memoryOffset + b->memorySize && b->memoryOffset < a->memoryOffset + a->memorySize;
+}
+
+static bool IsUsedTransient( Render_Graph_Resource *resource )
+{
+    return resource->kind == RENDER_GRAPH_TRANSIENT_IMAGE && resource->firstPass != RENDER_GRAPH_INVALID;
+}
+
+// Biggest first, each image goes at the lowest offset that doesn't collide with one alive at the same time
+static VkDeviceSize PlaceTransients( Render_Graph *graph, VkMemoryRequirements *requirements )
+{
+    u32 order[ RENDER_GRAPH_MAX_RESOURCES ];
+    u32 count = 0;
+    for ( u32 i = 0; i < graph->resourceCount; ++i )
+    {
+        if ( IsUsedTransient( &graph->resources[ i ] ) ) order[ count++ ] = i;
+    }
+    std::sort( order, order + count, [ requirements ]( u32 a, u32 b ) { return requirements[ a ].size > requirements[ b ].size; } );
+
+    VkDeviceSize heapSize = 0;
+    for ( u32 i = 0; i < count; ++i )
+    {
+        Render_Graph_Resource *resource = &graph->resources[ order[ i ] ];
+        VkDeviceSize alignment = requirements[ order[ i ] ].alignment;
+        resource->memorySize = requirements[ order[ i ] ].size;
+        resource->memoryOffset = 0;
+
+        bool moved = true;
+        while ( moved )
+        {
+            moved = false;
+            for ( u32 j = 0; j < i; ++j )
+            {
+                Render_Graph_Resource *placed = &graph->resources[ order[ j ] ];
+                if ( LifetimesOverlap( resource, placed ) && MemoryOverlaps( resource, placed ) )
+                {
+                    VkDeviceSize end = placed->memoryOffset + placed->memorySize;
+                    resource->memoryOffset = ( end + alignment - 1 ) & ~( alignment - 1 );
+                    moved = true;
+                }
+            }
+        }
+
+        VkDeviceSize end = resource->memoryOffset + resource->memorySize;
+        if ( end > heapSize ) heapSize = end;
+    }
+    return heapSize;
+}
+
+static VkImage CreateTransientImage( Render_Graph *graph, Render_Graph_Resource *resource )
+{
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = graph->extent.width;
+    imageInfo.extent.height = graph->extent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = resource->format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = resource->usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkImage image = VK_NULL_HANDLE;
+    if ( vkCreateImage( graph->device->device, &imageInfo, 0, &image ) != VK_SUCCESS )
+    {
+        printf( "Failed to create render graph image %s!\n", resource->name );
+    }
+    return image;
+}
+
+static bool CreateTransientTargets( Render_Graph *graph )
+{
+    VkDevice device = graph->device->device;
+    VkMemoryRequirements requirements[ RENDER_GRAPH_MAX_RESOURCES ] = {};
+    VkMemoryRequirements heapRequirements = {};
+    heapRequirements.alignment = 1;
+    heapRequirements.memoryTypeBits = 0xffffffff;
+
+    graph->stats.transientCount = 0;
+    graph->stats.transientBytes = 0;
+    for ( u32 frame = 0; frame < graph->framesInFlight; ++frame )
+    {
+        for ( u32 i = 0; i < graph->resourceCount; ++i )
+        {
+            Render_Graph_Resource *resource = &graph->resources[ i ];
+            if ( !IsUsedTransient( resource ) )
+            {
+                continue;
+            }
+
+            resource->images[ frame ] = CreateTransientImage( graph, resource );
+            if ( resource->images[ frame ] == VK_NULL_HANDLE )
+            {
+                return false;
+            }
+            if ( frame == 0 )
+            {
+                vkGetImageMemoryRequirements( device, resource->images[ 0 ], &requirements[ i ] );
+                heapRequirements.memoryTypeBits &= requirements[ i ].memoryTypeBits;
+                if ( requirements[ i ].alignment > heapRequirements.alignment ) heapRequirements.alignment = requirements[ i ].alignment;
+                graph->stats.transientCount++;
+                graph->stats.transientBytes += requirements[ i ].size;
+            }
+        }
+    }
+
+    // every frame in flight gets the same layout in its own allocation
+    heapRequirements.size = PlaceTransients( graph, requirements );
+    graph->stats.aliasedBytes = heapRequirements.size;
+    if ( heapRequirements.size == 0 )
+    {
+        return true;
+    }
+
+    for ( u32 frame = 0; frame < graph->framesInFlight; ++frame )
+    {
+        Gpu_Allocation *memory = &graph->transientMemory[ frame ];
+        *memory = AllocateGpuMemory( &graph->device->allocator, heapRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false );
+        if ( memory->memory == VK_NULL_HANDLE )
+        {
+            printf( "Failed to allocate render graph memory!\n" );
+            return false;
+        }
+
+        for ( u32 i = 0; i < graph->resourceCount; ++i )
+        {
+            Render_Graph_Resource *resource = &graph->resources[ i ];
+            if ( !IsUsedTransient( resource ) )
+            {
+                continue;
+            }
+
+            vkBindImageMemory( device, resource->images[ frame ], memory->memory, memory->offset + resource->memoryOffset );
+
+            VkImageViewCreateInfo viewInfo = {};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = resource->images[ frame ];
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = resource->format;
+            viewInfo.subresourceRange.aspectMask = resource->aspect;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.layerCount = 1;
+            if ( vkCreateImageView( device, &viewInfo, 0, &resource->views[ frame ] ) != VK_SUCCESS )
+            {
+                printf( "Failed to create render graph image view %s!\n", resource->name );
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void RetireTargets( Render_Graph *graph, u64 frameNumber )
+{
+    Retired_Render_Graph_Targets retired;
+    for ( u32 i = 0; i < graph->resourceCount; ++i )
+    {
+        Render_Graph_Resource *resource = &graph->resources[ i ];
+        if ( resource->kind != RENDER_GRAPH_TRANSIENT_IMAGE )
+        {
+            continue;
+        }
+        for ( u32 frame = 0; frame < RENDER_GRAPH_MAX_FRAMES; ++frame )
+        {
+            if ( resource->views[ frame ] != VK_NULL_HANDLE ) retired.views.push_back( resource->views[ frame ] );
+            if ( resource->images[ frame ] != VK_NULL_HANDLE ) retired.images.push_back( resource->images[ frame ] );
+            resource->views[ frame ] = VK_NULL_HANDLE;
+            resource->images[ frame ] = VK_NULL_HANDLE;
+        }
+    }
+    for ( u32 frame = 0; frame < RENDER_GRAPH_MAX_FRAMES; ++frame )
+    {
+        if ( graph->transientMemory[ frame ].memory != VK_NULL_HANDLE ) retired.memory.push_back( graph->transientMemory[ frame ] );
+        graph->transientMemory[ frame ] = {};
+    }
+    for ( auto &framebuffer : graph->framebuffers )
+    {
+        retired.framebuffers.push_back( framebuffer.framebuffer );
+    }
+    graph->framebuffers.clear();
+
+    retired.retireFrame = frameNumber;
+    graph->retired.push_back( std::move( retired ) );
+}
+
+static void DestroyRetiredTargets( Render_Graph *graph, Retired_Render_Graph_Targets *retired )
+{
+    VkDevice device = graph->device->device;
+    for ( auto framebuffer : retired->framebuffers ) vkDestroyFramebuffer( device, framebuffer, 0 );
+    for ( auto view : retired->views ) vkDestroyImageView( device, view, 0 );
+    for ( auto image : retired->images ) vkDestroyImage( device, image, 0 );
+    for ( auto &memory : retired->memory ) FreeGpuMemory( &graph->device->allocator, &memory );
+}
+
+bool CompileRenderGraph( Render_Graph *graph, VkExtent2D extent )
+{
+    TRACE_FUNCTION();
+    CullPasses( graph );
+    ComputeLifetimes( graph );
+
+    graph->stats.passCount = graph->passCount;
+    graph->stats.culledPassCount = 0;
+    for ( u32 p = 0; p < graph->passCount; ++p )
+    {
+        Render_Graph_Pass *pass = &graph->passes[ p ];
+        if ( pass->culled )
+        {
+            graph->stats.culledPassCount++;
+            continue;
+        }
+        if ( pass->graphics && !CreatePassRenderPass( graph, p ) )
+        {
+            return false;
+        }
+    }
+
+    graph->extent = extent;
+    graph->compiled = true;
+    return CreateTransientTargets( graph );
+}
+
+bool UpdateRenderGraphTargets( Render_Graph *graph, VkExtent2D extent, u64 generation, u64 frameNumber )
+{
+    if ( extent.width == graph->extent.width && extent.height == graph->extent.height && generation == graph->targetGeneration )
+    {
+        return true;
+    }
+
+    RetireTargets( graph, frameNumber );
+    graph->extent = extent;
+    graph->targetGeneration = generation;
+    if ( !CreateTransientTargets( graph ) )
+    {
+        // no swap chain generation matches, the next call retires what was created and tries again
+        graph->targetGeneration = ~0ull;
+        return false;
+    }
+    return true;
+}
+
+void DestroyRenderGraph( Render_Graph *graph )
+{
+    RetireTargets( graph, 0 );
+    for ( auto &retired : graph->retired )
+    {
+        DestroyRetiredTargets( graph, &retired );
+    }
+    graph->retired.clear();
+
+    for ( u32 p = 0; p < graph->passCount; ++p )
+    {
+        if ( graph->passes[ p ].renderPass != VK_NULL_HANDLE )
+        {
+            vkDestroyRenderPass( graph->device->device, graph->passes[ p ].renderPass, 0 );
+        }
+    }
+    graph->passCount = 0;
+    graph->resourceCount = 0;
+    graph->compiled = false;
+}
+
+void SetRenderGraphImage( Render_Graph *graph, u32 resource, VkImage image, VkImageView view )
+{
+    if ( resource >= graph->resourceCount || graph->resources[ resource ].kind != RENDER_GRAPH_IMPORTED_IMAGE )
+    {
+        return;
+    }
+    graph->resources[ resource ].image = image;
+    graph->resources[ resource ].view = view;
+}
+
+void SetRenderGraphBuffer( Render_Graph *graph, u32 resource, VkBuffer buffer )
+{
+    if ( resource >= graph->resourceCount || graph->resources[ resource ].kind != RENDER_GRAPH_IMPORTED_BUFFER )
+    {
+        return;
+    }
+    graph->resources[ resource ].buffer = buffer;
+}
+
+void BeginRenderGraphFrame( Render_Graph *graph, u32 frameIndex, u64 frameNumber )
+{
+    for ( size_t i = 0; i < graph->retired.size(); )
+    {
+        if ( graph->retired[ i ].retireFrame + graph->framesInFlight <= frameNumber )
+        {
+            DestroyRetiredTargets( graph, &graph->retired[ i ] );
+            graph->retired[ i ] = std::move( graph->retired.back() );
+            graph->retired.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    graph->frameIndex = frameIndex;
+    for ( u32 i = 0; i < graph->resourceCount; ++i )
+    {
+        Render_Graph_Resource *resource = &graph->resources[ i ];
+        if ( resource->kind == RENDER_GRAPH_TRANSIENT_IMAGE )
+        {
+            resource->image = resource->images[ frameIndex ];
+            resource->view = resource->views[ frameIndex ];
+        }
+    }
+}
+
+VkRenderPass GetRenderGraphRenderPass( Render_Graph *graph, u32 pass )
+{
+    return pass < graph->passCount ? graph->passes[ pass ].renderPass : VK_NULL_HANDLE;
+}
+
+VkFramebuffer GetRenderGraphFramebuffer( Render_Graph *graph, u32 pass )
+{
+    if ( pass >= graph->passCount || graph->passes[ pass ].renderPass == VK_NULL_HANDLE )
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    Render_Graph_Pass *graphPass = &graph->passes[ pass ];
+    Render_Graph_Access *attachments[ RENDER_GRAPH_MAX_PASS_ACCESSES ];
+    u32 attachmentCount = GetPassAttachments( graphPass, attachments );
+
+    Render_Graph_Framebuffer entry = {};
+    entry.pass = pass;
+    for ( u32 i = 0; i < attachmentCount; ++i )
+    {
+        entry.views[ i ] = graph->resources[ attachments[ i ]->resource ].view;
+    }
+
+    // one per combination of swap chain image and frame in flight, dropped whenever the targets change
+    for ( auto &framebuffer : graph->framebuffers )
+    {
+        if ( framebuffer.pass == pass && memcmp( framebuffer.views, entry.views, sizeof( entry.views ) ) == 0 )
+        {
+            return framebuffer.framebuffer;
+        }
+    }
+
+    VkFramebufferCreateInfo framebufferInfo = {};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = graphPass->renderPass;
+    framebufferInfo.attachmentCount = attachmentCount;
+    framebufferInfo.pAttachments = entry.views;
+    framebufferInfo.width = graph->extent.width;
+    framebufferInfo.height = graph->extent.height;
+    framebufferInfo.layers = 1;
+    if ( vkCreateFramebuffer( graph->device->device, &framebufferInfo, 0, &entry.framebuffer ) != VK_SUCCESS )
+    {
+        printf( "Failed to create framebuffer for %s!\n", graphPass->name );
+        return VK_NULL_HANDLE;
+    }
+    graph->framebuffers.push_back( entry );
+    return entry.framebuffer;
+}
+
+struct Render_Graph_Barrier
+{
+    VkPipelineStageFlags srcStages;
+    VkPipelineStageFlags dstStages;
+    VkMemoryBarrier memoryBarrier;
+    VkImageMemoryBarrier imageBarriers[ RENDER_GRAPH_MAX_RESOURCES ];
+    u32 imageBarrierCount;
+    u32 transitionCount;
+};
+
+static void ResetBarrier( Render_Graph_Barrier *barrier )
+{
+    barrier->srcStages = 0;
+    barrier->dstStages = 0;
+    barrier->memoryBarrier = {};
+    barrier->memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier->imageBarrierCount = 0;
+    barrier->transitionCount = 0;
+}
+
+// Adds whatever the new access needs to wait for, reads after reads in the same layout need nothing
+static void AddTransition( Render_Graph *graph, Render_Graph_Barrier *barrier, Render_Graph_Resource *resource,
+                           VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout, bool write,
+                           VkPipelineStageFlags aliasStages, VkAccessFlags aliasAccess )
+{
+    Render_Graph_State *state = &resource->state;
+    bool image = resource->kind != RENDER_GRAPH_IMPORTED_BUFFER;
+    bool layoutChange = image && state->layout != layout;
+
+    bool hazard = layoutChange || aliasStages != 0;
+    if ( write ) hazard = hazard || state->writeStages != 0 || state->readStages != 0;
+    else hazard = hazard || ( state->writeAccess != 0 && ( stages & ~state->readStages ) != 0 );
+
+    if ( hazard )
+    {
+        VkPipelineStageFlags srcStages = state->writeStages | state->readStages | aliasStages;
+        VkAccessFlags srcAccess = state->writeAccess | aliasAccess;
+        barrier->srcStages |= srcStages;
+        barrier->dstStages |= stages;
+        barrier->transitionCount++;
+
+        if ( image )
+        {
+            VkImageMemoryBarrier *imageBarrier = &barrier->imageBarriers[ barrier->imageBarrierCount++ ];
+            *imageBarrier = {};
+            imageBarrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            imageBarrier->srcAccessMask = srcAccess;
+            imageBarrier->dstAccessMask = access;
+            imageBarrier->oldLayout = state->layout;
+            imageBarrier->newLayout = layout;
+            imageBarrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier->image = resource->image;
+            imageBarrier->subresourceRange.aspectMask = resource->aspect;
+            imageBarrier->subresourceRange.levelCount = 1;
+            imageBarrier->subresourceRange.layerCount = 1;
+        }
+        else
+        {
+            // buffers share one global barrier
+            barrier->memoryBarrier.srcAccessMask |= srcAccess;
+            barrier->memoryBarrier.dstAccessMask |= access;
+        }
+    }
+
+    if ( write )
+    {
+        state->writeStages = stages;
+        state->writeAccess = access & ( VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT );
+        state->readStages = 0;
+    }
+    else
+    {
+        state->readStages |= stages;
+    }
+    state->layout = image ? layout : VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
+static void FlushBarrier( Render_Graph *graph, Render_Graph_Barrier *barrier, VkCommandBuffer commandBuffer )
+{
+    if ( barrier->transitionCount == 0 )
+    {
+        return;
+    }
+
+    // nothing before a transition out of UNDEFINED, nothing after the final one
+    VkPipelineStageFlags srcStages = barrier->srcStages ? barrier->srcStages : ( VkPipelineStageFlags ) VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    VkPipelineStageFlags dstStages = barrier->dstStages ? barrier->dstStages : ( VkPipelineStageFlags ) VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    bool memory = barrier->memoryBarrier.srcAccessMask != 0 || barrier->memoryBarrier.dstAccessMask != 0;
+    vkCmdPipelineBarrier( commandBuffer, srcStages, dstStages, 0, memory ? 1 : 0, &barrier->memoryBarrier, 0, 0,
+                          barrier->imageBarrierCount, barrier->imageBarriers );
+    graph->stats.transitionCount += barrier->transitionCount;
+    graph->stats.barrierCount++;
+}
+
+static void AddPassTransitions( Render_Graph *graph, Render_Graph_Barrier *barrier, u32 passIndex )
+{
+    Render_Graph_Pass *pass = &graph->passes[ passIndex ];
+    bool handled[ RENDER_GRAPH_MAX_PASS_ACCESSES ] = {};
+    for ( u32 i = 0; i < pass->accessCount; ++i )
+    {
+        if ( handled[ i ] )
+        {
+            continue;
+        }
+
+        // a pass using a resource more than one way waits for all of them at once
+        u32 resourceIndex = pass->accesses[ i ].resource;
+        Render_Graph_Usage_Info *info = &usageInfos[ pass->accesses[ i ].usage ];
+        VkPipelineStageFlags stages = info->stages;
+        VkAccessFlags access = info->access;
+        bool write = info->write;
+        for ( u32 j = i + 1; j < pass->accessCount; ++j )
+        {
+            if ( pass->accesses[ j ].resource == resourceIndex )
+            {
+                stages |= usageInfos[ pass->accesses[ j ].usage ].stages;
+                access |= usageInfos[ pass->accesses[ j ].usage ].access;
+                write = write || usageInfos[ pass->accesses[ j ].usage ].write;
+                handled[ j ] = true;
+            }
+        }
+
+        // the first user of aliased memory waits for the last users of whatever lived there before
+        Render_Graph_Resource *resource = &graph->resources[ resourceIndex ];
+        VkPipelineStageFlags aliasStages = 0;
+        VkAccessFlags aliasAccess = 0;
+        if ( resource->kind == RENDER_GRAPH_TRANSIENT_IMAGE && resource->firstPass == passIndex )
+        {
+            for ( u32 r = 0; r < graph->resourceCount; ++r )
+            {
+                Render_Graph_Resource *other = &graph->resources[ r ];
+                if ( other != resource && IsUsedTransient( other ) && other->lastPass < passIndex && MemoryOverlaps( resource, other ) )
+                {
+                    aliasStages |= other->state.writeStages | other->state.readStages;
+                    aliasAccess |= other->state.writeAccess;
+                }
+            }
+        }
+
+        AddTransition( graph, barrier, resource, stages, access, info->layout, write, aliasStages, aliasAccess );
+    }
+}
+
+void ExecuteRenderGraph( Render_Graph *graph, VkCommandBuffer commandBuffer )
+{
+    TRACE_FUNCTION();
+    graph->stats.transitionCount = 0;
+    graph->stats.barrierCount = 0;
+
+    for ( u32 i = 0; i < graph->resourceCount; ++i )
+    {
+        Render_Graph_Resource *resource = &graph->resources[ i ];
+        if ( resource->kind == RENDER_GRAPH_IMPORTED_IMAGE )
+        {
+            // swap chain images are acquired with a semaphore waited on at this stage
+            resource->state = { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0 };
+        }
+        else if ( resource->kind == RENDER_GRAPH_TRANSIENT_IMAGE )
+        {
+            // the frame that last used this slot's memory has finished
+            resource->state = { VK_IMAGE_LAYOUT_UNDEFINED, 0, 0, 0 };
+        }
+    }
+
+    Render_Graph_Barrier barrier;
+    for ( u32 p = 0; p < graph->passCount; ++p )
+    {
+        Render_Graph_Pass *pass = &graph->passes[ p ];
+        if ( pass->culled )
+        {
+            continue;
+        }
+
+        ResetBarrier( &barrier );
+        AddPassTransitions( graph, &barrier, p );
+        FlushBarrier( graph, &barrier, commandBuffer );
+
+        u32 zone = graph->profiler ? BeginGpuZone( graph->profiler, commandBuffer, pass->name, pass->pipelineStatistics ) : 0;
+
+        Render_Graph_Context context = {};
+        context.commandBuffer = commandBuffer;
+        context.extent = graph->extent;
+        context.frameIndex = graph->frameIndex;
+        if ( pass->graphics )
+        {
+            context.renderPass = pass->renderPass;
+            context.framebuffer = GetRenderGraphFramebuffer( graph, p );
+
+            Render_Graph_Access *attachments[ RENDER_GRAPH_MAX_PASS_ACCESSES ];
+            u32 attachmentCount = GetPassAttachments( pass, attachments );
+            VkClearValue clearValues[ RENDER_GRAPH_MAX_PASS_ACCESSES ] = {};
+            for ( u32 i = 0; i < attachmentCount; ++i )
+            {
+                clearValues[ i ] = attachments[ i ]->clearValue;
+            }
+
+            VkRenderPassBeginInfo renderPassInfo = {};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = context.renderPass;
+            renderPassInfo.framebuffer = context.framebuffer;
+            renderPassInfo.renderArea.extent = graph->extent;
+            renderPassInfo.clearValueCount = attachmentCount;
+            renderPassInfo.pClearValues = clearValues;
+            vkCmdBeginRenderPass( commandBuffer, &renderPassInfo, pass->contents );
+            pass->execute( &context, pass->data );
+            vkCmdEndRenderPass( commandBuffer );
+        }
+        else
+        {
+            pass->execute( &context, pass->data );
+        }
+
+        if ( graph->profiler )
+        {
+            EndGpuZone( graph->profiler, commandBuffer, zone );
+        }
+    }
+
+    // imported images end the frame in the layout whoever takes them next expects
+    ResetBarrier( &barrier );
+    for ( u32 i = 0; i < graph->resourceCount; ++i )
+    {
+        Render_Graph_Resource *resource = &graph->resources[ i ];
+        if ( resource->kind != RENDER_GRAPH_IMPORTED_IMAGE || resource->firstPass == RENDER_GRAPH_INVALID ||
+             resource->state.layout == resource->finalLayout )
+        {
+            continue;
+        }
+
+        bool readBack = resource->finalLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        AddTransition( graph, &barrier, resource, readBack ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                       readBack ? VK_ACCESS_TRANSFER_READ_BIT : 0, resource->finalLayout, false, 0, 0 );
+    }
+    FlushBarrier( graph, &barrier, commandBuffer );
+}
+
+void PrintRenderGraphStats( Render_Graph *graph )
+{
+    Render_Graph_Stats *stats = &graph->stats;
+    printf( "Render graph: %u passes, %u culled, %u transient images\n", stats->passCount, stats->culledPassCount,
+            stats->transientCount );
+    printf( "  transient memory: %.2f MB per frame in flight, %.2f MB without aliasing (%.2f MB saved over %u frames)\n",
+            ( float64 ) stats->aliasedBytes / ( 1024.0 * 1024.0 ), ( float64 ) stats->transientBytes / ( 1024.0 * 1024.0 ),
+            ( float64 ) ( stats->transientBytes - stats->aliasedBytes ) * graph->framesInFlight / ( 1024.0 * 1024.0 ),
+            graph->framesInFlight );
+    printf( "  barriers: %u transitions merged into %u barriers a frame\n", stats->transitionCount, stats->barrierCount );
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "device.h"
+#include "gpu_profiler.h"
+#include "utils/utils.h"
+#include <vector> //@TODO: Remove std garbage
+
+#define RENDER_GRAPH_MAX_PASSES 32
+#define RENDER_GRAPH_MAX_RESOURCES 32
+#define RENDER_GRAPH_MAX_PASS_ACCESSES 8
+#define RENDER_GRAPH_MAX_FRAMES 4
+#define RENDER_GRAPH_INVALID 0xffffffff
+
+// How a pass touches a resource, the graph derives stages, access masks and layouts from it
+enum Render_Graph_Usage
+{
+    RENDER_GRAPH_COLOR_ATTACHMENT,
+    RENDER_GRAPH_DEPTH_ATTACHMENT,
+    RENDER_GRAPH_SAMPLED,
+    RENDER_GRAPH_STORAGE_READ,
+    RENDER_GRAPH_STORAGE_WRITE,
+    RENDER_GRAPH_INDIRECT_READ,
+    RENDER_GRAPH_TRANSFER_READ,
+    RENDER_GRAPH_TRANSFER_WRITE,
+    RENDER_GRAPH_USAGE_COUNT,
+};
+
+enum Render_Graph_Resource_Kind
+{
+    // created by the graph once per frame in flight, memory is shared between images whose passes don't overlap
+    RENDER_GRAPH_TRANSIENT_IMAGE,
+    // set every frame, contents are discarded at the start of the frame and finalLayout is left at the end
+    RENDER_GRAPH_IMPORTED_IMAGE,
+    // lives across frames, its last access carries over into the next frame's first barrier
+    RENDER_GRAPH_IMPORTED_BUFFER,
+};
+
+// What has touched a resource since its last barrier
+struct Render_Graph_State
+{
+    VkImageLayout layout;
+    VkPipelineStageFlags writeStages;
+    VkAccessFlags writeAccess;
+    VkPipelineStageFlags readStages;
+};
+
+struct Render_Graph_Resource
+{
+    char *name;
+    Render_Graph_Resource_Kind kind;
+    VkFormat format;
+    VkImageUsageFlags usage;
+    VkImageAspectFlags aspect;
+    VkImageLayout finalLayout;
+
+    // this frame's handles, transients have one per frame in flight
+    VkImage image;
+    VkImageView view;
+    VkBuffer buffer;
+    VkImage images[ RENDER_GRAPH_MAX_FRAMES ];
+    VkImageView views[ RENDER_GRAPH_MAX_FRAMES ];
+
+    // first and last pass using it after culling, transients overlapping in memory never overlap here
+    u32 firstPass;
+    u32 lastPass;
+    VkDeviceSize memoryOffset;
+    VkDeviceSize memorySize;
+
+    Render_Graph_State state;
+};
+
+struct Render_Graph_Access
+{
+    u32 resource;
+    Render_Graph_Usage usage;
+    bool clear;
+    VkClearValue clearValue;
+};
+
+struct Render_Graph_Context
+{
+    VkCommandBuffer commandBuffer;
+    VkRenderPass renderPass;
+    VkFramebuffer framebuffer;
+    VkExtent2D extent;
+    u32 frameIndex;
+};
+
+typedef void ( *Render_Graph_Execute )( Render_Graph_Context *context, void *data );
+
+struct Render_Graph_Pass
+{
+    char *name; // string literal, also the GPU profiler zone
+    Render_Graph_Execute execute;
+    void *data;
+
+    Render_Graph_Access accesses[ RENDER_GRAPH_MAX_PASS_ACCESSES ];
+    u32 accessCount;
+
+    // graphics passes run inside a render pass built from their attachments
+    bool graphics;
+    VkSubpassContents contents;
+    bool pipelineStatistics;
+    // kept even when nothing reads what it writes
+    bool sideEffects;
+    bool culled;
+
+    VkRenderPass renderPass;
+};
+
+struct Render_Graph_Framebuffer
+{
+    u32 pass;
+    VkImageView views[ RENDER_GRAPH_MAX_PASS_ACCESSES ];
+    VkFramebuffer framebuffer;
+};
+
+// Everything sized by the extent, destroyed once the frames that used it have finished
+struct Retired_Render_Graph_Targets
+{
+    std::vector< VkImage > images;
+    std::vector< VkImageView > views;
+    std::vector< VkFramebuffer > framebuffers;
+    std::vector< Gpu_Allocation > memory;
+    u64 retireFrame;
+};
+
+struct Render_Graph_Stats
+{
+    u32 passCount;
+    u32 culledPassCount;
+    u32 transientCount;
+    // per frame in flight
+    VkDeviceSize transientBytes;
+    VkDeviceSize aliasedBytes;
+    // last frame, transitions are per resource and get merged into one barrier per pass
+    u32 transitionCount;
+    u32 barrierCount;
+};
+
+struct Render_Graph
+{
+    Device *device;
+    Gpu_Profiler *profiler;
+    u32 framesInFlight;
+    VkExtent2D extent;
+    u64 targetGeneration;
+    bool compiled;
+
+    Render_Graph_Pass passes[ RENDER_GRAPH_MAX_PASSES ];
+    u32 passCount;
+    Render_Graph_Resource resources[ RENDER_GRAPH_MAX_RESOURCES ];
+    u32 resourceCount;
+
+    // one allocation per frame in flight holds every transient image
+    Gpu_Allocation transientMemory[ RENDER_GRAPH_MAX_FRAMES ];
+    std::vector< Render_Graph_Framebuffer > framebuffers;
+    std::vector< Retired_Render_Graph_Targets > retired;
+
+    u32 frameIndex;
+    Render_Graph_Stats stats;
+};
+
+void InitRenderGraph( Render_Graph *graph, Device *device, Gpu_Profiler *profiler, u32 framesInFlight );
+void DestroyRenderGraph( Render_Graph *graph );
+
+u32 AddRenderGraphImage( Render_Graph *graph, char *name, VkFormat format, VkImageUsageFlags usage );
+u32 ImportRenderGraphImage( Render_Graph *graph, char *name, VkFormat format, VkImageLayout finalLayout );
+u32 ImportRenderGraphBuffer( Render_Graph *graph, char *name, VkBuffer buffer );
+
+u32 AddRenderGraphPass( Render_Graph *graph, char *name, bool graphics, Render_Graph_Execute execute, void *data );
+void UseRenderGraphResource( Render_Graph *graph, u32 pass, u32 resource, Render_Graph_Usage usage );
+// Attachments are loaded unless cleared, transients nobody wrote before are left undefined
+void ClearRenderGraphAttachment( Render_Graph *graph, u32 pass, u32 resource, VkClearValue clearValue );
+
+// Culls passes that don't lead to an imported image, creates render passes and places transients in memory
+bool CompileRenderGraph( Render_Graph *graph, VkExtent2D extent );
+
+// Recreates the transients and framebuffers when the extent or the swap chain changed, the old ones are retired.
+// False when the new ones couldn't be created, nothing may be recorded against the graph until a later call succeeds
+bool UpdateRenderGraphTargets( Render_Graph *graph, VkExtent2D extent, u64 generation, u64 frameNumber );
+
+void SetRenderGraphImage( Render_Graph *graph, u32 resource, VkImage image, VkImageView view );
+
+// For buffers with one copy per frame in flight, the access state carries over from whichever buffer came before
+void SetRenderGraphBuffer( Render_Graph *graph, u32 resource, VkBuffer buffer );
+
+// Call after the frame's fence has been waited on
+void BeginRenderGraphFrame( Render_Graph *graph, u32 frameIndex, u64 frameNumber );
+
+// For recording secondaries ahead of ExecuteRenderGraph, valid after BeginRenderGraphFrame
+VkRenderPass GetRenderGraphRenderPass( Render_Graph *graph, u32 pass );
+VkFramebuffer GetRenderGraphFramebuffer( Render_Graph *graph, u32 pass );
+
+void ExecuteRenderGraph( Render_Graph *graph, VkCommandBuffer commandBuffer );
+
+void PrintRenderGraphStats( Render_Graph *graph );
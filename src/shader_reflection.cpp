@@ -0,0 +1,747 @@
+#include "shader_reflection.h"
+#include "archive.h"
+#include "stdio.h"
+#include "string.h"
+
+// The few parts of the SPIR-V spec the reflection needs
+#define SPIRV_MAGIC 0x07230203
+#define SPIRV_HEADER_WORDS 5
+
+enum Spirv_Op
+{
+    SPIRV_OP_ENTRY_POINT = 15,
+    SPIRV_OP_TYPE_BOOL = 20,
+    SPIRV_OP_TYPE_INT = 21,
+    SPIRV_OP_TYPE_FLOAT = 22,
+    SPIRV_OP_TYPE_VECTOR = 23,
+    SPIRV_OP_TYPE_MATRIX = 24,
+    SPIRV_OP_TYPE_IMAGE = 25,
+    SPIRV_OP_TYPE_SAMPLER = 26,
+    SPIRV_OP_TYPE_SAMPLED_IMAGE = 27,
+    SPIRV_OP_TYPE_ARRAY = 28,
+    SPIRV_OP_TYPE_RUNTIME_ARRAY = 29,
+    SPIRV_OP_TYPE_STRUCT = 30,
+    SPIRV_OP_TYPE_POINTER = 32,
+    SPIRV_OP_CONSTANT = 43,
+    SPIRV_OP_SPEC_CONSTANT_TRUE = 48,
+    SPIRV_OP_SPEC_CONSTANT_FALSE = 49,
+    SPIRV_OP_SPEC_CONSTANT = 50,
+    SPIRV_OP_VARIABLE = 59,
+    SPIRV_OP_DECORATE = 71,
+    SPIRV_OP_MEMBER_DECORATE = 72,
+};
+
+enum Spirv_Decoration
+{
+    SPIRV_DECORATION_SPEC_ID = 1,
+    SPIRV_DECORATION_BLOCK = 2,
+    SPIRV_DECORATION_BUFFER_BLOCK = 3,
+    SPIRV_DECORATION_ROW_MAJOR = 4,
+    SPIRV_DECORATION_ARRAY_STRIDE = 6,
+    SPIRV_DECORATION_MATRIX_STRIDE = 7,
+    SPIRV_DECORATION_BUILT_IN = 11,
+    SPIRV_DECORATION_LOCATION = 30,
+    SPIRV_DECORATION_BINDING = 33,
+    SPIRV_DECORATION_DESCRIPTOR_SET = 34,
+    SPIRV_DECORATION_OFFSET = 35,
+};
+
+enum Spirv_Storage_Class
+{
+    SPIRV_STORAGE_UNIFORM_CONSTANT = 0,
+    SPIRV_STORAGE_INPUT = 1,
+    SPIRV_STORAGE_UNIFORM = 2,
+    SPIRV_STORAGE_PUSH_CONSTANT = 9,
+    SPIRV_STORAGE_STORAGE_BUFFER = 12,
+};
+
+#define SPIRV_DIM_BUFFER 5
+#define SPIRV_DIM_SUBPASS_DATA 6
+
+enum Spirv_Id_Flags
+{
+    SPIRV_ID_SET = 1 << 0,
+    SPIRV_ID_BINDING = 1 << 1,
+    SPIRV_ID_LOCATION = 1 << 2,
+    SPIRV_ID_SPEC_ID = 1 << 3,
+    SPIRV_ID_BLOCK = 1 << 4,
+    SPIRV_ID_BUFFER_BLOCK = 1 << 5,
+    SPIRV_ID_BUILT_IN = 1 << 6,
+};
+
+struct Spirv_Id
+{
+    u32 opcode;
+    // start of the instruction that defines the id
+    u32 word;
+    u32 flags;
+    u32 set;
+    u32 binding;
+    u32 location;
+    u32 specId;
+    u32 arrayStride;
+};
+
+struct Spirv_Member
+{
+    u32 structId;
+    u32 member;
+    u32 offset;
+    u32 matrixStride;
+    bool rowMajor;
+};
+
+struct Spirv_Module
+{
+    u32 *code;
+    u32 wordCount;
+    std::vector< Spirv_Id > ids;
+    std::vector< Spirv_Member > members;
+    VkShaderStageFlagBits stage;
+};
+
+static Spirv_Id *GetSpirvId( Spirv_Module *module, u32 id )
+{
+    static Spirv_Id missing = {};
+    return id < module->ids.size() ? &module->ids[ id ] : &missing;
+}
+
+// Operand index counts from the word after the opcode
+static u32 SpirvOperand( Spirv_Module *module, u32 id, u32 operand )
+{
+    Spirv_Id *entry = GetSpirvId( module, id );
+    u32 word = entry->word + 1 + operand;
+    return entry->opcode != 0 && word < module->wordCount ? module->code[ word ] : 0;
+}
+
+// Members that were never decorated have an offset of 0
+static Spirv_Member GetSpirvMember( Spirv_Module *module, u32 structId, u32 member )
+{
+    for ( Spirv_Member &entry : module->members )
+    {
+        if ( entry.structId == structId && entry.member == member )
+        {
+            return entry;
+        }
+    }
+    return { structId, member, 0, 0, false };
+}
+
+static Spirv_Member *FindSpirvMember( Spirv_Module *module, u32 structId, u32 member )
+{
+    for ( Spirv_Member &entry : module->members )
+    {
+        if ( entry.structId == structId && entry.member == member )
+        {
+            return &entry;
+        }
+    }
+    module->members.push_back( { structId, member, 0, 0, false } );
+    return &module->members.back();
+}
+
+static VkShaderStageFlagBits GetSpirvStage( u32 executionModel )
+{
+    switch ( executionModel )
+    {
+        case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+        case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+        case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+        case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+        case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+        case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    return ( VkShaderStageFlagBits ) 0;
+}
+
+static bool ParseSpirv( Spirv_Module *module, u32 *code, u64 size )
+{
+    if ( size < SPIRV_HEADER_WORDS * sizeof( u32 ) || ( size & 3 ) != 0 || code[ 0 ] != SPIRV_MAGIC )
+    {
+        printf( "Not a SPIR-V module!\n" );
+        return false;
+    }
+
+    module->code = code;
+    module->wordCount = ( u32 ) ( size / sizeof( u32 ) );
+    module->ids.assign( code[ 3 ], Spirv_Id{} );
+    module->members.clear();
+    module->stage = ( VkShaderStageFlagBits ) 0;
+
+    u32 word = SPIRV_HEADER_WORDS;
+    while ( word < module->wordCount )
+    {
+        u32 opcode = code[ word ] & 0xffff;
+        u32 instructionWords = code[ word ] >> 16;
+        if ( instructionWords == 0 || word + instructionWords > module->wordCount )
+        {
+            printf( "Truncated SPIR-V instruction at word %u!\n", word );
+            return false;
+        }
+        u32 *operands = &code[ word + 1 ];
+        u32 operandCount = instructionWords - 1;
+
+        switch ( opcode )
+        {
+            case SPIRV_OP_ENTRY_POINT:
+            {
+                // the first entry point decides the stage, modules here only ever have main
+                if ( operandCount >= 2 && module->stage == 0 )
+                {
+                    module->stage = GetSpirvStage( operands[ 0 ] );
+                }
+                break;
+            }
+            case SPIRV_OP_DECORATE:
+            {
+                if ( operandCount < 2 || operands[ 0 ] >= module->ids.size() ) break;
+                Spirv_Id *target = &module->ids[ operands[ 0 ] ];
+                u32 value = operandCount >= 3 ? operands[ 2 ] : 0;
+                switch ( operands[ 1 ] )
+                {
+                    case SPIRV_DECORATION_SPEC_ID: target->flags |= SPIRV_ID_SPEC_ID; target->specId = value; break;
+                    case SPIRV_DECORATION_BLOCK: target->flags |= SPIRV_ID_BLOCK; break;
+                    case SPIRV_DECORATION_BUFFER_BLOCK: target->flags |= SPIRV_ID_BUFFER_BLOCK; break;
+                    case SPIRV_DECORATION_ARRAY_STRIDE: target->arrayStride = value; break;
+                    case SPIRV_DECORATION_BUILT_IN: target->flags |= SPIRV_ID_BUILT_IN; break;
+                    case SPIRV_DECORATION_LOCATION: target->flags |= SPIRV_ID_LOCATION; target->location = value; break;
+                    case SPIRV_DECORATION_BINDING: target->flags |= SPIRV_ID_BINDING; target->binding = value; break;
+                    case SPIRV_DECORATION_DESCRIPTOR_SET: target->flags |= SPIRV_ID_SET; target->set = value; break;
+                }
+                break;
+            }
+            case SPIRV_OP_MEMBER_DECORATE:
+            {
+                if ( operandCount < 3 ) break;
+                u32 value = operandCount >= 4 ? operands[ 3 ] : 0;
+                switch ( operands[ 2 ] )
+                {
+                    case SPIRV_DECORATION_OFFSET: FindSpirvMember( module, operands[ 0 ], operands[ 1 ] )->offset = value; break;
+                    case SPIRV_DECORATION_MATRIX_STRIDE:
+                        FindSpirvMember( module, operands[ 0 ], operands[ 1 ] )->matrixStride = value;
+                        break;
+                    case SPIRV_DECORATION_ROW_MAJOR: FindSpirvMember( module, operands[ 0 ], operands[ 1 ] )->rowMajor = true; break;
+                }
+                break;
+            }
+            case SPIRV_OP_TYPE_BOOL:
+            case SPIRV_OP_TYPE_INT:
+            case SPIRV_OP_TYPE_FLOAT:
+            case SPIRV_OP_TYPE_VECTOR:
+            case SPIRV_OP_TYPE_MATRIX:
+            case SPIRV_OP_TYPE_IMAGE:
+            case SPIRV_OP_TYPE_SAMPLER:
+            case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+            case SPIRV_OP_TYPE_ARRAY:
+            case SPIRV_OP_TYPE_RUNTIME_ARRAY:
+            case SPIRV_OP_TYPE_STRUCT:
+            case SPIRV_OP_TYPE_POINTER:
+            {
+                // types define their result id first
+                if ( operandCount >= 1 && operands[ 0 ] < module->ids.size() )
+                {
+                    module->ids[ operands[ 0 ] ].opcode = opcode;
+                    module->ids[ operands[ 0 ] ].word = word;
+                }
+                break;
+            }
+            case SPIRV_OP_CONSTANT:
+            case SPIRV_OP_SPEC_CONSTANT_TRUE:
+            case SPIRV_OP_SPEC_CONSTANT_FALSE:
+            case SPIRV_OP_SPEC_CONSTANT:
+            case SPIRV_OP_VARIABLE:
+            {
+                // everything else has its result type first
+                if ( operandCount >= 2 && operands[ 1 ] < module->ids.size() )
+                {
+                    module->ids[ operands[ 1 ] ].opcode = opcode;
+                    module->ids[ operands[ 1 ] ].word = word;
+                }
+                break;
+            }
+        }
+        word += instructionWords;
+    }
+
+    if ( module->stage == 0 )
+    {
+        printf( "SPIR-V module has no entry point for a supported stage!\n" );
+        return false;
+    }
+    return true;
+}
+
+// Byte size of a type as laid out in a block, runtime arrays count as 0
+static u32 GetSpirvTypeSize( Spirv_Module *module, u32 typeId, u32 matrixStride, bool rowMajor, u32 depth = 0 )
+{
+    if ( depth > 16 ) return 0;
+
+    Spirv_Id *type = GetSpirvId( module, typeId );
+    switch ( type->opcode )
+    {
+        case SPIRV_OP_TYPE_BOOL: return 4;
+        case SPIRV_OP_TYPE_INT:
+        case SPIRV_OP_TYPE_FLOAT: return SpirvOperand( module, typeId, 1 ) / 8;
+        case SPIRV_OP_TYPE_VECTOR:
+        {
+            return SpirvOperand( module, typeId, 2 ) * GetSpirvTypeSize( module, SpirvOperand( module, typeId, 1 ), 0, false, depth + 1 );
+        }
+        case SPIRV_OP_TYPE_MATRIX:
+        {
+            u32 columnType = SpirvOperand( module, typeId, 1 );
+            u32 columns = SpirvOperand( module, typeId, 2 );
+            if ( matrixStride == 0 )
+            {
+                return columns * GetSpirvTypeSize( module, columnType, 0, false, depth + 1 );
+            }
+            u32 rows = SpirvOperand( module, columnType, 2 );
+            return ( rowMajor ? rows : columns ) * matrixStride;
+        }
+        case SPIRV_OP_TYPE_ARRAY:
+        {
+            u32 elementType = SpirvOperand( module, typeId, 1 );
+            u32 length = SpirvOperand( module, SpirvOperand( module, typeId, 2 ), 2 );
+            u32 stride = type->arrayStride;
+            if ( stride == 0 )
+            {
+                stride = GetSpirvTypeSize( module, elementType, matrixStride, rowMajor, depth + 1 );
+            }
+            return length * stride;
+        }
+        case SPIRV_OP_TYPE_STRUCT:
+        {
+            u32 memberCount = ( module->code[ type->word ] >> 16 ) - 2;
+            u32 size = 0;
+            for ( u32 i = 0; i < memberCount; ++i )
+            {
+                Spirv_Member member = GetSpirvMember( module, typeId, i );
+                u32 memberSize = GetSpirvTypeSize( module, SpirvOperand( module, typeId, 1 + i ), member.matrixStride,
+                                                   member.rowMajor, depth + 1 );
+                if ( member.offset + memberSize > size ) size = member.offset + memberSize;
+            }
+            return size;
+        }
+    }
+    return 0;
+}
+
+static VkFormat GetSpirvVertexFormat( Spirv_Module *module, u32 typeId )
+{
+    u32 componentCount = 1;
+    if ( GetSpirvId( module, typeId )->opcode == SPIRV_OP_TYPE_VECTOR )
+    {
+        componentCount = SpirvOperand( module, typeId, 2 );
+        typeId = SpirvOperand( module, typeId, 1 );
+    }
+
+    // only 32 bit components, anything else is left for the mesh to describe
+    Spirv_Id *component = GetSpirvId( module, typeId );
+    if ( SpirvOperand( module, typeId, 1 ) != 32 || componentCount < 1 || componentCount > 4 )
+    {
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    VkFormat floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+    VkFormat intFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+    VkFormat uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+    if ( component->opcode == SPIRV_OP_TYPE_FLOAT )
+    {
+        return floatFormats[ componentCount - 1 ];
+    }
+    if ( component->opcode == SPIRV_OP_TYPE_INT )
+    {
+        return SpirvOperand( module, typeId, 2 ) ? intFormats[ componentCount - 1 ] : uintFormats[ componentCount - 1 ];
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+static bool ReflectDescriptor( Spirv_Module *module, Spirv_Id *variable, u32 typeId, u32 storageClass,
+                               Shader_Reflection *reflection )
+{
+    // arrays of descriptors, runtime arrays leave the count at 0
+    u32 count = 1;
+    for ( u32 depth = 0; depth < 8; ++depth )
+    {
+        Spirv_Id *type = GetSpirvId( module, typeId );
+        if ( type->opcode == SPIRV_OP_TYPE_ARRAY )
+        {
+            count *= SpirvOperand( module, SpirvOperand( module, typeId, 2 ), 2 );
+            typeId = SpirvOperand( module, typeId, 1 );
+        }
+        else if ( type->opcode == SPIRV_OP_TYPE_RUNTIME_ARRAY )
+        {
+            count = 0;
+            typeId = SpirvOperand( module, typeId, 1 );
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    Spirv_Id *type = GetSpirvId( module, typeId );
+    VkDescriptorType descriptorType;
+    switch ( type->opcode )
+    {
+        case SPIRV_OP_TYPE_SAMPLER: descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER; break;
+        case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+        {
+            u32 dim = SpirvOperand( module, SpirvOperand( module, typeId, 1 ), 2 );
+            descriptorType = dim == SPIRV_DIM_BUFFER ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            break;
+        }
+        case SPIRV_OP_TYPE_IMAGE:
+        {
+            u32 dim = SpirvOperand( module, typeId, 2 );
+            bool storage = SpirvOperand( module, typeId, 6 ) == 2;
+            if ( dim == SPIRV_DIM_SUBPASS_DATA ) descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            else if ( dim == SPIRV_DIM_BUFFER ) descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+            else descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+            break;
+        }
+        case SPIRV_OP_TYPE_STRUCT:
+        {
+            bool storageBuffer = storageClass == SPIRV_STORAGE_STORAGE_BUFFER || ( type->flags & SPIRV_ID_BUFFER_BLOCK );
+            descriptorType = storageBuffer ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            break;
+        }
+        default:
+        {
+            printf( "Unsupported descriptor type at set %u binding %u!\n", variable->set, variable->binding );
+            return false;
+        }
+    }
+
+    if ( variable->set >= LAYOUT_MAX_SETS )
+    {
+        printf( "Descriptor set %u is past LAYOUT_MAX_SETS!\n", variable->set );
+        return false;
+    }
+    if ( variable->set + 1 > reflection->setCount ) reflection->setCount = variable->set + 1;
+    return AddDescriptorBinding( &reflection->sets[ variable->set ], variable->binding, descriptorType, count, module->stage );
+}
+
+static bool ReflectSpecializationConstant( Spirv_Module *module, Spirv_Id *constant, u32 typeId, Shader_Reflection *reflection )
+{
+    if ( reflection->specializationConstantCount == SHADER_MAX_SPECIALIZATION_CONSTANTS )
+    {
+        printf( "Shader has more than %u specialization constants!\n", SHADER_MAX_SPECIALIZATION_CONSTANTS );
+        return false;
+    }
+
+    Shader_Specialization_Constant *entry = &reflection->specializationConstants[ reflection->specializationConstantCount++ ];
+    entry->id = constant->specId;
+    entry->size = GetSpirvTypeSize( module, typeId, 0, false );
+    if ( constant->opcode == SPIRV_OP_SPEC_CONSTANT )
+    {
+        u32 *value = &module->code[ constant->word + 3 ];
+        entry->defaultValue = value[ 0 ];
+        if ( entry->size == 8 ) entry->defaultValue |= ( u64 ) value[ 1 ] << 32;
+    }
+    else
+    {
+        entry->defaultValue = constant->opcode == SPIRV_OP_SPEC_CONSTANT_TRUE ? 1 : 0;
+    }
+    return true;
+}
+
+static void ReflectPushConstants( Spirv_Module *module, u32 typeId, Shader_Reflection *reflection )
+{
+    if ( GetSpirvId( module, typeId )->opcode != SPIRV_OP_TYPE_STRUCT )
+    {
+        return;
+    }
+
+    u32 memberCount = ( module->code[ GetSpirvId( module, typeId )->word ] >> 16 ) - 2;
+    u32 offset = ~0u;
+    for ( u32 i = 0; i < memberCount; ++i )
+    {
+        u32 memberOffset = GetSpirvMember( module, typeId, i ).offset;
+        if ( memberOffset < offset ) offset = memberOffset;
+    }
+    u32 end = GetSpirvTypeSize( module, typeId, 0, false );
+    if ( memberCount == 0 || end <= offset )
+    {
+        return;
+    }
+
+    reflection->pushConstants.stageFlags = module->stage;
+    reflection->pushConstants.offset = offset;
+    reflection->pushConstants.size = ( end - offset + 3 ) & ~3u;
+}
+
+bool ReflectShader( u32 *code, u64 size, Shader_Reflection *reflection )
+{
+    memset( reflection, 0, sizeof( *reflection ) );
+
+    Spirv_Module module;
+    if ( !ParseSpirv( &module, code, size ) )
+    {
+        return false;
+    }
+    reflection->stages = module.stage;
+
+    for ( u32 id = 0; id < module.ids.size(); ++id )
+    {
+        Spirv_Id *entry = &module.ids[ id ];
+        if ( entry->opcode == SPIRV_OP_SPEC_CONSTANT || entry->opcode == SPIRV_OP_SPEC_CONSTANT_TRUE ||
+             entry->opcode == SPIRV_OP_SPEC_CONSTANT_FALSE )
+        {
+            if ( ( entry->flags & SPIRV_ID_SPEC_ID ) &&
+                 !ReflectSpecializationConstant( &module, entry, module.code[ entry->word + 1 ], reflection ) )
+            {
+                return false;
+            }
+            continue;
+        }
+        if ( entry->opcode != SPIRV_OP_VARIABLE )
+        {
+            continue;
+        }
+
+        u32 storageClass = module.code[ entry->word + 3 ];
+        u32 typeId = SpirvOperand( &module, module.code[ entry->word + 1 ], 2 );
+        switch ( storageClass )
+        {
+            case SPIRV_STORAGE_UNIFORM_CONSTANT:
+            case SPIRV_STORAGE_UNIFORM:
+            case SPIRV_STORAGE_STORAGE_BUFFER:
+            {
+                if ( ( entry->flags & SPIRV_ID_BINDING ) && !ReflectDescriptor( &module, entry, typeId, storageClass, reflection ) )
+                {
+                    return false;
+                }
+                break;
+            }
+            case SPIRV_STORAGE_PUSH_CONSTANT:
+            {
+                ReflectPushConstants( &module, typeId, reflection );
+                break;
+            }
+            case SPIRV_STORAGE_INPUT:
+            {
+                bool vertexInput = module.stage == VK_SHADER_STAGE_VERTEX_BIT && ( entry->flags & SPIRV_ID_LOCATION ) &&
+                                   !( entry->flags & SPIRV_ID_BUILT_IN );
+                if ( !vertexInput )
+                {
+                    break;
+                }
+                if ( reflection->vertexInputCount == SHADER_MAX_VERTEX_INPUTS )
+                {
+                    printf( "Vertex shader has more than %u inputs!\n", SHADER_MAX_VERTEX_INPUTS );
+                    return false;
+                }
+                Shader_Vertex_Input *input = &reflection->vertexInputs[ reflection->vertexInputCount++ ];
+                input->location = entry->location;
+                input->format = GetSpirvVertexFormat( &module, typeId );
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+bool ReflectShaderFile( char *path, Shader_Reflection *reflection )
+{
+    Asset_Data shader;
+    if ( !LoadAsset( path, &shader ) )
+    {
+        return false;
+    }
+
+    // archive blobs and loose files are both aligned, so the words can be read in place
+    bool reflected = ReflectShader( ( u32 * ) shader.data, shader.size, reflection );
+    FreeAsset( &shader );
+    if ( !reflected )
+    {
+        printf( "Failed to reflect %s!\n", path );
+    }
+    return reflected;
+}
+
+bool MergeShaderReflection( Shader_Reflection *merged, Shader_Reflection *stage )
+{
+    merged->stages |= stage->stages;
+
+    for ( u32 set = 0; set < stage->setCount; ++set )
+    {
+        Descriptor_Set_Layout_Desc *stageSet = &stage->sets[ set ];
+        for ( u32 i = 0; i < stageSet->bindingCount; ++i )
+        {
+            Descriptor_Binding_Desc *binding = &stageSet->bindings[ i ];
+            Descriptor_Binding_Desc *existing = FindDescriptorBinding( &merged->sets[ set ], binding->binding );
+            if ( !existing )
+            {
+                if ( !AddDescriptorBinding( &merged->sets[ set ], binding->binding, binding->type, binding->count, binding->stages ) )
+                {
+                    return false;
+                }
+                continue;
+            }
+            if ( existing->type != binding->type || existing->count != binding->count )
+            {
+                printf( "Stages disagree on set %u binding %u!\n", set, binding->binding );
+                return false;
+            }
+            existing->stages |= binding->stages;
+        }
+    }
+    if ( stage->setCount > merged->setCount ) merged->setCount = stage->setCount;
+
+    // one range covering every stage's block keeps vkCmdPushConstants calls simple
+    if ( stage->pushConstants.size > 0 )
+    {
+        VkPushConstantRange *range = &merged->pushConstants;
+        if ( range->size == 0 )
+        {
+            *range = stage->pushConstants;
+        }
+        else
+        {
+            u32 end = range->offset + range->size;
+            u32 stageEnd = stage->pushConstants.offset + stage->pushConstants.size;
+            if ( stage->pushConstants.offset < range->offset ) range->offset = stage->pushConstants.offset;
+            range->size = ( stageEnd > end ? stageEnd : end ) - range->offset;
+            range->stageFlags |= stage->pushConstants.stageFlags;
+        }
+    }
+
+    if ( stage->vertexInputCount > 0 )
+    {
+        merged->vertexInputCount = stage->vertexInputCount;
+        memcpy( merged->vertexInputs, stage->vertexInputs, sizeof( merged->vertexInputs ) );
+    }
+
+    for ( u32 i = 0; i < stage->specializationConstantCount; ++i )
+    {
+        Shader_Specialization_Constant *constant = &stage->specializationConstants[ i ];
+        bool found = false;
+        for ( u32 j = 0; j < merged->specializationConstantCount && !found; ++j )
+        {
+            Shader_Specialization_Constant *existing = &merged->specializationConstants[ j ];
+            found = existing->id == constant->id;
+            if ( found && existing->size != constant->size )
+            {
+                printf( "Stages disagree on the size of specialization constant %u!\n", constant->id );
+                return false;
+            }
+        }
+        if ( found )
+        {
+            continue;
+        }
+        if ( merged->specializationConstantCount == SHADER_MAX_SPECIALIZATION_CONSTANTS )
+        {
+            printf( "Shaders have more than %u specialization constants!\n", SHADER_MAX_SPECIALIZATION_CONSTANTS );
+            return false;
+        }
+        merged->specializationConstants[ merged->specializationConstantCount++ ] = *constant;
+    }
+    return true;
+}
+
+bool ReflectShaderFiles( char **paths, u32 pathCount, Shader_Reflection *reflection )
+{
+    memset( reflection, 0, sizeof( *reflection ) );
+    for ( u32 i = 0; i < pathCount; ++i )
+    {
+        Shader_Reflection stage;
+        if ( !ReflectShaderFile( paths[ i ], &stage ) || !MergeShaderReflection( reflection, &stage ) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool DescriptorTypesCompatible( VkDescriptorType reflected, VkDescriptorType provided )
+{
+    // dynamic offsets are a binding time decision the shader can't see
+    return reflected == provided ||
+           ( reflected == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER && provided == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ) ||
+           ( reflected == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER && provided == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC );
+}
+
+static bool CheckProvidedSet( u32 set, Descriptor_Set_Layout_Desc *reflected, Descriptor_Set_Layout_Desc *provided )
+{
+    bool fits = true;
+    for ( u32 i = 0; i < reflected->bindingCount; ++i )
+    {
+        Descriptor_Binding_Desc *binding = &reflected->bindings[ i ];
+        Descriptor_Binding_Desc *providedBinding = FindDescriptorBinding( provided, binding->binding );
+        if ( !providedBinding )
+        {
+            printf( "Set %u binding %u is used by the shaders but missing from its layout!\n", set, binding->binding );
+            fits = false;
+        }
+        else if ( !DescriptorTypesCompatible( binding->type, providedBinding->type ) )
+        {
+            printf( "Set %u binding %u has a different descriptor type in the shaders!\n", set, binding->binding );
+            fits = false;
+        }
+        else if ( binding->count > providedBinding->count || ( binding->stages & ~providedBinding->stages ) )
+        {
+            printf( "Set %u binding %u needs more descriptors or stages than its layout has!\n", set, binding->binding );
+            fits = false;
+        }
+    }
+    return fits;
+}
+
+VkPipelineLayout CreateReflectedPipelineLayout( Device *device, Shader_Reflection *reflection,
+                                                Descriptor_Set_Layout_Desc **providedSets, u32 providedSetCount )
+{
+    u32 setCount = reflection->setCount > providedSetCount ? reflection->setCount : providedSetCount;
+    VkDescriptorSetLayout setLayouts[ LAYOUT_MAX_SETS ];
+    for ( u32 set = 0; set < setCount; ++set )
+    {
+        Descriptor_Set_Layout_Desc *desc = &reflection->sets[ set ];
+        if ( set < providedSetCount && providedSets[ set ] )
+        {
+            if ( !CheckProvidedSet( set, desc, providedSets[ set ] ) )
+            {
+                return VK_NULL_HANDLE;
+            }
+            desc = providedSets[ set ];
+        }
+        else
+        {
+            for ( u32 i = 0; i < desc->bindingCount; ++i )
+            {
+                if ( desc->bindings[ i ].count == 0 )
+                {
+                    printf( "Set %u binding %u is a runtime array, its set has to be provided!\n", set, desc->bindings[ i ].binding );
+                    return VK_NULL_HANDLE;
+                }
+            }
+        }
+
+        setLayouts[ set ] = GetDescriptorSetLayout( &device->layoutCache, device->device, desc );
+        if ( setLayouts[ set ] == VK_NULL_HANDLE )
+        {
+            return VK_NULL_HANDLE;
+        }
+    }
+
+    return GetPipelineLayout( &device->layoutCache, device->device, setLayouts, setCount, &reflection->pushConstants );
+}
+
+bool CheckReflectedVertexInput( Shader_Reflection *reflection, Pipeline_Config_Info *configInfo )
+{
+    bool complete = true;
+    for ( u32 i = 0; i < reflection->vertexInputCount; ++i )
+    {
+        bool found = false;
+        for ( u32 j = 0; j < configInfo->vertexAttributeCount && !found; ++j )
+        {
+            found = configInfo->vertexAttributes[ j ].location == reflection->vertexInputs[ i ].location;
+        }
+        if ( !found )
+        {
+            printf( "Vertex shader reads location %u but the vertex input has no attribute for it!\n",
+                    reflection->vertexInputs[ i ].location );
+            complete = false;
+        }
+    }
+    return complete;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "device.h"
+#include "pipeline.h"
+#include "layout_cache.h"
+#include "utils/utils.h"
+
+#define SHADER_MAX_VERTEX_INPUTS 16
+#define SHADER_MAX_SPECIALIZATION_CONSTANTS 16
+
+struct Shader_Vertex_Input
+{
+    u32 location;
+    VkFormat format;
+};
+
+struct Shader_Specialization_Constant
+{
+    u32 id;
+    u32 size;
+    u64 defaultValue;
+};
+
+// What a set of SPIR-V modules needs from its pipeline layout and vertex input. Stages are merged into one of these
+struct Shader_Reflection
+{
+    VkShaderStageFlags stages;
+    u32 setCount;
+    Descriptor_Set_Layout_Desc sets[ LAYOUT_MAX_SETS ];
+    // size 0 when no stage uses push constants
+    VkPushConstantRange pushConstants;
+    u32 vertexInputCount;
+    Shader_Vertex_Input vertexInputs[ SHADER_MAX_VERTEX_INPUTS ];
+    u32 specializationConstantCount;
+    Shader_Specialization_Constant specializationConstants[ SHADER_MAX_SPECIALIZATION_CONSTANTS ];
+};
+
+// Parses the module without any external dependency. Descriptor types come out as the plain variants, a set that
+// needs dynamic buffers or update after bind arrays has to be provided when the layout is built
+bool ReflectShader( u32 *code, u64 size, Shader_Reflection *reflection );
+bool ReflectShaderFile( char *path, Shader_Reflection *reflection );
+
+// Bindings used by several stages have to agree on their type and count, their stage flags are combined
+bool MergeShaderReflection( Shader_Reflection *merged, Shader_Reflection *stage );
+
+// Reflects every path and merges the stages
+bool ReflectShaderFiles( char **paths, u32 pathCount, Shader_Reflection *reflection );
+
+// Sets below providedSetCount use the given descriptions, which every reflected binding in them has to fit, the
+// rest are generated from the reflection. Both go through the device's layout cache
+VkPipelineLayout CreateReflectedPipelineLayout( Device *device, Shader_Reflection *reflection,
+                                                Descriptor_Set_Layout_Desc **providedSets, u32 providedSetCount );
+
+// Every input location the vertex stage reads needs an attribute in the config
+bool CheckReflectedVertexInput( Shader_Reflection *reflection, Pipeline_Config_Info *configInfo );
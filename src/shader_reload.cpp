@@ -0,0 +1,330 @@
+#include "shader_reload.h"
+#include "trace.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include <chrono> //@TODO: Remove std garbage
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <limits.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+
+static s64 GetFileWriteTime( char *path )
+{
+#ifdef _WIN32
+    struct _stat64 fileStat;
+    if ( _stat64( path, &fileStat ) != 0 )
+    {
+        return 0;
+    }
+#else
+    struct stat fileStat;
+    if ( stat( path, &fileStat ) != 0 )
+    {
+        return 0;
+    }
+#endif
+    return ( s64 ) fileStat.st_mtime;
+}
+
+static u64 GetWatcherTimestamp()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return ( u64 ) std::chrono::duration_cast< std::chrono::nanoseconds >( now ).count();
+}
+
+void InitShaderWatcher( Shader_Watcher *watcher )
+{
+    watcher->lastPollNanoseconds = 0;
+    watcher->inotifyFd = -1;
+#ifdef __linux__
+    watcher->inotifyFd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+    if ( watcher->inotifyFd < 0 )
+    {
+        printf( "Shader watcher: inotify unavailable, falling back to polling\n" );
+    }
+#endif
+}
+
+void DestroyShaderWatcher( Shader_Watcher *watcher )
+{
+#ifdef __linux__
+    if ( watcher->inotifyFd >= 0 )
+    {
+        close( watcher->inotifyFd );
+        watcher->inotifyFd = -1;
+    }
+#endif
+    watcher->files.clear();
+}
+
+u32 AddWatchedFile( Shader_Watcher *watcher, char *path )
+{
+    Watched_File file = {};
+    snprintf( file.path, sizeof( file.path ), "%s", path );
+    file.watchDescriptor = -1;
+    file.lastWriteTime = GetFileWriteTime( file.path );
+
+#ifdef __linux__
+    if ( watcher->inotifyFd >= 0 )
+    {
+        // watch the directory, editors and glslc often replace the file instead of writing it in place
+        char directory[ WATCHED_PATH_SIZE ];
+        snprintf( directory, sizeof( directory ), "%s", path );
+        char *slash = strrchr( directory, '/' );
+        if ( slash )
+        {
+            *slash = 0;
+        }
+        else
+        {
+            snprintf( directory, sizeof( directory ), "." );
+        }
+
+        file.watchDescriptor = inotify_add_watch( watcher->inotifyFd, directory, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE );
+        if ( file.watchDescriptor < 0 )
+        {
+            printf( "Shader watcher: can't watch %s\n", directory );
+        }
+    }
+#endif
+
+    watcher->files.push_back( file );
+
+    // names point into the stored paths, which move whenever the vector grows
+    for ( auto &watched : watcher->files )
+    {
+        char *watchedSlash = strrchr( watched.path, '/' );
+        watched.name = watchedSlash ? watchedSlash + 1 : watched.path;
+    }
+
+    return ( u32 ) watcher->files.size() - 1;
+}
+
+void PollShaderWatcher( Shader_Watcher *watcher )
+{
+#ifdef __linux__
+    if ( watcher->inotifyFd >= 0 )
+    {
+        alignas( inotify_event ) char buffer[ 4096 ];
+        for ( ;; )
+        {
+            ssize_t length = read( watcher->inotifyFd, buffer, sizeof( buffer ) );
+            if ( length <= 0 )
+            {
+                break;
+            }
+
+            for ( char *cursor = buffer; cursor < buffer + length; )
+            {
+                inotify_event *event = ( inotify_event * ) cursor;
+                if ( event->len > 0 )
+                {
+                    for ( auto &file : watcher->files )
+                    {
+                        if ( file.watchDescriptor == event->wd && strcmp( file.name, event->name ) == 0 )
+                        {
+                            file.changed = true;
+                        }
+                    }
+                }
+                cursor += sizeof( inotify_event ) + event->len;
+            }
+        }
+        return;
+    }
+#endif
+
+    u64 now = GetWatcherTimestamp();
+    if ( now - watcher->lastPollNanoseconds < ( u64 ) SHADER_WATCHER_POLL_MILLISECONDS * 1000000 )
+    {
+        return;
+    }
+    watcher->lastPollNanoseconds = now;
+
+    for ( auto &file : watcher->files )
+    {
+        s64 writeTime = GetFileWriteTime( file.path );
+        if ( writeTime != 0 && writeTime != file.lastWriteTime )
+        {
+            file.lastWriteTime = writeTime;
+            file.changed = true;
+        }
+    }
+}
+
+bool ConsumeFileChange( Shader_Watcher *watcher, u32 fileIndex )
+{
+    if ( fileIndex >= watcher->files.size() )
+    {
+        return false;
+    }
+
+    bool changed = watcher->files[ fileIndex ].changed;
+    watcher->files[ fileIndex ].changed = false;
+    return changed;
+}
+
+static bool CompileShaderSource( char *sourcePath, char *outputPath )
+{
+    char command[ WATCHED_PATH_SIZE * 2 + 32 ];
+    snprintf( command, sizeof( command ), "glslc \"%s\" -o \"%s\"", sourcePath, outputPath );
+    if ( system( command ) != 0 )
+    {
+        printf( "Shader reload: failed to compile %s\n", sourcePath );
+        return false;
+    }
+    return true;
+}
+
+// the flags are passed in because the main thread keeps queueing changes while this runs
+static void CompilePipeline( Shader_Reload *reload, bool compileVertexSource, bool compileFragmentSource )
+{
+    TRACE_FUNCTION();
+
+    bool compiled = true;
+    if ( compileVertexSource )
+    {
+        compiled = CompileShaderSource( reload->vertexSourcePath, reload->vertexShaderPath ) && compiled;
+    }
+    if ( compileFragmentSource )
+    {
+        compiled = CompileShaderSource( reload->fragmentSourcePath, reload->fragmentShaderPath ) && compiled;
+    }
+
+    // the packed archive only has the SPIR-V that shipped, reloads read what is on disk from now on
+    ShadowArchiveEntry( reload->vertexShaderPath );
+    ShadowArchiveEntry( reload->fragmentShaderPath );
+
+    // unchanged SPIR-V maps to the same module, so only the pipelines for the stages that changed are new
+    reload->succeeded = compiled && CreateManagedGraphicsPipeline( reload->manager, &reload->pending, &reload->configInfo,
+                                                                   reload->vertexShaderPath, reload->fragmentShaderPath );
+
+    reload->state.store( SHADER_RELOAD_DONE, std::memory_order_release );
+}
+
+void InitShaderReload( Shader_Reload *reload, Pipeline_Manager *manager, Pipeline_Config_Info *configInfo,
+                       char *vertexShaderPath, char *fragmentShaderPath,
+                       char *vertexSourcePath, char *fragmentSourcePath )
+{
+    reload->device = manager->device;
+    reload->manager = manager;
+    reload->configInfo = *configInfo;
+    reload->state = SHADER_RELOAD_IDLE;
+    reload->compileVertexSource = false;
+    reload->compileFragmentSource = false;
+    reload->compilingSource = false;
+    reload->rebuildQueued = false;
+    reload->succeeded = false;
+    reload->reloadCount = 0;
+
+    snprintf( reload->vertexShaderPath, sizeof( reload->vertexShaderPath ), "%s", vertexShaderPath );
+    snprintf( reload->fragmentShaderPath, sizeof( reload->fragmentShaderPath ), "%s", fragmentShaderPath );
+    snprintf( reload->vertexSourcePath, sizeof( reload->vertexSourcePath ), "%s", vertexSourcePath ? vertexSourcePath : "" );
+    snprintf( reload->fragmentSourcePath, sizeof( reload->fragmentSourcePath ), "%s", fragmentSourcePath ? fragmentSourcePath : "" );
+
+    InitShaderWatcher( &reload->watcher );
+    reload->vertexShaderFile = AddWatchedFile( &reload->watcher, reload->vertexShaderPath );
+    reload->fragmentShaderFile = AddWatchedFile( &reload->watcher, reload->fragmentShaderPath );
+    reload->vertexSourceFile = vertexSourcePath ? AddWatchedFile( &reload->watcher, reload->vertexSourcePath ) : ~0u;
+    reload->fragmentSourceFile = fragmentSourcePath ? AddWatchedFile( &reload->watcher, reload->fragmentSourcePath ) : ~0u;
+}
+
+void DestroyShaderReload( Shader_Reload *reload )
+{
+    if ( reload->compileThread.joinable() )
+    {
+        reload->compileThread.join();
+    }
+
+    if ( reload->state == SHADER_RELOAD_DONE && reload->succeeded )
+    {
+        DestroyPipeline( &reload->pending );
+    }
+
+    for ( auto &retired : reload->retired )
+    {
+        DestroyPipeline( &retired.pipeline );
+    }
+    reload->retired.clear();
+
+    DestroyShaderWatcher( &reload->watcher );
+}
+
+void UpdateShaderReload( Shader_Reload *reload, Pipeline *pipeline, u64 frameNumber, u32 framesInFlight )
+{
+    TRACE_FUNCTION();
+
+    // frames before frameNumber - framesInFlight have had their fences waited on
+    u32 write = 0;
+    for ( u32 i = 0; i < reload->retired.size(); i++ )
+    {
+        if ( reload->retired[ i ].retireFrame + framesInFlight <= frameNumber )
+        {
+            DestroyPipeline( &reload->retired[ i ].pipeline );
+        }
+        else
+        {
+            reload->retired[ write++ ] = reload->retired[ i ];
+        }
+    }
+    reload->retired.resize( write );
+
+    u32 state = reload->state.load( std::memory_order_acquire );
+    if ( state == SHADER_RELOAD_DONE )
+    {
+        reload->compileThread.join();
+
+        if ( reload->compilingSource )
+        {
+            // our own glslc output shows up as a SPIR-V change, the pipeline we just built already has it
+            PollShaderWatcher( &reload->watcher );
+            ConsumeFileChange( &reload->watcher, reload->vertexShaderFile );
+            ConsumeFileChange( &reload->watcher, reload->fragmentShaderFile );
+        }
+
+        if ( reload->succeeded )
+        {
+            reload->retired.push_back( { *pipeline, frameNumber } );
+            *pipeline = reload->pending;
+            reload->reloadCount++;
+            printf( "Shader reload: pipeline swapped (%u reloads)\n", reload->reloadCount );
+        }
+        else
+        {
+            printf( "Shader reload: keeping the previous pipeline\n" );
+        }
+
+        reload->state.store( SHADER_RELOAD_IDLE, std::memory_order_relaxed );
+        state = SHADER_RELOAD_IDLE;
+    }
+
+    PollShaderWatcher( &reload->watcher );
+    bool vertexSourceChanged = ConsumeFileChange( &reload->watcher, reload->vertexSourceFile );
+    bool fragmentSourceChanged = ConsumeFileChange( &reload->watcher, reload->fragmentSourceFile );
+    bool spirvChanged = ConsumeFileChange( &reload->watcher, reload->vertexShaderFile );
+    spirvChanged = ConsumeFileChange( &reload->watcher, reload->fragmentShaderFile ) || spirvChanged;
+
+    if ( vertexSourceChanged || fragmentSourceChanged || spirvChanged )
+    {
+        reload->compileVertexSource = reload->compileVertexSource || vertexSourceChanged;
+        reload->compileFragmentSource = reload->compileFragmentSource || fragmentSourceChanged;
+        reload->rebuildQueued = true;
+    }
+
+    // changes that come in while compiling are picked up by the next build
+    if ( state == SHADER_RELOAD_IDLE && reload->rebuildQueued )
+    {
+        reload->rebuildQueued = false;
+        reload->compilingSource = reload->compileVertexSource || reload->compileFragmentSource;
+        reload->state.store( SHADER_RELOAD_COMPILING, std::memory_order_relaxed );
+        reload->compileThread = std::thread( CompilePipeline, reload, reload->compileVertexSource, reload->compileFragmentSource );
+        // only sources that change again get recompiled, edits made straight to the SPIR-V are kept
+        reload->compileVertexSource = false;
+        reload->compileFragmentSource = false;
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "pipeline_manager.h"
+#include "utils/utils.h"
+#include <vector> //@TODO: Remove std garbage
+#include <thread>
+#include <atomic>
+
+#define WATCHED_PATH_SIZE 260
+// stat based polling is only used where inotify isn't available
+#define SHADER_WATCHER_POLL_MILLISECONDS 250
+
+struct Watched_File
+{
+    char path[ WATCHED_PATH_SIZE ];
+    char *name;
+    s32 watchDescriptor;
+    s64 lastWriteTime;
+    bool changed;
+};
+
+struct Shader_Watcher
+{
+    std::vector< Watched_File > files;
+    s32 inotifyFd;
+    u64 lastPollNanoseconds;
+};
+
+void InitShaderWatcher( Shader_Watcher *watcher );
+void DestroyShaderWatcher( Shader_Watcher *watcher );
+
+u32 AddWatchedFile( Shader_Watcher *watcher, char *path );
+
+// Never blocks, marks the files that changed since the last poll
+void PollShaderWatcher( Shader_Watcher *watcher );
+
+// Returns whether the file changed and clears the flag
+bool ConsumeFileChange( Shader_Watcher *watcher, u32 fileIndex );
+
+enum Shader_Reload_State
+{
+    SHADER_RELOAD_IDLE,
+    SHADER_RELOAD_COMPILING,
+    SHADER_RELOAD_DONE,
+};
+
+struct Retired_Pipeline
+{
+    Pipeline pipeline;
+    u64 retireFrame;
+};
+
+// Watches a pipeline's SPIR-V and GLSL files and rebuilds it on a background thread when they change
+struct Shader_Reload
+{
+    Device *device;
+    // rebuilt pipelines come from the manager, so swapping back to an earlier shader is a lookup
+    Pipeline_Manager *manager;
+    Shader_Watcher watcher;
+    Pipeline_Config_Info configInfo;
+
+    char vertexShaderPath[ WATCHED_PATH_SIZE ];
+    char fragmentShaderPath[ WATCHED_PATH_SIZE ];
+    char vertexSourcePath[ WATCHED_PATH_SIZE ];
+    char fragmentSourcePath[ WATCHED_PATH_SIZE ];
+    u32 vertexShaderFile;
+    u32 fragmentShaderFile;
+    u32 vertexSourceFile;
+    u32 fragmentSourceFile;
+
+    std::thread compileThread;
+    std::atomic< u32 > state;
+    // sources changed since the last build was started, only the main thread touches these
+    bool compileVertexSource;
+    bool compileFragmentSource;
+    // the running build runs glslc, so its own SPIR-V output isn't a new change
+    bool compilingSource;
+    bool rebuildQueued;
+    bool succeeded;
+    Pipeline pending;
+
+    std::vector< Retired_Pipeline > retired;
+    u32 reloadCount;
+};
+
+// Source paths may be null when only the SPIR-V should be watched
+void InitShaderReload( Shader_Reload *reload, Pipeline_Manager *manager, Pipeline_Config_Info *configInfo,
+                       char *vertexShaderPath, char *fragmentShaderPath,
+                       char *vertexSourcePath, char *fragmentSourcePath );
+
+// The device has to be idle, retired pipelines are released right away
+void DestroyShaderReload( Shader_Reload *reload );
+
+// Call once per frame between DrawFrame calls, it never waits on the compile thread or the GPU.
+// Swaps in a finished pipeline and destroys old ones once no frame in flight can still reference them.
+void UpdateShaderReload( Shader_Reload *reload, Pipeline *pipeline, u64 frameNumber, u32 framesInFlight );
@@ -0,0 +1,326 @@
+#include "shader_variants.h"
+#include "trace.h"
+#include "stdio.h"
+#include <atomic> //@TODO: Remove std garbage
+#include <chrono>
+
+void InitShaderVariants( Shader_Variants *variants, Device *device )
+{
+    variants->device = device;
+    variants->switchCount = 0;
+    variants->pipelines.clear();
+    variants->ownsPipelines = false;
+    variants->stats = {};
+}
+
+void DestroyShaderVariants( Shader_Variants *variants )
+{
+    if ( variants->ownsPipelines )
+    {
+        for ( VkPipeline pipeline : variants->pipelines )
+        {
+            if ( pipeline != VK_NULL_HANDLE )
+            {
+                vkDestroyPipeline( variants->device->device, pipeline, 0 );
+            }
+        }
+    }
+    variants->pipelines.clear();
+    variants->ownsPipelines = false;
+}
+
+bool AddShaderVariantSwitch( Shader_Variants *variants, char *name, u32 constantId, u32 *values, u32 valueCount )
+{
+    if ( variants->switchCount == SHADER_VARIANT_MAX_SWITCHES )
+    {
+        printf( "Shader variant switch %s: more than %u switches!\n", name, SHADER_VARIANT_MAX_SWITCHES );
+        return false;
+    }
+    if ( valueCount == 0 || valueCount > SHADER_VARIANT_MAX_VALUES )
+    {
+        printf( "Shader variant switch %s: needs between 1 and %u values!\n", name, SHADER_VARIANT_MAX_VALUES );
+        return false;
+    }
+
+    Shader_Variant_Switch *variantSwitch = &variants->switches[ variants->switchCount++ ];
+    variantSwitch->name = name;
+    variantSwitch->constantId = constantId;
+    variantSwitch->valueCount = valueCount;
+    for ( u32 i = 0; i < valueCount; ++i )
+    {
+        variantSwitch->values[ i ] = values[ i ];
+    }
+    return true;
+}
+
+bool CheckShaderVariantSwitches( Shader_Variants *variants, Shader_Reflection *reflection )
+{
+    for ( u32 i = 0; i < variants->switchCount; ++i )
+    {
+        Shader_Variant_Switch *variantSwitch = &variants->switches[ i ];
+        Shader_Specialization_Constant *constant = 0;
+        for ( u32 j = 0; j < reflection->specializationConstantCount; ++j )
+        {
+            if ( reflection->specializationConstants[ j ].id == variantSwitch->constantId )
+            {
+                constant = &reflection->specializationConstants[ j ];
+            }
+        }
+        if ( !constant )
+        {
+            printf( "Shader variant switch %s: no shader declares constant_id %u!\n", variantSwitch->name, variantSwitch->constantId );
+            return false;
+        }
+        if ( constant->size != sizeof( u32 ) )
+        {
+            printf( "Shader variant switch %s: constant_id %u isn't 4 bytes!\n", variantSwitch->name, variantSwitch->constantId );
+            return false;
+        }
+    }
+    return true;
+}
+
+u32 GetShaderVariantCount( Shader_Variants *variants )
+{
+    u32 count = 1;
+    for ( u32 i = 0; i < variants->switchCount; ++i )
+    {
+        count *= variants->switches[ i ].valueCount;
+    }
+    return count;
+}
+
+bool GetShaderVariantConstants( Shader_Variants *variants, u32 variantIndex, Specialization_Constants *constants )
+{
+    for ( u32 i = 0; i < variants->switchCount; ++i )
+    {
+        Shader_Variant_Switch *variantSwitch = &variants->switches[ i ];
+        u32 value = variantSwitch->values[ variantIndex % variantSwitch->valueCount ];
+        variantIndex /= variantSwitch->valueCount;
+        if ( !SetSpecializationConstant( constants, variantSwitch->constantId, value ) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static u32 CountFailedVariants( Shader_Variants *variants )
+{
+    u32 failCount = 0;
+    for ( VkPipeline pipeline : variants->pipelines )
+    {
+        failCount += pipeline == VK_NULL_HANDLE ? 1 : 0;
+    }
+    return failCount;
+}
+
+struct Graphics_Variant_Build
+{
+    Shader_Variants *variants;
+    Pipeline_Manager *manager;
+    Pipeline_Config_Info *configInfo;
+    VkShaderModule vertexShaderModule;
+    VkShaderModule fragmentShaderModule;
+    std::atomic< u32 > batchCount;
+};
+
+static void BuildGraphicsVariantBatch( void *data, u32 begin, u32 end, u32 workerIndex )
+{
+    TRACE_FUNCTION();
+    ( void ) workerIndex;
+    Graphics_Variant_Build *build = ( Graphics_Variant_Build * ) data;
+    Assert( end - begin <= SHADER_VARIANT_BATCH_SIZE );
+
+    Pipeline_Config_Info configInfos[ SHADER_VARIANT_BATCH_SIZE ];
+    for ( u32 i = begin; i < end; ++i )
+    {
+        configInfos[ i - begin ] = *build->configInfo;
+        GetShaderVariantConstants( build->variants, i, &configInfos[ i - begin ].specialization );
+    }
+
+    // the manager creates whatever it doesn't have yet in one driver call
+    GetGraphicsPipelines( build->manager, configInfos, end - begin, build->vertexShaderModule, build->fragmentShaderModule,
+                          &build->variants->pipelines[ begin ] );
+    build->batchCount.fetch_add( 1, std::memory_order_relaxed );
+}
+
+bool BuildGraphicsVariants( Shader_Variants *variants, Pipeline_Manager *manager, Job_System *jobs, Pipeline_Config_Info *configInfo,
+                            VkShaderModule vertexShaderModule, VkShaderModule fragmentShaderModule )
+{
+    TRACE_FUNCTION();
+    DestroyShaderVariants( variants );
+
+    // every variant sets the same ids, so if the first fits they all do
+    Specialization_Constants constants = configInfo->specialization;
+    if ( !GetShaderVariantConstants( variants, 0, &constants ) )
+    {
+        return false;
+    }
+
+    u32 variantCount = GetShaderVariantCount( variants );
+    variants->pipelines.assign( variantCount, VK_NULL_HANDLE );
+
+    Graphics_Variant_Build build;
+    build.variants = variants;
+    build.manager = manager;
+    build.configInfo = configInfo;
+    build.vertexShaderModule = vertexShaderModule;
+    build.fragmentShaderModule = fragmentShaderModule;
+    build.batchCount = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    ParallelFor( jobs, variantCount, SHADER_VARIANT_BATCH_SIZE, BuildGraphicsVariantBatch, &build );
+    auto end = std::chrono::high_resolution_clock::now();
+
+    variants->stats.batchCount = build.batchCount.load();
+    variants->stats.failCount = CountFailedVariants( variants );
+    variants->stats.buildMilliseconds = std::chrono::duration< float64, std::milli >( end - start ).count();
+    return variants->stats.failCount == 0;
+}
+
+struct Compute_Variant_Build
+{
+    Shader_Variants *variants;
+    VkPipelineLayout pipelineLayout;
+    VkShaderModule shaderModule;
+    Specialization_Constants baseConstants;
+    std::atomic< u32 > batchCount;
+};
+
+static void BuildComputeVariantBatch( void *data, u32 begin, u32 end, u32 workerIndex )
+{
+    TRACE_FUNCTION();
+    ( void ) workerIndex;
+    Compute_Variant_Build *build = ( Compute_Variant_Build * ) data;
+    Device *device = build->variants->device;
+    u32 count = end - begin;
+    Assert( count <= SHADER_VARIANT_BATCH_SIZE );
+
+    Specialization_Constants constants[ SHADER_VARIANT_BATCH_SIZE ];
+    VkSpecializationMapEntry specializationEntries[ SHADER_VARIANT_BATCH_SIZE ][ PIPELINE_MAX_SPECIALIZATION_CONSTANTS ];
+    VkSpecializationInfo specializationInfos[ SHADER_VARIANT_BATCH_SIZE ];
+    VkComputePipelineCreateInfo pipelineInfos[ SHADER_VARIANT_BATCH_SIZE ] = {};
+    for ( u32 i = 0; i < count; ++i )
+    {
+        constants[ i ] = build->baseConstants;
+        GetShaderVariantConstants( build->variants, begin + i, &constants[ i ] );
+
+        VkComputePipelineCreateInfo *pipelineInfo = &pipelineInfos[ i ];
+        pipelineInfo->sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo->stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo->stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo->stage.module = build->shaderModule;
+        pipelineInfo->stage.pName = "main";
+        pipelineInfo->stage.pSpecializationInfo =
+            FillSpecializationInfo( &constants[ i ], specializationEntries[ i ], &specializationInfos[ i ] );
+        pipelineInfo->layout = build->pipelineLayout;
+        pipelineInfo->basePipelineIndex = -1;
+        pipelineInfo->basePipelineHandle = VK_NULL_HANDLE;
+    }
+
+    Pipeline_Cache *pipelineCache = &device->pipelineCache;
+    VkPipeline *pipelines = &build->variants->pipelines[ begin ];
+
+    auto createStart = std::chrono::high_resolution_clock::now();
+    VkResult result = vkCreateComputePipelines( device->device, pipelineCache->cache, count, pipelineInfos, 0, pipelines );
+    auto createEnd = std::chrono::high_resolution_clock::now();
+
+    if ( result != VK_SUCCESS )
+    {
+        printf( "Failed to create compute pipeline variants %u to %u!\n", begin, end - 1 );
+    }
+
+    float64 milliseconds = std::chrono::duration< float64, std::milli >( createEnd - createStart ).count() / ( float64 ) count;
+    for ( u32 i = 0; i < count; ++i )
+    {
+        if ( pipelines[ i ] != VK_NULL_HANDLE )
+        {
+            RecordPipelineCreation( pipelineCache, milliseconds );
+        }
+    }
+    build->batchCount.fetch_add( 1, std::memory_order_relaxed );
+}
+
+bool BuildComputeVariants( Shader_Variants *variants, Job_System *jobs, VkPipelineLayout pipelineLayout, VkShaderModule shaderModule,
+                           Specialization_Constants *baseConstants )
+{
+    TRACE_FUNCTION();
+    Assert( pipelineLayout != VK_NULL_HANDLE );
+    DestroyShaderVariants( variants );
+
+    Compute_Variant_Build build;
+    build.variants = variants;
+    build.pipelineLayout = pipelineLayout;
+    build.shaderModule = shaderModule;
+    build.baseConstants = {};
+    if ( baseConstants )
+    {
+        build.baseConstants = *baseConstants;
+    }
+    build.batchCount = 0;
+
+    // every variant sets the same ids, so if the first fits they all do
+    Specialization_Constants constants = build.baseConstants;
+    if ( !GetShaderVariantConstants( variants, 0, &constants ) )
+    {
+        return false;
+    }
+
+    u32 variantCount = GetShaderVariantCount( variants );
+    variants->pipelines.assign( variantCount, VK_NULL_HANDLE );
+    variants->ownsPipelines = true;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    ParallelFor( jobs, variantCount, SHADER_VARIANT_BATCH_SIZE, BuildComputeVariantBatch, &build );
+    auto end = std::chrono::high_resolution_clock::now();
+
+    variants->stats.batchCount = build.batchCount.load();
+    variants->stats.failCount = CountFailedVariants( variants );
+    variants->stats.buildMilliseconds = std::chrono::duration< float64, std::milli >( end - start ).count();
+    return variants->stats.failCount == 0;
+}
+
+VkPipeline GetShaderVariant( Shader_Variants *variants, u32 *values )
+{
+    u32 variantIndex = 0;
+    u32 stride = 1;
+    for ( u32 i = 0; i < variants->switchCount; ++i )
+    {
+        Shader_Variant_Switch *variantSwitch = &variants->switches[ i ];
+        u32 valueIndex = 0;
+        while ( valueIndex < variantSwitch->valueCount && variantSwitch->values[ valueIndex ] != values[ i ] )
+        {
+            valueIndex++;
+        }
+        if ( valueIndex == variantSwitch->valueCount )
+        {
+            return VK_NULL_HANDLE;
+        }
+        variantIndex += valueIndex * stride;
+        stride *= variantSwitch->valueCount;
+    }
+
+    if ( variantIndex >= variants->pipelines.size() )
+    {
+        return VK_NULL_HANDLE;
+    }
+    return variants->pipelines[ variantIndex ];
+}
+
+void PrintShaderVariantStats( Shader_Variants *variants, char *name )
+{
+    Shader_Variant_Stats *stats = &variants->stats;
+    printf( "Shader variants %s: %u variants in %u batches, %u failed, %.2f ms\n", name, ( u32 ) variants->pipelines.size(),
+            stats->batchCount, stats->failCount, stats->buildMilliseconds );
+    for ( u32 i = 0; i < variants->switchCount; ++i )
+    {
+        Shader_Variant_Switch *variantSwitch = &variants->switches[ i ];
+        printf( "  %s (constant_id %u):", variantSwitch->name, variantSwitch->constantId );
+        for ( u32 j = 0; j < variantSwitch->valueCount; ++j )
+        {
+            printf( " %u", variantSwitch->values[ j ] );
+        }
+        printf( "\n" );
+    }
+}
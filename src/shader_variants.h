@@ -0,0 +1,73 @@
+#pragma once
+
+#include "device.h"
+#include "pipeline.h"
+#include "pipeline_manager.h"
+#include "job_system.h"
+#include "shader_reflection.h"
+#include "utils/utils.h"
+#include <vector> //@TODO: Remove std garbage
+
+#define SHADER_VARIANT_MAX_SWITCHES 8
+#define SHADER_VARIANT_MAX_VALUES 8
+// Variants handed to one vkCreate*Pipelines call. A driver compiles a batch on the calling thread, so it's the
+// batches that spread over the workers
+#define SHADER_VARIANT_BATCH_SIZE 4
+
+// A feature switch or tunable, one specialization constant and every value it takes
+struct Shader_Variant_Switch
+{
+    char *name;
+    u32 constantId;
+    u32 valueCount;
+    u32 values[ SHADER_VARIANT_MAX_VALUES ];
+};
+
+struct Shader_Variant_Stats
+{
+    u32 batchCount;
+    u32 failCount;
+    float64 buildMilliseconds;
+};
+
+// Every combination of the switches. Variant i takes value ( i / stride ) % valueCount of each switch, where the
+// stride is the product of the value counts of the switches added before it
+struct Shader_Variants
+{
+    Device *device;
+    u32 switchCount;
+    Shader_Variant_Switch switches[ SHADER_VARIANT_MAX_SWITCHES ];
+
+    std::vector< VkPipeline > pipelines;
+    // compute variants are owned here, graphics ones by the pipeline manager
+    bool ownsPipelines;
+    Shader_Variant_Stats stats;
+};
+
+void InitShaderVariants( Shader_Variants *variants, Device *device );
+void DestroyShaderVariants( Shader_Variants *variants );
+
+bool AddShaderVariantSwitch( Shader_Variants *variants, char *name, u32 constantId, u32 *values, u32 valueCount );
+
+// Every switch has to be a 4 byte constant that the reflected shaders declare
+bool CheckShaderVariantSwitches( Shader_Variants *variants, Shader_Reflection *reflection );
+
+u32 GetShaderVariantCount( Shader_Variants *variants );
+
+// Sets the variant's value of every switch on top of what constants already holds
+bool GetShaderVariantConstants( Shader_Variants *variants, u32 variantIndex, Specialization_Constants *constants );
+
+// Builds every variant of configInfo on the job system, on top of the constants configInfo already sets. Variants
+// that failed are VK_NULL_HANDLE, false when any did
+bool BuildGraphicsVariants( Shader_Variants *variants, Pipeline_Manager *manager, Job_System *jobs, Pipeline_Config_Info *configInfo,
+                            VkShaderModule vertexShaderModule, VkShaderModule fragmentShaderModule );
+
+// Same for a compute shader, baseConstants can be null. The module can be destroyed once this returns
+bool BuildComputeVariants( Shader_Variants *variants, Job_System *jobs, VkPipelineLayout pipelineLayout, VkShaderModule shaderModule,
+                           Specialization_Constants *baseConstants );
+
+// values has one entry per switch in the order they were added. VK_NULL_HANDLE when a value isn't one of the
+// switch's or the variant failed to build
+VkPipeline GetShaderVariant( Shader_Variants *variants, u32 *values );
+
+void PrintShaderVariantStats( Shader_Variants *variants, char *name );
@@ -0,0 +1,11 @@
+#version 450
+
+// No vertex or descriptor input, so a draw costs what the API and the rasterizer cost. Every instance gets its own
+// small triangle somewhere on the screen
+void main()
+{
+    vec2 corners[3] = vec2[](vec2(0.0, -0.02), vec2(0.02, 0.02), vec2(-0.02, 0.02));
+    uint hash = uint(gl_InstanceIndex) * 2654435761u;
+    vec2 center = vec2(float(hash & 0xffffu), float(hash >> 16)) / 32767.5 - 1.0;
+    gl_Position = vec4(center + corners[gl_VertexIndex], 0.5, 1.0);
+}
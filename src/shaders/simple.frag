@@ -1,8 +1,66 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) flat in uint inMaterialIndex;
+layout (location = 2) in vec2 inUv;
 
 layout (location = 0) out vec4 outColor;
 
+const uint invalidIndex = 0xffffffff;
+
+// SCENE_CONSTANT_TEXTURE_FEEDBACK, off on devices that can't store from fragments
+layout (constant_id = 0) const bool TEXTURE_FEEDBACK = true;
+
+// binding 0 and 1 of Bindless_Binding
+layout (set = 0, binding = 0) uniform texture2D textures[];
+layout (set = 0, binding = 1) uniform sampler samplers[];
+
+// Texture_Feedback_Buffer, the finest mip each streamed texture was wanted at this frame
+layout (set = 0, binding = 2, std430) buffer Feedback
+{
+    uint minMips[];
+} feedbackBuffers[];
+
+// Gpu_Material is x = texture, y = streamed texture, z = width, w = height
+layout (set = 1, binding = 0) uniform Frame_Constants
+{
+    mat4 viewProjection;
+    float time;
+    uint frameNumber;
+    uint textureFeedbackIndex;
+    uint samplerIndex;
+    uvec4 materials[4];
+} frame;
+
+const vec3 materialColors[4] = vec3[]
+(
+    vec3(0.8, 0.0, 0.8), vec3(0.0, 0.6, 0.8), vec3(0.8, 0.6, 0.0), vec3(0.2, 0.8, 0.2)
+);
+
 void main()
 {
-    outColor = vec4(0.8, 0.0, 0.8, 1.0);
+    uint materialIndex = inMaterialIndex % 4;
+    uvec4 material = frame.materials[materialIndex];
+    vec3 color = materialColors[materialIndex];
+
+    // derivatives have to be taken before any branching
+    vec2 texel = inUv * vec2(material.zw);
+    float footprint = max(length(dFdx(texel)), length(dFdy(texel)));
+    uint mip = uint(max(floor(log2(max(footprint, 1.0))), 0.0));
+
+    if (material.x != invalidIndex)
+    {
+        color *= texture(sampler2D(textures[nonuniformEXT(material.x)], samplers[frame.samplerIndex]), inUv).rgb;
+
+        // one pixel of every 8x8 block reports, moving with the frame so small objects are still seen
+        uvec2 pixel = (uvec2(gl_FragCoord.xy) + frame.frameNumber) & 7u;
+        if (TEXTURE_FEEDBACK && frame.textureFeedbackIndex != invalidIndex && pixel == uvec2(0))
+        {
+            atomicMin(feedbackBuffers[frame.textureFeedbackIndex].minMips[material.y], mip);
+        }
+    }
+
+    float light = 0.5 + 0.5 * abs(inNormal.z);
+    outColor = vec4(color * light, 1.0);
 }
@@ -1,11 +1,64 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
-vec2 positions[3] = vec2[]
-(
-    vec2(0.0, -0.5), vec2(0.5, 0.5), vec2(-0.5, 0.5)
-);
+layout (location = 0) in vec3 inPosition;
+layout (location = 1) in vec2 inNormal;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) flat out uint outMaterialIndex;
+layout (location = 2) out vec2 outUv;
+
+struct Instance
+{
+    vec4 rows[3];
+    uint materialIndex;
+    uint padding0;
+    uint padding1;
+    uint padding2;
+};
+
+// Every storage buffer in the bindless set, binding 2 of Bindless_Binding.
+// gl_InstanceIndex includes firstInstance, so batched draws just point at their first instance
+layout (set = 0, binding = 2, std430) readonly buffer Instances
+{
+    Instance instances[];
+} instanceBuffers[];
+
+// Frame_Constants, bound with a dynamic offset into the frame ring
+layout (set = 1, binding = 0) uniform Frame_Constants
+{
+    mat4 viewProjection;
+    float time;
+    uint frameNumber;
+} frame;
+
+// snorm16 positions are stored relative to the mesh bounds
+layout (push_constant) uniform Push_Constants
+{
+    vec4 positionScale;
+    vec4 positionOffset;
+    uint instanceBufferIndex;
+} push;
+
+vec3 OctahedralDecode(vec2 encoded)
+{
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0);
+    normal.x += normal.x >= 0.0 ? -fold : fold;
+    normal.y += normal.y >= 0.0 ? -fold : fold;
+    return normalize(normal);
+}
 
 void main()
 {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
+    Instance instance = instanceBuffers[push.instanceBufferIndex].instances[gl_InstanceIndex];
+    vec4 position = vec4(inPosition * push.positionScale.xyz + push.positionOffset.xyz, 1.0);
+    vec3 worldPosition = vec3(dot(instance.rows[0], position), dot(instance.rows[1], position), dot(instance.rows[2], position));
+
+    vec3 normal = OctahedralDecode(inNormal);
+    outNormal = normalize(vec3(dot(instance.rows[0].xyz, normal), dot(instance.rows[1].xyz, normal), dot(instance.rows[2].xyz, normal)));
+    outMaterialIndex = instance.materialIndex;
+    // planar mapping over the mesh bounds until meshes carry their own uvs
+    outUv = inPosition.xy * 0.5 + 0.5;
+    gl_Position = frame.viewProjection * vec4(worldPosition, 1.0);
 }
@@ -1,50 +1,117 @@
 
 #include "swap_chain.h"
+#include "trace.h"
 #include "stdlib.h"
 
-void InitSwapChain( Swap_Chain *swapChain, Device *device, VkExtent2D extent )
+void InitSwapChain( Swap_Chain *swapChain, Device *device, VkExtent2D extent, Swap_Chain_Config config )
 {
+    // one frame executing and at most one queued behind it
+    if ( config.lowLatency && config.framesInFlight > 2 )
+    {
+        config.framesInFlight = 2;
+    }
+    if ( config.framesInFlight == 0 )
+    {
+        config.framesInFlight = 1;
+    }
+
+    swapChain->config = config;
+    swapChain->framesInFlight = config.framesInFlight;
     swapChain->device = device;
     swapChain->windowExtent = extent;
-    CreateSwapChain( swapChain );
+    swapChain->offscreen = device->headless;
+    swapChain->swapChain = VK_NULL_HANDLE;
+    swapChain->frameNumber = 0;
+    swapChain->recreateCount = 0;
+    if ( swapChain->offscreen )
+    {
+        CreateOffscreenImages( swapChain, config.imageCount ? config.imageCount : OFFSCREEN_IMAGE_COUNT );
+    }
+    else
+    {
+        CreateSwapChain( swapChain );
+    }
     CreateImageViews( swapChain );
-    CreateRenderPass( swapChain );
-    CreateDepthResources( swapChain );
-    CreateFramebuffers( swapChain );
     CreateSyncObjects( swapChain );
 }
 
-void DestroySwapChain( Swap_Chain *swapChain )
+static void RetireSwapChainResources( Swap_Chain *swapChain )
+{
+    Retired_Swap_Chain retired;
+    retired.swapChain = swapChain->swapChain;
+    retired.imageViews = std::move( swapChain->swapChainImageViews );
+    if ( swapChain->offscreen )
+    {
+        retired.offscreenImages = std::move( swapChain->swapChainImages );
+        retired.offscreenImageAllocations = std::move( swapChain->offscreenImageAllocations );
+    }
+    retired.retireFrame = swapChain->frameNumber;
+
+    swapChain->swapChainImageViews.clear();
+    swapChain->swapChainImages.clear();
+    swapChain->offscreenImageAllocations.clear();
+
+    swapChain->retired.push_back( std::move( retired ) );
+}
+
+static void DestroyRetiredSwapChain( Swap_Chain *swapChain, Retired_Swap_Chain *retired )
 {
     VkDevice device = swapChain->device->device;
-    for ( auto imageView : swapChain->swapChainImageViews )
+
+    for ( auto imageView : retired->imageViews )
     {
         vkDestroyImageView( device, imageView, 0 );
     }
-    swapChain->swapChainImageViews.clear();
 
-    if ( swapChain->swapChain != 0 )
+    for ( u32 i = 0; i < retired->offscreenImages.size(); i++ )
     {
-        vkDestroySwapchainKHR( device, swapChain->swapChain, 0 );
-        swapChain->swapChain = 0;
+        DestroyImage( swapChain->device, retired->offscreenImages[ i ], retired->offscreenImageAllocations[ i ] );
     }
 
-    for ( u32 i = 0; i < swapChain->depthImages.size(); i++ )
+    if ( retired->swapChain != VK_NULL_HANDLE )
     {
-        vkDestroyImageView( device, swapChain->depthImageViews[ i ], 0 );
-        vkDestroyImage( device, swapChain->depthImages[ i ], 0 );
-        vkFreeMemory( device, swapChain->depthImageMemorys[ i ], 0 );
+        vkDestroySwapchainKHR( device, retired->swapChain, 0 );
     }
+}
 
-    for ( auto framebuffer : swapChain->swapChainFramebuffers )
+// Only call right after waiting on the fence of the current frame slot
+static void DestroyFinishedSwapChains( Swap_Chain *swapChain )
+{
+    // frame N - framesInFlight used this slot and has finished, so did every frame before it
+    u32 write = 0;
+    for ( u32 i = 0; i < swapChain->retired.size(); i++ )
     {
-        vkDestroyFramebuffer( device, framebuffer, 0 );
+        Retired_Swap_Chain *retired = &swapChain->retired[ i ];
+        if ( retired->retireFrame + swapChain->framesInFlight <= swapChain->frameNumber + 1 )
+        {
+            DestroyRetiredSwapChain( swapChain, retired );
+        }
+        else
+        {
+            if ( write != i )
+            {
+                swapChain->retired[ write ] = std::move( *retired );
+            }
+            write++;
+        }
     }
+    swapChain->retired.resize( write );
+}
 
-    vkDestroyRenderPass( device, swapChain->renderPass, 0 );
+void DestroySwapChain( Swap_Chain *swapChain )
+{
+    VkDevice device = swapChain->device->device;
+
+    RetireSwapChainResources( swapChain );
+    for ( auto &retired : swapChain->retired )
+    {
+        DestroyRetiredSwapChain( swapChain, &retired );
+    }
+    swapChain->retired.clear();
+    swapChain->swapChain = VK_NULL_HANDLE;
 
     // cleanup synchronization objects
-    for ( size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++ )
+    for ( size_t i = 0; i < swapChain->framesInFlight; i++ )
     {
         vkDestroySemaphore( device, swapChain->renderFinishedSemaphores[ i ], 0 );
         vkDestroySemaphore( device, swapChain->imageAvailableSemaphores[ i ], 0 );
@@ -52,6 +119,40 @@ void DestroySwapChain( Swap_Chain *swapChain )
     }
 }
 
+bool RecreateSwapChain( Swap_Chain *swapChain, VkExtent2D extent )
+{
+    TRACE_FUNCTION();
+
+    VkFormat oldFormat = swapChain->swapChainImageFormat;
+    u32 oldImageCount = ( u32 ) swapChain->swapChainImages.size();
+    VkSwapchainKHR oldSwapChain = swapChain->swapChain;
+
+    swapChain->windowExtent = extent;
+    RetireSwapChainResources( swapChain );
+
+    // CreateSwapChain hands the old swap chain to the driver so it can reuse its resources
+    swapChain->swapChain = oldSwapChain;
+    if ( swapChain->offscreen )
+    {
+        CreateOffscreenImages( swapChain, oldImageCount );
+    }
+    else if ( !CreateSwapChain( swapChain ) )
+    {
+        return false;
+    }
+
+    // render passes only depend on the formats, they are kept so pipelines stay compatible
+    if ( swapChain->swapChainImageFormat != oldFormat )
+    {
+        printf( "Swap chain format changed on recreation, pipelines may be incompatible with the render pass!\n" );
+    }
+
+    CreateImageViews( swapChain );
+    swapChain->recreateCount++;
+    swapChain->imagesInFlight.assign( swapChain->swapChainImages.size(), VK_NULL_HANDLE );
+    return true;
+}
+
 float32 ExtentAspectRatio( VkExtent2D extent )
 {
     return ( float32 ) extent.width / ( float32 ) extent.height;
@@ -59,8 +160,28 @@ float32 ExtentAspectRatio( VkExtent2D extent )
 
 VkResult AcquireNextImage( Swap_Chain *swapChain, u32 *imageIndex )
 {
-    vkWaitForFences( swapChain->device->device, 1, &swapChain->inFlightFences[ swapChain->currentFrame ],
-                     VK_TRUE, 0xFFFFFFFFFFFFFFFF );
+    TRACE_FUNCTION();
+    {
+        TRACE_ZONE( "WaitForFrameFence" );
+        vkWaitForFences( swapChain->device->device, 1, &swapChain->inFlightFences[ swapChain->currentFrame ],
+                         VK_TRUE, 0xFFFFFFFFFFFFFFFF );
+    }
+
+    DestroyFinishedSwapChains( swapChain );
+
+    // a failed recreation left no swap chain behind, asking for another recreation retries it
+    if ( !swapChain->offscreen && swapChain->swapChain == VK_NULL_HANDLE )
+    {
+        return VK_ERROR_OUT_OF_DATE_KHR;
+    }
+
+    if ( swapChain->offscreen )
+    {
+        // SubmitCommandBuffers still waits on imagesInFlight before the image is reused
+        *imageIndex = swapChain->nextOffscreenImage;
+        swapChain->nextOffscreenImage = ( swapChain->nextOffscreenImage + 1 ) % ( u32 ) swapChain->swapChainImages.size();
+        return VK_SUCCESS;
+    }
 
     VkResult result = vkAcquireNextImageKHR( swapChain->device->device, swapChain->swapChain, 0xFFFFFFFFFFFFFFFF,
                                              swapChain->imageAvailableSemaphores[ swapChain->currentFrame ],
@@ -69,10 +190,13 @@ VkResult AcquireNextImage( Swap_Chain *swapChain, u32 *imageIndex )
     return result;
 }
 
-VkResult SubmitCommandBuffers( Swap_Chain *swapChain, VkCommandBuffer *buffers, u32 *imageIndex )
+VkResult SubmitCommandBuffers( Swap_Chain *swapChain, VkCommandBuffer *buffers, u32 *imageIndex, VkSemaphore timeline,
+                               u64 timelineValue, VkPipelineStageFlags timelineStages )
 {
+    TRACE_FUNCTION();
     if ( swapChain->imagesInFlight[ *imageIndex ] != VK_NULL_HANDLE )
     {
+        TRACE_ZONE( "WaitForImageInFlight" );
         vkWaitForFences( swapChain->device->device, 1, &swapChain->imagesInFlight[ *imageIndex ], VK_TRUE, UINT64_MAX );
     }
     swapChain->imagesInFlight[ *imageIndex ] = swapChain->inFlightFences[ swapChain->currentFrame ];
@@ -80,18 +204,42 @@ VkResult SubmitCommandBuffers( Swap_Chain *swapChain, VkCommandBuffer *buffers,
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = { swapChain->imageAvailableSemaphores[ swapChain->currentFrame ] };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
+    VkSemaphore waitSemaphores[ 2 ];
+    VkPipelineStageFlags waitStages[ 2 ];
+    // the binary semaphore's value is ignored
+    u64 waitValues[ 2 ] = {};
+    u32 waitCount = 0;
+    VkSemaphore signalSemaphores[] = { swapChain->renderFinishedSemaphores[ swapChain->currentFrame ] };
 
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = buffers;
 
-    VkSemaphore signalSemaphores[] = { swapChain->renderFinishedSemaphores[ swapChain->currentFrame ] };
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
+    // offscreen images are never acquired or presented, so there is nothing to wait on or signal
+    if ( !swapChain->offscreen )
+    {
+        waitSemaphores[ waitCount ] = swapChain->imageAvailableSemaphores[ swapChain->currentFrame ];
+        waitStages[ waitCount++ ] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = signalSemaphores;
+    }
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+    if ( timeline != VK_NULL_HANDLE )
+    {
+        waitSemaphores[ waitCount ] = timeline;
+        waitValues[ waitCount ] = timelineValue;
+        waitStages[ waitCount++ ] = timelineStages;
+
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = waitCount;
+        timelineInfo.pWaitSemaphoreValues = waitValues;
+        submitInfo.pNext = &timelineInfo;
+    }
+
+    submitInfo.waitSemaphoreCount = waitCount;
+    submitInfo.pWaitSemaphores = waitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages;
 
     vkResetFences( swapChain->device->device, 1, &swapChain->inFlightFences[ swapChain->currentFrame ] );
     if ( vkQueueSubmit( swapChain->device->graphicsQueue, 1, &submitInfo,
@@ -101,6 +249,14 @@ VkResult SubmitCommandBuffers( Swap_Chain *swapChain, VkCommandBuffer *buffers,
         return {};
     }
 
+    swapChain->frameNumber++;
+
+    if ( swapChain->offscreen )
+    {
+        swapChain->currentFrame = ( swapChain->currentFrame + 1 ) % swapChain->framesInFlight;
+        return VK_SUCCESS;
+    }
+
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
@@ -113,22 +269,40 @@ VkResult SubmitCommandBuffers( Swap_Chain *swapChain, VkCommandBuffer *buffers,
 
     presentInfo.pImageIndices = imageIndex;
 
-    auto result = vkQueuePresentKHR( swapChain->device->presentQueue, &presentInfo );
+    VkResult result;
+    {
+        TRACE_ZONE( "vkQueuePresentKHR" );
+        result = vkQueuePresentKHR( swapChain->device->presentQueue, &presentInfo );
+    }
 
-    swapChain->currentFrame = ( swapChain->currentFrame + 1 ) % MAX_FRAMES_IN_FLIGHT;
+    swapChain->currentFrame = ( swapChain->currentFrame + 1 ) % swapChain->framesInFlight;
 
     return result;
 }
 
-void CreateSwapChain( Swap_Chain *swapChain )
+bool CreateSwapChain( Swap_Chain *swapChain )
 {
     Swap_Chain_Support_Details swapChainSupport = GetSwapChainSupport( swapChain->device );
 
     VkSurfaceFormatKHR surfaceFormat = ChooseSwapSurfaceFormat( swapChainSupport.formats );
-    VkPresentModeKHR presentMode = ChooseSwapPresentMode( swapChainSupport.presentModes );
+    VkPresentModeKHR presentMode = ChooseSwapPresentMode( swapChainSupport.presentModes, swapChain->config.presentMode );
     VkExtent2D extent = ChooseSwapExtent( swapChain, &swapChainSupport.capabilities );
 
     u32 imageCount = swapChainSupport.capabilities.minImageCount + 1;
+    if ( swapChain->config.imageCount > 0 )
+    {
+        imageCount = swapChain->config.imageCount;
+    }
+    else if ( swapChain->config.lowLatency )
+    {
+        // every extra image is another frame that can queue up in front of the display
+        imageCount = swapChainSupport.capabilities.minImageCount;
+    }
+
+    if ( imageCount < swapChainSupport.capabilities.minImageCount )
+    {
+        imageCount = swapChainSupport.capabilities.minImageCount;
+    }
     if ( swapChainSupport.capabilities.maxImageCount > 0 &&
          imageCount > swapChainSupport.capabilities.maxImageCount )
     {
@@ -168,12 +342,14 @@ void CreateSwapChain( Swap_Chain *swapChain )
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
 
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    createInfo.oldSwapchain = swapChain->swapChain;
 
+    // the old swap chain is retired either way, it must not be destroyed a second time through swapChain->swapChain
     if ( vkCreateSwapchainKHR( swapChain->device->device, &createInfo, 0, &swapChain->swapChain ) != VK_SUCCESS )
     {
         printf( "Failed to create swap chain!\n" );
-        return;
+        swapChain->swapChain = VK_NULL_HANDLE;
+        return false;
     }
 
     // we only specified a minimum number of images in the swap chain, so the implementation is
@@ -186,176 +362,73 @@ void CreateSwapChain( Swap_Chain *swapChain )
 
     swapChain->swapChainImageFormat = surfaceFormat.format;
     swapChain->swapChainExtent = extent;
+    return true;
 }
 
-void CreateImageViews( Swap_Chain *swapChain )
+void CreateOffscreenImages( Swap_Chain *swapChain, u32 imageCount )
 {
-    swapChain->swapChainImageViews.resize( swapChain->swapChainImages.size() );
-    for ( size_t i = 0; i < swapChain->swapChainImages.size(); i++ )
-    {
-        VkImageViewCreateInfo viewInfo{};
-        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        viewInfo.image = swapChain->swapChainImages[ i ];
-        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        viewInfo.format = swapChain->swapChainImageFormat;
-        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        viewInfo.subresourceRange.baseMipLevel = 0;
-        viewInfo.subresourceRange.levelCount = 1;
-        viewInfo.subresourceRange.baseArrayLayer = 0;
-        viewInfo.subresourceRange.layerCount = 1;
+    std::vector< VkFormat > candidates = { VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM };
+    swapChain->swapChainImageFormat = FindSupportedFormat( swapChain->device, candidates, VK_IMAGE_TILING_OPTIMAL,
+                                                           VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT );
+    swapChain->swapChainExtent = swapChain->windowExtent;
+    swapChain->nextOffscreenImage = 0;
 
-        if ( vkCreateImageView( swapChain->device->device, &viewInfo, 0, &swapChain->swapChainImageViews[ i ] ) != VK_SUCCESS )
-        {
-            printf( "Failed to create texture image view!\n" );
-            return;
-        }
-    }
-}
-
-void CreateRenderPass( Swap_Chain *swapChain )
-{
-    VkAttachmentDescription depthAttachment{};
-    depthAttachment.format = FindDepthFormat( swapChain );
-    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference depthAttachmentRef{};
-    depthAttachmentRef.attachment = 1;
-    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentDescription colorAttachment = {};
-    colorAttachment.format = swapChain->swapChainImageFormat;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    VkAttachmentReference colorAttachmentRef = {};
-    colorAttachmentRef.attachment = 0;
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subpass = {};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorAttachmentRef;
-    subpass.pDepthStencilAttachment = &depthAttachmentRef;
-
-    VkSubpassDependency dependency = {};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.srcAccessMask = 0;
-    dependency.srcStageMask =
-    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.dstSubpass = 0;
-    dependency.dstStageMask =
-    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.dstAccessMask =
-    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-    std::vector< VkAttachmentDescription > attachments = { colorAttachment, depthAttachment };
-    VkRenderPassCreateInfo renderPassInfo = {};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = static_cast< uint32_t >( attachments.size() );
-    renderPassInfo.pAttachments = attachments.data();
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
-
-    if ( vkCreateRenderPass( swapChain->device->device, &renderPassInfo, 0, &swapChain->renderPass ) != VK_SUCCESS )
-    {
-        printf( "Failed to create render pass!\n" );
-        return;
-    }
-}
-
-void CreateFramebuffers( Swap_Chain *swapChain )
-{
-    swapChain->swapChainFramebuffers.resize( swapChain->swapChainImages.size() );
-    for ( size_t i = 0; i < swapChain->swapChainImages.size(); i++ )
-    {
-        std::vector< VkImageView > attachments = { swapChain->swapChainImageViews[ i ], swapChain->depthImageViews[ i ] };
-
-        VkExtent2D swapChainExtent = swapChain->swapChainExtent;
-        VkFramebufferCreateInfo framebufferInfo = {};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = swapChain->renderPass;
-        framebufferInfo.attachmentCount = static_cast< uint32_t >( attachments.size() );
-        framebufferInfo.pAttachments = attachments.data();
-        framebufferInfo.width = swapChainExtent.width;
-        framebufferInfo.height = swapChainExtent.height;
-        framebufferInfo.layers = 1;
-
-        if ( vkCreateFramebuffer( swapChain->device->device, &framebufferInfo, 0,
-                                  &swapChain->swapChainFramebuffers[ i ] ) != VK_SUCCESS )
-        {
-            printf( "Failed to create framebuffer!\n" );
-            return;
-        }
-    }
-}
-
-void CreateDepthResources( Swap_Chain *swapChain )
-{
-    VkFormat depthFormat = FindDepthFormat( swapChain );
-    VkExtent2D swapChainExtent = swapChain->swapChainExtent;
-
-    size_t imageCount = swapChain->swapChainImages.size();
-    swapChain->depthImages.resize( imageCount );
-    swapChain->depthImageMemorys.resize( imageCount );
-    swapChain->depthImageViews.resize( imageCount );
+    swapChain->swapChainImages.resize( imageCount );
+    swapChain->offscreenImageAllocations.resize( imageCount );
 
-    for ( u32 i = 0; i < swapChain->depthImages.size(); i++ )
+    for ( u32 i = 0; i < imageCount; i++ )
     {
         VkImageCreateInfo imageInfo{};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         imageInfo.imageType = VK_IMAGE_TYPE_2D;
-        imageInfo.extent.width = swapChainExtent.width;
-        imageInfo.extent.height = swapChainExtent.height;
+        imageInfo.extent.width = swapChain->swapChainExtent.width;
+        imageInfo.extent.height = swapChain->swapChainExtent.height;
         imageInfo.extent.depth = 1;
         imageInfo.mipLevels = 1;
         imageInfo.arrayLayers = 1;
-        imageInfo.format = depthFormat;
+        imageInfo.format = swapChain->swapChainImageFormat;
         imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
         imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        // transfer src so frames can be read back for captures
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
         imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         imageInfo.flags = 0;
 
         CreateImageWithInfo( swapChain->device, imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                             swapChain->depthImages[ i ], swapChain->depthImageMemorys[ i ] );
+                             swapChain->swapChainImages[ i ], swapChain->offscreenImageAllocations[ i ] );
+    }
+}
 
+void CreateImageViews( Swap_Chain *swapChain )
+{
+    swapChain->swapChainImageViews.resize( swapChain->swapChainImages.size() );
+    for ( size_t i = 0; i < swapChain->swapChainImages.size(); i++ )
+    {
         VkImageViewCreateInfo viewInfo{};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        viewInfo.image = swapChain->depthImages[ i ];
+        viewInfo.image = swapChain->swapChainImages[ i ];
         viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        viewInfo.format = depthFormat;
-        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        viewInfo.format = swapChain->swapChainImageFormat;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         viewInfo.subresourceRange.baseMipLevel = 0;
         viewInfo.subresourceRange.levelCount = 1;
         viewInfo.subresourceRange.baseArrayLayer = 0;
         viewInfo.subresourceRange.layerCount = 1;
 
-        if ( vkCreateImageView( swapChain->device->device, &viewInfo, 0, &swapChain->depthImageViews[ i ] ) != VK_SUCCESS )
+        if ( vkCreateImageView( swapChain->device->device, &viewInfo, 0, &swapChain->swapChainImageViews[ i ] ) != VK_SUCCESS )
         {
             printf( "Failed to create texture image view!\n" );
+            return;
         }
     }
 }
 
 void CreateSyncObjects( Swap_Chain *swapChain )
 {
-    swapChain->imageAvailableSemaphores.resize( MAX_FRAMES_IN_FLIGHT );
-    swapChain->renderFinishedSemaphores.resize( MAX_FRAMES_IN_FLIGHT );
-    swapChain->inFlightFences.resize( MAX_FRAMES_IN_FLIGHT );
+    swapChain->imageAvailableSemaphores.resize( swapChain->framesInFlight );
+    swapChain->renderFinishedSemaphores.resize( swapChain->framesInFlight );
+    swapChain->inFlightFences.resize( swapChain->framesInFlight );
     swapChain->imagesInFlight.resize( swapChain->swapChainImages.size(), VK_NULL_HANDLE );
 
     VkSemaphoreCreateInfo semaphoreInfo = {};
@@ -365,7 +438,7 @@ void CreateSyncObjects( Swap_Chain *swapChain )
     fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    for ( size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++ )
+    for ( size_t i = 0; i < swapChain->framesInFlight; i++ )
     {
         if ( vkCreateSemaphore( swapChain->device->device, &semaphoreInfo, 0,
                                 &swapChain->imageAvailableSemaphores[ i ] ) != VK_SUCCESS ||
@@ -393,28 +466,35 @@ VkSurfaceFormatKHR ChooseSwapSurfaceFormat( std::vector< VkSurfaceFormatKHR > &a
     return availableFormats[ 0 ];
 }
 
-VkPresentModeKHR ChooseSwapPresentMode( std::vector< VkPresentModeKHR > &availablePresentModes )
+VkPresentModeKHR ChooseSwapPresentMode( std::vector< VkPresentModeKHR > &availablePresentModes, VkPresentModeKHR preferredMode )
 {
     for ( const auto &availablePresentMode : availablePresentModes )
     {
-        if ( availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR )
+        if ( availablePresentMode == preferredMode )
         {
-            printf( "Present mode: Mailbox\n" );
+            printf( "Present mode: %s\n", GetPresentModeName( availablePresentMode ) );
             return availablePresentMode;
         }
     }
 
-    // for (const auto &availablePresentMode : availablePresentModes) {
-    //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-    //     std::cout << "Present mode: Immediate" << std::endl;
-    //     return availablePresentMode;
-    //   }
-    // }
-
-    printf( "Present mode: V-Sync" );
+    // FIFO is the only mode every surface has to support
+    printf( "Present mode: %s is not supported, using %s\n", GetPresentModeName( preferredMode ),
+            GetPresentModeName( VK_PRESENT_MODE_FIFO_KHR ) );
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
+char *GetPresentModeName( VkPresentModeKHR presentMode )
+{
+    switch ( presentMode )
+    {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: return "Immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR: return "Mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR: return "V-Sync";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "Relaxed V-Sync";
+        default: return "Unknown";
+    }
+}
+
 VkExtent2D ChooseSwapExtent( Swap_Chain *swapChain, VkSurfaceCapabilitiesKHR *capabilities )
 {
     if ( capabilities->currentExtent.width != 0xFFFFFFFF )
@@ -6,19 +6,36 @@
 #include <string> //@TODO: Remove the std garbage
 #include <vector>
 
-#define MAX_FRAMES_IN_FLIGHT 2
+#define DEFAULT_FRAMES_IN_FLIGHT 2
+#define OFFSCREEN_IMAGE_COUNT 3
+
+struct Swap_Chain_Config
+{
+    u32 framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+    // 0 picks one more than the surface minimum, or exactly OFFSCREEN_IMAGE_COUNT when headless
+    u32 imageCount = 0;
+    // falls back to FIFO when the surface doesn't support it
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+    // at most one frame queued behind the one on the GPU and the fewest images the surface allows,
+    // Frame_Pacer takes care of sampling input late
+    bool lowLatency = false;
+};
+
+// Everything that depends on the extent, kept alive until the last frame that used it has finished
+struct Retired_Swap_Chain
+{
+    VkSwapchainKHR swapChain;
+    std::vector< VkImageView > imageViews;
+    std::vector< VkImage > offscreenImages;
+    std::vector< Gpu_Allocation > offscreenImageAllocations;
+    u64 retireFrame;
+};
 
 struct Swap_Chain
 {
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
 
-    std::vector< VkFramebuffer > swapChainFramebuffers;
-    VkRenderPass renderPass;
-
-    std::vector< VkImage > depthImages;
-    std::vector< VkDeviceMemory > depthImageMemorys;
-    std::vector< VkImageView > depthImageViews;
     std::vector< VkImage > swapChainImages;
     std::vector< VkImageView > swapChainImageViews;
 
@@ -27,39 +44,57 @@ struct Swap_Chain
 
     VkSwapchainKHR swapChain;
 
+    // Headless devices render into these instead of swap chain images
+    bool offscreen;
+    std::vector< Gpu_Allocation > offscreenImageAllocations;
+    u32 nextOffscreenImage;
+
     std::vector< VkSemaphore > imageAvailableSemaphores;
     std::vector< VkSemaphore > renderFinishedSemaphores;
     std::vector< VkFence > inFlightFences;
     std::vector< VkFence > imagesInFlight;
     size_t currentFrame = 0;
+    Swap_Chain_Config config;
+    u32 framesInFlight;
+
+    // number of frames submitted so far
+    u64 frameNumber;
+    // bumped whenever the images are recreated, anything built on the image views rebuilds when it changes
+    u64 recreateCount;
+    std::vector< Retired_Swap_Chain > retired;
 };
 
-void InitSwapChain( Swap_Chain *swapChain, Device *device, VkExtent2D extent );
+void InitSwapChain( Swap_Chain *swapChain, Device *device, VkExtent2D extent, Swap_Chain_Config config = {} );
 
 void DestroySwapChain( Swap_Chain *swapChain );
 
+// Builds a new swap chain from the old one without waiting for the device. Frames already in flight keep
+// using the old images, which are destroyed once their fences have signalled.
+// On failure there is no swap chain until a later recreation succeeds, AcquireNextImage reports it as out of date
+bool RecreateSwapChain( Swap_Chain *swapChain, VkExtent2D extent );
+
 float32 ExtentAspectRatio( VkExtent2D extent );
 
 VkFormat FindDepthFormat( Swap_Chain *swapChain );
 
 VkResult AcquireNextImage( Swap_Chain *swapChain, u32 *imageIndex );
 
-VkResult SubmitCommandBuffers( Swap_Chain *swapChain, VkCommandBuffer *buffers, u32 *imageIndex );
+// With a timeline semaphore the submit also waits at timelineStages until it reaches timelineValue
+VkResult SubmitCommandBuffers( Swap_Chain *swapChain, VkCommandBuffer *buffers, u32 *imageIndex, VkSemaphore timeline = VK_NULL_HANDLE,
+                               u64 timelineValue = 0, VkPipelineStageFlags timelineStages = 0 );
 
-void CreateSwapChain( Swap_Chain *swapChain );
-
-void CreateImageViews( Swap_Chain *swapChain );
+bool CreateSwapChain( Swap_Chain *swapChain );
 
-void CreateDepthResources( Swap_Chain *swapChain );
+void CreateOffscreenImages( Swap_Chain *swapChain, u32 imageCount );
 
-void CreateRenderPass( Swap_Chain *swapChain );
-
-void CreateFramebuffers( Swap_Chain *swapChain );
+void CreateImageViews( Swap_Chain *swapChain );
 
 void CreateSyncObjects( Swap_Chain *swapChain );
 
 VkSurfaceFormatKHR ChooseSwapSurfaceFormat( std::vector< VkSurfaceFormatKHR > &availableFormats );
 
-VkPresentModeKHR ChooseSwapPresentMode( std::vector< VkPresentModeKHR > &availablePresentModes );
+VkPresentModeKHR ChooseSwapPresentMode( std::vector< VkPresentModeKHR > &availablePresentModes, VkPresentModeKHR preferredMode );
+
+char *GetPresentModeName( VkPresentModeKHR presentMode );
 
 VkExtent2D ChooseSwapExtent( Swap_Chain *swapChain, VkSurfaceCapabilitiesKHR *capabilities );
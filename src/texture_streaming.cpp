@@ -0,0 +1,717 @@
+#include "texture_streaming.h"
+#include "platform.h"
+#include "trace.h"
+#include "stdio.h"
+#include "string.h"
+#include <algorithm> //@TODO: Remove std garbage
+
+static u8 ktx2Identifier[ 12 ] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+struct Ktx2_Header
+{
+    u8 identifier[ 12 ];
+    u32 vkFormat;
+    u32 typeSize;
+    u32 pixelWidth;
+    u32 pixelHeight;
+    u32 pixelDepth;
+    u32 layerCount;
+    u32 faceCount;
+    u32 levelCount;
+    u32 supercompressionScheme;
+    u32 dfdByteOffset;
+    u32 dfdByteLength;
+    u32 kvdByteOffset;
+    u32 kvdByteLength;
+    u64 sgdByteOffset;
+    u64 sgdByteLength;
+};
+
+struct Ktx2_Level_Index
+{
+    u64 byteOffset;
+    u64 byteLength;
+    u64 uncompressedByteLength;
+};
+
+struct Ktx2_Format_Block
+{
+    u32 width;
+    u32 height;
+    u32 bytes;
+};
+
+// The formats whose level sizes can be checked, everything else is rejected
+static bool GetKtx2FormatBlock( VkFormat format, Ktx2_Format_Block *block )
+{
+    switch ( format )
+    {
+    case VK_FORMAT_R8_UNORM:
+        *block = { 1, 1, 1 };
+        return true;
+    case VK_FORMAT_R8G8_UNORM:
+        *block = { 1, 1, 2 };
+        return true;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        *block = { 1, 1, 4 };
+        return true;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        *block = { 1, 1, 8 };
+        return true;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        *block = { 1, 1, 16 };
+        return true;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+        *block = { 4, 4, 8 };
+        return true;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+    case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        *block = { 4, 4, 16 };
+        return true;
+    default:
+        return false;
+    }
+}
+
+static u32 MipExtent( u32 extent, u32 mip )
+{
+    u32 result = extent >> mip;
+    return result > 0 ? result : 1;
+}
+
+bool ParseKtx2( void *data, u64 size, Ktx2_Texture *texture )
+{
+    *texture = {};
+    if ( size < sizeof( Ktx2_Header ) )
+    {
+        printf( "KTX2 file is too small\n" );
+        return false;
+    }
+
+    Ktx2_Header header;
+    memcpy( &header, data, sizeof( header ) );
+    if ( memcmp( header.identifier, ktx2Identifier, sizeof( ktx2Identifier ) ) != 0 )
+    {
+        printf( "Not a KTX2 file\n" );
+        return false;
+    }
+
+    // format 0 means Basis Universal, which would need transcoding first
+    if ( header.vkFormat == VK_FORMAT_UNDEFINED || header.supercompressionScheme != 0 || header.pixelWidth == 0 ||
+         header.pixelHeight == 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 )
+    {
+        printf( "Only KTX2 files of single 2D textures without supercompression are supported\n" );
+        return false;
+    }
+
+    Ktx2_Format_Block block;
+    if ( !GetKtx2FormatBlock( ( VkFormat ) header.vkFormat, &block ) )
+    {
+        printf( "KTX2 format %u isn't supported\n", header.vkFormat );
+        return false;
+    }
+
+    // 0 asks the loader to generate the mips, the file then only holds level 0
+    u32 levelCount = header.levelCount > 0 ? header.levelCount : 1;
+    u32 largestExtent = header.pixelWidth > header.pixelHeight ? header.pixelWidth : header.pixelHeight;
+    u32 fullChainLevels = 1;
+    while ( largestExtent >> fullChainLevels ) fullChainLevels++;
+    if ( levelCount > KTX2_MAX_LEVELS || levelCount > fullChainLevels ||
+         sizeof( Ktx2_Header ) + levelCount * sizeof( Ktx2_Level_Index ) > size )
+    {
+        printf( "KTX2 level index is invalid\n" );
+        return false;
+    }
+
+    texture->format = ( VkFormat ) header.vkFormat;
+    texture->width = header.pixelWidth;
+    texture->height = header.pixelHeight;
+    texture->levelCount = levelCount;
+
+    Ktx2_Level_Index *levels = ( Ktx2_Level_Index * ) ( ( u8 * ) data + sizeof( Ktx2_Header ) );
+    for ( u32 i = 0; i < levelCount; ++i )
+    {
+        Ktx2_Level_Index level;
+        memcpy( &level, &levels[ i ], sizeof( level ) );
+        if ( level.byteLength == 0 || level.byteOffset > size || level.byteLength > size - level.byteOffset )
+        {
+            printf( "KTX2 level %u is out of bounds\n", i );
+            return false;
+        }
+
+        // the copy region covers the whole level, so a shorter level would be read past its end
+        u64 blocksWide = ( MipExtent( header.pixelWidth, i ) + block.width - 1 ) / block.width;
+        u64 blocksHigh = ( MipExtent( header.pixelHeight, i ) + block.height - 1 ) / block.height;
+        if ( level.byteLength < blocksWide * blocksHigh * block.bytes )
+        {
+            printf( "KTX2 level %u is smaller than its extent\n", i );
+            return false;
+        }
+        texture->levels[ i ] = { level.byteOffset, level.byteLength };
+    }
+    return true;
+}
+
+bool CreateTestPatternKtx2( u32 size, u32 seed, Asset_Data *file )
+{
+    u32 levelCount = 1;
+    while ( ( size >> levelCount ) > 0 && levelCount < KTX2_MAX_LEVELS ) levelCount++;
+
+    u64 headerSize = sizeof( Ktx2_Header ) + levelCount * sizeof( Ktx2_Level_Index );
+    u64 fileSize = headerSize;
+    for ( u32 mip = 0; mip < levelCount; ++mip )
+    {
+        fileSize += ( u64 ) MipExtent( size, mip ) * MipExtent( size, mip ) * 4;
+    }
+
+    u8 *data = ( u8 * ) AllocateAligned( fileSize, 64 );
+    if ( !data )
+    {
+        return false;
+    }
+
+    Ktx2_Header header = {};
+    memcpy( header.identifier, ktx2Identifier, sizeof( ktx2Identifier ) );
+    header.vkFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    header.typeSize = 1;
+    header.pixelWidth = size;
+    header.pixelHeight = size;
+    header.faceCount = 1;
+    header.levelCount = levelCount;
+    memcpy( data, &header, sizeof( header ) );
+
+    // a checkerboard tinted by the seed, every mip is drawn straight at its size so the cells line up
+    u8 tint[ 3 ] = { ( u8 ) ( 96 + ( seed * 67 ) % 160 ), ( u8 ) ( 96 + ( seed * 131 ) % 160 ), ( u8 ) ( 96 + ( seed * 193 ) % 160 ) };
+    u64 offset = headerSize;
+    for ( u32 mip = 0; mip < levelCount; ++mip )
+    {
+        u32 extent = MipExtent( size, mip );
+        u32 cell = MipExtent( 64, mip );
+        Ktx2_Level_Index level = { offset, ( u64 ) extent * extent * 4, ( u64 ) extent * extent * 4 };
+        memcpy( data + sizeof( Ktx2_Header ) + mip * sizeof( Ktx2_Level_Index ), &level, sizeof( level ) );
+
+        u8 *pixel = data + offset;
+        for ( u32 y = 0; y < extent; ++y )
+        {
+            for ( u32 x = 0; x < extent; ++x )
+            {
+                bool dark = ( ( x / cell ) + ( y / cell ) ) & 1;
+                pixel[ 0 ] = dark ? tint[ 0 ] / 2 : tint[ 0 ];
+                pixel[ 1 ] = dark ? tint[ 1 ] / 2 : tint[ 1 ];
+                pixel[ 2 ] = dark ? tint[ 2 ] / 2 : tint[ 2 ];
+                pixel[ 3 ] = 255;
+                pixel += 4;
+            }
+        }
+        offset += level.byteLength;
+    }
+
+    file->data = data;
+    file->size = fileSize;
+    file->owned = true;
+    return true;
+}
+
+static VkDeviceSize MipRangeBytes( Streamed_Texture *texture, u32 firstMip )
+{
+    VkDeviceSize bytes = 0;
+    for ( u32 i = firstMip; i < texture->ktx.levelCount; ++i )
+    {
+        bytes += texture->ktx.levels[ i ].size;
+    }
+    return bytes;
+}
+
+// What the texture will hold once its pending change lands, the budget is checked against this
+static VkDeviceSize CommittedBytes( Streamed_Texture *texture )
+{
+    if ( texture->pending ) return MipRangeBytes( texture, texture->pendingMip );
+    if ( texture->image != VK_NULL_HANDLE ) return MipRangeBytes( texture, texture->residentMip );
+    return 0;
+}
+
+bool InitTextureStreamer( Texture_Streamer *streamer, Device *device, Upload_Manager *uploads, Bindless_Set *bindless,
+                          u32 framesInFlight, VkDeviceSize budget )
+{
+    TRACE_FUNCTION();
+    streamer->device = device;
+    streamer->uploads = uploads;
+    streamer->bindless = bindless;
+    streamer->budget = budget;
+    streamer->textures.clear();
+    streamer->textures.reserve( TEXTURE_STREAMING_MAX_TEXTURES );
+    streamer->retired.clear();
+    streamer->feedback.clear();
+    streamer->sampler = VK_NULL_HANDLE;
+    streamer->samplerIndex = BINDLESS_INVALID_INDEX;
+    streamer->stats = {};
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.anisotropyEnable = VK_TRUE;
+    samplerInfo.maxAnisotropy = device->properties.limits.maxSamplerAnisotropy < 8.0f ?
+                                device->properties.limits.maxSamplerAnisotropy : 8.0f;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    if ( vkCreateSampler( device->device, &samplerInfo, 0, &streamer->sampler ) != VK_SUCCESS )
+    {
+        printf( "Failed to create texture sampler!\n" );
+        return false;
+    }
+    streamer->samplerIndex = AddBindlessSampler( bindless, streamer->sampler );
+
+    streamer->feedback.resize( framesInFlight );
+    for ( auto &feedback : streamer->feedback )
+    {
+        feedback = {};
+        feedback.bindlessIndex = BINDLESS_INVALID_INDEX;
+    }
+
+    for ( auto &feedback : streamer->feedback )
+    {
+        VkDeviceSize size = TEXTURE_STREAMING_MAX_TEXTURES * sizeof( u32 );
+        CreateBuffer( device, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, feedback.buffer,
+                      feedback.allocation );
+        feedback.minMips = ( u32 * ) feedback.allocation.mapped;
+        if ( !feedback.minMips )
+        {
+            printf( "Failed to create texture feedback buffer!\n" );
+            DestroyTextureStreamer( streamer );
+            return false;
+        }
+        memset( feedback.minMips, 0xff, size );
+        feedback.bindlessIndex = AddBindlessStorageBuffer( bindless, feedback.buffer );
+    }
+
+    return streamer->samplerIndex != BINDLESS_INVALID_INDEX;
+}
+
+static void DestroyTextureImage( Texture_Streamer *streamer, VkImage image, Gpu_Allocation &allocation, VkImageView view )
+{
+    if ( image == VK_NULL_HANDLE )
+    {
+        return;
+    }
+    streamer->stats.residentBytes -= allocation.size;
+    vkDestroyImageView( streamer->device->device, view, 0 );
+    DestroyImage( streamer->device, image, allocation );
+}
+
+// Only once the device is idle
+void DestroyTextureStreamer( Texture_Streamer *streamer )
+{
+    Device *device = streamer->device;
+
+    // copies into pending images may still be recorded and not submitted
+    WaitForUpload( streamer->uploads, FlushUploads( streamer->uploads ) );
+    for ( auto &texture : streamer->textures )
+    {
+        RemoveBindlessResource( streamer->bindless, BINDLESS_BINDING_SAMPLED_IMAGES, texture.bindlessIndex, 0 );
+        DestroyTextureImage( streamer, texture.image, texture.allocation, texture.view );
+        if ( texture.pending )
+        {
+            DestroyTextureImage( streamer, texture.pendingImage, texture.pendingAllocation, texture.pendingView );
+        }
+        FreeAsset( &texture.file );
+    }
+    streamer->textures.clear();
+
+    for ( auto &retired : streamer->retired )
+    {
+        DestroyTextureImage( streamer, retired.image, retired.allocation, retired.view );
+    }
+    streamer->retired.clear();
+
+    for ( auto &feedback : streamer->feedback )
+    {
+        RemoveBindlessResource( streamer->bindless, BINDLESS_BINDING_STORAGE_BUFFERS, feedback.bindlessIndex, 0 );
+        if ( feedback.buffer != VK_NULL_HANDLE )
+        {
+            DestroyBuffer( device, feedback.buffer, feedback.allocation );
+        }
+    }
+    streamer->feedback.clear();
+
+    RemoveBindlessResource( streamer->bindless, BINDLESS_BINDING_SAMPLERS, streamer->samplerIndex, 0 );
+    vkDestroySampler( device->device, streamer->sampler, 0 );
+    streamer->sampler = VK_NULL_HANDLE;
+}
+
+// Creates an image holding firstMip and everything smaller and queues the uploads for all of it. The file is
+// mapped or already in memory, so re-uploading the smaller mips is cheaper than a GPU copy with its own queue sync
+static bool BeginMipChange( Texture_Streamer *streamer, Streamed_Texture *texture, u32 firstMip )
+{
+    TRACE_FUNCTION();
+    Ktx2_Texture *ktx = &texture->ktx;
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = ktx->format;
+    imageInfo.extent = { MipExtent( ktx->width, firstMip ), MipExtent( ktx->height, firstMip ), 1 };
+    imageInfo.mipLevels = ktx->levelCount - firstMip;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkImage image = VK_NULL_HANDLE;
+    Gpu_Allocation allocation = {};
+    CreateImageWithInfo( streamer->device, imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, allocation );
+    if ( allocation.memory == VK_NULL_HANDLE )
+    {
+        printf( "Failed to create streamed texture image!\n" );
+        return false;
+    }
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = ktx->format;
+    viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, imageInfo.mipLevels, 0, 1 };
+
+    VkImageView view;
+    if ( vkCreateImageView( streamer->device->device, &viewInfo, 0, &view ) != VK_SUCCESS )
+    {
+        printf( "Failed to create streamed texture view!\n" );
+        DestroyImage( streamer->device, image, allocation );
+        return false;
+    }
+
+    Upload_Token token = 0;
+    VkDeviceSize uploadedBytes = 0;
+    for ( u32 mip = firstMip; mip < ktx->levelCount; ++mip )
+    {
+        Ktx2_Level *level = &ktx->levels[ mip ];
+        token = UploadToImageMip( streamer->uploads, image, mip - firstMip, MipExtent( ktx->width, mip ),
+                                  MipExtent( ktx->height, mip ), ( u8 * ) texture->file.data + level->offset, level->size,
+                                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL );
+        uploadedBytes += level->size;
+    }
+
+    texture->pending = true;
+    texture->pendingImage = image;
+    texture->pendingAllocation = allocation;
+    texture->pendingView = view;
+    texture->pendingMip = firstMip;
+    texture->pendingToken = token;
+
+    streamer->stats.residentBytes += allocation.size;
+    if ( streamer->stats.residentBytes > streamer->stats.peakResidentBytes )
+    {
+        streamer->stats.peakResidentBytes = streamer->stats.residentBytes;
+    }
+    streamer->stats.streamedBytes += uploadedBytes;
+    return true;
+}
+
+u32 AddStreamedTexture( Texture_Streamer *streamer, Asset_Data *file )
+{
+    TRACE_FUNCTION();
+    if ( streamer->textures.size() >= TEXTURE_STREAMING_MAX_TEXTURES )
+    {
+        printf( "Too many streamed textures!\n" );
+        FreeAsset( file );
+        return TEXTURE_FEEDBACK_NONE;
+    }
+
+    Streamed_Texture texture = {};
+    texture.file = *file;
+    *file = {};
+    if ( !ParseKtx2( texture.file.data, texture.file.size, &texture.ktx ) )
+    {
+        FreeAsset( &texture.file );
+        return TEXTURE_FEEDBACK_NONE;
+    }
+
+    // the small mips are cheap and keep something on screen no matter how tight the budget gets
+    texture.tailMip = texture.ktx.levelCount - 1;
+    while ( texture.tailMip > 0 && MipExtent( texture.ktx.width, texture.tailMip - 1 ) <= TEXTURE_STREAMING_TAIL_SIZE &&
+            MipExtent( texture.ktx.height, texture.tailMip - 1 ) <= TEXTURE_STREAMING_TAIL_SIZE )
+    {
+        texture.tailMip--;
+    }
+    texture.residentMip = texture.ktx.levelCount;
+    texture.wantedMip = texture.tailMip;
+    texture.bindlessIndex = BINDLESS_INVALID_INDEX;
+
+    streamer->textures.push_back( texture );
+    Streamed_Texture *added = &streamer->textures.back();
+    if ( !BeginMipChange( streamer, added, added->tailMip ) )
+    {
+        FreeAsset( &added->file );
+        streamer->textures.pop_back();
+        return TEXTURE_FEEDBACK_NONE;
+    }
+    return ( u32 ) streamer->textures.size() - 1;
+}
+
+u32 LoadStreamedTexture( Texture_Streamer *streamer, char *path )
+{
+    Asset_Data file;
+    if ( !LoadAsset( path, &file ) )
+    {
+        return TEXTURE_FEEDBACK_NONE;
+    }
+    return AddStreamedTexture( streamer, &file );
+}
+
+u32 GetTextureBindlessIndex( Texture_Streamer *streamer, u32 texture )
+{
+    if ( texture >= streamer->textures.size() )
+    {
+        return BINDLESS_INVALID_INDEX;
+    }
+    return streamer->textures[ texture ].bindlessIndex;
+}
+
+u32 GetTextureFeedbackIndex( Texture_Streamer *streamer, u32 frameIndex )
+{
+    return streamer->feedback[ frameIndex ].bindlessIndex;
+}
+
+void RecordTextureFeedbackBarrier( Texture_Streamer *streamer, VkCommandBuffer commandBuffer, u32 frameIndex )
+{
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = streamer->feedback[ frameIndex ].buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                          0, 0, 0, 1, &barrier, 0, 0 );
+}
+
+static void FinishMipChange( Texture_Streamer *streamer, Streamed_Texture *texture, u64 frameNumber )
+{
+    // frames already recorded keep sampling the old image through the old slot until they retire
+    if ( texture->image != VK_NULL_HANDLE )
+    {
+        streamer->retired.push_back( { texture->image, texture->allocation, texture->view, frameNumber } );
+        RemoveBindlessResource( streamer->bindless, BINDLESS_BINDING_SAMPLED_IMAGES, texture->bindlessIndex, frameNumber );
+    }
+
+    texture->image = texture->pendingImage;
+    texture->allocation = texture->pendingAllocation;
+    texture->view = texture->pendingView;
+    texture->residentMip = texture->pendingMip;
+    texture->bindlessIndex = AddBindlessSampledImage( streamer->bindless, texture->view,
+                                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL );
+    texture->pending = false;
+    texture->pendingImage = VK_NULL_HANDLE;
+    texture->pendingView = VK_NULL_HANDLE;
+}
+
+// A change re-uploads its whole mip chain. One change is let through whatever its size as long as nothing else was
+// started this frame, otherwise a chain bigger than the per frame cap could never become resident
+static bool FitsUploadBudget( VkDeviceSize uploadBudget, VkDeviceSize bytes )
+{
+    return bytes <= uploadBudget || uploadBudget == TEXTURE_STREAMING_BYTES_PER_FRAME;
+}
+
+static void ChargeUploadBudget( VkDeviceSize *uploadBudget, VkDeviceSize bytes )
+{
+    *uploadBudget = bytes < *uploadBudget ? *uploadBudget - bytes : 0;
+}
+
+// Frees budget by dropping detail from textures that are over resolved or less recently used than the one
+// that needs the space, never below their tail
+static bool MakeRoom( Texture_Streamer *streamer, u32 needyIndex, VkDeviceSize needed, VkDeviceSize *committed,
+                      VkDeviceSize *uploadBudget )
+{
+    Streamed_Texture *needy = &streamer->textures[ needyIndex ];
+
+    std::vector< u32 > victims;
+    for ( u32 i = 0; i < streamer->textures.size(); ++i )
+    {
+        Streamed_Texture *texture = &streamer->textures[ i ];
+        bool overResolved = texture->wantedMip > texture->residentMip;
+        if ( i == needyIndex || texture->pending || texture->image == VK_NULL_HANDLE || texture->residentMip >= texture->tailMip )
+        {
+            continue;
+        }
+        if ( overResolved || texture->lastUsedFrame < needy->lastUsedFrame )
+        {
+            victims.push_back( i );
+        }
+    }
+
+    std::sort( victims.begin(), victims.end(), [ streamer ]( u32 a, u32 b ) {
+        Streamed_Texture *textureA = &streamer->textures[ a ];
+        Streamed_Texture *textureB = &streamer->textures[ b ];
+        bool overA = textureA->wantedMip > textureA->residentMip;
+        bool overB = textureB->wantedMip > textureB->residentMip;
+        if ( overA != overB ) return overA;
+        return textureA->lastUsedFrame < textureB->lastUsedFrame;
+    } );
+
+    for ( u32 victimIndex : victims )
+    {
+        if ( *committed + needed <= streamer->budget )
+        {
+            break;
+        }
+
+        Streamed_Texture *victim = &streamer->textures[ victimIndex ];
+        u32 newMip = victim->wantedMip > victim->residentMip ? victim->wantedMip : victim->residentMip + 1;
+        VkDeviceSize oldBytes = CommittedBytes( victim );
+        VkDeviceSize newBytes = MipRangeBytes( victim, newMip );
+        if ( !FitsUploadBudget( *uploadBudget, newBytes ) || !BeginMipChange( streamer, victim, newMip ) )
+        {
+            continue;
+        }
+        ChargeUploadBudget( uploadBudget, newBytes );
+        *committed -= oldBytes - newBytes;
+        streamer->stats.evictionCount++;
+    }
+
+    return *committed + needed <= streamer->budget;
+}
+
+void UpdateTextureStreamer( Texture_Streamer *streamer, u32 frameIndex, u64 frameNumber, u32 framesInFlight )
+{
+    TRACE_FUNCTION();
+
+    // the frame that last used this slot has finished, so its feedback is complete
+    u32 *minMips = streamer->feedback[ frameIndex ].minMips;
+    for ( u32 i = 0; i < streamer->textures.size(); ++i )
+    {
+        Streamed_Texture *texture = &streamer->textures[ i ];
+        if ( minMips[ i ] != TEXTURE_FEEDBACK_NONE )
+        {
+            texture->wantedMip = minMips[ i ] < texture->tailMip ? minMips[ i ] : texture->tailMip;
+            texture->lastUsedFrame = frameNumber;
+            minMips[ i ] = TEXTURE_FEEDBACK_NONE;
+        }
+        else if ( texture->lastUsedFrame + TEXTURE_STREAMING_IDLE_FRAMES < frameNumber )
+        {
+            texture->wantedMip = texture->tailMip;
+        }
+
+        if ( texture->pending && IsUploadComplete( streamer->uploads, texture->pendingToken ) )
+        {
+            FinishMipChange( streamer, texture, frameNumber );
+            streamer->stats.streamInCount++;
+        }
+    }
+
+    for ( size_t i = 0; i < streamer->retired.size(); )
+    {
+        Retired_Texture_Image *retired = &streamer->retired[ i ];
+        if ( retired->retireFrame + framesInFlight <= frameNumber )
+        {
+            DestroyTextureImage( streamer, retired->image, retired->allocation, retired->view );
+            *retired = streamer->retired.back();
+            streamer->retired.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    VkDeviceSize committed = 0;
+    std::vector< u32 > requests;
+    for ( u32 i = 0; i < streamer->textures.size(); ++i )
+    {
+        Streamed_Texture *texture = &streamer->textures[ i ];
+        committed += CommittedBytes( texture );
+        if ( !texture->pending && texture->image != VK_NULL_HANDLE && texture->wantedMip < texture->residentMip )
+        {
+            requests.push_back( i );
+        }
+    }
+
+    // the most under resolved textures go first, one mip per change so a single texture can't hog the frame
+    std::sort( requests.begin(), requests.end(), [ streamer ]( u32 a, u32 b ) {
+        Streamed_Texture *textureA = &streamer->textures[ a ];
+        Streamed_Texture *textureB = &streamer->textures[ b ];
+        return textureA->residentMip - textureA->wantedMip > textureB->residentMip - textureB->wantedMip;
+    } );
+
+    VkDeviceSize uploadBudget = TEXTURE_STREAMING_BYTES_PER_FRAME;
+    for ( u32 textureIndex : requests )
+    {
+        if ( uploadBudget == 0 )
+        {
+            break;
+        }
+
+        // a texture too big for what is left this frame doesn't hold back the smaller ones behind it
+        Streamed_Texture *texture = &streamer->textures[ textureIndex ];
+        u32 newMip = texture->residentMip - 1;
+        VkDeviceSize newBytes = MipRangeBytes( texture, newMip );
+        VkDeviceSize growth = newBytes - CommittedBytes( texture );
+        if ( !FitsUploadBudget( uploadBudget, newBytes ) )
+        {
+            continue;
+        }
+
+        if ( committed + growth > streamer->budget && !MakeRoom( streamer, textureIndex, growth, &committed, &uploadBudget ) )
+        {
+            streamer->stats.budgetMissCount++;
+            continue;
+        }
+        // evictions may have used up what was left
+        if ( !FitsUploadBudget( uploadBudget, newBytes ) )
+        {
+            continue;
+        }
+
+        texture = &streamer->textures[ textureIndex ];
+        if ( BeginMipChange( streamer, texture, newMip ) )
+        {
+            ChargeUploadBudget( &uploadBudget, newBytes );
+            committed += growth;
+        }
+    }
+}
+
+void PrintTextureStreamingStats( Texture_Streamer *streamer )
+{
+    Texture_Streaming_Stats *stats = &streamer->stats;
+    printf( "Texture streaming: %u textures, budget %.2f MB\n", ( u32 ) streamer->textures.size(),
+            ( float64 ) streamer->budget / ( 1024.0 * 1024.0 ) );
+    printf( "\tresident: %.2f MB (peak %.2f MB)\n", ( float64 ) stats->residentBytes / ( 1024.0 * 1024.0 ),
+            ( float64 ) stats->peakResidentBytes / ( 1024.0 * 1024.0 ) );
+    printf( "\tstreamed: %.2f MB in %llu changes, %llu evictions, %llu put off by the budget\n",
+            ( float64 ) stats->streamedBytes / ( 1024.0 * 1024.0 ), ( unsigned long long ) stats->streamInCount,
+            ( unsigned long long ) stats->evictionCount, ( unsigned long long ) stats->budgetMissCount );
+    for ( u32 i = 0; i < streamer->textures.size() && i < 16; ++i )
+    {
+        Streamed_Texture *texture = &streamer->textures[ i ];
+        printf( "\t%u: %ux%u, resident from mip %u, wanted %u, tail %u\n", i, texture->ktx.width, texture->ktx.height,
+                texture->residentMip, texture->wantedMip, texture->tailMip );
+    }
+}
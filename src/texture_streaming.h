@@ -0,0 +1,135 @@
+#pragma once
+
+#include "device.h"
+#include "upload.h"
+#include "bindless.h"
+#include "archive.h"
+#include "utils/utils.h"
+#include <vector> //@TODO: Remove std garbage
+
+#define KTX2_MAX_LEVELS 16
+// Mips at or below this size are made resident as soon as a texture is added and never evicted
+#define TEXTURE_STREAMING_TAIL_SIZE 64
+#define TEXTURE_STREAMING_MAX_TEXTURES 4096
+// Caps how much one frame starts uploading so streaming never shows up as a spike
+#define TEXTURE_STREAMING_BYTES_PER_FRAME ( ( VkDeviceSize ) 8 << 20 )
+// Textures not seen by the feedback for this many frames only want their tail
+#define TEXTURE_STREAMING_IDLE_FRAMES 120
+#define TEXTURE_FEEDBACK_NONE 0xffffffff
+
+struct Ktx2_Level
+{
+    u64 offset;
+    u64 size;
+};
+
+// The parts of a KTX2 container the streamer uses, levels point into the file data, level 0 is the largest
+struct Ktx2_Texture
+{
+    VkFormat format;
+    u32 width;
+    u32 height;
+    u32 levelCount;
+    Ktx2_Level levels[ KTX2_MAX_LEVELS ];
+};
+
+// Plain 2D textures without supercompression, the formats are used as is
+bool ParseKtx2( void *data, u64 size, Ktx2_Texture *texture );
+
+// Square RGBA8 checkerboard with a full mip chain, for running without texture files
+bool CreateTestPatternKtx2( u32 size, u32 seed, Asset_Data *file );
+
+struct Streamed_Texture
+{
+    Asset_Data file;
+    Ktx2_Texture ktx;
+    u32 tailMip; // first mip that is always resident
+
+    // the image only holds mips residentMip and smaller, its mip 0 is residentMip of the file
+    VkImage image;
+    Gpu_Allocation allocation;
+    VkImageView view;
+    u32 bindlessIndex;
+    u32 residentMip;
+
+    // a replacement image with a different mip range, swapped in once its uploads have landed
+    bool pending;
+    VkImage pendingImage;
+    Gpu_Allocation pendingAllocation;
+    VkImageView pendingView;
+    u32 pendingMip;
+    Upload_Token pendingToken;
+
+    u32 wantedMip;
+    u64 lastUsedFrame;
+};
+
+struct Retired_Texture_Image
+{
+    VkImage image;
+    Gpu_Allocation allocation;
+    VkImageView view;
+    u64 retireFrame;
+};
+
+// One per frame in flight, the fragment shader atomicMins the finest mip it wanted for each texture
+struct Texture_Feedback_Buffer
+{
+    VkBuffer buffer;
+    Gpu_Allocation allocation;
+    u32 *minMips;
+    u32 bindlessIndex;
+};
+
+struct Texture_Streaming_Stats
+{
+    VkDeviceSize residentBytes;
+    VkDeviceSize peakResidentBytes;
+    VkDeviceSize streamedBytes;
+    u64 streamInCount;
+    u64 evictionCount;
+    u64 budgetMissCount; // uploads put off because nothing else could be evicted
+};
+
+// Streams KTX2 mips in by screen space demand and evicts the least recently used ones to stay inside a VRAM budget.
+// Texture handles are stable, the bindless index behind one changes whenever its mip range does.
+// The budget holds for the mip ranges textures have or are changing to. An image being replaced lives on until its
+// replacement has landed and the frames using it have finished, so for a few frames after a change actual VRAM use
+// can go over it, peakResidentBytes shows by how much
+struct Texture_Streamer
+{
+    Device *device;
+    Upload_Manager *uploads;
+    Bindless_Set *bindless;
+    VkDeviceSize budget;
+
+    std::vector< Streamed_Texture > textures;
+    std::vector< Retired_Texture_Image > retired;
+    std::vector< Texture_Feedback_Buffer > feedback;
+
+    VkSampler sampler;
+    u32 samplerIndex;
+
+    Texture_Streaming_Stats stats;
+};
+
+bool InitTextureStreamer( Texture_Streamer *streamer, Device *device, Upload_Manager *uploads, Bindless_Set *bindless,
+                          u32 framesInFlight, VkDeviceSize budget );
+void DestroyTextureStreamer( Texture_Streamer *streamer );
+
+// Takes the file, its tail mips start uploading right away, returns the handle or TEXTURE_FEEDBACK_NONE
+u32 AddStreamedTexture( Texture_Streamer *streamer, Asset_Data *file );
+u32 LoadStreamedTexture( Texture_Streamer *streamer, char *path );
+
+// BINDLESS_INVALID_INDEX until the tail mips are resident
+u32 GetTextureBindlessIndex( Texture_Streamer *streamer, u32 texture );
+
+// Call after the frame's fence has been waited on, reads its feedback and decides what to stream
+void UpdateTextureStreamer( Texture_Streamer *streamer, u32 frameIndex, u64 frameNumber, u32 framesInFlight );
+
+u32 GetTextureFeedbackIndex( Texture_Streamer *streamer, u32 frameIndex );
+
+// Record after the frame's last draw so UpdateTextureStreamer sees the fragment shader's writes
+void RecordTextureFeedbackBarrier( Texture_Streamer *streamer, VkCommandBuffer commandBuffer, u32 frameIndex );
+
+void PrintTextureStreamingStats( Texture_Streamer *streamer );
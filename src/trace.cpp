@@ -0,0 +1,177 @@
+#include "trace.h"
+
+#ifdef ENABLE_TRACING
+
+#include "platform.h"
+#include "stdio.h"
+#include <atomic> //@TODO: Remove std garbage
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+// Single producer (the owning thread), single consumer (CollectTraceEvents)
+struct Trace_Thread_Buffer
+{
+    Trace_Event events[ TRACE_BUFFER_EVENTS ];
+    std::atomic< u64 > writeIndex;
+    std::atomic< u64 > readIndex;
+    std::atomic< u64 > droppedCount;
+    u32 threadIndex;
+    char *threadName;
+};
+
+struct Trace_Collected_Event
+{
+    Trace_Event event;
+    u32 threadIndex;
+};
+
+struct Trace_State
+{
+    std::mutex mutex;
+    std::vector< Trace_Thread_Buffer * > threads;
+    std::vector< Trace_Collected_Event > collected;
+    u64 droppedCount;
+    u64 startNanoseconds;
+};
+
+static Trace_State traceState;
+static thread_local Trace_Thread_Buffer *threadBuffer;
+
+u64 GetTraceTimestamp()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return ( u64 ) std::chrono::duration_cast< std::chrono::nanoseconds >( now ).count();
+}
+
+static Trace_Thread_Buffer *GetThreadBuffer()
+{
+    if ( !threadBuffer )
+    {
+        Trace_Thread_Buffer *buffer = new Trace_Thread_Buffer;
+        buffer->writeIndex = 0;
+        buffer->readIndex = 0;
+        buffer->droppedCount = 0;
+        buffer->threadName = 0;
+
+        std::lock_guard< std::mutex > lock( traceState.mutex );
+        buffer->threadIndex = ( u32 ) traceState.threads.size();
+        traceState.threads.push_back( buffer );
+        threadBuffer = buffer;
+    }
+    return threadBuffer;
+}
+
+void RecordTraceEvent( const char *name, u64 beginNanoseconds, u64 endNanoseconds )
+{
+    Trace_Thread_Buffer *buffer = GetThreadBuffer();
+
+    u64 write = buffer->writeIndex.load( std::memory_order_relaxed );
+    u64 read = buffer->readIndex.load( std::memory_order_acquire );
+    if ( write - read >= TRACE_BUFFER_EVENTS )
+    {
+        // never block the traced thread, losing an event is better than a stall
+        buffer->droppedCount.fetch_add( 1, std::memory_order_relaxed );
+        return;
+    }
+
+    Trace_Event *event = &buffer->events[ write % TRACE_BUFFER_EVENTS ];
+    event->name = name;
+    event->beginNanoseconds = beginNanoseconds;
+    event->endNanoseconds = endNanoseconds;
+    buffer->writeIndex.store( write + 1, std::memory_order_release );
+}
+
+void InitTracing()
+{
+    traceState.startNanoseconds = GetTraceTimestamp();
+    traceState.droppedCount = 0;
+    SetTraceThreadName( "main" );
+}
+
+void ShutdownTracing()
+{
+    std::lock_guard< std::mutex > lock( traceState.mutex );
+    for ( auto buffer : traceState.threads )
+    {
+        delete buffer;
+    }
+    traceState.threads.clear();
+    traceState.collected.clear();
+    threadBuffer = 0;
+}
+
+void SetTraceThreadName( char *name )
+{
+    GetThreadBuffer()->threadName = name;
+}
+
+void CollectTraceEvents()
+{
+    std::lock_guard< std::mutex > lock( traceState.mutex );
+    for ( auto buffer : traceState.threads )
+    {
+        u64 read = buffer->readIndex.load( std::memory_order_relaxed );
+        u64 write = buffer->writeIndex.load( std::memory_order_acquire );
+
+        for ( ; read < write; ++read )
+        {
+            if ( traceState.collected.size() >= TRACE_MAX_COLLECTED_EVENTS )
+            {
+                traceState.droppedCount++;
+                continue;
+            }
+            traceState.collected.push_back( { buffer->events[ read % TRACE_BUFFER_EVENTS ], buffer->threadIndex } );
+        }
+
+        buffer->readIndex.store( read, std::memory_order_release );
+    }
+}
+
+bool ExportChromeTrace( char *path )
+{
+    CollectTraceEvents();
+
+    FILE *file = OpenFile( path, "w" );
+    if ( !file )
+    {
+        printf( "Failed to write trace: %s\n", path );
+        return false;
+    }
+
+    std::lock_guard< std::mutex > lock( traceState.mutex );
+
+    u64 droppedCount = traceState.droppedCount;
+    fprintf( file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+
+    bool first = true;
+    for ( auto buffer : traceState.threads )
+    {
+        droppedCount += buffer->droppedCount.load( std::memory_order_relaxed );
+        if ( buffer->threadName )
+        {
+            fprintf( file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                     first ? "" : ",\n", buffer->threadIndex, buffer->threadName );
+            first = false;
+        }
+    }
+
+    for ( auto &collected : traceState.collected )
+    {
+        Trace_Event *event = &collected.event;
+        float64 timestamp = ( float64 ) ( event->beginNanoseconds - traceState.startNanoseconds ) / 1000.0;
+        float64 duration = ( float64 ) ( event->endNanoseconds - event->beginNanoseconds ) / 1000.0;
+        fprintf( file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                 first ? "" : ",\n", event->name, collected.threadIndex, timestamp, duration );
+        first = false;
+    }
+
+    fprintf( file, "\n]}\n" );
+    fclose( file );
+
+    printf( "Trace: wrote %llu events to %s (%llu dropped)\n", ( unsigned long long ) traceState.collected.size(), path,
+            ( unsigned long long ) droppedCount );
+    return true;
+}
+
+#endif
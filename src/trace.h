@@ -0,0 +1,65 @@
+#pragma once
+
+#include "utils/utils.h"
+
+// CPU tracing. Build with ENABLE_TRACING to record zones, without it every macro and call below compiles to nothing.
+// Zone names must be string literals, only the pointer is stored.
+#ifdef ENABLE_TRACING
+
+#define TRACE_CONCAT_( a, b ) a##b
+#define TRACE_CONCAT( a, b ) TRACE_CONCAT_( a, b )
+#define TRACE_ZONE( name ) Trace_Scope TRACE_CONCAT( traceScope, __LINE__ )( name )
+#define TRACE_FUNCTION() TRACE_ZONE( __FUNCTION__ )
+
+#define TRACE_BUFFER_EVENTS 16384
+#define TRACE_MAX_COLLECTED_EVENTS ( 1 << 20 )
+
+struct Trace_Event
+{
+    const char *name;
+    u64 beginNanoseconds;
+    u64 endNanoseconds;
+};
+
+u64 GetTraceTimestamp();
+void RecordTraceEvent( const char *name, u64 beginNanoseconds, u64 endNanoseconds );
+
+struct Trace_Scope
+{
+    const char *name;
+    u64 beginNanoseconds;
+
+    Trace_Scope( const char *zoneName )
+    {
+        name = zoneName;
+        beginNanoseconds = GetTraceTimestamp();
+    }
+
+    ~Trace_Scope()
+    {
+        RecordTraceEvent( name, beginNanoseconds, GetTraceTimestamp() );
+    }
+};
+
+void InitTracing();
+void ShutdownTracing();
+void SetTraceThreadName( char *name );
+
+// Drains every thread's ring buffer, call once per frame so the rings never fill up
+void CollectTraceEvents();
+
+// Chrome trace event format, loads in chrome://tracing and ui.perfetto.dev
+bool ExportChromeTrace( char *path );
+
+#else
+
+#define TRACE_ZONE( name )
+#define TRACE_FUNCTION()
+
+inline void InitTracing() {}
+inline void ShutdownTracing() {}
+inline void SetTraceThreadName( char *name ) {}
+inline void CollectTraceEvents() {}
+inline bool ExportChromeTrace( char *path ) { return false; }
+
+#endif
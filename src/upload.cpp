@@ -0,0 +1,431 @@
+#include "upload.h"
+#include "align.h"
+#include "trace.h"
+#include "stdio.h"
+
+void InitUploadManager( Upload_Manager *uploads, Device *device, VkDeviceSize stagingSize )
+{
+    uploads->device = device;
+    uploads->queue = device->transferQueue;
+    uploads->queueFamily = device->queueFamilies.transferFamily;
+    uploads->stagingSize = stagingSize;
+    uploads->head = 0;
+    uploads->tail = 0;
+    uploads->firstBatch = 0;
+    uploads->submittedBatchCount = 0;
+    uploads->recording = false;
+    uploads->nextTimelineValue = 1;
+    uploads->stats = {};
+
+    VkDeviceSize copyAlignment = device->properties.limits.optimalBufferCopyOffsetAlignment;
+    uploads->copyAlignment = copyAlignment > 16 ? copyAlignment : 16;
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = uploads->queueFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    if ( vkCreateCommandPool( device->device, &poolInfo, 0, &uploads->commandPool ) != VK_SUCCESS )
+    {
+        printf( "Failed to create upload command pool!\n" );
+        return;
+    }
+
+    VkCommandBuffer commandBuffers[ UPLOAD_MAX_BATCHES ];
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = uploads->commandPool;
+    allocInfo.commandBufferCount = UPLOAD_MAX_BATCHES;
+
+    if ( vkAllocateCommandBuffers( device->device, &allocInfo, commandBuffers ) != VK_SUCCESS )
+    {
+        printf( "Failed to allocate upload command buffers!\n" );
+        return;
+    }
+
+    for ( u32 i = 0; i < UPLOAD_MAX_BATCHES; i++ )
+    {
+        uploads->batches[ i ] = {};
+        uploads->batches[ i ].commandBuffer = commandBuffers[ i ];
+    }
+
+    VkSemaphoreTypeCreateInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &timelineInfo;
+
+    if ( vkCreateSemaphore( device->device, &semaphoreInfo, 0, &uploads->timeline ) != VK_SUCCESS )
+    {
+        printf( "Failed to create upload timeline semaphore!\n" );
+        return;
+    }
+
+    CreateBuffer( device, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                  uploads->stagingBuffer, uploads->stagingAllocation );
+    uploads->stagingMemory = ( u8 * ) uploads->stagingAllocation.mapped;
+}
+
+static u64 GetCompletedValue( Upload_Manager *uploads )
+{
+    u64 value = 0;
+    vkGetSemaphoreCounterValue( uploads->device->device, uploads->timeline, &value );
+    return value;
+}
+
+static void WaitForTimeline( Upload_Manager *uploads, u64 value )
+{
+    VkSemaphoreWaitInfo waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &uploads->timeline;
+    waitInfo.pValues = &value;
+    vkWaitSemaphores( uploads->device->device, &waitInfo, UINT64_MAX );
+}
+
+static void RetireBatches( Upload_Manager *uploads, u64 completedValue )
+{
+    while ( uploads->submittedBatchCount > 0 )
+    {
+        Upload_Batch *batch = &uploads->batches[ uploads->firstBatch ];
+        if ( batch->timelineValue > completedValue )
+        {
+            break;
+        }
+
+        uploads->tail = batch->ringEnd;
+        uploads->firstBatch = ( uploads->firstBatch + 1 ) % UPLOAD_MAX_BATCHES;
+        uploads->submittedBatchCount--;
+    }
+}
+
+static void WaitForOldestBatch( Upload_Manager *uploads )
+{
+    Upload_Batch *batch = &uploads->batches[ uploads->firstBatch ];
+    WaitForTimeline( uploads, batch->timelineValue );
+    uploads->stats.stallCount++;
+    RetireBatches( uploads, batch->timelineValue );
+}
+
+static Upload_Batch *GetRecordingBatch( Upload_Manager *uploads )
+{
+    return &uploads->batches[ ( uploads->firstBatch + uploads->submittedBatchCount ) % UPLOAD_MAX_BATCHES ];
+}
+
+static Upload_Batch *BeginBatch( Upload_Manager *uploads )
+{
+    if ( uploads->recording )
+    {
+        return GetRecordingBatch( uploads );
+    }
+
+    RetireBatches( uploads, GetCompletedValue( uploads ) );
+    if ( uploads->submittedBatchCount == UPLOAD_MAX_BATCHES )
+    {
+        WaitForOldestBatch( uploads );
+    }
+
+    Upload_Batch *batch = GetRecordingBatch( uploads );
+    batch->timelineValue = uploads->nextTimelineValue;
+    batch->copyCount = 0;
+    batch->byteCount = 0;
+
+    vkResetCommandBuffer( batch->commandBuffer, 0 );
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer( batch->commandBuffer, &beginInfo );
+
+    uploads->recording = true;
+    return batch;
+}
+
+static void SubmitBatch( Upload_Manager *uploads )
+{
+    Upload_Batch *batch = GetRecordingBatch( uploads );
+    vkEndCommandBuffer( batch->commandBuffer );
+    batch->ringEnd = uploads->head;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &batch->timelineValue;
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch->commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &uploads->timeline;
+
+    if ( vkQueueSubmit( uploads->queue, 1, &submitInfo, VK_NULL_HANDLE ) != VK_SUCCESS )
+    {
+        printf( "Failed to submit upload batch!\n" );
+    }
+
+    uploads->recording = false;
+    uploads->submittedBatchCount++;
+    uploads->nextTimelineValue++;
+    uploads->stats.submitCount++;
+}
+
+// Returns the ring offset of a free staging range, recycling finished batches as needed
+static bool AllocateStaging( Upload_Manager *uploads, VkDeviceSize size, VkDeviceSize *offset )
+{
+    if ( size > uploads->stagingSize )
+    {
+        printf( "Upload of %llu bytes does not fit the staging ring!\n", ( unsigned long long ) size );
+        return false;
+    }
+
+    for ( ;; )
+    {
+        VkDeviceSize position = uploads->head % uploads->stagingSize;
+        VkDeviceSize aligned = AlignUp( position, uploads->copyAlignment );
+        if ( aligned + size > uploads->stagingSize )
+        {
+            aligned = uploads->stagingSize;
+        }
+        VkDeviceSize padding = aligned - position;
+        aligned %= uploads->stagingSize;
+
+        if ( uploads->head + padding + size - uploads->tail <= uploads->stagingSize )
+        {
+            uploads->head += padding + size;
+            *offset = aligned;
+            return true;
+        }
+
+        RetireBatches( uploads, GetCompletedValue( uploads ) );
+        if ( uploads->head + padding + size - uploads->tail <= uploads->stagingSize )
+        {
+            continue;
+        }
+
+        if ( uploads->recording && GetRecordingBatch( uploads )->copyCount > 0 )
+        {
+            SubmitBatch( uploads );
+        }
+
+        if ( uploads->submittedBatchCount == 0 )
+        {
+            // nothing left in flight, restart at the beginning of the empty ring
+            uploads->head = AlignUp( uploads->head, uploads->stagingSize );
+            uploads->tail = uploads->head;
+            continue;
+        }
+
+        WaitForOldestBatch( uploads );
+    }
+}
+
+static void EndCopy( Upload_Manager *uploads, Upload_Batch *batch, VkDeviceSize size )
+{
+    batch->copyCount++;
+    batch->byteCount += size;
+    uploads->stats.copyCount++;
+    uploads->stats.bytesUploaded += size;
+
+    // a single batch never holds more than half the ring, so the next one can fill while it is in flight
+    if ( batch->byteCount > uploads->stagingSize / 2 )
+    {
+        SubmitBatch( uploads );
+    }
+}
+
+Upload_Token UploadToBuffer( Upload_Manager *uploads, VkBuffer dstBuffer, VkDeviceSize dstOffset, void *data, VkDeviceSize size )
+{
+    TRACE_FUNCTION();
+    std::lock_guard< std::mutex > lock( uploads->mutex );
+
+    Upload_Token token = 0;
+    VkDeviceSize maxChunk = uploads->stagingSize / 4;
+    VkDeviceSize uploaded = 0;
+    while ( uploaded < size )
+    {
+        VkDeviceSize chunk = size - uploaded < maxChunk ? size - uploaded : maxChunk;
+
+        VkDeviceSize stagingOffset;
+        if ( !AllocateStaging( uploads, chunk, &stagingOffset ) )
+        {
+            return token;
+        }
+
+        Upload_Batch *batch = BeginBatch( uploads );
+        memcpy( uploads->stagingMemory + stagingOffset, ( u8 * ) data + uploaded, chunk );
+
+        VkBufferCopy copyRegion = {};
+        copyRegion.srcOffset = stagingOffset;
+        copyRegion.dstOffset = dstOffset + uploaded;
+        copyRegion.size = chunk;
+        vkCmdCopyBuffer( batch->commandBuffer, uploads->stagingBuffer, dstBuffer, 1, &copyRegion );
+
+        token = batch->timelineValue;
+        EndCopy( uploads, batch, chunk );
+        uploaded += chunk;
+    }
+
+    return token;
+}
+
+Upload_Token UploadDeviceLocalBuffer( Upload_Manager *uploads, void *data, VkDeviceSize size, VkBufferUsageFlags usage,
+                                      VkBuffer &buffer, Gpu_Allocation &bufferAllocation )
+{
+    TRACE_FUNCTION();
+    CreateBuffer( uploads->device, size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                  buffer, bufferAllocation );
+    if ( bufferAllocation.memory == VK_NULL_HANDLE )
+    {
+        DestroyBuffer( uploads->device, buffer, bufferAllocation );
+        buffer = VK_NULL_HANDLE;
+        return 0;
+    }
+
+    Upload_Token token = UploadToBuffer( uploads, buffer, 0, data, size );
+    if ( token == 0 )
+    {
+        printf( "Failed to upload device local buffer!\n" );
+        DestroyBuffer( uploads->device, buffer, bufferAllocation );
+        buffer = VK_NULL_HANDLE;
+    }
+    return token;
+}
+
+Upload_Token UploadToImage( Upload_Manager *uploads, VkImage image, u32 width, u32 height, u32 layerCount,
+                            void *data, VkDeviceSize size )
+{
+    TRACE_FUNCTION();
+    std::lock_guard< std::mutex > lock( uploads->mutex );
+
+    VkDeviceSize stagingOffset;
+    if ( !AllocateStaging( uploads, size, &stagingOffset ) )
+    {
+        return 0;
+    }
+
+    Upload_Batch *batch = BeginBatch( uploads );
+    memcpy( uploads->stagingMemory + stagingOffset, data, size );
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset = stagingOffset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = layerCount;
+
+    region.imageOffset = { 0, 0, 0 };
+    region.imageExtent = { width, height, 1 };
+
+    vkCmdCopyBufferToImage( batch->commandBuffer, uploads->stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region );
+
+    Upload_Token token = batch->timelineValue;
+    EndCopy( uploads, batch, size );
+    return token;
+}
+
+Upload_Token UploadToImageMip( Upload_Manager *uploads, VkImage image, u32 mipLevel, u32 width, u32 height, void *data,
+                               VkDeviceSize size, VkImageLayout finalLayout )
+{
+    TRACE_FUNCTION();
+    std::lock_guard< std::mutex > lock( uploads->mutex );
+
+    VkDeviceSize stagingOffset;
+    if ( !AllocateStaging( uploads, size, &stagingOffset ) )
+    {
+        return 0;
+    }
+
+    Upload_Batch *batch = BeginBatch( uploads );
+    memcpy( uploads->stagingMemory + stagingOffset, data, size );
+
+    // the old contents of the mip are overwritten, so it is discarded on the way in
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, mipLevel, 1, 0, 1 };
+    vkCmdPipelineBarrier( batch->commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0,
+                          0, 1, &barrier );
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset = stagingOffset;
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mipLevel, 0, 1 };
+    region.imageOffset = { 0, 0, 0 };
+    region.imageExtent = { width, height, 1 };
+    vkCmdCopyBufferToImage( batch->commandBuffer, uploads->stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region );
+
+    // consumers wait on the timeline on the CPU before they use the image, nothing to chain on this queue
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = finalLayout;
+    vkCmdPipelineBarrier( batch->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, 0,
+                          0, 0, 1, &barrier );
+
+    Upload_Token token = batch->timelineValue;
+    EndCopy( uploads, batch, size );
+    return token;
+}
+
+Upload_Token FlushUploads( Upload_Manager *uploads )
+{
+    TRACE_FUNCTION();
+    std::lock_guard< std::mutex > lock( uploads->mutex );
+
+    if ( uploads->recording )
+    {
+        if ( GetRecordingBatch( uploads )->copyCount == 0 )
+        {
+            return uploads->nextTimelineValue - 1;
+        }
+        SubmitBatch( uploads );
+    }
+
+    RetireBatches( uploads, GetCompletedValue( uploads ) );
+    return uploads->nextTimelineValue - 1;
+}
+
+bool IsUploadComplete( Upload_Manager *uploads, Upload_Token token )
+{
+    return GetCompletedValue( uploads ) >= token;
+}
+
+void WaitForUpload( Upload_Manager *uploads, Upload_Token token )
+{
+    TRACE_FUNCTION();
+    {
+        std::lock_guard< std::mutex > lock( uploads->mutex );
+        if ( uploads->recording && token >= uploads->nextTimelineValue )
+        {
+            SubmitBatch( uploads );
+        }
+    }
+
+    WaitForTimeline( uploads, token );
+}
+
+void DestroyUploadManager( Upload_Manager *uploads )
+{
+    Upload_Token last = FlushUploads( uploads );
+    WaitForTimeline( uploads, last );
+
+    VkDevice device = uploads->device->device;
+    DestroyBuffer( uploads->device, uploads->stagingBuffer, uploads->stagingAllocation );
+    vkDestroySemaphore( device, uploads->timeline, 0 );
+    vkDestroyCommandPool( device, uploads->commandPool, 0 );
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "device.h"
+#include "utils/utils.h"
+#include <mutex> //@TODO: Remove std garbage
+
+#define UPLOAD_STAGING_SIZE ( ( VkDeviceSize ) 64 << 20 )
+#define UPLOAD_MAX_BATCHES 16
+
+// Timeline semaphore value that is reached once the upload has landed on the GPU
+typedef u64 Upload_Token;
+
+struct Upload_Batch
+{
+    VkCommandBuffer commandBuffer;
+    u64 timelineValue;
+    VkDeviceSize ringEnd;
+    VkDeviceSize byteCount;
+    u32 copyCount;
+};
+
+struct Upload_Stats
+{
+    u64 bytesUploaded;
+    u64 copyCount;
+    u64 submitCount;
+    u64 stallCount;
+};
+
+struct Upload_Manager
+{
+    Device *device;
+    VkQueue queue;
+    u32 queueFamily;
+    VkCommandPool commandPool;
+    VkSemaphore timeline;
+
+    VkBuffer stagingBuffer;
+    Gpu_Allocation stagingAllocation;
+    u8 *stagingMemory;
+    VkDeviceSize stagingSize;
+    VkDeviceSize copyAlignment;
+
+    // head and tail only ever grow, the ring position is value % stagingSize
+    VkDeviceSize head;
+    VkDeviceSize tail;
+
+    Upload_Batch batches[ UPLOAD_MAX_BATCHES ];
+    u32 firstBatch;
+    u32 submittedBatchCount;
+    bool recording;
+    u64 nextTimelineValue;
+
+    Upload_Stats stats;
+    std::mutex mutex;
+};
+
+void InitUploadManager( Upload_Manager *uploads, Device *device, VkDeviceSize stagingSize );
+void DestroyUploadManager( Upload_Manager *uploads );
+
+Upload_Token UploadToBuffer( Upload_Manager *uploads, VkBuffer dstBuffer, VkDeviceSize dstOffset, void *data, VkDeviceSize size );
+
+// Creates a device local buffer and queues its contents through the staging ring, 0 and no buffer on failure.
+// Nothing may read or destroy the buffer before the token completes
+Upload_Token UploadDeviceLocalBuffer( Upload_Manager *uploads, void *data, VkDeviceSize size, VkBufferUsageFlags usage,
+                                      VkBuffer &buffer, Gpu_Allocation &bufferAllocation );
+
+// The image has to be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, same as CopyBufferToImage
+Upload_Token UploadToImage( Upload_Manager *uploads, VkImage image, u32 width, u32 height, u32 layerCount,
+                            void *data, VkDeviceSize size );
+
+// Uploads one mip level of an image that can start out in any layout, the transitions around the copy
+// leave that mip in finalLayout. Only the mip is touched, so the rest of the image can be filled later
+Upload_Token UploadToImageMip( Upload_Manager *uploads, VkImage image, u32 mipLevel, u32 width, u32 height, void *data,
+                               VkDeviceSize size, VkImageLayout finalLayout );
+
+// Submits everything recorded so far in a single vkQueueSubmit
+Upload_Token FlushUploads( Upload_Manager *uploads );
+
+bool IsUploadComplete( Upload_Manager *uploads, Upload_Token token );
+
+void WaitForUpload( Upload_Manager *uploads, Upload_Token token );
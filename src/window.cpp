@@ -2,13 +2,25 @@
 #include "glfw3.h"
 #include <stdio.h>
 
+static void FramebufferResizeCallback( GLFWwindow *glfwWindow, int width, int height )
+{
+    Window *window = ( Window * ) glfwGetWindowUserPointer( glfwWindow );
+    window->framebufferResized = true;
+    window->width = width;
+    window->height = height;
+}
+
 void InitWindow( Window *window )
 {
     glfwInit();
     glfwWindowHint( GLFW_CLIENT_API, GLFW_NO_API );
-    glfwWindowHint( GLFW_RESIZABLE, GLFW_FALSE );
+    glfwWindowHint( GLFW_RESIZABLE, GLFW_TRUE );
 
+    window->framebufferResized = false;
     window->window = glfwCreateWindow( window->width, window->height, window->windowName, 0, 0 );
+    glfwGetFramebufferSize( window->window, &window->width, &window->height );
+    glfwSetWindowUserPointer( window->window, window );
+    glfwSetFramebufferSizeCallback( window->window, FramebufferResizeCallback );
 }
 
 void DestroyWindow( Window *window )
@@ -29,3 +41,8 @@ VkExtent2D GetWindowExtent( Window *window )
 {
     return { ( u32 ) window->width, ( u32 ) window->height };
 }
+
+bool IsWindowMinimized( Window *window )
+{
+    return window->width == 0 || window->height == 0;
+}
@@ -10,6 +10,7 @@ struct Window
     int width;
     int height;
     char *windowName;
+    bool framebufferResized;
 };
 
 void InitWindow( Window *window );
@@ -18,3 +19,6 @@ void DestroyWindow( Window *window );
 void CreateWindowSurface( Window *window, VkInstance instance, VkSurfaceKHR *surface );
 
 VkExtent2D GetWindowExtent( Window *window );
+
+// A minimized window has a zero sized framebuffer and can't be rendered to
+bool IsWindowMinimized( Window *window );